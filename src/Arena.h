@@ -0,0 +1,183 @@
+/********************************************************************
+
+   Arena.h
+
+   Bump allocator for many small objects which are freed together,
+   and a pool of interned strings built on it.
+
+   Copyright (c) Microsoft Corporation. All rights reserved.
+   Licensed under the MIT License.
+
+********************************************************************/
+
+#pragma once
+
+#include <new>
+#include <memory>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <unordered_set>
+
+
+// Memory from Allocate stays valid until the arena is cleared or destroyed; nothing is freed one by one
+// and no destructors run.  Not thread safe; give each thread its own arena and Adopt them afterwards.
+class Arena
+{
+	std::vector<std::unique_ptr<char[]>> m_blocks;
+	char* m_pNext;
+	size_t m_cbLeft;
+	size_t m_cbUsed;
+
+public:
+	static constexpr size_t BLOCK_SIZE = 64 * 1024;
+
+	Arena() :
+		m_pNext(nullptr), m_cbLeft(0), m_cbUsed(0)
+	{
+	}
+
+	Arena(const Arena&) = delete;
+	Arena& operator=(const Arena&) = delete;
+
+	// returns nullptr when out of memory
+	void* Allocate(size_t cb, size_t alignment = alignof(std::max_align_t))
+	{
+		size_t cbPad = (alignment - reinterpret_cast<uintptr_t>(m_pNext) % alignment) % alignment;
+		if (m_pNext == nullptr || cbPad + cb > m_cbLeft)
+		{
+			// big requests get a block of their own so the current one isn't wasted
+			if (cb > BLOCK_SIZE / 4)
+				return AllocateBlock(cb + alignment, alignment, false);
+
+			if (!AllocateBlock(BLOCK_SIZE, alignment, true))
+				return nullptr;
+
+			cbPad = (alignment - reinterpret_cast<uintptr_t>(m_pNext) % alignment) % alignment;
+		}
+
+		void* p = m_pNext + cbPad;
+		m_pNext += cbPad + cb;
+		m_cbLeft -= cbPad + cb;
+		return p;
+	}
+
+	// takes over the memory of other, which is left empty
+	void Adopt(Arena& other)
+	{
+		m_blocks.insert(m_blocks.end(), std::make_move_iterator(other.m_blocks.begin()), std::make_move_iterator(other.m_blocks.end()));
+		m_cbUsed += other.m_cbUsed;
+
+		other.m_blocks.clear();
+		other.m_pNext = nullptr;
+		other.m_cbLeft = 0;
+		other.m_cbUsed = 0;
+	}
+
+	void Swap(Arena& other)
+	{
+		m_blocks.swap(other.m_blocks);
+		std::swap(m_pNext, other.m_pNext);
+		std::swap(m_cbLeft, other.m_cbLeft);
+		std::swap(m_cbUsed, other.m_cbUsed);
+	}
+
+	void Clear()
+	{
+		m_blocks.clear();
+		m_pNext = nullptr;
+		m_cbLeft = 0;
+		m_cbUsed = 0;
+	}
+
+	// bytes of the blocks held
+	size_t MemoryUsage() const
+	{
+		return m_cbUsed;
+	}
+
+private:
+	void* AllocateBlock(size_t cb, size_t alignment, bool fCurrent)
+	{
+		std::unique_ptr<char[]> block(new (std::nothrow) char[cb]);
+		if (!block)
+			return nullptr;
+
+		char* p = block.get();
+		try
+		{
+			m_blocks.push_back(std::move(block));
+		}
+		catch (const std::bad_alloc&)
+		{
+			return nullptr;
+		}
+
+		m_cbUsed += cb;
+		if (fCurrent)
+		{
+			m_pNext = p;
+			m_cbLeft = cb;
+		}
+		else
+		{
+			// the caller asked for cb - alignment bytes
+			p += (alignment - reinterpret_cast<uintptr_t>(p) % alignment) % alignment;
+		}
+
+		return p;
+	}
+};
+
+
+// Each distinct string is stored once; the views returned stay valid until the pool is cleared or destroyed.
+// Not thread safe.
+class StringPool
+{
+	Arena m_arena;
+	std::unordered_set<std::wstring_view> m_strings;
+
+public:
+	// throws std::bad_alloc when out of memory
+	std::wstring_view Intern(const std::wstring_view str)
+	{
+		auto itr = m_strings.find(str);
+		if (itr != m_strings.end())
+			return *itr;
+
+		auto pch = static_cast<wchar_t*>(m_arena.Allocate(str.size() * sizeof(wchar_t) + sizeof(wchar_t), alignof(wchar_t)));
+		if (pch == nullptr)
+			throw std::bad_alloc();
+
+		std::copy(str.cbegin(), str.cend(), pch);
+		std::wstring_view interned(pch, str.size());
+		m_strings.insert(interned);
+		return interned;
+	}
+
+	// takes over the strings of other (views from either stay valid); other is left empty
+	void Adopt(StringPool& other)
+	{
+		m_arena.Adopt(other.m_arena);
+		m_strings.insert(other.m_strings.cbegin(), other.m_strings.cend());
+		other.m_strings.clear();
+	}
+
+	void Swap(StringPool& other)
+	{
+		m_arena.Swap(other.m_arena);
+		m_strings.swap(other.m_strings);
+	}
+
+	void Clear()
+	{
+		m_strings = std::unordered_set<std::wstring_view>();
+		m_arena.Clear();
+	}
+
+	size_t size() const
+	{
+		return m_strings.size();
+	}
+};
@@ -0,0 +1,406 @@
+/********************************************************************
+
+   BagOTrie.h
+
+   Compressed (radix) trie variant of BagOValues.  Keys are collected
+   by Add and frozen by Sort into a trie whose edge labels live in one
+   character arena and whose values are stored once, in key order, so
+   that every trie node maps to a contiguous range of postings.
+
+   The node and label arrays contain only indices, so a frozen trie
+   can also be attached to arrays which live elsewhere (e.g. in a
+   mapped snapshot file).
+
+   Copyright (c) Microsoft Corporation. All rights reserved.
+   Licensed under the MIT License.
+
+********************************************************************/
+
+#pragma once
+
+#include <mutex>
+#include <vector>
+#include <string>
+#include <climits>
+#include <cstdint>
+#include <iterator>
+#include <algorithm>
+#include <string_view>
+
+#include "spinlock.h"
+#include "Arena.h"
+#include "wfcase.h"
+
+
+template <class TValue>
+class BagOTrie
+{
+	typedef std::pair<std::wstring_view, TValue> TPair;
+	typedef std::vector<TPair> TVector;
+
+public:
+	struct TrieNode
+	{
+		uint32_t labelOffset;		// offset of the edge label in the label arena
+		uint32_t labelLength;		// length of the edge label; 0 only for the root
+		uint32_t firstChild;		// children are contiguous and sorted by first label char
+		uint32_t childCount;
+		uint32_t postingsBegin;		// values for keys ending at this node start here
+		uint32_t postingsExactEnd;	// ... and end here
+		uint32_t postingsEnd;		// values for the whole subtree end here
+	};
+	static_assert(sizeof(TrieNode) == 7 * sizeof(uint32_t), "TrieNode is stored in snapshot files");
+
+private:
+	SpinLock m_spinlock;
+	TVector m_pending;					// Add()ed pairs not yet frozen by Sort(); keys are in m_keys
+	StringPool m_keys;					// lowered keys; a name like "bin" is stored once however often it is added
+	std::wstring m_lowered;				// scratch for Add
+	std::vector<TrieNode> m_nodes;		// storage for m_pNodes unless attached
+	std::vector<wchar_t> m_labels;		// storage for m_pLabels unless attached
+	std::vector<TValue> m_postings;		// values in key order
+
+	const TrieNode* m_pNodes;			// m_pNodes[0] is the root
+	size_t m_cNodes;
+	const wchar_t* m_pLabels;			// arena holding all edge labels
+	size_t m_cchLabels;
+
+public:
+	BagOTrie() :
+		m_pNodes(nullptr), m_cNodes(0), m_pLabels(nullptr), m_cchLabels(0)
+	{
+	}
+
+	// copies the value, but doesn't assume any memory management needs be done
+	void Add(const std::wstring_view key, TValue value)
+	{
+		std::lock_guard<SpinLock> guard(this->m_spinlock);
+		m_lowered.resize(key.size());
+		LowerCaseBuff(key.data(), &m_lowered[0], key.size());
+		m_pending.emplace_back(m_keys.Intern(m_lowered), value);
+	}
+
+	// builds the trie from everything added so far; the pending keys are released
+	void Sort()
+	{
+		std::lock_guard<SpinLock> guard(this->m_spinlock);
+
+		// merge what was frozen before with the new keys
+		if (m_cNodes != 0)
+			Flatten();
+
+		std::sort(m_pending.begin(), m_pending.end());
+
+		m_nodes.clear();
+		m_labels.clear();
+		m_postings.clear();
+		m_postings.reserve(m_pending.size());
+		for (const auto& pair : m_pending)
+			m_postings.push_back(pair.second);
+
+		m_nodes.push_back(TrieNode{ 0, 0, 0, 0, 0, 0, 0 });
+		BuildNode(0, 0, m_pending.size(), 0);
+
+		TVector().swap(m_pending);
+		m_keys.Clear();
+		m_nodes.shrink_to_fit();
+		m_labels.shrink_to_fit();
+		m_postings.shrink_to_fit();
+		Publish(m_nodes.data(), m_nodes.size(), m_labels.data(), m_labels.size());
+	}
+
+	// uses a frozen trie stored elsewhere; the arrays must outlive this bag (or the next Sort()).
+	// returns false (and leaves the bag empty) if the arrays do not form a valid trie.
+	bool Attach(const TrieNode* pNodes, size_t cNodes, const wchar_t* pLabels, size_t cchLabels, std::vector<TValue>&& postings)
+	{
+		std::lock_guard<SpinLock> guard(this->m_spinlock);
+
+		if (!IsValidTrie(pNodes, cNodes, cchLabels, postings.size()))
+			return false;
+
+		m_nodes.clear();
+		m_labels.clear();
+		m_postings = std::move(postings);
+		Publish(pNodes, cNodes, pLabels, cchLabels);
+		return true;
+	}
+
+	// exchanges the contents of two bags; used to publish a trie built elsewhere
+	void Swap(BagOTrie& other)
+	{
+		std::lock_guard<SpinLock> guardOther(other.m_spinlock);
+		std::lock_guard<SpinLock> guard(this->m_spinlock);
+		m_pending.swap(other.m_pending);
+		m_keys.Swap(other.m_keys);
+		m_nodes.swap(other.m_nodes);
+		m_labels.swap(other.m_labels);
+		m_postings.swap(other.m_postings);
+		std::swap(m_pNodes, other.m_pNodes);
+		std::swap(m_cNodes, other.m_cNodes);
+		std::swap(m_pLabels, other.m_pLabels);
+		std::swap(m_cchLabels, other.m_cchLabels);
+	}
+
+	// calls fn(key, value) for every frozen pair, in key order
+	template <class TFn>
+	void ForEachPair(TFn fn) const
+	{
+		if (m_cNodes == 0)
+			return;
+
+		std::wstring key;
+		ForEachPairNode(0, key, fn);
+	}
+
+	// the frozen trie, e.g. for writing it to a file
+	const TrieNode* Nodes() const { return m_pNodes; }
+	size_t NodeCount() const { return m_cNodes; }
+	const wchar_t* Labels() const { return m_pLabels; }
+	size_t LabelCount() const { return m_cchLabels; }
+	const std::vector<TValue>& Postings() const { return m_postings; }
+
+	// Same semantics as BagOValues::Retrieve:
+	// fPrefix = true returns the values of every key which starts with the query;
+	// fPrefix = false returns only the values of keys equal to the query.
+	// Results are in key order and there are at most maxResults of them.
+	auto Retrieve(const std::wstring_view query, bool fPrefix = true, unsigned maxResults = UINT_MAX) const
+	{
+		std::wstring lowered;
+		lowered.resize(query.size());
+		LowerCaseBuff(query.data(), &lowered[0], query.size());
+
+		std::vector<TValue> results;
+		if (m_cNodes == 0)
+			return results;
+
+		uint32_t iNode = 0;
+		size_t matched = 0;
+		while (matched < lowered.size())
+		{
+			const TrieNode& node = m_pNodes[iNode];
+			const TrieNode* first = m_pNodes + node.firstChild;
+			const TrieNode* last = first + node.childCount;
+			wchar_t ch = lowered[matched];
+			auto child = std::lower_bound(first, last, ch, [this](const TrieNode& n, wchar_t c) {
+				return m_pLabels[n.labelOffset] < c;
+			});
+			if (child == last || m_pLabels[child->labelOffset] != ch)
+				return results;
+
+			size_t cch = std::min<size_t>(child->labelLength, lowered.size() - matched);
+			if (lowered.compare(matched, cch, m_pLabels + child->labelOffset, cch) != 0)
+				return results;
+
+			iNode = static_cast<uint32_t>(child - m_pNodes);
+			matched += cch;
+
+			if (cch < child->labelLength)
+			{
+				// query ends in the middle of an edge; no key equals the query
+				if (!fPrefix)
+					return results;
+				break;
+			}
+		}
+
+		const TrieNode& node = m_pNodes[iNode];
+		size_t begin = node.postingsBegin;
+		size_t end = fPrefix ? node.postingsEnd : node.postingsExactEnd;
+		if (end - begin > maxResults)
+			end = begin + maxResults;
+
+		results.assign(m_postings.cbegin() + begin, m_postings.cbegin() + end);
+		return results;
+	}
+
+	// moves the keys added to other (and not yet sorted) into this bag
+	void Append(BagOTrie& other)
+	{
+		std::lock_guard<SpinLock> guardOther(other.m_spinlock);
+		std::lock_guard<SpinLock> guard(this->m_spinlock);
+		m_pending.insert(m_pending.end(), other.m_pending.cbegin(), other.m_pending.cend());
+		m_keys.Adopt(other.m_keys);
+		TVector().swap(other.m_pending);
+	}
+
+	// values of keys which start with the query's first char and contain the rest of the query
+	// in order (not necessarily adjacent); "wfg" finds "winfilegoto".  Includes all prefix matches.
+	auto RetrieveSubsequence(const std::wstring_view query, unsigned maxResults = UINT_MAX) const
+	{
+		std::wstring lowered;
+		lowered.resize(query.size());
+		LowerCaseBuff(query.data(), &lowered[0], query.size());
+
+		std::vector<TValue> results;
+		if (m_cNodes == 0 || lowered.empty())
+			return results;
+
+		// nodes still to visit with the number of query chars matched above them; children are
+		// pushed in reverse so they are visited in key order
+		std::vector<std::pair<uint32_t, size_t>> stack;
+		const TrieNode& root = m_pNodes[0];
+		for (uint32_t iChild = root.firstChild + root.childCount; iChild-- > root.firstChild; )
+		{
+			if (m_pLabels[m_pNodes[iChild].labelOffset] == lowered[0])
+				stack.emplace_back(iChild, 0);
+		}
+
+		while (!stack.empty() && results.size() < maxResults)
+		{
+			uint32_t iNode = stack.back().first;
+			size_t matched = stack.back().second;
+			stack.pop_back();
+
+			// matching greedily is enough to decide whether a subsequence exists
+			const TrieNode& node = m_pNodes[iNode];
+			const wchar_t* pLabel = m_pLabels + node.labelOffset;
+			for (uint32_t i = 0; i < node.labelLength && matched < lowered.size(); i++)
+			{
+				if (pLabel[i] == lowered[matched])
+					matched++;
+			}
+
+			if (matched == lowered.size())
+			{
+				// every key below here matches
+				size_t count = std::min<size_t>(node.postingsEnd - node.postingsBegin, maxResults - results.size());
+				results.insert(results.end(), m_postings.cbegin() + node.postingsBegin, m_postings.cbegin() + node.postingsBegin + count);
+				continue;
+			}
+
+			for (uint32_t iChild = node.firstChild + node.childCount; iChild-- > node.firstChild; )
+				stack.emplace_back(iChild, matched);
+		}
+
+		return results;
+	}
+
+	size_t size() const
+	{
+		return m_postings.size() + m_pending.size();
+	}
+
+	// bytes held by the trie (not counting the pending, unsorted keys)
+	size_t MemoryUsage() const
+	{
+		return m_nodes.capacity() * sizeof(TrieNode) +
+			m_labels.capacity() * sizeof(wchar_t) +
+			m_postings.capacity() * sizeof(TValue);
+	}
+
+private:
+	void Publish(const TrieNode* pNodes, size_t cNodes, const wchar_t* pLabels, size_t cchLabels)
+	{
+		m_pNodes = pNodes;
+		m_cNodes = cNodes;
+		m_pLabels = pLabels;
+		m_cchLabels = cchLabels;
+	}
+
+	// checks everything Retrieve and Flatten rely on, so a damaged file cannot send them out of bounds
+	static bool IsValidTrie(const TrieNode* pNodes, size_t cNodes, size_t cchLabels, size_t cPostings)
+	{
+		if (cNodes == 0 || pNodes[0].labelLength != 0 || pNodes[0].postingsBegin != 0 || pNodes[0].postingsEnd != cPostings)
+			return false;
+
+		for (size_t i = 0; i < cNodes; i++)
+		{
+			const TrieNode& node = pNodes[i];
+			if (node.labelOffset > cchLabels || node.labelLength > cchLabels - node.labelOffset ||
+				node.postingsBegin > node.postingsExactEnd || node.postingsExactEnd > node.postingsEnd ||
+				node.postingsEnd > cPostings)
+				return false;
+
+			// children come after their parent, so walking down always terminates
+			if (node.childCount != 0 &&
+				(node.firstChild <= i || node.firstChild > cNodes || node.childCount > cNodes - node.firstChild))
+				return false;
+
+			for (uint32_t iChild = node.firstChild; iChild < node.firstChild + node.childCount; iChild++)
+			{
+				const TrieNode& child = pNodes[iChild];
+				if (child.labelLength == 0 || child.postingsBegin < node.postingsExactEnd || child.postingsEnd > node.postingsEnd)
+					return false;
+			}
+		}
+
+		return true;
+	}
+
+	// keys [lo, hi) of m_pending share their first depth chars; fill in node iNode for them
+	void BuildNode(uint32_t iNode, size_t lo, size_t hi, size_t depth)
+	{
+		size_t i = lo;
+		while (i < hi && m_pending[i].first.size() == depth)
+			i++;
+
+		m_nodes[iNode].postingsBegin = static_cast<uint32_t>(lo);
+		m_nodes[iNode].postingsExactEnd = static_cast<uint32_t>(i);
+		m_nodes[iNode].postingsEnd = static_cast<uint32_t>(hi);
+
+		// the remaining keys group by their next char; one child per group
+		uint32_t childCount = 0;
+		for (size_t j = i; j < hi; childCount++)
+			j = GroupEnd(j, hi, depth);
+
+		uint32_t firstChild = static_cast<uint32_t>(m_nodes.size());
+		m_nodes[iNode].firstChild = firstChild;
+		m_nodes[iNode].childCount = childCount;
+		m_nodes.resize(m_nodes.size() + childCount);
+
+		for (uint32_t iChild = firstChild; i < hi; iChild++)
+		{
+			size_t groupEnd = GroupEnd(i, hi, depth);
+
+			// sorted, so the common prefix of the group is that of its first and last keys
+			std::wstring_view keyFirst = m_pending[i].first;
+			std::wstring_view keyLast = m_pending[groupEnd - 1].first;
+			size_t lcp = depth + 1;
+			while (lcp < keyFirst.size() && lcp < keyLast.size() && keyFirst[lcp] == keyLast[lcp])
+				lcp++;
+
+			m_nodes[iChild].labelOffset = static_cast<uint32_t>(m_labels.size());
+			m_nodes[iChild].labelLength = static_cast<uint32_t>(lcp - depth);
+			m_labels.insert(m_labels.end(), keyFirst.cbegin() + depth, keyFirst.cbegin() + lcp);
+
+			BuildNode(iChild, i, groupEnd, lcp);
+			i = groupEnd;
+		}
+	}
+
+	size_t GroupEnd(size_t i, size_t hi, size_t depth) const
+	{
+		wchar_t ch = m_pending[i].first[depth];
+		size_t j = i + 1;
+		while (j < hi && m_pending[j].first[depth] == ch)
+			j++;
+		return j;
+	}
+
+	// turn the frozen trie back into (key, value) pairs so more keys can be merged in
+	void Flatten()
+	{
+		ForEachPair([this](const std::wstring& key, const TValue& value) {
+			m_pending.emplace_back(m_keys.Intern(key), value);
+		});
+		Publish(nullptr, 0, nullptr, 0);
+		m_nodes.clear();
+		m_labels.clear();
+		m_postings.clear();
+	}
+
+	template <class TFn>
+	void ForEachPairNode(uint32_t iNode, std::wstring& key, TFn& fn) const
+	{
+		const TrieNode& node = m_pNodes[iNode];
+		key.append(m_pLabels + node.labelOffset, node.labelLength);
+
+		for (uint32_t i = node.postingsBegin; i < node.postingsExactEnd; i++)
+			fn(key, m_postings[i]);
+
+		for (uint32_t iChild = node.firstChild; iChild < node.firstChild + node.childCount; iChild++)
+			ForEachPairNode(iChild, key, fn);
+
+		key.resize(key.size() - node.labelLength);
+	}
+};
@@ -9,27 +9,35 @@
 
 #include <map>
 #include <mutex>
+#include <memory>
 #include <vector>
 #include <algorithm>
+#include <climits>
 #include <string_view>
 
 #include "spinlock.h"
+#include "wfcase.h"
 
 
+// Values added are invisible until Sort(), which publishes a new sorted, immutable snapshot.
+// Readers never take the lock; a reader keeps the snapshot it started with alive until it is done.
 template <class TValue>
 class BagOValues
 {
 	typedef std::pair<std::wstring, TValue> TPair;
 	typedef std::vector<TPair> TVector;
-	typedef typename TVector::const_iterator TItr;
 
-	SpinLock m_spinlock;
-	TVector m_Values;
-	std::wstring m_lastStr;
-	TItr m_LastItr;
+public:
+	typedef std::shared_ptr<const TVector> TSnapshot;
+
+private:
+	SpinLock m_spinlock;	// serializes writers (Add, Sort and Clear)
+	TVector m_pending;		// added since the last Sort
+	TSnapshot m_snapshot;	// use std::atomic_load/atomic_store
 
 public:
 	BagOValues()
+		: m_snapshot(std::make_shared<const TVector>())
 	{
 	}
 
@@ -39,48 +47,53 @@ public:
 		std::lock_guard<SpinLock> guard(this->m_spinlock);
 		std::wstring lowered;
 		lowered.resize(key.size());
-		std::transform(std::begin(key), std::end(key), std::begin(lowered), ::tolower);
-		m_Values.emplace_back(make_pair(std::move(lowered), value));
-
-		m_lastStr.resize(0);	// clear this after new data added
+		LowerCaseBuff(key.data(), &lowered[0], key.size());
+		m_pending.emplace_back(make_pair(std::move(lowered), value));
 	}
 
+	// merges the values added since the last Sort into a new snapshot and publishes it
 	void Sort()
 	{
 		std::lock_guard<SpinLock> guard(this->m_spinlock);
-		std::sort(m_Values.begin(), m_Values.end());
+		std::sort(m_pending.begin(), m_pending.end());
+
+		auto current = std::atomic_load(&m_snapshot);
+		auto values = std::make_shared<TVector>();
+		values->reserve(current->size() + m_pending.size());
+		std::merge(current->cbegin(), current->cend(), m_pending.cbegin(), m_pending.cend(), std::back_inserter(*values));
+		m_pending.clear();
+
+		std::atomic_store(&m_snapshot, TSnapshot(std::move(values)));
+	}
+
+	// removes all values, published or not
+	void Clear()
+	{
+		std::lock_guard<SpinLock> guard(this->m_spinlock);
+		m_pending.clear();
+		std::atomic_store(&m_snapshot, std::make_shared<const TVector>());
+	}
+
+	// the values as of the last Sort; a snapshot never changes, so it can be kept along with other
+	// state published at the same time and queried later
+	TSnapshot Snapshot() const
+	{
+		return std::atomic_load(&m_snapshot);
 	}
 
 	// Retrieve with fPrefix = true means return values for the tree at the point of the query matched; 
 	//      we must consume the whole query for anything to be returned
 	// fPrefix = false means that we only return values when an entire key matches and we match substrings of the query
-	//
-	// NOTE: returns a newly allocated vector; must delete it
-	auto Retrieve(const std::wstring_view query, bool fPrefix = true, unsigned maxResults = ULONG_MAX)
+	static auto Retrieve(const TSnapshot& snapshot, const std::wstring_view query, bool fPrefix = true, unsigned maxResults = UINT_MAX)
 	{
 		std::wstring lowered;
 		lowered.resize(query.size());
-		std::transform(std::cbegin(query), std::cend(query), std::begin(lowered), ::tolower);
+		LowerCaseBuff(query.data(), &lowered[0], query.size());
 
 		std::vector<TValue> results;
-		TValue val = TValue();
-		TPair laspair = make_pair(lowered, val);
-
-		std::lock_guard<SpinLock> guard(this->m_spinlock);
+		TPair laspair = make_pair(lowered, TValue());
 
-		// if last saved string/iterator is a prefix of the new string, start there
-		TItr itr;
-		if (m_lastStr.size() != 0 && lowered.compare(0, m_lastStr.size(), m_lastStr) == 0)
-			itr = m_LastItr;
-		else
-		{
-			itr = lower_bound(m_Values.begin(), m_Values.end(), laspair, CompareFirst);
-
-			m_lastStr = lowered;
-			m_LastItr = itr;
-		}
-
-		for (; itr != m_Values.end(); itr++)
+		for (auto itr = lower_bound(snapshot->begin(), snapshot->end(), laspair, CompareFirst); itr != snapshot->end(); itr++)
 		{
 			const auto& key = itr->first;
 			int cmp = key.compare(0, lowered.size(), lowered);
@@ -107,10 +120,15 @@ public:
 		return results;
 	}
 
+	// query on the current snapshot
+	auto Retrieve(const std::wstring_view query, bool fPrefix = true, unsigned maxResults = UINT_MAX) const
+	{
+		return Retrieve(Snapshot(), query, fPrefix, maxResults);
+	}
+
 private:
 	static bool CompareFirst(const TPair& a, const TPair& b)
 	{
 		return a.first < b.first;
 	}
 };
-
@@ -0,0 +1,243 @@
+/********************************************************************
+
+   bench_case.cpp
+
+   Time per name of the case folding and comparison in wfcase.c
+   (LowerCaseBuff, CompareOrdinalNoCase) against folding one character
+   at a time with towlower and comparing with lstrcmpi, as the code did
+   before.  Two corpora of file names: plain ASCII, and the same with
+   one name in eight carrying accented, Cyrillic or CJK characters.
+
+   Built with 16 bit WCHARs (HOST_WCHAR16, see host/windows.h), so it
+   doesn't link host.cpp; LCMapStringEx and CompareStringOrdinal, which
+   wfcase.c falls back on past ASCII, are here.
+
+   bench_case [names [rounds]]
+
+   Copyright (c) Microsoft Corporation. All rights reserved.
+   Licensed under the MIT License.
+
+********************************************************************/
+
+#include "winfile.h"
+#include <algorithm>
+#include <chrono>
+#include <clocale>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+	typedef std::basic_string<WCHAR> name;
+
+	const LPCWSTR c_rgszWords[] = {
+		u"Program Files", u"Documents", u"README", u"setup", u"IMG", u"Report", u"build", u"node_modules",
+		u"Microsoft.VisualStudio", u"System32", u"libcrypto", u"Backup", u"Invoice", u"DSC", u"notes", u"WindowsApps",
+	};
+
+	const LPCWSTR c_rgszExts[] = {
+		u".txt", u".JPG", u".dll", u".cpp", u".h", u".pdf", u".Docx", u".exe", u"",
+	};
+
+	const LPCWSTR c_rgszNonAscii[] = {
+		u"Résumé", u"Übersicht", u"año", u"Документы", u"写真", u"Ærø", u"ÇALIŞMA",
+	};
+
+	// towlower and towupper fold only ASCII in the C locale
+	locale_t g_locale;
+
+	WCHAR FoldCase(WCHAR ch, DWORD dwMapFlags)
+	{
+		return (WCHAR)(dwMapFlags & LCMAP_LOWERCASE ? towlower_l(ch, g_locale) : towupper_l(ch, g_locale));
+	}
+
+	name Number(UINT u)
+	{
+		std::string s = std::to_string(u);
+		return name(s.begin(), s.end());
+	}
+
+	std::vector<name> MakeNames(size_t cNames, bool fNonAscii)
+	{
+		std::mt19937 rng(1);
+		std::vector<name> names;
+
+		for (size_t i = 0; i < cNames; i++)
+		{
+			name s = c_rgszWords[rng() % COUNTOF(c_rgszWords)];
+			LPCWSTR szExt = c_rgszExts[rng() % COUNTOF(c_rgszExts)];
+
+			if (fNonAscii && rng() % 8 == 0)
+				s += u" " + name(c_rgszNonAscii[rng() % COUNTOF(c_rgszNonAscii)]) + u" " + Number(rng() % 1000);
+			else
+				s += u"_" + Number(rng() % 100000);
+			names.push_back(s + szExt);
+		}
+
+		return names;
+	}
+
+	// what lstrcmpi comes to on this host (wcscasecmp): towlower on each character, then by code point
+	int Lstrcmpi(LPCWSTR lpsz1, LPCWSTR lpsz2)
+	{
+		for (;; lpsz1++, lpsz2++)
+		{
+			wint_t ch1 = towlower_l(*lpsz1, g_locale);
+			wint_t ch2 = towlower_l(*lpsz2, g_locale);
+
+			if (ch1 != ch2)
+				return ch1 < ch2 ? -1 : 1;
+			if (ch1 == 0)
+				return 0;
+		}
+	}
+
+	int CompareReference(const name& s1, const name& s2)
+	{
+		return CompareStringOrdinal(s1.c_str(), -1, s2.c_str(), -1, TRUE) - CSTR_EQUAL;
+	}
+
+	int Sign(int i) { return i < 0 ? -1 : i > 0; }
+
+	void Fail(const char* szWhat, const name& s)
+	{
+		printf("FAILED: %s on \"%ls\"\n", szWhat, std::wstring(s.begin(), s.end()).c_str());
+		exit(1);
+	}
+
+	// best of cRounds, in ns per name
+	template <class TFn>
+	double Measure(size_t cNames, unsigned cRounds, TFn fn)
+	{
+		double tBest = 0;
+
+		for (unsigned iRound = 0; iRound < cRounds; iRound++)
+		{
+			auto tStart = std::chrono::steady_clock::now();
+			fn();
+			double t = std::chrono::duration<double>(std::chrono::steady_clock::now() - tStart).count();
+
+			if (iRound == 0 || t < tBest)
+				tBest = t;
+		}
+
+		return tBest * 1e9 / cNames;
+	}
+
+	void Run(const char* szCorpus, const std::vector<name>& names, unsigned cRounds)
+	{
+		std::vector<name> lowered(names);
+		volatile int iSink = 0;
+
+		// neighbours in name order share a prefix, as the comparisons of a sort mostly do
+		std::vector<name> sorted(names);
+		std::sort(sorted.begin(), sorted.end(), [](const name& s1, const name& s2) { return CompareReference(s1, s2) < 0; });
+
+		for (size_t i = 0; i < names.size(); i++)
+		{
+			name expected(names[i]);
+			for (auto& ch : expected)
+				ch = FoldCase(ch, LCMAP_LOWERCASE);
+
+			LowerCaseBuff(names[i].c_str(), &lowered[i][0], names[i].size());
+			if (lowered[i] != expected)
+				Fail("LowerCaseBuff", names[i]);
+
+			size_t j = (i * 7919) % names.size();
+			if (Sign(CompareOrdinalNoCase(names[i].c_str(), names[j].c_str())) != Sign(CompareReference(names[i], names[j])) ||
+				(i > 0 && Sign(CompareOrdinalNoCase(sorted[i - 1].c_str(), sorted[i].c_str())) != Sign(CompareReference(sorted[i - 1], sorted[i]))))
+			{
+				Fail("CompareOrdinalNoCase", names[i]);
+			}
+		}
+
+		size_t cch = 0;
+		for (const auto& s : names)
+			cch += s.size();
+
+		double tTowlower = Measure(names.size(), cRounds, [&]() {
+			for (size_t i = 0; i < names.size(); i++)
+			{
+				LPCWSTR pSrc = names[i].c_str();
+				LPWSTR pDst = &lowered[i][0];
+				for (size_t ich = 0; ich < names[i].size(); ich++)
+					pDst[ich] = (WCHAR)towlower_l(pSrc[ich], g_locale);
+			}
+		});
+		double tLower = Measure(names.size(), cRounds, [&]() {
+			for (size_t i = 0; i < names.size(); i++)
+				LowerCaseBuff(names[i].c_str(), &lowered[i][0], names[i].size());
+		});
+
+		double tLstrcmpi = Measure(names.size(), cRounds, [&]() {
+			int iSum = 0;
+			for (size_t i = 1; i < sorted.size(); i++)
+				iSum += Lstrcmpi(sorted[i - 1].c_str(), sorted[i].c_str()) < 0;
+			iSink = iSum;
+		});
+		double tCompare = Measure(names.size(), cRounds, [&]() {
+			int iSum = 0;
+			for (size_t i = 1; i < sorted.size(); i++)
+				iSum += CompareOrdinalNoCase(sorted[i - 1].c_str(), sorted[i].c_str()) < 0;
+			iSink = iSum;
+		});
+
+		printf("%-10s %5.1f chars/name   lower: towlower %5.1f  LowerCaseBuff %5.1f (%.1fx)   "
+			"compare: lstrcmpi %5.1f  CompareOrdinalNoCase %5.1f (%.1fx)\n",
+			szCorpus, (double)cch / names.size(), tTowlower, tLower, tTowlower / tLower, tLstrcmpi, tCompare, tLstrcmpi / tCompare);
+		(void)iSink;
+	}
+}
+
+extern "C" {
+
+INT LCMapStringEx(LPCWSTR, DWORD dwMapFlags, LPCWSTR lpSrcStr, INT cchSrc, LPWSTR lpDestStr, INT cchDest, LPVOID, LPVOID, LPARAM)
+{
+	if (cchSrc > cchDest)
+		return 0;
+
+	for (INT i = 0; i < cchSrc; i++)
+		lpDestStr[i] = FoldCase(lpSrcStr[i], dwMapFlags);
+	return cchSrc;
+}
+
+INT CompareStringOrdinal(LPCWSTR lpString1, INT cchCount1, LPCWSTR lpString2, INT cchCount2, BOOL bIgnoreCase)
+{
+	size_t cch1 = cchCount1 < 0 ? std::char_traits<WCHAR>::length(lpString1) : (size_t)cchCount1;
+	size_t cch2 = cchCount2 < 0 ? std::char_traits<WCHAR>::length(lpString2) : (size_t)cchCount2;
+
+	for (size_t i = 0; i < cch1 && i < cch2; i++)
+	{
+		WCHAR ch1 = bIgnoreCase ? FoldCase(lpString1[i], LCMAP_UPPERCASE) : lpString1[i];
+		WCHAR ch2 = bIgnoreCase ? FoldCase(lpString2[i], LCMAP_UPPERCASE) : lpString2[i];
+
+		if (ch1 != ch2)
+			return ch1 < ch2 ? CSTR_LESS_THAN : CSTR_GREATER_THAN;
+	}
+
+	return cch1 < cch2 ? CSTR_LESS_THAN : cch1 > cch2 ? CSTR_GREATER_THAN : CSTR_EQUAL;
+}
+
+}
+
+int main(int argc, char** argv)
+{
+	size_t cNames = argc > 1 ? atoi(argv[1]) : 200000;
+	unsigned cRounds = argc > 2 ? atoi(argv[2]) : 10;
+
+	setlocale(LC_CTYPE, "C.UTF-8");
+	g_locale = newlocale(LC_CTYPE_MASK, "C.UTF-8", (locale_t)0);
+	if (g_locale == (locale_t)0)
+	{
+		printf("no C.UTF-8 locale\n");
+		return 1;
+	}
+
+	printf("%zu names, best of %u, ns per name\n", cNames, cRounds);
+	Run("ascii", MakeNames(cNames, false), cRounds);
+	Run("non-ascii", MakeNames(cNames, true), cRounds);
+
+	return 0;
+}
@@ -0,0 +1,245 @@
+/********************************************************************
+
+   bench_cols.cpp
+
+   What the columns (XDTACOLS, wfcols.c) buy over reading the XDTA
+   chain, on one big synthetic listing (HostMakeListing, see host.h):
+
+   sort     ColsSort, against a stable merge sort of the chain's
+            entries with CompareDTA; each of the five sorts
+   select   the size and count of a selection (half the entries, in
+            name order), as GetDirSelData adds them up: from aqSize and
+            adwAttrs through the order, against from the XDTA records
+            through the sorted array SortDirList makes
+   filter   the files of one type (*.txt): by extension rank in adwExt,
+            against GetExtension and CompareOrdinalNoCase on each name
+            of the chain
+
+   Each pair must come to the same result.
+
+   bench_cols [entries [rounds]]
+
+   Copyright (c) Microsoft Corporation. All rights reserved.
+   Licensed under the MIT License.
+
+********************************************************************/
+
+#include "winfile.h"
+#include "host.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+namespace {
+	const struct {
+		DWORD dwSort;
+		const char* szName;
+	} c_rgSorts[] = {
+		{ IDD_NAME, "name" },
+		{ IDD_TYPE, "type" },
+		{ IDD_SIZE, "size" },
+		{ IDD_DATE, "date" },
+		{ IDD_FDATE, "fdate" },
+	};
+
+	const WCHAR c_szFilterExt[] = L"txt";
+
+	struct selection_totals {
+		INT cSelected;
+		LONGLONG qSize;
+
+		bool operator==(const selection_totals& other) const { return cSelected == other.cSelected && qSize == other.qSize; }
+	};
+
+	// best of cRounds, in ms
+	template <class TFn>
+	double Measure(unsigned cRounds, TFn fn)
+	{
+		double tBest = 0;
+
+		for (unsigned iRound = 0; iRound < cRounds; iRound++)
+		{
+			auto tStart = std::chrono::steady_clock::now();
+			fn();
+			double t = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - tStart).count();
+
+			if (iRound == 0 || t < tBest)
+				tBest = t;
+		}
+
+		return tBest;
+	}
+
+	std::vector<LPXDTA> ChainEntries(LPXDTALINK lpStart)
+	{
+		std::vector<LPXDTA> entries(MemLinkToHead(lpStart)->dwEntries);
+		LPXDTA lpxdta = MemFirst(lpStart);
+
+		for (DWORD i = 0; i < entries.size(); i++)
+		{
+			if (i != 0)
+				lpxdta = MemNext(&lpStart, lpxdta);
+			entries[i] = lpxdta;
+		}
+		return entries;
+	}
+
+	bool Fail(const char* szWhat)
+	{
+		printf("FAILED: %s\n", szWhat);
+		return false;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	DWORD cEntries = argc > 1 ? atoi(argv[1]) : 1000000;
+	unsigned cRounds = argc > 2 ? atoi(argv[2]) : 3;
+	bool fSame = true;
+
+	LPXDTALINK lpStart = HostMakeListing(cEntries);
+	if (lpStart == NULL)
+	{
+		printf("out of memory for %u entries\n", cEntries);
+		return 1;
+	}
+
+	PXDTACOLS pCols = NULL;
+	double tBuild = Measure(1, [&]() { pCols = ColsBuild(lpStart); });
+	MemLinkToHead(lpStart)->pCols = pCols;
+	if (pCols == NULL)
+	{
+		printf("ColsBuild failed\n");
+		return 1;
+	}
+
+	printf("%u entries, best of %u, ms\n", cEntries, cRounds);
+	printf("%-12s %10.1f\n", "ColsBuild", tBuild);
+	printf("%-12s %10s %10s\n", "", "columns", "chain");
+
+	// sort
+	std::vector<DWORD> aiOrder(cEntries);
+	std::vector<LPXDTA> sorted;
+	for (auto& sort : c_rgSorts)
+	{
+		double tCols = Measure(cRounds, [&]() {
+			if (!ColsSort(pCols, sort.dwSort, aiOrder.data()))
+				fSame = Fail("ColsSort out of memory");
+		});
+		double tChain = Measure(cRounds, [&]() {
+			sorted = ChainEntries(lpStart);
+			std::stable_sort(sorted.begin(), sorted.end(), [&sort](LPXDTA lpxdta1, LPXDTA lpxdta2) {
+				return CompareDTA(lpxdta1, lpxdta2, sort.dwSort) < 0;
+			});
+		});
+
+		for (DWORD i = 0; i < cEntries; i++)
+		{
+			if (pCols->alpxdta[aiOrder[i]] != sorted[i])
+			{
+				fSame = Fail(sort.szName);
+				break;
+			}
+		}
+
+		char szRow[32];
+		snprintf(szRow, sizeof(szRow), "sort %s", sort.szName);
+		printf("%-12s %10.1f %10.1f (%.1fx)\n", szRow, tCols, tChain, tChain / tCols);
+	}
+
+	// select: every other item of the name order, as the list box reports them
+	if (!ColsSort(pCols, IDD_NAME, aiOrder.data()))
+		return 1;
+	sorted = ChainEntries(lpStart);
+	std::stable_sort(sorted.begin(), sorted.end(), [](LPXDTA lpxdta1, LPXDTA lpxdta2) {
+		return CompareDTA(lpxdta1, lpxdta2, IDD_NAME) < 0;
+	});
+
+	std::vector<INT> selItems;
+	for (DWORD i = 0; i < cEntries; i += 2)
+		selItems.push_back(i);
+
+	selection_totals colsTotals{}, chainTotals{};
+	double tCols = Measure(cRounds, [&]() {
+		colsTotals = {};
+		for (INT iItem : selItems)
+		{
+			DWORD i = aiOrder[iItem];
+			if (pCols->adwAttrs[i] & ATTR_PARENT)
+				continue;
+			colsTotals.cSelected++;
+			colsTotals.qSize += pCols->aqSize[i];
+		}
+	});
+	double tChain = Measure(cRounds, [&]() {
+		chainTotals = {};
+		for (INT iItem : selItems)
+		{
+			LPXDTA lpxdta = sorted[iItem];
+			if (lpxdta->dwAttrs & ATTR_PARENT)
+				continue;
+			chainTotals.cSelected++;
+			chainTotals.qSize += lpxdta->qFileSize.QuadPart;
+		}
+	});
+
+	if (!(colsTotals == chainTotals))
+		fSame = Fail("selection totals");
+	printf("%-12s %10.2f %10.2f (%.1fx)   %d entries, %lld bytes\n",
+		"select", tCols, tChain, tChain / tCols, colsTotals.cSelected, (long long)colsTotals.qSize);
+
+	// filter: the rank of the extension is found once, from the first name which has it
+	std::vector<LPXDTA> colsMatches, chainMatches;
+	tCols = Measure(cRounds, [&]() {
+		colsMatches.clear();
+
+		DWORD dwRank = (DWORD)-1;
+		for (DWORD i = 0; i < cEntries; i++)
+		{
+			if (!(pCols->adwAttrs[i] & ATTR_DIR) && !CompareOrdinalNoCase(GetExtension(ColsGetName(pCols, i)), c_szFilterExt))
+			{
+				dwRank = pCols->adwExt[i];
+				break;
+			}
+		}
+
+		for (DWORD i = 0; i < cEntries; i++)
+		{
+			if (pCols->adwExt[i] == dwRank && !(pCols->adwAttrs[i] & ATTR_DIR))
+				colsMatches.push_back(pCols->alpxdta[i]);
+		}
+	});
+	tChain = Measure(cRounds, [&]() {
+		chainMatches.clear();
+
+		LPXDTALINK lpLink = lpStart;
+		LPXDTA lpxdta = MemFirst(lpStart);
+		for (DWORD i = 0; i < cEntries; i++)
+		{
+			if (i != 0)
+				lpxdta = MemNext(&lpLink, lpxdta);
+			if (!(lpxdta->dwAttrs & ATTR_DIR) && !CompareOrdinalNoCase(GetExtension(MemGetFileName(lpxdta)), c_szFilterExt))
+				chainMatches.push_back(lpxdta);
+		}
+	});
+
+	if (colsMatches != chainMatches)
+		fSame = Fail("filter");
+	char szRow[32];
+	snprintf(szRow, sizeof(szRow), "filter *.%ls", c_szFilterExt);
+	printf("%-12s %10.2f %10.2f (%.1fx)   %zu entries\n",
+		szRow, tCols, tChain, tChain / tCols, colsMatches.size());
+
+	MemDelete(lpStart);
+
+	if (!fSame)
+	{
+		printf("FAILED\n");
+		return 1;
+	}
+
+	printf("results identical\n");
+	return 0;
+}
@@ -0,0 +1,196 @@
+/********************************************************************
+
+   bench_mem.cpp
+
+   What the XDTA links of a listing cost in allocations and bytes: the
+   links as wfmem.c grows them now (doubling from 1K up to 1MB, from
+   VirtualAlloc once 64K or more), against fixed 1K links from the local
+   heap as it used to make them (OldMemAdd, copied here).  Both hold the
+   same entries: those of a synthetic listing (HostMakeListing, see
+   host.h), copied into 1K links in the same order.
+
+   held     bytes allocated, VirtualAlloc's in whole pages
+   touched  what MemSize counts: pages past the last entry of a
+            VirtualAlloc'd link are never touched, so take no memory
+   used     the entries themselves (XDTA records and their names)
+
+   WCHAR is 32 bits here, so the names take twice the bytes they do on
+   Windows; the local heap's own per-block overhead is not counted.
+
+   bench_mem [entries ...]
+
+   Copyright (c) Microsoft Corporation. All rights reserved.
+   Licensed under the MIT License.
+
+********************************************************************/
+
+#include "winfile.h"
+#include "host.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#define BLOCK_SIZE_GRANULARITY 1024     // as in wfmem.c
+#define ALIGNBLOCK(x) (((x)+7)&~7)
+
+namespace {
+	struct chain_costs {
+		DWORD cAllocs;
+		DWORD cVirtualAllocs;
+		DWORD cFrees;
+		DWORD cLinks;
+		SIZE_T cbHeld;
+		SIZE_T cbTouched;
+		SIZE_T cbUsed;
+	};
+
+	HOST_ALLOC_COUNTS Counts()
+	{
+		HOST_ALLOC_COUNTS counts;
+		HostGetAllocCounts(&counts);
+		return counts;
+	}
+
+	// wfmem.c's MemAdd before links grew: every link is BLOCK_SIZE_GRANULARITY from the local heap
+	LPXDTA OldMemAdd(LPXDTALINK* plpLast, UINT cchFileName, UINT cchAlternateFileName)
+	{
+		LPXDTA lpxdta;
+		UINT cbSpace;
+		LPXDTALINK lpLast = *plpLast;
+
+		cbSpace = ALIGNBLOCK((cchFileName + cchAlternateFileName + 2) * sizeof(WCHAR) + sizeof(XDTA));
+
+		if (cbSpace + lpLast->dwNextFree > BLOCK_SIZE_GRANULARITY)
+		{
+			lpLast->next = (LPXDTALINK)LocalAlloc(LMEM_FIXED, BLOCK_SIZE_GRANULARITY);
+
+			if (!lpLast->next)
+				return NULL;
+
+			lpLast = *plpLast = lpLast->next;
+
+			lpLast->next = NULL;
+			lpLast->dwSize = BLOCK_SIZE_GRANULARITY;	// so MemDelete frees it with LocalFree, as it did
+			lpLast->dwNextFree = ALIGNBLOCK(sizeof(XDTALINK));
+		}
+
+		lpxdta = (LPXDTA)((PBYTE)lpLast + lpLast->dwNextFree);
+
+		lpLast->dwNextFree += cbSpace;
+		lpxdta->dwSize = cbSpace;
+		lpxdta->cchFileNameOffset = cchFileName + 1;
+
+		return lpxdta;
+	}
+
+	// the entries of lpStart in 1K links, as the old MemAdd would have laid them out
+	LPXDTALINK CopyToOldLinks(LPXDTALINK lpStart)
+	{
+		LPXDTALINK lpOld = MemNew();
+		LPXDTALINK lpLast = lpOld;
+		DWORD cEntries = MemLinkToHead(lpStart)->dwEntries;
+		LPXDTA lpxdta = MemFirst(lpStart);
+
+		if (lpOld == NULL)
+			return NULL;
+
+		for (DWORD i = 0; i < cEntries; i++)
+		{
+			if (i != 0)
+				lpxdta = MemNext(&lpStart, lpxdta);
+
+			UINT cchFileName = (UINT)wcslen(MemGetFileName(lpxdta));
+			UINT cchAlternateFileName = (UINT)wcslen(MemGetAlternateFileName(lpxdta));
+			LPXDTA lpxdtaOld = OldMemAdd(&lpLast, cchFileName, cchAlternateFileName);
+			if (lpxdtaOld == NULL)
+			{
+				MemDelete(lpOld);
+				return NULL;
+			}
+
+			DWORD cbSpace = lpxdtaOld->dwSize;
+			memcpy(lpxdtaOld, lpxdta, cbSpace);
+			MemLinkToHead(lpOld)->dwEntries++;
+		}
+
+		return lpOld;
+	}
+
+	// what the chain from lpStart took to make (the counts from before and after it was made), then frees it
+	chain_costs Measure(LPXDTALINK lpStart, const HOST_ALLOC_COUNTS& before, HOST_ALLOC_COUNTS after)
+	{
+		chain_costs costs{};
+
+		costs.cAllocs = (after.cLocalAllocs - before.cLocalAllocs) + (after.cVirtualAllocs - before.cVirtualAllocs);
+		costs.cVirtualAllocs = after.cVirtualAllocs - before.cVirtualAllocs;
+		costs.cbHeld = (after.cbLocal - before.cbLocal) + (after.cbVirtual - before.cbVirtual);
+		costs.cbTouched = MemSize(lpStart);
+
+		for (LPXDTALINK lpLink = lpStart; lpLink; lpLink = lpLink->next)
+		{
+			costs.cLinks++;
+			costs.cbUsed += lpLink->dwNextFree - (lpLink == lpStart ? LINKHEADSIZE : ALIGNBLOCK(sizeof(XDTALINK)));
+		}
+
+		HOST_ALLOC_COUNTS beforeFree = Counts();
+		MemDelete(lpStart);
+		after = Counts();
+		costs.cFrees = (after.cLocalFrees - beforeFree.cLocalFrees) + (after.cVirtualFrees - beforeFree.cVirtualFrees);
+
+		return costs;
+	}
+
+	void Print(const char* szLinks, DWORD cEntries, const chain_costs& costs)
+	{
+		printf("%8u  %-10s %8u %8u %8u %8u %10.1f %10.1f %10.1f\n", cEntries, szLinks, costs.cLinks,
+			costs.cAllocs, costs.cVirtualAllocs, costs.cFrees, (double)costs.cbHeld / cEntries,
+			(double)costs.cbTouched / cEntries, (double)costs.cbUsed / cEntries);
+	}
+}
+
+int main(int argc, char** argv)
+{
+	std::vector<DWORD> sizes;
+	for (int i = 1; i < argc; i++)
+		sizes.push_back(atoi(argv[i]));
+	if (sizes.empty())
+		sizes = { 100, 5000, 1000000 };
+
+	printf("%8s  %-10s %8s %8s %8s %8s %10s %10s %10s\n", "", "", "", "", "of which", "", "held", "touched", "used");
+	printf("%8s  %-10s %8s %8s %8s %8s %10s %10s %10s\n", "entries", "policy", "links", "allocs", "virtual", "frees", "B/entry", "B/entry", "B/entry");
+
+	for (DWORD cEntries : sizes)
+	{
+		HOST_ALLOC_COUNTS before = Counts();
+		LPXDTALINK lpNew = HostMakeListing(cEntries);
+		if (lpNew == NULL)
+		{
+			printf("out of memory for %u entries\n", cEntries);
+			return 1;
+		}
+		HOST_ALLOC_COUNTS afterNew = Counts();
+
+		LPXDTALINK lpOld = CopyToOldLinks(lpNew);
+		if (lpOld == NULL)
+		{
+			printf("out of memory for %u entries\n", cEntries);
+			return 1;
+		}
+		HOST_ALLOC_COUNTS afterOld = Counts();
+
+		chain_costs oldCosts = Measure(lpOld, afterNew, afterOld);
+		chain_costs newCosts = Measure(lpNew, before, afterNew);
+
+		Print("1K", cEntries, oldCosts);
+		Print("geometric", cEntries, newCosts);
+
+		if (oldCosts.cFrees != oldCosts.cAllocs || newCosts.cFrees != newCosts.cAllocs || oldCosts.cbUsed != newCosts.cbUsed)
+		{
+			printf("FAILED: allocations not all freed, or the chains hold different entries\n");
+			return 1;
+		}
+	}
+
+	return 0;
+}
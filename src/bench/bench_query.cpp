@@ -0,0 +1,150 @@
+/********************************************************************
+
+   bench_query.cpp
+
+   Go To query throughput with 1 to 8 threads querying one bag at the
+   same time, with the bag left alone and with a writer adding and
+   removing directories (and compacting) the whole time, as
+   ChangeFileSystem does on a busy drive.
+
+   bench_query [fanout [depth [seconds per run]]]
+
+   Copyright (c) Microsoft Corporation. All rights reserved.
+   Licensed under the MIT License.
+
+********************************************************************/
+
+#include "wfgoto.cpp"
+#include "host.h"
+#include <cstdio>
+#include <cstdlib>
+#include <time.h>
+
+namespace {
+	const LPCWSTR c_rgszQueries[] = {
+		L"s", L"sr", L"src", L"do", L"doc", L"bin de", L"tools x", L"src\\te", L"'release", L"web api",
+	};
+
+	double ThreadCpuSeconds()
+	{
+		struct timespec ts;
+		clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+		return ts.tv_sec + ts.tv_nsec / 1e9;
+	}
+
+	struct run_result {
+		double queriesPerSecond;
+		double queriesPerCpuSecond;		// of the query threads' CPU time
+		size_t cChanges;
+		size_t cCompactions;
+		double writerCpu;		// fraction of the run's CPU time the writer used
+	};
+
+	run_result Run(const std::shared_ptr<values_bag>& pBag, unsigned cThreads, bool fWriter, double seconds)
+	{
+		std::atomic_bool fStop{ false };
+		std::atomic_size_t cQueries{ 0 };
+		size_t cChanges = 0;
+		size_t cCompactions = 0;
+		double tWriter = 0;
+		std::mutex lockReaders;
+		double tReaders = 0;
+
+		std::vector<std::thread> threads;
+		for (unsigned iThread = 0; iThread < cThreads; iThread++)
+		{
+			threads.emplace_back([&pBag, &fStop, &cQueries, &lockReaders, &tReaders, iThread]() {
+				query_cancel cancel{ nullptr, 0 };
+				size_t cLocal = 0;
+				for (size_t i = iThread; !fStop; i++)
+				{
+					BOOL bLimited = FALSE;
+					GetDirectoryOptionsFromText(pBag, c_rgszQueries[i % std::size(c_rgszQueries)], &bLimited, cancel);
+					cLocal++;
+				}
+				cQueries += cLocal;
+
+				std::lock_guard<std::mutex> guard(lockReaders);
+				tReaders += ThreadCpuSeconds();
+			});
+		}
+
+		std::thread writer;
+		if (fWriter)
+		{
+			// new directories under existing ones, half of them removed again
+			writer = std::thread([&pBag, &fStop, &cChanges, &cCompactions, &tWriter]() {
+				WCHAR szParent[MAXPATHLEN];
+				WCHAR szPath[MAXPATHLEN];
+				for (size_t i = 0; !fStop; i++)
+				{
+					GetTreePath(pBag->allNodes[(i * 7919) % 100000 % pBag->allNodes.size()], szParent);
+					swprintf(szPath, COUNTOF(szPath), L"%ls\\added %zu", szParent, i);
+
+					pBag->AddDirectoryNode(szPath, pBag);
+					if (i % 2)
+						pBag->RemoveDirectoryNode(szPath);
+					cChanges += 1 + i % 2;
+
+					if (pBag->NeedsCompaction())
+					{
+						pBag->Compact();
+						cCompactions++;
+					}
+
+					std::this_thread::sleep_for(std::chrono::microseconds(200));
+				}
+
+				tWriter = ThreadCpuSeconds();
+			});
+		}
+
+		double t = HostNow();
+		std::this_thread::sleep_for(std::chrono::duration<double>(seconds));
+		fStop = true;
+		for (auto& thread : threads)
+			thread.join();
+		if (writer.joinable())
+			writer.join();
+		t = HostNow() - t;
+
+		return run_result{ cQueries / t, cQueries / tReaders, cChanges, cCompactions, tWriter / (t * std::thread::hardware_concurrency()) };
+	}
+}
+
+int main(int argc, char** argv)
+{
+	UINT cFanout = argc > 1 ? atoi(argv[1]) : 12;
+	UINT cDepth = argc > 2 ? atoi(argv[2]) : 5;
+	double seconds = argc > 3 ? atof(argv[3]) : 3;
+
+	HostSetTree(cFanout, cDepth, 0);
+
+	std::atomic_uint32_t scanEpoc{ 0 };
+	auto pBag = std::make_shared<values_bag>();
+	directory_scanner scanner(GetScanWorkerCount(), scanEpoc, 0, GOTO_LOCAL_MAX_NODES);
+	scanner.Scan(*pBag, L"T:\\");
+	pBag->BagOCDrive.Sort();
+	pBag->Label();
+	printf("%zu directories, %u CPUs, %.0f s per run\n\n", pBag->allNodes.size(), std::thread::hardware_concurrency(), seconds);
+
+	// the runs without the writer first, while the bag is as the scan left it
+	std::vector<run_result> idle, busy;
+	for (unsigned cThreads = 1; cThreads <= 8; cThreads *= 2)
+		idle.push_back(Run(pBag, cThreads, false, seconds));
+	for (unsigned cThreads = 1; cThreads <= 8; cThreads *= 2)
+		busy.push_back(Run(pBag, cThreads, true, seconds));
+	run_result after = Run(pBag, 1, false, seconds);
+	auto pView = pBag->GetView();
+
+	printf("%-8s %12s %12s %12s %12s %10s %12s %12s\n", "", "", "per CPU s", "with writer", "per CPU s", "", "", "");
+	printf("%-8s %12s %12s %12s %12s %10s %12s %12s\n", "threads", "queries/s", "(queries)", "queries/s", "(queries)", "changes", "compactions", "writer CPU");
+	for (unsigned cThreads = 1, i = 0; cThreads <= 8; cThreads *= 2, i++)
+		printf("%-8u %12.0f %12.0f %12.0f %12.0f %10zu %12zu %11.0f%%\n", cThreads, idle[i].queriesPerSecond, idle[i].queriesPerCpuSecond,
+			busy[i].queriesPerSecond, busy[i].queriesPerCpuSecond, busy[i].cChanges, busy[i].cCompactions, busy[i].writerCpu * 100);
+
+	printf("\n1 thread, no writer, after the changes (%zu in the overlay, %zu removed): %.0f queries/s\n",
+		pView->overlayNodes->size(), pView->removedNodes->size(), after.queriesPerSecond);
+
+	return 0;
+}
@@ -0,0 +1,116 @@
+/********************************************************************
+
+   bench_rank.cpp
+
+   Latency of ranked Go To queries (GetRankedDirectoryOptions) on an
+   index of millions of directories from a synthetic tree (see host.h),
+   typed one character at a time as the dialog sends them.  Unranked
+   queries (GetDirectoryOptionsFromText) are shown for comparison.
+
+   bench_rank [fanout [depth [rounds]]]
+
+   Copyright (c) Microsoft Corporation. All rights reserved.
+   Licensed under the MIT License.
+
+********************************************************************/
+
+#include "wfgoto.cpp"
+#include "host.h"
+#include <cstdio>
+#include <cstdlib>
+
+namespace {
+	// what people type: words, fuzzy abbreviations, a path and an exact match
+	const LPCWSTR c_rgszQueries[] = {
+		L"src",
+		L"documents",
+		L"dcmnts",
+		L"bin debug",
+		L"tools x64",
+		L"src\\test",
+		L"'release",
+		L"web api services",
+	};
+
+	double Percentile(std::vector<double> samples, double p)
+	{
+		std::sort(samples.begin(), samples.end());
+		return samples[(size_t)(p * (samples.size() - 1))];
+	}
+}
+
+int main(int argc, char** argv)
+{
+	UINT cFanout = argc > 1 ? atoi(argv[1]) : 18;
+	UINT cDepth = argc > 2 ? atoi(argv[2]) : 5;
+	unsigned cRounds = argc > 3 ? atoi(argv[3]) : 3;
+
+	HostSetTree(cFanout, cDepth, 0);
+
+	// as BuildDirectoryTreeBagOValues builds a bag
+	std::atomic_uint32_t scanEpoc{ 0 };
+	auto pBag = std::make_shared<values_bag>();
+	directory_scanner scanner(GetScanWorkerCount(), scanEpoc, 0, GOTO_LOCAL_MAX_NODES);
+	double t = HostNow();
+	scanner.Scan(*pBag, L"T:\\");
+	pBag->BagOCDrive.Sort();
+	pBag->Label();
+	t = HostNow() - t;
+	printf("%zu directories, %zu keys, indexed in %.1f s\n", pBag->allNodes.size(), pBag->BagOCDrive.size(), t);
+
+	// a full history of directories spread over the tree
+	goto_history history;
+	WCHAR szPath[MAXPATHLEN];
+	for (size_t i = 0; i < 20; i++)
+	{
+		GetTreePath(pBag->allNodes[(i * 7919 * 7919) % pBag->allNodes.size()], szPath);
+		history.emplace_back(szPath);
+	}
+
+	query_cancel cancel{ nullptr, 0 };
+	recent_cache recentCache;
+
+	// the first query resolves the history; later ones find it in recentCache
+	BOOL bLimited = FALSE;
+	size_t cTotal;
+	t = HostNow();
+	GetRankedDirectoryOptions(pBag, L"s", history, recentCache, &bLimited, GOTO_RANK_SHOWN, &cTotal, cancel);
+	printf("first ranked query (resolves the history): %.2f ms\n\n", (HostNow() - t) * 1e3);
+
+	printf("%-18s %10s %10s %10s %12s %12s\n", "typed", "ranked p50", "p95", "max", "candidates", "unranked p50");
+
+	std::vector<double> allRanked, allUnranked;
+	for (LPCWSTR szQuery : c_rgszQueries)
+	{
+		std::vector<double> ranked, unranked;
+		size_t cTotalLast = 0;
+
+		for (unsigned iRound = 0; iRound < cRounds; iRound++)
+		{
+			std::wstring typed;
+			for (LPCWSTR pch = szQuery; *pch; pch++)
+			{
+				typed.push_back(*pch);
+
+				t = HostNow();
+				GetRankedDirectoryOptions(pBag, typed.c_str(), history, recentCache, &bLimited, GOTO_RANK_SHOWN, &cTotalLast, cancel);
+				ranked.push_back((HostNow() - t) * 1e3);
+
+				t = HostNow();
+				GetDirectoryOptionsFromText(pBag, typed.c_str(), &bLimited, cancel);
+				unranked.push_back((HostNow() - t) * 1e3);
+			}
+		}
+
+		printf("%-18ls %8.2fms %8.2fms %8.2fms %12zu %10.2fms\n", szQuery,
+			Percentile(ranked, 0.5), Percentile(ranked, 0.95), Percentile(ranked, 1.0), cTotalLast, Percentile(unranked, 0.5));
+
+		allRanked.insert(allRanked.end(), ranked.begin(), ranked.end());
+		allUnranked.insert(allUnranked.end(), unranked.begin(), unranked.end());
+	}
+
+	printf("%-18s %8.2fms %8.2fms %8.2fms %12s %10.2fms\n", "all keystrokes",
+		Percentile(allRanked, 0.5), Percentile(allRanked, 0.95), Percentile(allRanked, 1.0), "", Percentile(allUnranked, 0.5));
+
+	return 0;
+}
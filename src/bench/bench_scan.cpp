@@ -0,0 +1,55 @@
+/********************************************************************
+
+   bench_scan.cpp
+
+   Directories per second the Go To scanner reads with 1 to 8 workers,
+   on a synthetic tree (see host.h).  With a latency every directory
+   read waits that long, as it would on a disk, so workers overlap
+   their waits even where there are fewer CPUs than workers.
+
+   bench_scan [fanout [depth [latency in us [files per directory]]]]
+
+   Copyright (c) Microsoft Corporation. All rights reserved.
+   Licensed under the MIT License.
+
+********************************************************************/
+
+#include "wfgoto.cpp"
+#include "host.h"
+#include <cstdio>
+#include <cstdlib>
+
+int main(int argc, char** argv)
+{
+	UINT cFanout = argc > 1 ? atoi(argv[1]) : 8;
+	UINT cDepth = argc > 2 ? atoi(argv[2]) : 4;
+	UINT cLatency = argc > 3 ? atoi(argv[3]) : 0;
+	UINT cFiles = argc > 4 ? atoi(argv[4]) : 0;
+
+	HostSetTree(cFanout, cDepth, cFiles);
+	HostSetFindLatency(cLatency);
+
+	printf("fanout %u, depth %u, %u us per directory, %u files per directory, %u CPUs\n",
+		cFanout, cDepth, cLatency, cFiles, std::thread::hardware_concurrency());
+
+	double tOne = 0;
+	for (unsigned cWorkers = 1; cWorkers <= MAX_SCAN_WORKERS; cWorkers *= 2)
+	{
+		std::atomic_uint32_t scanEpoc{ 0 };
+		values_bag bag;
+		directory_scanner scanner(cWorkers, scanEpoc, 0, GOTO_LOCAL_MAX_NODES);
+
+		double t = HostNow();
+		scanner.Scan(bag, L"T:\\");
+		bag.BagOCDrive.Sort();
+		t = HostNow() - t;
+
+		if (cWorkers == 1)
+			tOne = t;
+
+		printf("%u workers %10zu directories %9.3f s %12.0f directories/s %6.2fx\n",
+			cWorkers, bag.allNodes.size(), t, bag.allNodes.size() / t, tOne / t);
+	}
+
+	return 0;
+}
@@ -0,0 +1,171 @@
+/********************************************************************
+
+   bench_sort.cpp
+
+   Time to put a directory listing in name, size and date order: the
+   binary insertion SortDirList does into an array of its own (copied
+   here from wfdir.c; CompareDTA is in host.cpp), against the sort kept
+   with the columns (ColsBuild, then ColsGetOrder in wfcols.c).  The two
+   orders must be the same, entry for entry.
+
+   The listings are synthetic (HostMakeListing, see host.h), read in
+   no particular order.  NTFS returns names in order, which SortDirList
+   takes a shortcut for; FAT and network drives don't.
+
+   bench_sort [entries ...]
+
+   Copyright (c) Microsoft Corporation. All rights reserved.
+   Licensed under the MIT License.
+
+********************************************************************/
+
+#include "winfile.h"
+#include "host.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+namespace {
+	const struct {
+		DWORD dwSort;
+		const char* szName;
+	} c_rgSorts[] = {
+		{ IDD_NAME, "name" },
+		{ IDD_SIZE, "size" },
+		{ IDD_DATE, "date" },
+	};
+
+	// wfdir.c's SortDirList, given the sort rather than the window to read it from
+	VOID SortDirList(DWORD dwSort, LPXDTALINK lpStart, DWORD count, LPXDTA* lplpxdta)
+	{
+		INT i, j;
+		INT iMax, iMin, iMid;
+		LPXDTA lpxdta;
+
+		lpxdta = MemFirst(lpStart);
+		lplpxdta[0] = lpxdta;
+
+		for (i = 1; i < (INT)count; i++)
+		{
+			lpxdta = MemNext(&lpStart, lpxdta);
+
+			if (IDD_NAME == dwSort && CompareDTA(lpxdta, lplpxdta[i - 1], IDD_NAME) >= 0)
+			{
+				lplpxdta[i] = lpxdta;
+				continue;
+			}
+
+			iMin = 0;
+			iMax = i - 1;
+
+			do
+			{
+				iMid = (iMax + iMin) / 2;
+				if (CompareDTA(lpxdta, lplpxdta[iMid], dwSort) > 0)
+					iMin = iMid + 1;
+				else
+					iMax = iMid - 1;
+			} while (iMax > iMin);
+
+			if (iMax < 0)
+				iMax = 0;
+
+			if (CompareDTA(lpxdta, lplpxdta[iMax], dwSort) > 0)
+				iMax++;
+
+			if (i != iMax)
+			{
+				for (j = i; j > iMax; j--)
+					lplpxdta[j] = lplpxdta[j - 1];
+			}
+			lplpxdta[iMax] = lpxdta;
+		}
+	}
+
+	template <class TFn>
+	double Milliseconds(TFn fn)
+	{
+		auto tStart = std::chrono::steady_clock::now();
+		fn();
+		return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - tStart).count();
+	}
+
+	bool Run(DWORD cEntries)
+	{
+		LPXDTALINK lpStart = HostMakeListing(cEntries);
+		if (lpStart == NULL)
+		{
+			printf("out of memory for %u entries\n", cEntries);
+			return false;
+		}
+
+		PXDTACOLS pCols = NULL;
+		double tBuild = Milliseconds([&]() { pCols = ColsBuild(lpStart); });
+		MemLinkToHead(lpStart)->pCols = pCols;
+		if (pCols == NULL)
+		{
+			printf("ColsBuild failed for %u entries\n", cEntries);
+			MemDelete(lpStart);
+			return false;
+		}
+
+		printf("%8u entries, ColsBuild %8.1f ms\n", cEntries, tBuild);
+
+		bool fSame = true;
+		std::vector<LPXDTA> sorted(cEntries);
+		for (auto& sort : c_rgSorts)
+		{
+			LPDWORD aiOrder = NULL;
+			double tOld = Milliseconds([&]() { SortDirList(sort.dwSort, lpStart, cEntries, sorted.data()); });
+			double tNew = Milliseconds([&]() { aiOrder = ColsGetOrder(pCols, sort.dwSort); });
+
+			if (aiOrder == NULL)
+			{
+				printf("ColsGetOrder failed for the %s sort\n", sort.szName);
+				fSame = false;
+				continue;
+			}
+
+			for (DWORD i = 0; i < cEntries; i++)
+			{
+				if (pCols->alpxdta[aiOrder[i]] != sorted[i])
+				{
+					printf("FAILED: %s sort differs at %u: \"%ls\" for \"%ls\"\n", sort.szName, i,
+						MemGetFileName(pCols->alpxdta[aiOrder[i]]), MemGetFileName(sorted[i]));
+					fSame = false;
+					break;
+				}
+			}
+
+			printf("%8s %4s   SortDirList %10.1f ms   ColsGetOrder %8.1f ms (%.0fx)\n",
+				"", sort.szName, tOld, tNew, tOld / tNew);
+		}
+
+		MemDelete(lpStart);
+		return fSame;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	std::vector<DWORD> sizes;
+	for (int i = 1; i < argc; i++)
+		sizes.push_back(atoi(argv[i]));
+	if (sizes.empty())
+		sizes = { 10000, 100000, 1000000 };
+
+	bool fSame = true;
+	for (DWORD cEntries : sizes)
+		fSame = Run(cEntries) && fSame;
+
+	if (!fSame)
+	{
+		printf("FAILED\n");
+		return 1;
+	}
+
+	printf("orders identical\n");
+	return 0;
+}
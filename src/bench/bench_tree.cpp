@@ -0,0 +1,101 @@
+/********************************************************************
+
+   bench_tree.cpp
+
+   Time to intersect candidate sets of 100 to 10000 directories per
+   word, as a two word Go To query does: TreeIntersection with the
+   bag's interval labels and with path comparisons (what nodes added
+   since labelling get), and FilterBySubtree for "word\word" queries.
+   The candidates come from a synthetic tree (see host.h).
+
+   bench_tree [fanout [depth [rounds]]]
+
+   Copyright (c) Microsoft Corporation. All rights reserved.
+   Licensed under the MIT License.
+
+********************************************************************/
+
+#include "wfgoto.cpp"
+#include "host.h"
+#include <cstdio>
+#include <cstdlib>
+
+namespace {
+	const LPCWSTR c_rgszPairs[][2] = {
+		{ L"src", L"test" },
+		{ L"bin", L"debug" },
+		{ L"web", L"api" },
+	};
+
+	// microseconds per call, best of cRounds; fn gets fresh copies of the sets since merging sorts them
+	template <class TFn>
+	double Measure(const std::vector<std::vector<PDNODE>>& sets, unsigned cRounds, size_t& cResult, TFn fn)
+	{
+		double tBest = 0;
+
+		for (unsigned iRound = 0; iRound < cRounds; iRound++)
+		{
+			std::vector<std::vector<PDNODE>> copy(sets);
+
+			double t = HostNow();
+			cResult = fn(copy).size();
+			t = HostNow() - t;
+
+			if (iRound == 0 || t < tBest)
+				tBest = t;
+		}
+
+		return tBest * 1e6;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	UINT cFanout = argc > 1 ? atoi(argv[1]) : 14;
+	UINT cDepth = argc > 2 ? atoi(argv[2]) : 5;
+	unsigned cRounds = argc > 3 ? atoi(argv[3]) : 20;
+
+	HostSetTree(cFanout, cDepth, 0);
+
+	std::atomic_uint32_t scanEpoc{ 0 };
+	auto pBag = std::make_shared<values_bag>();
+	directory_scanner scanner(GetScanWorkerCount(), scanEpoc, 0, GOTO_LOCAL_MAX_NODES);
+	scanner.Scan(*pBag, L"T:\\");
+	pBag->BagOCDrive.Sort();
+	pBag->Label();
+	auto pView = pBag->GetView();
+	printf("%zu directories\n\n", pBag->allNodes.size());
+
+	printf("%-12s %12s %14s %14s %8s %14s %8s\n", "words", "candidates", "intervals us", "paths us", "found", "subtree us", "found");
+	for (unsigned cMax : { 100u, 1000u, 10000u })
+	{
+		for (const auto& pair : c_rgszPairs)
+		{
+			std::vector<std::vector<PDNODE>> sets;
+			sets.push_back(pBag->Retrieve(*pView, pair[0], true, cMax));
+			sets.push_back(pBag->Retrieve(*pView, pair[1], true, cMax));
+
+			size_t cIntervals = 0, cPaths = 0, cSubtree = 0;
+			double tIntervals = Measure(sets, cRounds, cIntervals, [&pView](std::vector<std::vector<PDNODE>>& trees) {
+				return TreeIntersection(trees, pView->intervals.get());
+			});
+			double tPaths = Measure(sets, cRounds, cPaths, [](std::vector<std::vector<PDNODE>>& trees) {
+				return TreeIntersection(trees, nullptr);
+			});
+			double tSubtree = Measure(sets, cRounds, cSubtree, [](std::vector<std::vector<PDNODE>>& trees) {
+				return FilterBySubtree(trees[0], trees[1]);
+			});
+
+			if (cIntervals != cPaths)
+				printf("intersections differ: %zu with intervals, %zu with paths\n", cIntervals, cPaths);
+
+			WCHAR szWords[64];
+			swprintf(szWords, COUNTOF(szWords), L"%ls %ls", pair[0], pair[1]);
+			char szCandidates[32];
+			snprintf(szCandidates, sizeof(szCandidates), "%zux%zu", sets[0].size(), sets[1].size());
+			printf("%-12ls %12s %14.1f %14.1f %8zu %14.1f %8zu\n", szWords, szCandidates, tIntervals, tPaths, cIntervals, tSubtree, cSubtree);
+		}
+	}
+
+	return 0;
+}
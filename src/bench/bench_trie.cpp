@@ -0,0 +1,123 @@
+/********************************************************************
+
+   bench_trie.cpp
+
+   Memory per key and prefix query latency of BagOTrie against the
+   sorted vector of BagOValues, on the keys a scan of a synthetic tree
+   produces (see host.h).
+
+   bench_trie [fanout [depth [rounds]]]
+
+   Copyright (c) Microsoft Corporation. All rights reserved.
+   Licensed under the MIT License.
+
+********************************************************************/
+
+#include "wfgoto.cpp"
+#include "host.h"
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+
+namespace {
+	typedef std::vector<std::pair<std::wstring, PDNODE>> key_list;
+
+	// the queries GetDirectoryOptionsFromText sends for a word typed one character at a time
+	std::vector<std::wstring> GetQueries(const key_list& keys)
+	{
+		std::unordered_set<std::wstring> seen;
+		std::vector<std::wstring> queries;
+
+		for (size_t i = 0; i < keys.size() && queries.size() < 512; i += keys.size() / 97 + 1)
+		{
+			const std::wstring& key = keys[i].first;
+			for (size_t cch = 1; cch <= key.size() && cch <= 6; cch++)
+			{
+				std::wstring query = key.substr(0, cch);
+				if (seen.insert(query).second)
+					queries.push_back(query);
+			}
+		}
+
+		return queries;
+	}
+
+	template <class TRetrieve>
+	void Measure(const char* szName, size_t cbHeap, size_t cKeys, const std::vector<std::wstring>& queries, unsigned cRounds, TRetrieve retrieve)
+	{
+		size_t cResults = 0;
+		double tBest = 0;
+
+		for (unsigned iRound = 0; iRound < cRounds; iRound++)
+		{
+			size_t cRound = 0;
+			double t = HostNow();
+			for (const auto& query : queries)
+				cRound += retrieve(query).size();
+			t = HostNow() - t;
+
+			if (iRound == 0 || t < tBest)
+				tBest = t;
+			cResults = cRound;
+		}
+
+		printf("%-12s %10.1f bytes/key %10.2f us/query %12zu results\n",
+			szName, (double)cbHeap / cKeys, tBest * 1e6 / queries.size(), cResults);
+	}
+}
+
+int main(int argc, char** argv)
+{
+	UINT cFanout = argc > 1 ? atoi(argv[1]) : 12;
+	UINT cDepth = argc > 2 ? atoi(argv[2]) : 5;
+	unsigned cRounds = argc > 3 ? atoi(argv[3]) : 5;
+
+	HostSetTree(cFanout, cDepth, 0);
+
+	// the keys and nodes of a scan, as the scanner adds them
+	std::atomic_uint32_t scanEpoc{ 0 };
+	values_bag scanned;
+	directory_scanner scanner(1, scanEpoc, 0, GOTO_LOCAL_MAX_NODES);
+	scanner.Scan(scanned, L"T:\\");
+	scanned.BagOCDrive.Sort();
+
+	key_list keys;
+	scanned.BagOCDrive.ForEachPair([&keys](const std::wstring& key, PDNODE pNode) {
+		keys.emplace_back(key, pNode);
+	});
+
+	// Add order matters to neither; shuffle so neither benefits from sorted input
+	std::shuffle(keys.begin(), keys.end(), std::mt19937(1));
+
+	auto queries = GetQueries(keys);
+	printf("%zu directories, %zu keys, %zu queries\n", scanned.allNodes.size(), keys.size(), queries.size());
+
+	{
+		size_t cbBefore = HostHeapInUse();
+		BagOValues<PDNODE> values;
+		for (const auto& key : keys)
+			values.Add(key.first, key.second);
+		values.Sort();
+		size_t cbHeap = HostHeapInUse() - cbBefore;
+
+		auto snapshot = values.Snapshot();
+		Measure("BagOValues", cbHeap, keys.size(), queries, cRounds, [&snapshot](const std::wstring& query) {
+			return BagOValues<PDNODE>::Retrieve(snapshot, query, true, 1000);
+		});
+	}
+
+	{
+		size_t cbBefore = HostHeapInUse();
+		BagOTrie<PDNODE> trie;
+		for (const auto& key : keys)
+			trie.Add(key.first, key.second);
+		trie.Sort();
+		size_t cbHeap = HostHeapInUse() - cbBefore;
+
+		Measure("BagOTrie", cbHeap, keys.size(), queries, cRounds, [&trie](const std::wstring& query) {
+			return trie.Retrieve(query, true, 1000);
+		});
+	}
+
+	return 0;
+}
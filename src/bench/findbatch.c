@@ -0,0 +1,268 @@
+/********************************************************************
+
+   findbatch.c
+
+   Entries per second listing one large directory, one entry per call
+   to the file system against a buffer of entries per call, which is
+   what WFFindFirstBatch / WFFindNextEntry (lfn.c) do.
+
+   On Windows the calls are the ones lfn.c makes: FindFirstFileEx /
+   FindNextFile, and GetFileInformationByHandleEx(FileIdBothDirectory
+   Info) into LFNBATCH_BUFFER_SIZE.  Elsewhere getdents64 is called
+   with buffers from one entry up to the same size, and readdir is
+   shown for reference.
+
+   findbatch [directory [entries [rounds]]]
+
+   Fills the directory with files if it has fewer than entries, then
+   lists it rounds times per method (warm cache) and prints the best.
+
+   Copyright (c) Microsoft Corporation. All rights reserved.
+   Licensed under the MIT License.
+
+********************************************************************/
+
+#ifndef _WIN32
+#define _GNU_SOURCE
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#endif
+
+#define LFNBATCH_BUFFER_SIZE  0x10000      // as in lfn.h
+
+typedef unsigned long (*LISTPROC)(const char* pszDir, size_t cbBuffer);
+
+static unsigned char abBuffer[LFNBATCH_BUFFER_SIZE];
+
+
+#ifdef _WIN32
+
+static double
+Now(void)
+{
+   LARGE_INTEGER li, liFreq;
+
+   QueryPerformanceCounter(&li);
+   QueryPerformanceFrequency(&liFreq);
+   return (double)li.QuadPart / (double)liFreq.QuadPart;
+}
+
+static void
+Populate(const char* pszDir, unsigned long cEntries)
+{
+   char szPath[MAX_PATH];
+   unsigned long i;
+   HANDLE h;
+
+   CreateDirectoryA(pszDir, NULL);
+
+   for (i = 0; i < cEntries; i++) {
+      sprintf(szPath, "%s\\entry number %07lu.txt", pszDir, i);
+      h = CreateFileA(szPath, GENERIC_WRITE, 0, NULL, CREATE_NEW, FILE_ATTRIBUTE_NORMAL, NULL);
+      if (h != INVALID_HANDLE_VALUE)
+         CloseHandle(h);
+   }
+}
+
+//
+// WFFindFirst / WFFindNext: one entry per call
+//
+static unsigned long
+ListFindNext(const char* pszDir, size_t cbBuffer)
+{
+   char szSpec[MAX_PATH];
+   WIN32_FIND_DATAA fd;
+   unsigned long cEntries = 0;
+   HANDLE h;
+
+   (void)cbBuffer;
+   sprintf(szSpec, "%s\\*", pszDir);
+
+   h = FindFirstFileExA(szSpec, FindExInfoStandard, &fd, FindExSearchNameMatch, NULL, 0);
+   if (h == INVALID_HANDLE_VALUE)
+      return 0;
+
+   do {
+      cEntries++;
+   } while (FindNextFileA(h, &fd));
+
+   FindClose(h);
+   return cEntries;
+}
+
+//
+// WFFindFirstBatch / WFFindNextEntry: a buffer of entries per call
+//
+static unsigned long
+ListBatch(const char* pszDir, size_t cbBuffer)
+{
+   PFILE_ID_BOTH_DIR_INFO pInfo;
+   FILE_INFO_BY_HANDLE_CLASS infoClass = FileIdBothDirectoryRestartInfo;
+   unsigned long cEntries = 0;
+   HANDLE h;
+
+   h = CreateFileA(pszDir, FILE_LIST_DIRECTORY,
+      FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, NULL,
+      OPEN_EXISTING, FILE_FLAG_BACKUP_SEMANTICS, NULL);
+   if (h == INVALID_HANDLE_VALUE)
+      return 0;
+
+   while (GetFileInformationByHandleEx(h, infoClass, abBuffer, (DWORD)cbBuffer)) {
+
+      infoClass = FileIdBothDirectoryInfo;
+
+      for (pInfo = (PFILE_ID_BOTH_DIR_INFO)abBuffer; ; pInfo = (PFILE_ID_BOTH_DIR_INFO)((LPBYTE)pInfo + pInfo->NextEntryOffset)) {
+         cEntries++;
+         if (!pInfo->NextEntryOffset)
+            break;
+      }
+   }
+
+   CloseHandle(h);
+   return cEntries;
+}
+
+#else
+
+static double
+Now(void)
+{
+   struct timespec ts;
+
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void
+Populate(const char* pszDir, unsigned long cEntries)
+{
+   char szPath[4096];
+   unsigned long i;
+   int fd;
+
+   mkdir(pszDir, 0777);
+
+   for (i = 0; i < cEntries; i++) {
+      snprintf(szPath, sizeof(szPath), "%s/entry number %07lu.txt", pszDir, i);
+      fd = open(szPath, O_WRONLY | O_CREAT | O_EXCL, 0666);
+      if (fd >= 0)
+         close(fd);
+   }
+}
+
+static unsigned long
+ListReaddir(const char* pszDir, size_t cbBuffer)
+{
+   unsigned long cEntries = 0;
+   DIR* pDir;
+
+   (void)cbBuffer;
+
+   if (!(pDir = opendir(pszDir)))
+      return 0;
+
+   while (readdir(pDir))
+      cEntries++;
+
+   closedir(pDir);
+   return cEntries;
+}
+
+struct linux_dirent64 {
+   unsigned long long d_ino;
+   long long d_off;
+   unsigned short d_reclen;
+   unsigned char d_type;
+   char d_name[];
+};
+
+static unsigned long
+ListGetdents(const char* pszDir, size_t cbBuffer)
+{
+   unsigned long cEntries = 0;
+   long cb, ib;
+   int fd;
+
+   if ((fd = open(pszDir, O_RDONLY | O_DIRECTORY)) < 0)
+      return 0;
+
+   while ((cb = syscall(SYS_getdents64, fd, abBuffer, cbBuffer)) > 0) {
+      for (ib = 0; ib < cb; ib += ((struct linux_dirent64*)(abBuffer + ib))->d_reclen)
+         cEntries++;
+   }
+
+   close(fd);
+   return cEntries;
+}
+
+#endif
+
+
+static unsigned long
+CountEntries(const char* pszDir)
+{
+#ifdef _WIN32
+   return ListFindNext(pszDir, 0);
+#else
+   return ListReaddir(pszDir, 0);
+#endif
+}
+
+static void
+Measure(const char* pszName, LISTPROC pfnList, const char* pszDir, size_t cbBuffer, int cRounds)
+{
+   double dBest = 0;
+   unsigned long cEntries = 0;
+   double t;
+   int i;
+
+   for (i = 0; i < cRounds; i++) {
+      t = Now();
+      cEntries = pfnList(pszDir, cbBuffer);
+      t = Now() - t;
+      if (i == 0 || t < dBest)
+         dBest = t;
+   }
+
+   printf("%-28s %8lu entries  %8.2f ms  %12.0f entries/s\n",
+      pszName, cEntries, dBest * 1000, dBest > 0 ? cEntries / dBest : 0);
+}
+
+int
+main(int argc, char** argv)
+{
+   const char* pszDir = argc > 1 ? argv[1] : "findbatch.dir";
+   unsigned long cEntries = argc > 2 ? strtoul(argv[2], NULL, 10) : 100000;
+   int cRounds = argc > 3 ? atoi(argv[3]) : 10;
+
+   if (CountEntries(pszDir) < cEntries)
+      Populate(pszDir, cEntries);
+
+   // warm the cache
+   CountEntries(pszDir);
+
+#ifdef _WIN32
+   Measure("FindFirstFileEx/FindNextFile", ListFindNext, pszDir, 0, cRounds);
+   Measure("GetFileInformationByHandleEx", ListBatch, pszDir, LFNBATCH_BUFFER_SIZE, cRounds);
+#else
+   Measure("readdir", ListReaddir, pszDir, 0, cRounds);
+   Measure("getdents64 64 B (1 entry)", ListGetdents, pszDir, 64, cRounds);
+   Measure("getdents64 4 KB", ListGetdents, pszDir, 0x1000, cRounds);
+   Measure("getdents64 64 KB", ListGetdents, pszDir, LFNBATCH_BUFFER_SIZE, cRounds);
+#endif
+
+   return 0;
+}
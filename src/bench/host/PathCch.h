@@ -0,0 +1,19 @@
+/********************************************************************
+
+   PathCch.h
+
+   Host stand-in for the PathCch functions wfgoto.cpp calls; see
+   host.cpp.
+
+   Copyright (c) Microsoft Corporation. All rights reserved.
+   Licensed under the MIT License.
+
+********************************************************************/
+
+#pragma once
+
+#include <windows.h>
+
+HRESULT PathCchAddBackslash(LPWSTR pszPath, size_t cchPath);
+HRESULT PathCchAppend(LPWSTR pszPath, size_t cchPath, LPCWSTR pszMore);
+HRESULT PathCchSkipRoot(LPCWSTR pszPath, LPCWSTR* ppszRootEnd);
@@ -0,0 +1,694 @@
+/********************************************************************
+
+   host.cpp
+
+   Host definitions of the Windows and winfile functions wfgoto.cpp and
+   the listing code call, for the benchmarks.  The ones they don't
+   reach while benchmarking do nothing.
+
+   Copyright (c) Microsoft Corporation. All rights reserved.
+   Licensed under the MIT License.
+
+********************************************************************/
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cwctype>
+#include <mutex>
+#include <numeric>
+#include <random>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include <malloc.h>
+#include <sys/mman.h>
+#include <PathCch.h>
+#include "winfile.h"
+#include "treectl.h"
+#include "lfn.h"
+#include "host.h"
+
+namespace {
+	// words directory names are made of; 64 of them, see SyntheticName
+	const LPCWSTR c_rgszWords[] = {
+		L"src", L"include", L"lib", L"bin", L"obj", L"docs", L"test", L"tools",
+		L"build", L"debug", L"release", L"common", L"core", L"util", L"data", L"config",
+		L"assets", L"images", L"icons", L"fonts", L"scripts", L"templates", L"samples", L"examples",
+		L"vendor", L"external", L"packages", L"modules", L"cache", L"temp", L"logs", L"backup",
+		L"archive", L"projects", L"users", L"public", L"shared", L"system", L"windows", L"program",
+		L"files", L"office", L"games", L"music", L"videos", L"pictures", L"downloads", L"desktop",
+		L"documents", L"app", L"server", L"client", L"web", L"api", L"services", L"drivers",
+		L"kernel", L"network", L"ui", L"resources", L"locale", L"x64", L"arm64", L"v2",
+	};
+	constexpr UINT c_cWords = sizeof(c_rgszWords) / sizeof(c_rgszWords[0]);
+	static_assert((c_cWords & (c_cWords - 1)) == 0, "SyntheticName needs a power of 2");
+
+	struct find_cursor {
+		ULONGLONG hash;			// of the directory's path
+		UINT iEntry;			// next entry to return: ., .., subdirectories, then files
+		UINT cDirs;
+		UINT cFiles;
+	};
+
+	UINT g_cFanout = 8;
+	UINT g_cDepth = 4;
+	UINT g_cFiles = 0;
+	UINT g_cLatencyMicroseconds = 0;
+	std::atomic<DWORD> g_cDirectoriesRead{ 0 };
+
+	// LocalAlloc blocks carry their size in front, for LocalSize
+	struct local_header {
+		SIZE_T cb;
+		SIZE_T pad;
+	};
+
+	std::atomic<DWORD> g_cLocalAllocs{ 0 };
+	std::atomic<DWORD> g_cLocalFrees{ 0 };
+	std::atomic<DWORD> g_cVirtualAllocs{ 0 };
+	std::atomic<DWORD> g_cVirtualFrees{ 0 };
+	std::atomic<SIZE_T> g_cbLocal{ 0 };
+	std::atomic<SIZE_T> g_cbVirtual{ 0 };
+	std::mutex g_virtualLock;
+	std::unordered_map<LPVOID, SIZE_T> g_virtualSizes;
+
+	// for HostMakeListing
+	const LPCWSTR c_rgszListingWords[] = {
+		L"Program Files", L"Documents", L"README", L"setup", L"IMG", L"Report", L"build", L"node_modules",
+		L"System32", L"libcrypto", L"Backup", L"Invoice", L"DSC", L"notes", L"_cache", L"[old]",
+	};
+
+	const LPCWSTR c_rgszListingExts[] = {
+		L".txt", L".JPG", L".dll", L".cpp", L".h", L".pdf", L".Docx", L".exe", L"",
+	};
+
+	constexpr ULONGLONG c_qListingTimeBase = 132000000000000000ull;	// 2019, in FILETIME units
+
+	ULONGLONG Mix(ULONGLONG h)
+	{
+		h ^= h >> 33;
+		h *= 0xff51afd7ed558ccdULL;
+		h ^= h >> 33;
+		h *= 0xc4ceb9fe1a85ec53ULL;
+		h ^= h >> 33;
+		return h;
+	}
+
+	// entries with different i under one parent get different first words (and so different
+	// names) as long as there are no more than c_cWords of them
+	VOID SyntheticName(ULONGLONG hash, UINT i, BOOL bFile, LPWSTR szName, size_t cchName)
+	{
+		ULONGLONG h = Mix(hash + i);
+		ULONGLONG stride = 2 * (hash % (c_cWords / 2)) + 1;	// odd, so i -> first word is one to one
+		LPCWSTR szFirst = c_rgszWords[((hash >> 32) + i * stride) % c_cWords];
+		LPCWSTR szSecond = c_rgszWords[(h >> 8) % c_cWords];
+
+		if (bFile)
+		{
+			swprintf(szName, cchName, L"%ls %u.txt", szFirst, i);
+			return;
+		}
+
+		// mostly words, as people name directories; some with a version or a
+		// generated suffix, as builds and installers do
+		switch (h % 8)
+		{
+		case 0:
+		case 1:
+			swprintf(szName, cchName, L"%ls", szFirst);
+			break;
+		case 2:
+			swprintf(szName, cchName, L"%ls %ls", szFirst, szSecond);
+			break;
+		case 3:
+			swprintf(szName, cchName, L"%ls_%ls", szFirst, szSecond);
+			break;
+		case 4:
+			swprintf(szName, cchName, L"%ls-%u", szFirst, (UINT)(h >> 16) % 100);
+			break;
+		case 5:
+			swprintf(szName, cchName, L"%ls%u", szFirst, (UINT)(h >> 16) % 10000);
+			break;
+		case 6:
+			swprintf(szName, cchName, L"%ls.%06x", szFirst, (UINT)(h >> 16) & 0xffffff);
+			break;
+		default:
+			swprintf(szName, cchName, L"%ls %ls %u", szFirst, szSecond, (UINT)(h >> 16) % 1000);
+			break;
+		}
+	}
+
+	BOOL FillEntry(LPLFNDTA lpFind)
+	{
+		find_cursor* pCursor = (find_cursor*)lpFind->hFindFile;
+		UINT i = pCursor->iEntry++;
+
+		memset(&lpFind->fd, 0, sizeof(lpFind->fd));
+
+		if (i < 2)
+		{
+			wcscpy(lpFind->fd.cFileName, i == 0 ? L"." : L"..");
+			lpFind->fd.dwFileAttributes = FILE_ATTRIBUTE_DIRECTORY;
+			return TRUE;
+		}
+
+		i -= 2;
+		if (i < pCursor->cDirs)
+		{
+			SyntheticName(pCursor->hash, i, FALSE, lpFind->fd.cFileName, COUNTOF(lpFind->fd.cFileName));
+			lpFind->fd.dwFileAttributes = FILE_ATTRIBUTE_DIRECTORY;
+			return TRUE;
+		}
+
+		i -= pCursor->cDirs;
+		if (i < pCursor->cFiles)
+		{
+			SyntheticName(pCursor->hash, i, TRUE, lpFind->fd.cFileName, COUNTOF(lpFind->fd.cFileName));
+			lpFind->fd.dwFileAttributes = FILE_ATTRIBUTE_NORMAL;
+			return TRUE;
+		}
+
+		lpFind->err = 18;	// ERROR_NO_MORE_FILES
+		return FALSE;
+	}
+}
+
+extern "C" {
+
+WCHAR szStarDotStar[] = L"*.*";
+WCHAR szSettings[] = L"Settings";
+WCHAR szGotoRoots[] = L"GotoRoots";
+WCHAR szTheINIFile[] = L"winfile.ini";
+WCHAR szGotoSnapshotFile[] = L"GOTO-%s.IDX";
+WCHAR szGotoLegacySnapshotFile[] = L"GOTO.IDX";
+WCHAR szRoamINIPath[] = L"\\Microsoft\\Winfile";
+HWND hwndStatus;
+HWND hwndMDIClient;
+BOOL bGotoRanked = TRUE;
+UINT wHelpMessage;
+
+VOID HostSetTree(UINT cFanout, UINT cDepth, UINT cFiles)
+{
+	g_cFanout = cFanout;
+	g_cDepth = cDepth;
+	g_cFiles = cFiles;
+}
+
+VOID HostSetFindLatency(UINT cMicroseconds)
+{
+	g_cLatencyMicroseconds = cMicroseconds;
+}
+
+DWORD HostDirectoriesRead(VOID)
+{
+	return g_cDirectoriesRead;
+}
+
+double HostNow(VOID)
+{
+	return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+size_t HostHeapInUse(VOID)
+{
+	struct mallinfo2 mi = mallinfo2();
+	return mi.uordblks + mi.hblkhd;
+}
+
+VOID HostGetAllocCounts(HOST_ALLOC_COUNTS* pCounts)
+{
+	pCounts->cLocalAllocs = g_cLocalAllocs;
+	pCounts->cLocalFrees = g_cLocalFrees;
+	pCounts->cVirtualAllocs = g_cVirtualAllocs;
+	pCounts->cVirtualFrees = g_cVirtualFrees;
+	pCounts->cbLocal = g_cbLocal;
+	pCounts->cbVirtual = g_cbVirtual;
+}
+
+// as the reader (CreateDTABlockWorker in wfdirrd.c) fills in the chain
+LPXDTALINK HostMakeListing(DWORD cEntries)
+{
+	std::mt19937 rng(cEntries);
+	LPXDTALINK lpStart = MemNew();
+	LPXDTALINK lpLast = lpStart;
+
+	if (lpStart == NULL)
+		return NULL;
+
+	LPXDTAHEAD lpHead = MemLinkToHead(lpStart);
+
+	// numbers in a random order, so the names are unique but not read in order
+	std::vector<DWORD> numbers(cEntries);
+	std::iota(numbers.begin(), numbers.end(), 0);
+	std::shuffle(numbers.begin(), numbers.end(), rng);
+
+	for (DWORD i = 0; i < cEntries; i++)
+	{
+		std::wstring name;
+		DWORD dwAttrs = 0;
+
+		if (i == 0)
+		{
+			dwAttrs = ATTR_DIR | ATTR_PARENT;
+		}
+		else
+		{
+			name = c_rgszListingWords[rng() % COUNTOF(c_rgszListingWords)] + (L"_" + std::to_wstring(numbers[i]));
+			if (rng() % 16 == 0)
+				dwAttrs = ATTR_DIR;
+			else
+				name += c_rgszListingExts[rng() % COUNTOF(c_rgszListingExts)];
+
+			for (auto& ch : name)
+			{
+				if (rng() % 4 == 0)
+					ch = iswupper(ch) ? towlower(ch) : towupper(ch);
+			}
+		}
+
+		LPXDTA lpxdta = MemAdd(&lpLast, (UINT)name.size(), 0);
+		if (lpxdta == NULL)
+		{
+			MemDelete(lpStart);
+			return NULL;
+		}
+
+		lpHead->dwEntries++;
+
+		ULONGLONG qTime = c_qListingTimeBase + (ULONGLONG)(rng() % (cEntries / 4 + 1)) * 10000000;
+		lpxdta->dwAttrs = dwAttrs;
+		lpxdta->ftLastWriteTime.dwLowDateTime = (DWORD)qTime;
+		lpxdta->ftLastWriteTime.dwHighDateTime = (DWORD)(qTime >> 32);
+		lpxdta->qFileSize.QuadPart = (dwAttrs & ATTR_DIR) ? 0 : (LONGLONG)(rng() % (cEntries / 8 + 1)) * 512;
+		lpxdta->byBitmap = 0;
+		lpxdta->pDocB = NULL;
+
+		std::copy(name.begin(), name.end(), MemGetFileName(lpxdta));
+		MemGetFileName(lpxdta)[name.size()] = CHAR_NULL;
+		MemGetAlternateFileName(lpxdta)[0] = CHAR_NULL;
+
+		if (!(dwAttrs & ATTR_DIR))
+		{
+			lpHead->dwTotalCount++;
+			lpHead->qTotalSize.QuadPart += lpxdta->qFileSize.QuadPart;
+		}
+	}
+
+	return lpStart;
+}
+
+HLOCAL LocalAlloc(UINT uFlags, SIZE_T cb)
+{
+	local_header* pHeader = (local_header*)(uFlags & LMEM_ZEROINIT ? calloc(1, sizeof(local_header) + cb) : malloc(sizeof(local_header) + cb));
+
+	if (pHeader == NULL)
+		return NULL;
+
+	pHeader->cb = cb;
+	g_cLocalAllocs++;
+	g_cbLocal += cb;
+	return pHeader + 1;
+}
+
+HLOCAL LocalReAlloc(HLOCAL hMem, SIZE_T cb, UINT)
+{
+	local_header* pHeader = (local_header*)hMem - 1;
+	SIZE_T cbOld = pHeader->cb;
+
+	pHeader = (local_header*)realloc(pHeader, sizeof(local_header) + cb);
+	if (pHeader == NULL)
+		return NULL;
+
+	pHeader->cb = cb;
+	g_cLocalAllocs++;
+	g_cLocalFrees++;
+	g_cbLocal += cb - cbOld;
+	return pHeader + 1;
+}
+
+HLOCAL LocalFree(HLOCAL hMem)
+{
+	if (hMem != NULL)
+	{
+		local_header* pHeader = (local_header*)hMem - 1;
+
+		g_cLocalFrees++;
+		g_cbLocal -= pHeader->cb;
+		free(pHeader);
+	}
+	return NULL;
+}
+
+SIZE_T LocalSize(HLOCAL hMem)
+{
+	return ((local_header*)hMem - 1)->cb;
+}
+
+// pages come from mmap, so like VirtualAlloc's they take no memory until touched
+LPVOID VirtualAlloc(LPVOID, SIZE_T cb, DWORD, DWORD)
+{
+	LPVOID lpAddress = mmap(NULL, cb, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+	if (lpAddress == MAP_FAILED)
+		return NULL;
+
+	cb = (cb + 4095) & ~(SIZE_T)4095;
+	{
+		std::lock_guard<std::mutex> lock(g_virtualLock);
+		g_virtualSizes[lpAddress] = cb;
+	}
+	g_cVirtualAllocs++;
+	g_cbVirtual += cb;
+	return lpAddress;
+}
+
+BOOL VirtualFree(LPVOID lpAddress, SIZE_T, DWORD)
+{
+	SIZE_T cb;
+	{
+		std::lock_guard<std::mutex> lock(g_virtualLock);
+		auto it = g_virtualSizes.find(lpAddress);
+		if (it == g_virtualSizes.end())
+			return FALSE;
+		cb = it->second;
+		g_virtualSizes.erase(it);
+	}
+	munmap(lpAddress, cb);
+	g_cVirtualFrees++;
+	g_cbVirtual -= cb;
+	return TRUE;
+}
+
+LONG InterlockedIncrement(LONG volatile* plAddend) { return __atomic_add_fetch(plAddend, 1, __ATOMIC_SEQ_CST); }
+LONG InterlockedDecrement(LONG volatile* plAddend) { return __atomic_sub_fetch(plAddend, 1, __ATOMIC_SEQ_CST); }
+
+// the handle is the std::thread; waiting joins and frees it, so CloseHandle has nothing left to do
+HANDLE CreateThread(LPVOID, SIZE_T, LPTHREAD_START_ROUTINE lpStartAddress, LPVOID lpParameter, DWORD, LPDWORD lpThreadId)
+{
+	*lpThreadId = 0;
+	return new std::thread(lpStartAddress, lpParameter);
+}
+
+DWORD WaitForSingleObject(HANDLE hHandle, DWORD)
+{
+	std::thread* pThread = (std::thread*)hHandle;
+
+	pThread->join();
+	delete pThread;
+	return 0;
+}
+
+VOID GetSystemInfo(SYSTEM_INFO* lpSystemInfo)
+{
+	lpSystemInfo->dwNumberOfProcessors = std::max(1u, std::thread::hardware_concurrency());
+}
+
+// lpName is <root>\<component>\...\*.*; the depth and a hash of the path decide what is in it
+BOOL WFFindFirst(LPLFNDTA lpFind, LPTSTR lpName, DWORD dwAttrFilter)
+{
+	ULONGLONG hash = 1469598103934665603ULL;
+	UINT cDepth = 0;
+	LPCWSTR pch;
+	LPCWSTR pchEnd = wcsrchr(lpName, CHAR_BACKSLASH);
+
+	(void)dwAttrFilter;
+
+	if (PathCchSkipRoot(lpName, &pch) != S_OK || pchEnd == NULL)
+	{
+		lpFind->hFindFile = INVALID_HANDLE_VALUE;
+		lpFind->err = 3;	// ERROR_PATH_NOT_FOUND
+		return FALSE;
+	}
+
+	for (; pch <= pchEnd; pch++)
+	{
+		if (*pch == CHAR_BACKSLASH)
+			cDepth++;
+		hash = (hash ^ towlower(*pch)) * 1099511628211ULL;
+	}
+
+	g_cDirectoriesRead++;
+	if (g_cLatencyMicroseconds)
+		std::this_thread::sleep_for(std::chrono::microseconds(g_cLatencyMicroseconds));
+
+	find_cursor* pCursor = new find_cursor;
+	pCursor->hash = Mix(hash);
+	pCursor->iEntry = 0;
+	pCursor->cDirs = cDepth < g_cDepth ? g_cFanout / 2 + (UINT)(pCursor->hash % (g_cFanout + 1)) : 0;
+	pCursor->cFiles = g_cFiles;
+
+	lpFind->hFindFile = pCursor;
+	lpFind->dwAttrFilter = dwAttrFilter;
+	lpFind->err = 0;
+	return FillEntry(lpFind);
+}
+
+BOOL WFFindNext(LPLFNDTA lpFind)
+{
+	return FillEntry(lpFind);
+}
+
+BOOL WFFindClose(LPLFNDTA lpFind)
+{
+	if (lpFind->hFindFile != INVALID_HANDLE_VALUE)
+		delete (find_cursor*)lpFind->hFindFile;
+	lpFind->hFindFile = INVALID_HANDLE_VALUE;
+	return TRUE;
+}
+
+VOID LowerCaseBuff(LPCWSTR lpSrc, LPWSTR lpDst, SIZE_T cch)
+{
+	for (SIZE_T i = 0; i < cch; i++)
+		lpDst[i] = towlower(lpSrc[i]);
+}
+
+VOID UpperCaseBuff(LPCWSTR lpSrc, LPWSTR lpDst, SIZE_T cch)
+{
+	for (SIZE_T i = 0; i < cch; i++)
+		lpDst[i] = towupper(lpSrc[i]);
+}
+
+// as wfcase.c: upper cased, then by code point, so '_' sorts before the letters as it does there
+INT CompareOrdinalNoCase(LPCWSTR lpsz1, LPCWSTR lpsz2)
+{
+	for (;; lpsz1++, lpsz2++)
+	{
+		wint_t ch1 = towupper(*lpsz1);
+		wint_t ch2 = towupper(*lpsz2);
+
+		if (ch1 != ch2)
+			return ch1 < ch2 ? -1 : 1;
+		if (ch1 == 0)
+			return 0;
+	}
+}
+
+static VOID GetTreePathIndirect(PDNODE pNode, LPTSTR szDest)
+{
+	if (pNode->pParent)
+	{
+		GetTreePathIndirect(pNode->pParent, szDest);
+		if (pNode->pParent->pParent)
+			wcscat(szDest, SZ_BACKSLASH);
+	}
+	wcscat(szDest, pNode->szName);
+}
+
+// the root's name is the whole root including its backslash (see directory_scanner::Scan)
+VOID GetTreePath(PDNODE pNode, LPTSTR szDest)
+{
+	szDest[0] = CHAR_NULL;
+	GetTreePathIndirect(pNode, szDest);
+}
+
+VOID StripBackslash(LPWSTR szPath)
+{
+	size_t cch = wcslen(szPath);
+	if (cch > 0 && szPath[cch - 1] == CHAR_BACKSLASH && !(cch == 3 && szPath[1] == CHAR_COLON))
+		szPath[cch - 1] = CHAR_NULL;
+}
+
+VOID StripFilespec(LPWSTR szPath)
+{
+	LPWSTR pch = wcsrchr(szPath, CHAR_BACKSLASH);
+	if (pch == NULL)
+		return;
+	if (pch > szPath && pch[-1] == CHAR_COLON)
+		pch[1] = CHAR_NULL;
+	else
+		*pch = CHAR_NULL;
+}
+
+BOOL IsWild(LPWSTR szPath) { return wcschr(szPath, L'*') || wcschr(szPath, L'?'); }
+BOOL GetHistoryDir(INT, LPWSTR) { return FALSE; }
+LPWSTR StrRChr(LPCWSTR lpStart, LPCWSTR, WCHAR wMatch) { return (LPWSTR)wcsrchr(lpStart, wMatch); }
+BOOL PathIsDirectoryEmpty(LPCWSTR) { return TRUE; }
+BOOL PathIsDirectory(LPCWSTR) { return TRUE; }
+BOOL IsCharAlphaNumeric(WCHAR ch) { return iswalnum(ch); }
+DWORD GetEnvironmentVariable(LPCWSTR, LPWSTR, DWORD) { return 0; }
+BOOL CreateDirectory(LPCWSTR, void*) { return FALSE; }
+DWORD GetLastError(void) { return 0; }
+BOOL UnmapViewOfFile(LPVOID) { return TRUE; }
+BOOL GetFileSizeEx(HANDLE, LARGE_INTEGER*) { return FALSE; }
+HANDLE CreateFileMapping(HANDLE, void*, DWORD, DWORD, DWORD, LPCWSTR) { return NULL; }
+BOOL CloseHandle(HANDLE) { return TRUE; }
+LPVOID MapViewOfFile(HANDLE, DWORD, DWORD, DWORD, SIZE_T) { return NULL; }
+BOOL WriteFile(HANDLE, const void*, DWORD, DWORD*, void*) { return FALSE; }
+BOOL MoveFileEx(LPCWSTR, LPCWSTR, DWORD) { return FALSE; }
+BOOL DeleteFile(LPCWSTR) { return FALSE; }
+UINT GetDriveType(LPCWSTR) { return DRIVE_FIXED; }
+
+DWORD GetPrivateProfileString(LPCWSTR, LPCWSTR, LPCWSTR lpDefault, LPWSTR lpReturned, DWORD cch, LPCWSTR)
+{
+	wcsncpy(lpReturned, lpDefault, cch);
+	return (DWORD)wcslen(lpReturned);
+}
+
+LRESULT SendMessageW(HWND, UINT, WPARAM, LPARAM) { return 0; }
+LRESULT SendDlgItemMessageW(HWND, INT, UINT, WPARAM, LPARAM) { return 0; }
+BOOL PostMessage(HWND, UINT, WPARAM, LPARAM) { return TRUE; }
+HWND GetDlgItem(HWND, INT) { return NULL; }
+UINT GetDlgItemTextW(HWND, INT, LPWSTR lpString, INT) { lpString[0] = CHAR_NULL; return 0; }
+HWND GetParent(HWND) { return NULL; }
+LRESULT CallWindowProcW(WNDPROC, HWND, UINT, WPARAM, LPARAM) { return 0; }
+LONG_PTR SetWindowLongPtr(HWND, INT, LONG_PTR) { return 0; }
+BOOL EndDialog(HWND, INT_PTR) { return TRUE; }
+HWND SetFocus(HWND) { return NULL; }
+HWND CreateDirWindow(LPWSTR, BOOL, HWND) { return NULL; }
+HWND HasTreeWindow(HWND) { return NULL; }
+VOID WFHelp(HWND) {}
+VOID OutputDebugString(LPCWSTR lpOutputString) { fprintf(stderr, "%ls", lpOutputString); }
+INT wsprintf(LPWSTR lpOut, LPCWSTR, ...) { lpOut[0] = CHAR_NULL; return 0; }
+VOID UpdateMoveStatus(DWORD) {}
+DWORD ReadMoveStatus(void) { return 0; }
+
+// as wfutil.c: what follows the last dot, or the end of the name
+LPTSTR GetExtension(LPTSTR pszFile)
+{
+	LPTSTR pszDot = wcsrchr(pszFile, CHAR_DOT);
+	return pszDot ? pszDot + 1 : pszFile + wcslen(pszFile);
+}
+
+// as wfdir.c, which sorts listings without columns with it
+INT CompareDTA(LPXDTA lpItem1, LPXDTA lpItem2, DWORD dwSort)
+{
+	INT ret;
+
+	if (!lpItem1 || !lpItem2)
+		return lpItem1 ? 1 : -1;
+
+	if (lpItem1->dwAttrs & ATTR_PARENT)
+		return -1;
+
+	if (lpItem2->dwAttrs & ATTR_PARENT)
+		return 1;
+
+	if ((lpItem1->dwAttrs & ATTR_DIR) > (lpItem2->dwAttrs & ATTR_DIR))
+		return -1;
+	else if ((lpItem1->dwAttrs & ATTR_DIR) < (lpItem2->dwAttrs & ATTR_DIR))
+		return 1;
+
+	switch (dwSort)
+	{
+	case IDD_TYPE:
+	{
+		LPWSTR ptr1 = GetExtension(MemGetFileName(lpItem1));
+		LPWSTR ptr2 = GetExtension(MemGetFileName(lpItem2));
+
+		ret = CompareOrdinalNoCase(ptr1, ptr2);
+		if (ret != 0)
+			return ret;
+
+		// same extension; compare what is before the dot
+		if (*ptr1)
+			ptr1--;
+		if (*ptr2)
+			ptr2--;
+
+		return CompareStringOrdinal(MemGetFileName(lpItem1), (INT)(ptr1 - MemGetFileName(lpItem1)),
+			MemGetFileName(lpItem2), (INT)(ptr2 - MemGetFileName(lpItem2)), TRUE) - CSTR_EQUAL;
+	}
+
+	case IDD_SIZE:
+		if (lpItem1->qFileSize.HighPart != lpItem2->qFileSize.HighPart)
+			return lpItem1->qFileSize.HighPart > lpItem2->qFileSize.HighPart ? -1 : 1;
+		if (lpItem1->qFileSize.LowPart != lpItem2->qFileSize.LowPart)
+			return lpItem1->qFileSize.LowPart > lpItem2->qFileSize.LowPart ? -1 : 1;
+		break;
+
+	case IDD_DATE:
+	case IDD_FDATE:
+		if (lpItem1->ftLastWriteTime.dwHighDateTime != lpItem2->ftLastWriteTime.dwHighDateTime)
+			ret = lpItem1->ftLastWriteTime.dwHighDateTime > lpItem2->ftLastWriteTime.dwHighDateTime ? -1 : 1;
+		else if (lpItem1->ftLastWriteTime.dwLowDateTime != lpItem2->ftLastWriteTime.dwLowDateTime)
+			ret = lpItem1->ftLastWriteTime.dwLowDateTime > lpItem2->ftLastWriteTime.dwLowDateTime ? -1 : 1;
+		else
+			break;
+
+		return dwSort == IDD_FDATE ? -ret : ret;
+	}
+
+	return CompareOrdinalNoCase(MemGetFileName(lpItem1), MemGetFileName(lpItem2));
+}
+
+// upper cased like CompareOrdinalNoCase; only the counted, case insensitive use of CompareDTA
+INT CompareStringOrdinal(LPCWSTR lpString1, INT cchCount1, LPCWSTR lpString2, INT cchCount2, BOOL)
+{
+	for (INT i = 0; i < cchCount1 && i < cchCount2; i++)
+	{
+		wint_t ch1 = towupper(lpString1[i]);
+		wint_t ch2 = towupper(lpString2[i]);
+
+		if (ch1 != ch2)
+			return ch1 < ch2 ? CSTR_LESS_THAN : CSTR_GREATER_THAN;
+	}
+
+	return cchCount1 < cchCount2 ? CSTR_LESS_THAN : cchCount1 > cchCount2 ? CSTR_GREATER_THAN : CSTR_EQUAL;
+}
+
+}
+
+HRESULT PathCchAddBackslash(LPWSTR pszPath, size_t cchPath)
+{
+	size_t cch = wcslen(pszPath);
+	if (cch > 0 && pszPath[cch - 1] == CHAR_BACKSLASH)
+		return S_OK;
+	if (cch + 2 > cchPath)
+		return E_FAIL;
+	pszPath[cch] = CHAR_BACKSLASH;
+	pszPath[cch + 1] = CHAR_NULL;
+	return S_OK;
+}
+
+HRESULT PathCchAppend(LPWSTR pszPath, size_t cchPath, LPCWSTR pszMore)
+{
+	if (FAILED(PathCchAddBackslash(pszPath, cchPath)) || wcslen(pszPath) + wcslen(pszMore) >= cchPath)
+		return E_FAIL;
+	wcscat(pszPath, pszMore);
+	return S_OK;
+}
+
+// x:\ and \\server\share\ only
+HRESULT PathCchSkipRoot(LPCWSTR pszPath, LPCWSTR* ppszRootEnd)
+{
+	if (pszPath[0] && pszPath[1] == CHAR_COLON && pszPath[2] == CHAR_BACKSLASH)
+	{
+		*ppszRootEnd = pszPath + 3;
+		return S_OK;
+	}
+
+	if (pszPath[0] == CHAR_BACKSLASH && pszPath[1] == CHAR_BACKSLASH)
+	{
+		LPCWSTR pch = wcschr(pszPath + 2, CHAR_BACKSLASH);
+		if (pch != NULL)
+			pch = wcschr(pch + 1, CHAR_BACKSLASH);
+		if (pch != NULL)
+		{
+			*ppszRootEnd = pch + 1;
+			return S_OK;
+		}
+	}
+
+	return E_FAIL;
+}
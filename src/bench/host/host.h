@@ -0,0 +1,58 @@
+/********************************************************************
+
+   host.h
+
+   What the benchmarks ask of the host stand-ins in host.cpp.
+
+   WFFindFirst lists a synthetic tree rather than a disk: below the
+   root, a directory at depth d < cDepth has between cFanout / 2 and
+   cFanout * 3 / 2 subdirectories (chosen by a hash of its path) plus
+   cFiles files.  Names are built from a fixed vocabulary, some with
+   spaces, numbers or generated suffixes, so the keys look like a real
+   drive's.  Every directory read
+   can be made to take a fixed time, as if waiting on the disk.
+
+   HostMakeListing builds an XDTA chain as the directory reader would
+   for a directory of cEntries: the ".." entry, then names unique
+   ignoring case in no particular order (as FAT and network drives
+   return them), one in 16 a directory.  Sizes and dates are drawn from
+   ranges small enough that many tie and fall back to the name.
+
+   LocalAlloc and VirtualAlloc (see windows.h) count their calls and
+   the bytes they hold, which HostGetAllocCounts reports.
+
+   Copyright (c) Microsoft Corporation. All rights reserved.
+   Licensed under the MIT License.
+
+********************************************************************/
+
+#pragma once
+
+#include <windows.h>
+
+typedef struct _XDTALINK* LPXDTALINK;
+
+typedef struct {
+   DWORD cLocalAllocs;          // LocalAlloc and LocalReAlloc calls so far
+   DWORD cLocalFrees;
+   DWORD cVirtualAllocs;
+   DWORD cVirtualFrees;
+   SIZE_T cbLocal;              // bytes held now, as asked for
+   SIZE_T cbVirtual;            // bytes held now, in whole pages
+} HOST_ALLOC_COUNTS;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+VOID HostSetTree(UINT cFanout, UINT cDepth, UINT cFiles);
+VOID HostSetFindLatency(UINT cMicroseconds);
+DWORD HostDirectoriesRead(VOID);        // WFFindFirst calls so far
+double HostNow(VOID);                   // seconds, monotonic
+size_t HostHeapInUse(VOID);             // bytes malloc has handed out
+LPXDTALINK HostMakeListing(DWORD cEntries);    // NULL if out of memory; free with MemDelete
+VOID HostGetAllocCounts(HOST_ALLOC_COUNTS* pCounts);
+
+#ifdef __cplusplus
+}
+#endif
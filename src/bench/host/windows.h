@@ -0,0 +1,254 @@
+/********************************************************************
+
+   windows.h
+
+   Host stand-in for the parts of windows.h the Go To index and the
+   listing code (wfcase.c, wfcols.c, wfmem.c) use, so they build with
+   g++ and gcc for the benchmarks.  Nothing here is meant to behave
+   like Windows beyond what those paths need.
+
+   Copyright (c) Microsoft Corporation. All rights reserved.
+   Licensed under the MIT License.
+
+********************************************************************/
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <limits.h>
+#include <wchar.h>
+#include <wctype.h>
+#include <pthread.h>
+
+typedef int BOOL;
+typedef int INT;
+typedef unsigned UINT;
+typedef uint32_t DWORD;
+typedef uint16_t WORD;
+typedef uint8_t BYTE;
+typedef unsigned short USHORT;
+typedef short SHORT;
+typedef BYTE* LPBYTE;
+typedef BYTE* PBYTE;
+typedef int32_t LONG;   // 32 bits, as on Windows; LARGE_INTEGER depends on it
+typedef int64_t LONGLONG;
+typedef uint64_t ULONGLONG;
+typedef intptr_t LONG_PTR;
+typedef intptr_t INT_PTR;
+typedef uintptr_t UINT_PTR;
+typedef uintptr_t WPARAM;
+typedef intptr_t LPARAM;
+typedef intptr_t LRESULT;
+typedef long HRESULT;
+typedef size_t SIZE_T;
+typedef void VOID;
+typedef void* LPVOID;
+typedef void* PVOID;
+typedef void* HANDLE;
+typedef HANDLE HWND;
+typedef HANDLE HICON;
+typedef HANDLE HLOCAL;
+//
+// WCHAR is 16 bits on Windows and wfcase.c's vector kernels count on
+// it, while wchar_t is 32 bits here.  HOST_WCHAR16 builds (bench_case)
+// get 16 bit WCHARs and do without the wide C library and L"" strings.
+//
+#if !defined(HOST_WCHAR16)
+typedef wchar_t WCHAR;
+#elif defined(__cplusplus)
+typedef char16_t WCHAR;
+#else
+typedef uint16_t WCHAR;
+#endif
+typedef WCHAR TCHAR;
+typedef WCHAR* LPWSTR;
+typedef const WCHAR* LPCWSTR;
+typedef LPWSTR LPTSTR;
+typedef LPCWSTR LPCTSTR;
+typedef DWORD* LPDWORD;
+typedef DWORD* PDWORD;
+
+typedef struct {
+   DWORD dwLowDateTime;
+   DWORD dwHighDateTime;
+} FILETIME;
+
+typedef union {
+   struct {
+      DWORD LowPart;
+      LONG HighPart;
+   };
+   LONGLONG QuadPart;
+} LARGE_INTEGER;
+
+typedef struct {
+   DWORD dwFileAttributes;
+   FILETIME ftCreationTime;
+   FILETIME ftLastAccessTime;
+   FILETIME ftLastWriteTime;
+   DWORD nFileSizeHigh;
+   DWORD nFileSizeLow;
+   DWORD dwReserved0;
+   DWORD dwReserved1;
+   WCHAR cFileName[260];
+   WCHAR cAlternateFileName[14];
+} WIN32_FIND_DATA;
+
+typedef struct {
+   HWND hwnd;
+   UINT message;
+   WPARAM wParam;
+   LPARAM lParam;
+} MSG, *LPMSG;
+
+typedef struct {
+   DWORD dwNumberOfProcessors;
+} SYSTEM_INFO;
+
+typedef LRESULT (*WNDPROC)(HWND, UINT, WPARAM, LPARAM);
+typedef DWORD (*LPTHREAD_START_ROUTINE)(LPVOID);
+
+#define APIENTRY
+#define CALLBACK
+#define WINAPI
+#define TRUE 1
+#define FALSE 0
+#ifndef NULL
+#define NULL 0
+#endif
+#ifdef HOST_WCHAR16
+#define TEXT(x) u##x
+#else
+#define TEXT(x) L##x
+#endif
+
+#define MAXDWORD 0xffffffffu
+#define MAXBYTE 0xff
+#define MAKELONG(a, b) ((LONG)(((WORD)(a)) | ((DWORD)((WORD)(b))) << 16))
+#define LOWORD(l) ((WORD)(((DWORD)(l)) & 0xffff))
+#define HIWORD(l) ((WORD)((((DWORD)(l)) >> 16) & 0xffff))
+
+#define SUCCEEDED(hr) (((HRESULT)(hr)) >= 0)
+#define FAILED(hr) (((HRESULT)(hr)) < 0)
+#define S_OK 0
+#define E_FAIL ((HRESULT)0x80004005L)
+#define ERROR_SUCCESS 0
+#define ERROR_ALREADY_EXISTS 183
+
+#define INVALID_HANDLE_VALUE ((HANDLE)(intptr_t)-1)
+#define FILE_ATTRIBUTE_DIRECTORY 0x10
+#define FILE_ATTRIBUTE_NORMAL 0x80
+#define GENERIC_READ 0x80000000u
+#define GENERIC_WRITE 0x40000000u
+#define FILE_SHARE_READ 1
+#define FILE_SHARE_DELETE 4
+#define CREATE_ALWAYS 2
+#define OPEN_EXISTING 3
+#define PAGE_READONLY 2
+#define FILE_MAP_READ 4
+#define MOVEFILE_REPLACE_EXISTING 1
+#define DRIVE_FIXED 3
+#define DRIVE_RAMDISK 6
+#define THREAD_PRIORITY_BELOW_NORMAL -1
+
+#define WM_DESTROY 0x0002
+#define WM_GETDLGCODE 0x0087
+#define WM_KEYDOWN 0x0100
+#define WM_INITDIALOG 0x0110
+#define WM_COMMAND 0x0111
+#define WM_MDIGETACTIVE 0x0229
+#define WM_USER 0x0400
+#define EN_UPDATE 0x0400
+#define VK_END 0x23
+#define VK_HOME 0x24
+#define VK_UP 0x26
+#define VK_DOWN 0x28
+#define DLGC_WANTALLKEYS 4
+#define GWLP_WNDPROC (-4)
+#define LB_ERR (-1)
+#define LB_ADDSTRING 0x0180
+#define LB_RESETCONTENT 0x0184
+#define LB_SETCURSEL 0x0186
+#define LB_GETCURSEL 0x0188
+#define LB_GETTEXT 0x0189
+#define LB_GETCOUNT 0x018b
+#define SB_SETTEXT (WM_USER + 11)
+#define IDOK 1
+#define IDCANCEL 2
+
+#define INFINITE 0xffffffffu
+#define LMEM_FIXED 0
+#define LMEM_MOVEABLE 2
+#define LMEM_ZEROINIT 0x40
+#define LPTR (LMEM_FIXED | LMEM_ZEROINIT)
+#define MEM_COMMIT 0x1000
+#define MEM_RESERVE 0x2000
+#define MEM_RELEASE 0x8000
+#define PAGE_READWRITE 4
+
+#define LOCALE_NAME_INVARIANT TEXT("")
+#define LCMAP_LOWERCASE 0x100
+#define LCMAP_UPPERCASE 0x200
+#define CSTR_LESS_THAN 1
+#define CSTR_EQUAL 2
+#define CSTR_GREATER_THAN 3
+
+#define CopyMemory memcpy
+#define ZeroMemory(p, cb) memset(p, 0, cb)
+#define UNREFERENCED_PARAMETER(P) (void)(P)
+
+#ifndef __cplusplus
+#define min(a, b) ((a) < (b) ? (a) : (b))
+#endif
+
+typedef struct {
+   pthread_mutex_t m;
+} CRITICAL_SECTION;
+
+static inline BOOL InitializeCriticalSectionAndSpinCount(CRITICAL_SECTION* pcs, DWORD dwSpinCount)
+{
+   pthread_mutexattr_t attr;
+
+   UNREFERENCED_PARAMETER(dwSpinCount);
+   pthread_mutexattr_init(&attr);
+   pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+   pthread_mutex_init(&pcs->m, &attr);
+   pthread_mutexattr_destroy(&attr);
+   return TRUE;
+}
+
+static inline VOID DeleteCriticalSection(CRITICAL_SECTION* pcs) { pthread_mutex_destroy(&pcs->m); }
+static inline VOID EnterCriticalSection(CRITICAL_SECTION* pcs) { pthread_mutex_lock(&pcs->m); }
+static inline VOID LeaveCriticalSection(CRITICAL_SECTION* pcs) { pthread_mutex_unlock(&pcs->m); }
+static inline BOOL SetThreadPriority(pthread_t hThread, int nPriority) { UNREFERENCED_PARAMETER(hThread); UNREFERENCED_PARAMETER(nPriority); return TRUE; }
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//
+// In host.cpp, which counts the local and virtual allocations (see
+// HostGetAllocCounts in host.h); LCMapStringEx, and CompareStringOrdinal for the
+// HOST_WCHAR16 build of wfcase.c, are in bench_case.cpp.
+//
+HLOCAL LocalAlloc(UINT uFlags, SIZE_T cb);
+HLOCAL LocalReAlloc(HLOCAL hMem, SIZE_T cb, UINT uFlags);
+HLOCAL LocalFree(HLOCAL hMem);
+SIZE_T LocalSize(HLOCAL hMem);
+LPVOID VirtualAlloc(LPVOID lpAddress, SIZE_T cb, DWORD flAllocationType, DWORD flProtect);
+BOOL VirtualFree(LPVOID lpAddress, SIZE_T cb, DWORD dwFreeType);
+LONG InterlockedIncrement(LONG volatile* plAddend);
+LONG InterlockedDecrement(LONG volatile* plAddend);
+HANDLE CreateThread(LPVOID lpAttributes, SIZE_T cbStack, LPTHREAD_START_ROUTINE lpStartAddress,
+   LPVOID lpParameter, DWORD dwCreationFlags, LPDWORD lpThreadId);
+DWORD WaitForSingleObject(HANDLE hHandle, DWORD dwMilliseconds);
+VOID GetSystemInfo(SYSTEM_INFO* lpSystemInfo);
+INT LCMapStringEx(LPCWSTR lpLocaleName, DWORD dwMapFlags, LPCWSTR lpSrcStr, INT cchSrc,
+   LPWSTR lpDestStr, INT cchDest, LPVOID lpVersionInformation, LPVOID lpReserved, LPARAM sortHandle);
+INT CompareStringOrdinal(LPCWSTR lpString1, INT cchCount1, LPCWSTR lpString2, INT cchCount2, BOOL bIgnoreCase);
+
+#ifdef __cplusplus
+}
+#endif
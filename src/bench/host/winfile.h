@@ -0,0 +1,130 @@
+/********************************************************************
+
+   winfile.h
+
+   Host stand-in for winfile.h: only what wfgoto.cpp, wfcase.c,
+   wfcols.c and wfmem.c use.  They are compiled through links in this
+   directory (see ../GNUmakefile) so that their #include "winfile.h"
+   finds this file.
+
+   Copyright (c) Microsoft Corporation. All rights reserved.
+   Licensed under the MIT License.
+
+********************************************************************/
+
+#pragma once
+
+#include <stdio.h>
+#include <windows.h>
+#include "wfcase.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// inside, as wfmem.h and wfdocb.h (which wfcols.h includes) are C only
+#include "wfcols.h"
+
+#define MAXPATHLEN 260
+#define MAXFILENAMELEN 260
+#define CHAR_BACKSLASH L'\\'
+#define CHAR_COLON L':'
+#define CHAR_NULL L'\0'
+#define CHAR_DOT L'.'
+#define CHAR_A TEXT('A')
+#define CHAR_a TEXT('a')
+#define CHAR_Z TEXT('Z')
+#define CHAR_z TEXT('z')
+#define SZ_BACKSLASH L"\\"
+#define COUNTOF(x) (sizeof(x) / sizeof(*(x)))
+#define ByteCountOf(x) ((x) * sizeof(WCHAR))
+#define ISDOTDIR(x) (x[0] == L'.' && (x[1] == L'\0' || (x[1] == L'.' && x[2] == L'\0')))
+
+#define ATTR_DIR 0x0010
+#define ATTR_PARENT 0x0040
+#define ATTR_REPARSE_POINT 0x0400
+
+#define IDD_NAME 201
+#define IDD_TYPE 202
+#define IDD_SIZE 203
+#define IDD_DATE 204
+#define IDD_FDATE 205
+
+#define FSC_MKDIR 3
+#define FSC_RMDIR 4
+#define FSC_RENAME 7
+#define FSC_MKDIRQUIET 103
+#define FSC_RMDIRQUIET 104
+#define FS_GOTORESULTS (WM_USER + 0x210)
+#define IDD_GOTODIR 100
+#define IDD_GOTOLIST 101
+#define IDD_HELP 254
+#define GET_WM_COMMAND_ID(wp, lp) LOWORD(wp)
+
+#define StringCchCopy(d, n, s) (wcsncpy(d, s, n), (wcslen(s) < (n) ? S_OK : E_FAIL))
+#define StringCchPrintf(d, n, ...) (swprintf(d, n, __VA_ARGS__) >= 0 ? S_OK : E_FAIL)
+#define lstrcpy wcscpy
+#define lstrcat wcscat
+#define lstrlen(s) ((int)wcslen(s))
+#define lstrcmpi wcscasecmp
+#define CreateFile(...) INVALID_HANDLE_VALUE
+#define SendMessage SendMessageW
+#define SendDlgItemMessage SendDlgItemMessageW
+#define GetDlgItemText GetDlgItemTextW
+
+extern WCHAR szStarDotStar[];
+extern WCHAR szSettings[];
+extern WCHAR szGotoRoots[];
+extern WCHAR szTheINIFile[];
+extern WCHAR szGotoSnapshotFile[];
+extern WCHAR szGotoLegacySnapshotFile[];
+extern WCHAR szRoamINIPath[];
+extern HWND hwndStatus;
+extern HWND hwndMDIClient;
+extern BOOL bGotoRanked;
+extern UINT wHelpMessage;
+
+VOID StripBackslash(LPWSTR);
+VOID StripFilespec(LPWSTR);
+BOOL IsWild(LPWSTR);
+BOOL GetHistoryDir(INT, LPWSTR);
+LPWSTR StrRChr(LPCWSTR, LPCWSTR, WCHAR);
+BOOL PathIsDirectoryEmpty(LPCWSTR);
+BOOL PathIsDirectory(LPCWSTR);
+BOOL IsCharAlphaNumeric(WCHAR);
+DWORD GetEnvironmentVariable(LPCWSTR, LPWSTR, DWORD);
+BOOL CreateDirectory(LPCWSTR, void*);
+DWORD GetLastError(void);
+BOOL UnmapViewOfFile(LPVOID);
+BOOL GetFileSizeEx(HANDLE, LARGE_INTEGER*);
+HANDLE CreateFileMapping(HANDLE, void*, DWORD, DWORD, DWORD, LPCWSTR);
+BOOL CloseHandle(HANDLE);
+LPVOID MapViewOfFile(HANDLE, DWORD, DWORD, DWORD, SIZE_T);
+BOOL WriteFile(HANDLE, const void*, DWORD, DWORD*, void*);
+BOOL MoveFileEx(LPCWSTR, LPCWSTR, DWORD);
+BOOL DeleteFile(LPCWSTR);
+UINT GetDriveType(LPCWSTR);
+DWORD GetPrivateProfileString(LPCWSTR, LPCWSTR, LPCWSTR, LPWSTR, DWORD, LPCWSTR);
+LRESULT SendMessageW(HWND, UINT, WPARAM, LPARAM);
+LRESULT SendDlgItemMessageW(HWND, INT, UINT, WPARAM, LPARAM);
+BOOL PostMessage(HWND, UINT, WPARAM, LPARAM);
+HWND GetDlgItem(HWND, INT);
+UINT GetDlgItemTextW(HWND, INT, LPWSTR, INT);
+HWND GetParent(HWND);
+LRESULT CallWindowProcW(WNDPROC, HWND, UINT, WPARAM, LPARAM);
+LONG_PTR SetWindowLongPtr(HWND, INT, LONG_PTR);
+BOOL EndDialog(HWND, INT_PTR);
+HWND SetFocus(HWND);
+HWND CreateDirWindow(LPWSTR, BOOL, HWND);
+HWND HasTreeWindow(HWND);
+VOID WFHelp(HWND);
+VOID OutputDebugString(LPCWSTR);
+INT wsprintf(LPWSTR, LPCWSTR, ...);
+VOID UpdateMoveStatus(DWORD);
+DWORD ReadMoveStatus(void);
+LPTSTR GetExtension(LPTSTR pszFile);
+INT CompareDTA(LPXDTA lpItem1, LPXDTA lpItem2, DWORD dwSort);
+
+#ifdef __cplusplus
+}
+#endif
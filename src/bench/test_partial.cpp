@@ -0,0 +1,238 @@
+/********************************************************************
+
+   test_partial.cpp
+
+   Go To queries while the first scan of a root runs, with every
+   directory read slowed down as if waiting on the disk (see host.h).
+   What the partial bag answers must only grow, always be part of what
+   the complete bag answers, and in the end be all of it.
+
+   Directories created, removed and renamed while the partial bag is
+   up must show in it at once, and in the complete bag when the scan
+   publishes it.
+
+   test_partial [fanout [depth [microseconds per directory]]]
+
+   Copyright (c) Microsoft Corporation. All rights reserved.
+   Licensed under the MIT License.
+
+********************************************************************/
+
+#include "wfgoto.cpp"
+#include "host.h"
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+#include <set>
+
+namespace {
+	const LPCWSTR c_rgszQueries[] = {
+		L"s", L"src", L"doc", L"x64", L"bin", L"te",
+	};
+
+	const LPCWSTR c_rgszFuzzy[] = {
+		L"dcmnts", L"tls", L"pkgs",
+	};
+
+	typedef std::vector<std::set<std::wstring>> query_results;	// per query, c_rgszQueries then c_rgszFuzzy
+
+	int g_cFailed;
+
+	void Check(bool f, const char* szWhat, LPCWSTR szDetail = L"")
+	{
+		if (!f)
+		{
+			printf("FAILED: %s %ls\n", szWhat, szDetail);
+			g_cFailed++;
+		}
+	}
+
+	query_results Query(const values_bag& bag)
+	{
+		auto pView = bag.GetView();
+		query_results results;
+		WCHAR szPath[MAXPATHLEN];
+
+		auto Add = [&results, &szPath](const std::vector<PDNODE>& nodes) {
+			results.emplace_back();
+			for (PDNODE p : nodes)
+			{
+				GetTreePath(p, szPath);
+				results.back().insert(szPath);
+			}
+		};
+
+		for (LPCWSTR szQuery : c_rgszQueries)
+			Add(bag.Retrieve(*pView, szQuery, true, UINT_MAX));
+		for (LPCWSTR szQuery : c_rgszFuzzy)
+			Add(bag.RetrieveSubsequence(*pView, szQuery, UINT_MAX));
+
+		return results;
+	}
+
+	bool Includes(const query_results& larger, const query_results& smaller)
+	{
+		for (size_t i = 0; i < larger.size(); i++)
+		{
+			if (!std::includes(larger[i].begin(), larger[i].end(), smaller[i].begin(), smaller[i].end()))
+				return false;
+		}
+		return true;
+	}
+
+	size_t Count(const query_results& results)
+	{
+		size_t c = 0;
+		for (auto& set : results)
+			c += set.size();
+		return c;
+	}
+
+	bool Has(const values_bag& bag, const std::wstring& path)
+	{
+		return bag.FindDirectoryNode(*bag.GetView(), path.c_str()) != nullptr;
+	}
+
+	// the first scan of the shard, as StartBuildingDirectoryTrie runs it; onPartial is called on the
+	// partial bag until the scan is done
+	template <class TOnPartial>
+	void ScanWhile(goto_shard* pShard, TOnPartial onPartial)
+	{
+		std::atomic_store(&pShard->pBag, std::shared_ptr<values_bag>());
+
+		std::atomic_bool fDone{ false };
+		std::thread thread([pShard, &fDone]() {
+			BuildDirectoryTreeBagOValues(pShard);
+			fDone = true;
+		});
+
+		while (!fDone)
+		{
+			auto pBag = std::atomic_load(&pShard->pBag);
+			if (pBag != nullptr && pBag->fPartial)
+				onPartial(*pBag);
+			std::this_thread::sleep_for(std::chrono::milliseconds(10));
+		}
+
+		thread.join();
+	}
+}
+
+int main(int argc, char** argv)
+{
+	UINT cFanout = argc > 1 ? atoi(argv[1]) : 8;
+	UINT cDepth = argc > 2 ? atoi(argv[2]) : 5;
+	UINT cMicroseconds = argc > 3 ? atoi(argv[3]) : 50;
+
+	HostSetTree(cFanout, cDepth, 0);
+
+	// the default root, c:\, is the one shard
+	goto_shard* pShard = GetGotoShards().front().get();
+
+	// what the complete bag must answer
+	std::atomic_uint32_t scanEpoc{ 0 };
+	values_bag reference;
+	directory_scanner scanner(GetScanWorkerCount(), scanEpoc, 0, GOTO_LOCAL_MAX_NODES);
+	scanner.Scan(reference, pShard->root.c_str());
+	reference.BagOCDrive.Sort();
+	query_results expected = Query(reference);
+	printf("%zu directories, %zu results expected\n", reference.allNodes.size(), Count(expected));
+
+	HostSetFindLatency(cMicroseconds);
+
+	// the partial bag's answers only grow
+	std::vector<size_t> counts;
+	query_results last(expected.size());
+	ScanWhile(pShard, [&](const values_bag& partial) {
+		query_results results = Query(partial);
+		Check(Includes(results, last), "partial results shrank");
+		Check(Includes(expected, results), "partial results not in the complete ones");
+		if (counts.empty() || Count(results) != counts.back())
+			counts.push_back(Count(results));
+		last = std::move(results);
+	});
+
+	query_results complete = Query(*std::atomic_load(&pShard->pBag));
+	Check(!std::atomic_load(&pShard->pBag)->fPartial, "complete bag published");
+	Check(complete == expected, "complete results");
+	Check(Includes(complete, last), "last partial results not in the complete ones");
+
+	printf("partial results grew through %zu counts:", counts.size());
+	for (size_t c : counts)
+		printf(" %zu", c);
+	printf(" -> %zu\n", Count(complete));
+	Check(counts.size() >= 3, "partial results seen growing");
+
+	// changes made while the partial bag is up; the directories changed are ones it already has
+	std::wstring parent, removed, renamedFrom;
+	std::wstring added, renamedTo;
+	bool fChanged = false;
+	ScanWhile(pShard, [&](values_bag& partial) {
+		if (fChanged || partial.GetView()->segments == nullptr)
+			return;
+
+		// three directories under one parent, from the runs published so far
+		WCHAR szPath[MAXPATHLEN];
+		std::map<PDNODE, std::vector<PDNODE>> children;
+		for (auto& pRun : *partial.GetView()->segments)
+		{
+			pRun->ForEachPair([&children](const std::wstring&, PDNODE p) {
+				if (p->pParent != nullptr)
+					children[p->pParent].push_back(p);
+			});
+		}
+
+		for (auto& entry : children)
+		{
+			std::sort(entry.second.begin(), entry.second.end());
+			entry.second.erase(std::unique(entry.second.begin(), entry.second.end()), entry.second.end());
+			if (entry.second.size() < 2)
+				continue;
+
+			GetTreePath(entry.first, szPath);
+			parent = szPath;
+			GetTreePath(entry.second[0], szPath);
+			removed = szPath;
+			GetTreePath(entry.second[1], szPath);
+			renamedFrom = szPath;
+			break;
+		}
+
+		if (parent.empty())
+			return;
+
+		std::wstring prefix = parent.back() == CHAR_BACKSLASH ? parent : parent + SZ_BACKSLASH;
+		added = prefix + L"zzadded during scan";
+		renamedTo = prefix + L"zzrenamed during scan";
+
+		Check(Has(partial, parent) && Has(partial, removed) && Has(partial, renamedFrom), "partial bag finds its directories", parent.c_str());
+
+		UpdateDirectoryTrie(FSC_MKDIR, &added[0], NULL);
+		UpdateDirectoryTrie(FSC_RMDIR, &removed[0], NULL);
+		UpdateDirectoryTrie(FSC_RENAME, &renamedFrom[0], &renamedTo[0]);
+		fChanged = true;
+
+		Check(partial.fPartial && std::atomic_load(&pShard->pBag).get() == &partial, "changes made on the partial bag");
+		Check(Has(partial, added), "created directory in the partial bag", added.c_str());
+		Check(!Has(partial, removed), "removed directory gone from the partial bag", removed.c_str());
+		Check(!Has(partial, renamedFrom) && Has(partial, renamedTo), "renamed directory in the partial bag", renamedTo.c_str());
+	});
+
+	Check(fChanged, "changes made while the scan ran");
+	printf("changed under %ls while the scan ran\n", parent.c_str());
+
+	auto pComplete = std::atomic_load(&pShard->pBag);
+	Check(Has(*pComplete, added), "created directory in the complete bag", added.c_str());
+	Check(!Has(*pComplete, removed), "removed directory gone from the complete bag", removed.c_str());
+	Check(!Has(*pComplete, renamedFrom) && Has(*pComplete, renamedTo), "renamed directory in the complete bag", renamedTo.c_str());
+	Check(pShard->cScans == 0 && pShard->changes.empty(), "changes dropped once replayed");
+
+	if (g_cFailed)
+	{
+		printf("%d FAILED\n", g_cFailed);
+		return 1;
+	}
+
+	printf("passed\n");
+	return 0;
+}
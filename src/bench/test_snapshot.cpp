@@ -0,0 +1,179 @@
+/********************************************************************
+
+   test_snapshot.cpp
+
+   Round trip of the Go To snapshot (GOTO-<root>.IDX) format: a bag
+   indexed from a synthetic tree (see host.h) is serialized and loaded
+   back, and prefix, exact and fuzzy queries must give the same
+   directories on both.  Damaged images (truncated, from another
+   version, with a broken trie) must be refused.
+
+   test_snapshot [fanout [depth]]
+
+   Copyright (c) Microsoft Corporation. All rights reserved.
+   Licensed under the MIT License.
+
+********************************************************************/
+
+#include "wfgoto.cpp"
+#include "host.h"
+#include <cstdio>
+#include <cstdlib>
+
+namespace {
+	const LPCWSTR c_rgszQueries[] = {
+		L"s", L"sr", L"src", L"doc", L"documents", L"x64", L"v2", L"bin", L"te", L"zzz",
+	};
+
+	const LPCWSTR c_rgszFuzzy[] = {
+		L"dcmnts", L"srcs", L"tls", L"wndws", L"pkgs", L"xyzzy",
+	};
+
+	const LPCWSTR c_rgszTyped[] = {
+		L"src", L"bin debug", L"tools x64", L"src\\test", L"'release", L"web api",
+	};
+
+	int g_cFailed;
+
+	void Check(bool f, const char* szWhat, LPCWSTR szQuery = L"")
+	{
+		if (!f)
+		{
+			printf("FAILED: %s %ls\n", szWhat, szQuery);
+			g_cFailed++;
+		}
+	}
+
+	std::vector<std::wstring> Paths(const std::vector<PDNODE>& nodes)
+	{
+		std::vector<std::wstring> paths;
+		WCHAR szPath[MAXPATHLEN];
+
+		for (PDNODE p : nodes)
+		{
+			GetTreePath(p, szPath);
+			paths.push_back(szPath);
+		}
+		std::sort(paths.begin(), paths.end());
+		return paths;
+	}
+
+	bool Loads(std::vector<BYTE> image)
+	{
+		values_bag bag;
+		return DeserializeSnapshot(bag, image.data(), image.size());
+	}
+
+	snapshot_header& Header(std::vector<BYTE>& image)
+	{
+		return *reinterpret_cast<snapshot_header*>(image.data());
+	}
+}
+
+int main(int argc, char** argv)
+{
+	UINT cFanout = argc > 1 ? atoi(argv[1]) : 10;
+	UINT cDepth = argc > 2 ? atoi(argv[2]) : 4;
+
+	HostSetTree(cFanout, cDepth, 0);
+
+	// as BuildDirectoryTreeBagOValues builds a bag and saves it
+	std::atomic_uint32_t scanEpoc{ 0 };
+	auto pBag = std::make_shared<values_bag>();
+	directory_scanner scanner(GetScanWorkerCount(), scanEpoc, 0, GOTO_LOCAL_MAX_NODES);
+	scanner.Scan(*pBag, L"T:\\");
+	pBag->BagOCDrive.Sort();
+	pBag->Label();
+
+	std::vector<BYTE> image;
+	Check(SerializeSnapshot(*pBag, image), "SerializeSnapshot");
+
+	// as LoadGotoSnapshot loads it; the image stands in for the mapped file
+	auto pLoaded = std::make_shared<values_bag>();
+	Check(DeserializeSnapshot(*pLoaded, image.data(), image.size()), "DeserializeSnapshot");
+	pLoaded->Label();
+
+	printf("%zu directories, %zu keys, %zu byte image\n", pBag->allNodes.size(), pBag->BagOCDrive.size(), image.size());
+	Check(pLoaded->allNodes.size() == pBag->allNodes.size(), "directory count");
+	Check(pLoaded->BagOCDrive.size() == pBag->BagOCDrive.size(), "key count");
+	Check(Paths(std::vector<PDNODE>(pLoaded->allNodes.begin(), pLoaded->allNodes.end())) ==
+		Paths(std::vector<PDNODE>(pBag->allNodes.begin(), pBag->allNodes.end())), "directories");
+
+	auto pView = pBag->GetView();
+	auto pLoadedView = pLoaded->GetView();
+	size_t cResults = 0;
+
+	for (LPCWSTR szQuery : c_rgszQueries)
+	{
+		for (bool fPrefix : { true, false })
+		{
+			auto results = Paths(pBag->Retrieve(*pView, szQuery, fPrefix, UINT_MAX));
+			Check(results == Paths(pLoaded->Retrieve(*pLoadedView, szQuery, fPrefix, UINT_MAX)), fPrefix ? "prefix query" : "exact query", szQuery);
+			cResults += results.size();
+		}
+	}
+
+	for (LPCWSTR szQuery : c_rgszFuzzy)
+	{
+		auto results = Paths(pBag->RetrieveSubsequence(*pView, szQuery, UINT_MAX));
+		Check(results == Paths(pLoaded->RetrieveSubsequence(*pLoadedView, szQuery, UINT_MAX)), "fuzzy query", szQuery);
+		cResults += results.size();
+	}
+
+	// the whole query path, as the dialog runs it
+	query_cancel cancel{ nullptr, 0 };
+	for (LPCWSTR szTyped : c_rgszTyped)
+	{
+		BOOL bLimited = FALSE;
+		auto results = Paths(GetDirectoryOptionsFromText(pBag, szTyped, &bLimited, cancel));
+		Check(results == Paths(GetDirectoryOptionsFromText(pLoaded, szTyped, &bLimited, cancel)), "typed query", szTyped);
+		cResults += results.size();
+	}
+
+	printf("%zu results compared\n", cResults);
+
+	// truncated: the size in the header gives it away, and if that is fixed up, the sections don't fit
+	const size_t cbImage = image.size();
+	for (size_t cb : { (size_t)0, sizeof(snapshot_header) - 1, sizeof(snapshot_header), cbImage / 2, cbImage - 4, cbImage - 1 })
+	{
+		std::vector<BYTE> truncated(image.begin(), image.begin() + cb);
+		Check(!Loads(truncated), "truncated image loaded");
+
+		if (cb >= sizeof(snapshot_header))
+		{
+			Header(truncated).cbFile = static_cast<DWORD>(cb);
+			Check(!Loads(truncated), "truncated image with its size fixed up loaded");
+		}
+	}
+
+	std::vector<BYTE> damaged(image);
+	Header(damaged).dwVersion++;
+	Check(!Loads(damaged), "image of the next version loaded");
+
+	damaged = image;
+	Header(damaged).dwSignature = 0;
+	Check(!Loads(damaged), "image without the signature loaded");
+
+	// a child pointing back at the root would send Retrieve round in circles; IsValidTrie must catch it
+	damaged = image;
+	auto pTrieNodes = reinterpret_cast<BagOTrie<PDNODE>::TrieNode*>(damaged.data() + Header(damaged).dwTrieNodesOffset);
+	Check(pTrieNodes[0].childCount != 0, "trie has children");
+	pTrieNodes[0].firstChild = 0;
+	Check(!Loads(damaged), "image with a cyclic trie loaded");
+
+	damaged = image;
+	pTrieNodes = reinterpret_cast<BagOTrie<PDNODE>::TrieNode*>(damaged.data() + Header(damaged).dwTrieNodesOffset);
+	pTrieNodes[Header(damaged).cTrieNodes - 1].labelOffset = Header(damaged).cchLabels;
+	Check(!Loads(damaged), "image with a label past the arena loaded");
+
+	Check(Loads(image), "the undamaged image after all that");
+
+	if (g_cFailed)
+	{
+		printf("%d FAILED\n", g_cFailed);
+		return 1;
+	}
+
+	printf("passed\n");
+	return 0;
+}
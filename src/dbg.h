@@ -9,6 +9,10 @@
 
 ********************************************************************/
 
+#ifdef __cplusplus
+extern "C" {
+#endif
+
 #if DBG
 
 extern TCHAR szAsrtFmt[];
@@ -60,3 +64,7 @@ VOID DbgTraceDefMessage(LPTSTR funName, WORD msgId);
 #define LEAVE(funName)
 
 #endif // DBG
+
+#ifdef __cplusplus
+}
+#endif
@@ -185,6 +185,423 @@ WFFindClose(LPLFNDTA lpFind)
 }
 
 
+/////////////////////////////////////////////////////////////////////
+//
+// Batched enumeration
+//
+// WFFindFirstBatch / WFFindNextEntry walk a directory the same way
+// WFFindFirst / WFFindNext do (same attribute filter, same long name
+// rule) but fill a buffer with many entries per call to the file system.
+// When the pattern matches everything the directory is opened once and
+// read with GetFileInformationByHandleEx, which returns a buffer's worth
+// of entries (and their name lengths) per query; otherwise, or when the
+// file system doesn't support it, FindFirstFile / FindNextFile fill the
+// same buffer so callers see one interface.
+//
+/////////////////////////////////////////////////////////////////////
+
+#define LFNBATCH_MIN_BUFFER   (sizeof(LFNENTRY) + ByteCountOf(MAXPATHLEN) + 2 * sizeof(DWORD))
+#define LFNENTRY_SIZE(cch)    ((FIELD_OFFSET(LFNENTRY, cFileName) + ByteCountOf((cch) + 1) + 7) & ~7)
+
+
+/* BatchKeepEntry -
+ *
+ *  Applies the attribute filter and the MAXPATHLEN rule of WFFindNext.
+ *  Returns FALSE if the entry is to be skipped; otherwise *ppName and
+ *  *pcchName name the entry (possibly replaced by its short name).
+ */
+static BOOL
+BatchKeepEntry(
+   LPLFNBATCH lpBatch,
+   DWORD dwAttrs,
+   LPCWSTR* ppName,
+   INT* pcchName,
+   LPCWSTR pAltName,
+   INT cchAltName)
+{
+   if ((dwAttrs & ~lpBatch->dwAttrFilter) != 0)
+      return FALSE;
+
+   if (*pcchName > lpBatch->nSpaceLeft) {
+
+      if (!cchAltName || cchAltName > lpBatch->nSpaceLeft)
+         return FALSE;
+
+      *ppName = pAltName;
+      *pcchName = cchAltName;
+   }
+
+   return TRUE;
+}
+
+
+/* FillBatchFromHandle -
+ *
+ *  Reads the next buffer of entries with one bulk query and compacts
+ *  them in place into LFNENTRY records.  An LFNENTRY is never larger
+ *  than the FILE_ID_BOTH_DIR_INFO it is built from, so the write
+ *  position never passes the read position.
+ */
+static BOOL
+FillBatchFromHandle(LPLFNBATCH lpBatch)
+{
+   PFILE_ID_BOTH_DIR_INFO pInfo;
+   LPLFNENTRY lpEntry;
+   LPLFNENTRY lpLast;
+   LPBYTE pOut;
+   DWORD cbNext;
+   DWORD dwAttrs;
+   LARGE_INTEGER liWrite;
+   LARGE_INTEGER liChange;
+   LARGE_INTEGER liFileId;
+   LARGE_INTEGER liSize;
+   LPCWSTR pName;
+   INT cchName;
+   INT cchAlt;
+   WCHAR szAlt[14];
+
+   do {
+      if (!GetFileInformationByHandleEx(lpBatch->hDir,
+         lpBatch->bRestart ? FileIdBothDirectoryRestartInfo : FileIdBothDirectoryInfo,
+         lpBatch->pBuffer, lpBatch->cbBuffer)) {
+
+         lpBatch->err = GetLastError();
+         lpBatch->bEnd = TRUE;
+         return FALSE;
+      }
+
+      lpBatch->bRestart = FALSE;
+
+      pInfo = (PFILE_ID_BOTH_DIR_INFO)lpBatch->pBuffer;
+      pOut = lpBatch->pBuffer;
+      lpLast = NULL;
+
+      while (pInfo) {
+
+         //
+         // Copy out everything but the name before the record is overwritten
+         //
+         cbNext = pInfo->NextEntryOffset;
+         dwAttrs = pInfo->FileAttributes & ATTR_USED;
+         liWrite = pInfo->LastWriteTime;
+         liChange = pInfo->ChangeTime;
+         liFileId = pInfo->FileId;
+         liSize = pInfo->EndOfFile;
+         cchName = pInfo->FileNameLength / sizeof(WCHAR);
+         cchAlt = (INT)((BYTE)pInfo->ShortNameLength / sizeof(WCHAR));
+         if (cchAlt >= (INT)COUNTOF(szAlt))
+            cchAlt = (INT)COUNTOF(szAlt) - 1;
+         CopyMemory(szAlt, pInfo->ShortName, ByteCountOf(cchAlt));
+         szAlt[cchAlt] = CHAR_NULL;
+         pName = pInfo->FileName;
+
+         if (BatchKeepEntry(lpBatch, dwAttrs, &pName, &cchName, szAlt, cchAlt)) {
+
+            lpEntry = (LPLFNENTRY)pOut;
+
+            MoveMemory(lpEntry->cFileName, pName, ByteCountOf(cchName));
+            lpEntry->cFileName[cchName] = CHAR_NULL;
+
+            lpEntry->dwFileAttributes = dwAttrs;
+            lpEntry->ftLastWriteTime.dwLowDateTime = liWrite.LowPart;
+            lpEntry->ftLastWriteTime.dwHighDateTime = liWrite.HighPart;
+            lpEntry->liFileId = liFileId;
+            lpEntry->ftChangeTime.dwLowDateTime = liChange.LowPart;
+            lpEntry->ftChangeTime.dwHighDateTime = liChange.HighPart;
+            lpEntry->nFileSizeHigh = liSize.HighPart;
+            lpEntry->nFileSizeLow = liSize.LowPart;
+            lpEntry->cchFileName = cchName;
+            lpEntry->cchAlternateFileName = cchAlt;
+            lstrcpy(lpEntry->cAlternateFileName, szAlt);
+
+            lpEntry->cbNext = LFNENTRY_SIZE(cchName);
+            pOut += lpEntry->cbNext;
+            lpLast = lpEntry;
+         }
+
+         pInfo = cbNext ? (PFILE_ID_BOTH_DIR_INFO)((LPBYTE)pInfo + cbNext) : NULL;
+      }
+
+   } while (!lpLast);
+
+   lpLast->cbNext = 0;
+   return TRUE;
+}
+
+
+/* FillBatchFromFind -
+ *
+ *  Packs FindNextFile results into the buffer until it is full.  An
+ *  entry that doesn't fit is kept in lpBatch->fd for the next fill.
+ */
+static BOOL
+FillBatchFromFind(LPLFNBATCH lpBatch)
+{
+   LPLFNENTRY lpEntry;
+   LPLFNENTRY lpLast = NULL;
+   LPBYTE pOut = lpBatch->pBuffer;
+   LPBYTE pEnd = lpBatch->pBuffer + lpBatch->cbBuffer;
+   LPCWSTR pName;
+   INT cchName;
+   INT cchAlt;
+   DWORD dwAttrs;
+   PVOID oldValue;
+
+   if (lpBatch->bEnd)
+      return FALSE;
+
+   Wow64DisableWow64FsRedirection(&oldValue);
+
+   while (TRUE) {
+
+      if (!lpBatch->bPendingFd) {
+
+         if (!FindNextFile(lpBatch->hFindFile, &lpBatch->fd)) {
+            lpBatch->err = GetLastError();
+            lpBatch->bEnd = TRUE;
+            break;
+         }
+      }
+
+      dwAttrs = lpBatch->fd.dwFileAttributes & ATTR_USED;
+      pName = lpBatch->fd.cFileName;
+      cchName = lstrlen(pName);
+      cchAlt = lstrlen(lpBatch->fd.cAlternateFileName);
+
+      if (!BatchKeepEntry(lpBatch, dwAttrs, &pName, &cchName,
+         lpBatch->fd.cAlternateFileName, cchAlt)) {
+
+         lpBatch->bPendingFd = FALSE;
+         continue;
+      }
+
+      if (pOut + LFNENTRY_SIZE(cchName) > pEnd) {
+         lpBatch->bPendingFd = TRUE;
+         break;
+      }
+
+      lpBatch->bPendingFd = FALSE;
+
+      lpEntry = (LPLFNENTRY)pOut;
+      lpEntry->dwFileAttributes = dwAttrs;
+      lpEntry->ftLastWriteTime = lpBatch->fd.ftLastWriteTime;
+      lpEntry->liFileId.QuadPart = 0;
+      lpEntry->ftChangeTime.dwLowDateTime = 0;
+      lpEntry->ftChangeTime.dwHighDateTime = 0;
+      lpEntry->nFileSizeHigh = lpBatch->fd.nFileSizeHigh;
+      lpEntry->nFileSizeLow = lpBatch->fd.nFileSizeLow;
+      lpEntry->cchFileName = cchName;
+      lpEntry->cchAlternateFileName = cchAlt;
+      lstrcpy(lpEntry->cAlternateFileName, lpBatch->fd.cAlternateFileName);
+      CopyMemory(lpEntry->cFileName, pName, ByteCountOf(cchName + 1));
+
+      lpEntry->cbNext = LFNENTRY_SIZE(cchName);
+      pOut += lpEntry->cbNext;
+      lpLast = lpEntry;
+   }
+
+   Wow64RevertWow64FsRedirection(oldValue);
+
+   if (!lpLast)
+      return FALSE;
+
+   lpLast->cbNext = 0;
+   return TRUE;
+}
+
+
+static BOOL
+FillBatch(LPLFNBATCH lpBatch)
+{
+   if (lpBatch->hDir != INVALID_HANDLE_VALUE) {
+      return FillBatchFromHandle(lpBatch);
+   }
+   return FillBatchFromFind(lpBatch);
+}
+
+
+/* WFFindFirstBatch -
+ *
+ * returns:
+ *      TRUE for success - lpBatch->lpEntry is the first matching entry.
+ *      FALSE for failure - lpBatch->err set, nothing left open.
+ *
+ *  pBuffer may be NULL, in which case a buffer of LFNBATCH_BUFFER_SIZE
+ *  is allocated and freed by WFFindCloseBatch.  Errors are those of
+ *  FindFirstFile: if the bulk query fails before returning anything the
+ *  directory is enumerated with FindFirstFile instead.
+ */
+BOOL
+WFFindFirstBatch(
+   LPLFNBATCH lpBatch,
+   LPTSTR lpName,
+   DWORD dwAttrFilter,
+   LPVOID pBuffer,
+   DWORD cbBuffer)
+{
+   INT    nLen;
+   LPTSTR pSpec;
+   PVOID  oldValue;
+   TCHAR  szDir[MAXPATHLEN];
+
+   ZeroMemory(lpBatch, sizeof(*lpBatch));
+   lpBatch->hDir = INVALID_HANDLE_VALUE;
+   lpBatch->hFindFile = INVALID_HANDLE_VALUE;
+
+   if (!pBuffer || cbBuffer < LFNBATCH_MIN_BUFFER) {
+      cbBuffer = LFNBATCH_BUFFER_SIZE;
+      pBuffer = LocalAlloc(LMEM_FIXED, cbBuffer);
+      if (!pBuffer) {
+         lpBatch->err = ERROR_NOT_ENOUGH_MEMORY;
+         return FALSE;
+      }
+      lpBatch->bOwnBuffer = TRUE;
+   }
+
+   lpBatch->pBuffer = (LPBYTE)pBuffer;
+   lpBatch->cbBuffer = cbBuffer;
+
+   // see WFFindFirst
+   lpBatch->dwAttrFilter = dwAttrFilter | ATTR_ARCHIVE | ATTR_READONLY | ATTR_NORMAL |
+      ATTR_REPARSE_POINT | ATTR_TEMPORARY | ATTR_COMPRESSED | ATTR_NOT_INDEXED;
+
+   pSpec = &lpName[lstrlen(lpName)];
+   while (pSpec > lpName && CHAR_BACKSLASH != pSpec[-1])
+      pSpec--;
+
+   nLen = (INT)(pSpec - lpName);
+   lpBatch->nSpaceLeft = MAXPATHLEN-nLen-1;
+
+   //
+   // Redirection only matters while the path is resolved, so it is
+   // switched off around the open rather than around every read.
+   //
+   Wow64DisableWow64FsRedirection(&oldValue);
+
+   if (nLen && nLen < (INT)COUNTOF(szDir) &&
+      (!lstrcmp(pSpec, TEXT("*")) || !lstrcmp(pSpec, szStarDotStar))) {
+
+      // keep the trailing backslash so roots ("c:\", "\\server\share\") open
+      lstrcpyn(szDir, lpName, nLen + 1);
+
+      lpBatch->hDir = CreateFile(szDir, FILE_LIST_DIRECTORY,
+         FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, NULL,
+         OPEN_EXISTING, FILE_FLAG_BACKUP_SEMANTICS, NULL);
+
+      if (lpBatch->hDir != INVALID_HANDLE_VALUE) {
+
+         lpBatch->bRestart = TRUE;
+
+         if (!FillBatchFromHandle(lpBatch)) {
+            CloseHandle(lpBatch->hDir);
+            lpBatch->hDir = INVALID_HANDLE_VALUE;
+            lpBatch->bEnd = FALSE;
+         }
+      }
+   }
+
+   if (lpBatch->hDir == INVALID_HANDLE_VALUE) {
+
+      if ((dwAttrFilter & ~(ATTR_DIR | ATTR_HS)) == 0)
+      {
+         // directories only (hidden or not)
+         lpBatch->hFindFile = FindFirstFileEx(lpName, FindExInfoStandard, &lpBatch->fd, FindExSearchLimitToDirectories, NULL, 0);
+      }
+      else
+      {
+         lpBatch->hFindFile = FindFirstFile(lpName, &lpBatch->fd);
+      }
+
+      if (lpBatch->hFindFile == INVALID_HANDLE_VALUE) {
+         lpBatch->err = GetLastError();
+      } else {
+         lpBatch->bPendingFd = TRUE;
+      }
+   }
+
+   Wow64RevertWow64FsRedirection(oldValue);
+
+   if (lpBatch->hFindFile != INVALID_HANDLE_VALUE && !FillBatchFromFind(lpBatch)) {
+      FindClose(lpBatch->hFindFile);
+      lpBatch->hFindFile = INVALID_HANDLE_VALUE;
+   }
+
+   if (lpBatch->hDir == INVALID_HANDLE_VALUE && lpBatch->hFindFile == INVALID_HANDLE_VALUE) {
+
+      if (lpBatch->bOwnBuffer)
+         LocalFree(lpBatch->pBuffer);
+      lpBatch->pBuffer = NULL;
+
+      return FALSE;
+   }
+
+   lpBatch->err = 0;
+   lpBatch->lpEntry = (LPLFNENTRY)lpBatch->pBuffer;
+
+   return TRUE;
+}
+
+
+/* WFFindNextEntry -
+ *
+ *  Advances lpBatch->lpEntry, refilling the buffer when it is used up.
+ *  Returns FALSE with lpBatch->err set when there are no more entries.
+ */
+BOOL
+WFFindNextEntry(LPLFNBATCH lpBatch)
+{
+   if (!lpBatch->lpEntry)
+      return FALSE;
+
+   if (lpBatch->lpEntry->cbNext) {
+      lpBatch->lpEntry = (LPLFNENTRY)((LPBYTE)lpBatch->lpEntry + lpBatch->lpEntry->cbNext);
+      return TRUE;
+   }
+
+   if (lpBatch->bEnd || !FillBatch(lpBatch)) {
+      lpBatch->lpEntry = NULL;
+      return FALSE;
+   }
+
+   lpBatch->lpEntry = (LPLFNENTRY)lpBatch->pBuffer;
+   return TRUE;
+}
+
+
+/* WFFindCloseBatch -
+ *
+ *  Like WFFindClose, safe to call more than once and on a batch that
+ *  was zero initialized but never opened.
+ */
+BOOL
+WFFindCloseBatch(LPLFNBATCH lpBatch)
+{
+   BOOL bRet = FALSE;
+
+   if (!lpBatch->pBuffer) {
+      return(FALSE);
+   }
+
+   if (lpBatch->hDir != INVALID_HANDLE_VALUE) {
+      bRet = CloseHandle(lpBatch->hDir);
+   }
+   if (lpBatch->hFindFile != INVALID_HANDLE_VALUE) {
+      bRet = FindClose(lpBatch->hFindFile);
+   }
+
+   if (lpBatch->bOwnBuffer) {
+      LocalFree(lpBatch->pBuffer);
+   }
+
+   lpBatch->hDir = INVALID_HANDLE_VALUE;
+   lpBatch->hFindFile = INVALID_HANDLE_VALUE;
+   lpBatch->pBuffer = NULL;
+   lpBatch->lpEntry = NULL;
+
+   return(bRet);
+}
+
+
 
 
 /* WFIsDir
@@ -35,6 +35,41 @@ typedef struct {
    INT   nSpaceLeft;           // Space left for deeper paths
 } LFNDTA, *LPLFNDTA, * PLFNDTA;
 
+// batched enumeration: one file system query fills a buffer with many
+// entries which are then walked without further calls.
+
+#define LFNBATCH_BUFFER_SIZE  0x10000
+
+typedef struct _LFNENTRY {
+   DWORD cbNext;               // offset of the next entry; 0 for the last
+   DWORD dwFileAttributes;     // already masked with ATTR_USED
+   FILETIME ftLastWriteTime;
+   LARGE_INTEGER liFileId;     // 0 when read with FindFirstFile
+   FILETIME ftChangeTime;      // likewise; changes with the reparse data
+   DWORD nFileSizeHigh;
+   DWORD nFileSizeLow;
+   INT   cchFileName;          // length of cFileName, excluding the NUL
+   INT   cchAlternateFileName;
+   WCHAR cAlternateFileName[14];
+   WCHAR cFileName[1];         // NUL terminated, variable length
+} LFNENTRY, *LPLFNENTRY;
+
+typedef struct {
+   HANDLE hDir;                // directory handle for bulk queries
+   HANDLE hFindFile;           // FindFirstFile() handle when hDir can't be used
+   DWORD dwAttrFilter;         // search attribute mask.
+   DWORD err;                  // error info if failure.
+   INT   nSpaceLeft;           // Space left for deeper paths
+   LPBYTE pBuffer;             // packed LFNENTRY records
+   DWORD cbBuffer;
+   BOOL  bOwnBuffer;           // pBuffer was allocated by WFFindFirstBatch
+   BOOL  bRestart;             // next bulk query restarts the scan
+   BOOL  bPendingFd;           // fd holds an entry that didn't fit last time
+   BOOL  bEnd;                 // no more entries beyond this buffer
+   LPLFNENTRY lpEntry;         // current entry
+   WIN32_FIND_DATA fd;         // FindNextFile() data for the fallback path
+} LFNBATCH, *LPLFNBATCH;
+
 VOID  LFNInit( VOID );
 VOID  InvalidateVolTypes( VOID );
 
@@ -46,6 +81,10 @@ BOOL  WFFindFirst(LPLFNDTA lpFind, LPTSTR lpName, DWORD dwAttrFilter);
 BOOL  WFFindNext(LPLFNDTA);
 BOOL  WFFindClose(LPLFNDTA);
 
+BOOL  WFFindFirstBatch(LPLFNBATCH lpBatch, LPTSTR lpName, DWORD dwAttrFilter, LPVOID pBuffer, DWORD cbBuffer);
+BOOL  WFFindNextEntry(LPLFNBATCH lpBatch);
+BOOL  WFFindCloseBatch(LPLFNBATCH lpBatch);
+
 
 DWORD  I_LFNCanon( USHORT CanonType, LPTSTR InFile, LPTSTR OutFile );
 DWORD  LFNParse(LPTSTR,LPTSTR,LPTSTR);
@@ -214,7 +214,7 @@ ComparePath(PDNODE p1, PDNODE p2)
       if (ret == 0) {
          // parents are equal
 
-         ret = lstrcmpi(p1->szName, p2->szName);
+         ret = CompareOrdinalNoCase(p1->szName, p2->szName);
 #if 0
          {
             TCHAR buf[200];
@@ -527,7 +527,9 @@ ReadDirLevel(
    BOOL bPartialSort)
 {
    LPWSTR      szEndPath;
-   LFNDTA    lfndta;
+   LFNBATCH  batch = { 0 };
+   LPWSTR    pName = NULL;      // current directory, in batch or the dir window's DTA
+   DWORD     dwEntryAttrs = 0;
    INT       iNode;
    BOOL      bFound;
    PDNODE     pNode;
@@ -537,7 +539,7 @@ ReadDirLevel(
    HWND      hwndParent;
    HWND      hwndDir;
    LPXDTALINK lpStart;
-   LPXDTA*  plpxdta = NULL;
+   LPXDTALINK lpLink = NULL;
    LPXDTA   lpxdta = NULL;
    INT       count;
 
@@ -553,9 +555,8 @@ ReadDirLevel(
    // directories for the path we are about to search.  in this
    // case we look through the DTA structure in the dir window
    // to get all the directories (instead of calling FindFirst/FindNext).
-   // in this case we have to disable yielding since the user could
-   // potentially close the dir window that we are reading, or change
-   // directory.
+   // we hold a reference on the DTA, so the user can close the dir
+   // window or change directory while we yield.
    //
 
    lpStart = NULL;
@@ -573,7 +574,7 @@ ReadDirLevel(
 
             if (!lstrcmp(szMessage, szStarDotStar)) {
 
-               lpStart = (LPXDTALINK)GetWindowLongPtr(hwndDir, GWL_HDTA);
+               lpStart = MemAddRef((LPXDTALINK)GetWindowLongPtr(hwndDir, GWL_HDTA));
 
                if (lpStart) {
 
@@ -581,19 +582,6 @@ ReadDirLevel(
                   // holds number of entries, NOT size.
                   //
                   count = (INT)MemLinkToHead(lpStart)->dwEntries;
-
-                  //
-                  // We are currently using it, so mark it as in use.
-                  // There's a sync problem around lpStart:
-                  // Since we do a wfYield, this could be free'd in
-                  // the same thread if the user changes directories.
-                  // So we must mark it appropriately.
-                  //
-                  // Don't worry about critical sections, since
-                  // we are cooperatively multitasking using the
-                  // wfYield.
-                  //
-                  MemLinkToHead(lpStart)->fdwStatus |= LPXDTA_STATUS_READING;
                }
             }
          }
@@ -619,20 +607,17 @@ ReadDirLevel(
    AddBackslash(szPath);
    lstrcat(szPath, szStarDotStar);
 
-   if ( (lpStart) &&
-        (plpxdta = MemLinkToHead(lpStart)->alpxdtaSorted) )
+   if (lpStart)
    {
       //
-      // steal the entry from the dir window
+      // steal the entry from the dir window.  The DTA is in read order,
+      // which is fine since InsertDirectory sorts.
       //
-
-      // TODO: why not set count here?
+      lpLink = lpStart;
 
       // find first directory which isn't the special parent node
-      for (; count > 0; count--, plpxdta++)
+      for (lpxdta = MemFirst(lpStart); count > 0; count--, lpxdta = MemNext(&lpLink, lpxdta))
       {
-         lpxdta = *plpxdta;
-
          if ( (lpxdta->dwAttrs & ATTR_DIR) &&
               !(lpxdta->dwAttrs & ATTR_PARENT))
          {
@@ -645,10 +630,11 @@ ReadDirLevel(
          bFound = TRUE;
 
          //
-         // Only need to copy filename and my_dwAttrs
+         // Only need filename and my_dwAttrs; our reference on
+         // lpStart keeps the name put
          //
-         lfndta.fd.dwFileAttributes = lpxdta->dwAttrs;
-         lstrcpy(lfndta.fd.cFileName, MemGetFileName(lpxdta));
+         dwEntryAttrs = lpxdta->dwAttrs;
+         pName = MemGetFileName(lpxdta);
       }
       else
       {
@@ -662,7 +648,12 @@ ReadDirLevel(
       //
       lstrcpy(szMessage, szPath);
 
-      bFound = WFFindFirst(&lfndta, szMessage, dwAttribs);
+      bFound = WFFindFirstBatch(&batch, szMessage, dwAttribs, NULL, 0);
+
+      if (bFound) {
+         dwEntryAttrs = batch.lpEntry->dwFileAttributes;
+         pName = batch.lpEntry->cFileName;
+      }
    }
 
    // for net drive case where we can't actually see what is in these
@@ -688,7 +679,7 @@ ReadDirLevel(
                                &pNode,
                                IsCasePreservedDrive(DRIVEID(szPath)),
                                bPartialSort,
-                               lfndta.fd.dwFileAttributes );
+                               dwEntryAttrs );
 
       pParentNode->wFlags |= TF_DISABLED;
 
@@ -727,14 +718,14 @@ ReadDirLevel(
       }
 
       /* Is this not a '.' or '..' directory? */
-      if (!ISDOTDIR(lfndta.fd.cFileName) &&
-         (lfndta.fd.dwFileAttributes & ATTR_DIR)) {
+      if (!ISDOTDIR(pName) &&
+         (dwEntryAttrs & ATTR_DIR)) {
 
           // we will try to auto expand this node if it matches
 
           // Must check if NULL
 
-          if (szAutoExpand && *szAutoExpand && !lstrcmpi(szAutoExpand, lfndta.fd.cFileName)) {
+          if (szAutoExpand && *szAutoExpand && !lstrcmpi(szAutoExpand, pName)) {
                 bAutoExpand = TRUE;
                 szAutoExpand += lstrlen(szAutoExpand) + 1;
           } else {
@@ -744,11 +735,11 @@ ReadDirLevel(
           iNode = InsertDirectory( hwndTreeCtl,
                                    pParentNode,
                                    iParentNode,
-                                   lfndta.fd.cFileName,
+                                   pName,
                                    &pNode,
                                    IsCasePreservedDrive(DRIVEID(szPath)),
                                    bPartialSort,
-                                   lfndta.fd.dwFileAttributes );
+                                   dwEntryAttrs );
 
              if (hwndStatus && ((cNodes % READDIRLEVEL_UPDATE) == 0)) {
 
@@ -769,7 +760,7 @@ ReadDirLevel(
           //
           *szEndPath = CHAR_NULL;
           AddBackslash(szPath);
-          lstrcat(szPath, lfndta.fd.cFileName);         // cFileName is ANSI now
+          lstrcat(szPath, pName);
 
 
           // either recurse or add pluses
@@ -791,21 +782,20 @@ ReadDirLevel(
           }
       }
 
-      if (lpStart && plpxdta)
+      if (lpStart)
       {
           //
           // short cut, steal data from dir window
           //
-          // Warning: count could be zero now, so may go negative.
+          // count is at least 1 here (we found lpxdta), so MemNext
+          // only ever steps off a real entry.
           //
           count--;
-          ++plpxdta;
+          lpxdta = MemNext(&lpLink, lpxdta);
 
           // find next directory which isn't the special parent node
           while (count > 0)
           {
-              lpxdta = *plpxdta;
-
               if ( (lpxdta->dwAttrs & ATTR_DIR) &&
                    !(lpxdta->dwAttrs & ATTR_PARENT))
               {
@@ -816,7 +806,7 @@ ReadDirLevel(
               // Go to next item.
               //
               count--;
-              ++plpxdta;
+              lpxdta = MemNext(&lpLink, lpxdta);
           }
 
           if (count > 0)
@@ -824,10 +814,10 @@ ReadDirLevel(
               bFound = TRUE;
 
               //
-              // Only need to copy attrs and file name
+              // Only need attrs and file name
               //
-              lfndta.fd.dwFileAttributes = lpxdta->dwAttrs;
-              lstrcpy(lfndta.fd.cFileName, MemGetFileName(lpxdta));
+              dwEntryAttrs = lpxdta->dwAttrs;
+              pName = MemGetFileName(lpxdta);
           }
           else
           {
@@ -836,7 +826,12 @@ ReadDirLevel(
       }
       else
       {
-          bFound = WFFindNext(&lfndta); // get it from dos
+          bFound = WFFindNextEntry(&batch); // get it from dos
+
+          if (bFound) {
+             dwEntryAttrs = batch.lpEntry->dwFileAttributes;
+             pName = batch.lpEntry->cFileName;
+          }
       }
   }
 
@@ -844,26 +839,15 @@ ReadDirLevel(
 
 DONE:
 
-  if (lpStart)
-  {
-      //
-      // No longer using it.
-      //
-      MemLinkToHead(lpStart)->fdwStatus &= ~LPXDTA_STATUS_READING;
+  //
+  // No longer using it; frees it if the dir window let go meanwhile
+  //
+  MemDelete(lpStart);
 
-      //
-      // If we were stealing from a directory and then
-      // we tried to delete it (but couldn't since we're reading),
-      // we mark it as LPXDTA_STATUS_CLOSE.  If it's marked,
-      // free it.
-      //
-      if (MemLinkToHead(lpStart)->fdwStatus & LPXDTA_STATUS_CLOSE)
-          MemDelete(lpStart);
-  }
-  else
-  {
-      WFFindClose(&lfndta);
-  }
+  //
+  // Nothing to close if we stole from the dir window
+  //
+  WFFindCloseBatch(&batch);
 
    SetWindowLongPtr(hwndTreeCtl,
                  GWL_READLEVEL,
@@ -1450,7 +1434,6 @@ IsNetPath(PDNODE pNode)
 {
    // 2* buffer for single file overflow
    TCHAR szPath[MAXPATHLEN * 2];
-   DWORD dwType;
    DRIVE drive;
 
 
@@ -1458,28 +1441,15 @@ IsNetPath(PDNODE pNode)
       return FALSE;
 
    //
-   // Only do WNetGetDirectoryType if the drive
-   // hasn't failed before on this call.
+   // Only ask the network once per node (GetNetDirType doesn't
+   // ask drives which failed before).
    //
    if (pNode->dwNetType == (DWORD)-1)
    {
       GetTreePath(pNode, szPath);
       drive = DRIVEID(szPath);
 
-      if (!aDriveInfo[drive].bShareChkFail &&
-          WNetGetDirectoryType( szPath,
-                                &dwType,
-                                !aDriveInfo[drive].bShareChkTried ) == WN_SUCCESS)
-      {
-         pNode->dwNetType = dwType;
-      }
-      else
-      {
-         pNode->dwNetType = 0;
-         aDriveInfo[drive].bShareChkFail = TRUE;
-      }
-
-      aDriveInfo[drive].bShareChkTried = TRUE;
+      pNode->dwNetType = GetNetDirType(drive, szPath, NULL);
    }
 
    return pNode->dwNetType;
@@ -1768,6 +1738,12 @@ InvalidateAllNetTypes(VOID)
 {
    HWND hwndT, hwndNext, hwndDir;
 
+   //
+   // Shared directories are remembered with the listings
+   //
+   ProbeCacheFlush(-1);
+   DirCacheFlush();
+
    for (hwndT=GetWindow(hwndMDIClient, GW_CHILD); hwndT; hwndT=hwndNext) {
       hwndNext = GetWindow(hwndT, GW_HWNDNEXT);
       if (hwndT != hwndSearch && !GetWindow(hwndT, GW_OWNER)) {
@@ -0,0 +1,230 @@
+/********************************************************************
+
+   wfcase.c
+
+   Case folding and ordinal case insensitive comparison of file names
+
+   Copyright (c) Microsoft Corporation. All rights reserved.
+   Licensed under the MIT License.
+
+********************************************************************/
+
+#include "winfile.h"
+
+#if defined(_M_IX86) || defined(_M_X64) || defined(__SSE2__)
+#include <emmintrin.h>
+#define CASE_SSE2
+#endif
+
+#define CASE_CHUNK   8                   // WCHARs per 128 bit vector
+
+//
+// A vector load may read past the end of a string as long as it stays
+// in the same page; the characters past the end are never used.
+//
+#define CHUNK_IN_PAGE(p) ((((UINT_PTR)(p)) & 0xFFF) <= 0x1000 - CASE_CHUNK * sizeof(WCHAR))
+
+
+#ifdef CASE_SSE2
+
+static __inline UINT
+FirstBit(UINT uMask)
+{
+#ifdef _MSC_VER
+   unsigned long i;
+
+   _BitScanForward(&i, uMask);
+   return (UINT)i;
+#else
+   return (UINT)__builtin_ctz(uMask);
+#endif
+}
+
+//
+// Each lane of v (which must be ASCII) with ch - chFirst < 26 gets 0x20;
+// the others 0.
+//
+static __inline __m128i
+LetterBits(__m128i v, WCHAR chFirst)
+{
+   __m128i off = _mm_sub_epi16(v, _mm_set1_epi16(chFirst));
+   __m128i inRange = _mm_and_si128(_mm_cmpgt_epi16(off, _mm_set1_epi16(-1)),
+                                   _mm_cmplt_epi16(off, _mm_set1_epi16(26)));
+
+   return _mm_and_si128(inRange, _mm_set1_epi16(0x20));
+}
+
+//
+// Mask (one bit per byte, as _mm_movemask_epi8) of the lanes which are not ASCII
+//
+static __inline UINT
+NonAsciiMask(__m128i v)
+{
+   __m128i high = _mm_and_si128(v, _mm_set1_epi16((SHORT)0xFF80));
+
+   return ~(UINT)_mm_movemask_epi8(_mm_cmpeq_epi16(high, _mm_setzero_si128())) & 0xFFFF;
+}
+
+#endif // CASE_SSE2
+
+
+//
+// Flips the case of the ASCII letters from chFirst (CHAR_A or CHAR_a)
+// on; the rest goes through LCMapStringEx with dwMapFlags
+//
+static VOID
+MapCaseBuff(LPCWSTR lpSrc, LPWSTR lpDst, SIZE_T cch, WCHAR chFirst, DWORD dwMapFlags)
+{
+   SIZE_T i = 0;
+
+#ifdef CASE_SSE2
+   for (; i + CASE_CHUNK <= cch; i += CASE_CHUNK) {
+
+      __m128i v = _mm_loadu_si128((const __m128i*)(lpSrc + i));
+
+      if (NonAsciiMask(v))
+         break;
+
+      _mm_storeu_si128((__m128i*)(lpDst + i), _mm_xor_si128(v, LetterBits(v, chFirst)));
+   }
+#endif
+
+   for (; i < cch; i++) {
+
+      WCHAR ch = lpSrc[i];
+
+      if (ch >= 0x80) {
+
+         //
+         // Hand the rest to the system; the simple mapping keeps the length
+         //
+         if (LCMapStringEx(LOCALE_NAME_INVARIANT, dwMapFlags, lpSrc + i, (INT)(cch - i),
+                           lpDst + i, (INT)(cch - i), NULL, NULL, 0) != 0) {
+            return;
+         }
+
+         lpDst[i] = ch;
+         continue;
+      }
+
+      lpDst[i] = (WCHAR)(ch - chFirst) < 26 ? ch ^ 0x20 : ch;
+   }
+}
+
+
+/////////////////////////////////////////////////////////////////////
+//
+// Name:     LowerCaseBuff
+//
+// Synopsis: Lower cases cch characters of lpSrc into lpDst (which may be
+//           the same buffer).  Ordinal: the result does not depend on the
+//           user's locale, so keys lowered today match keys lowered in a
+//           saved index.
+//
+/////////////////////////////////////////////////////////////////////
+
+VOID
+LowerCaseBuff(LPCWSTR lpSrc, LPWSTR lpDst, SIZE_T cch)
+{
+   MapCaseBuff(lpSrc, lpDst, cch, CHAR_A, LCMAP_LOWERCASE);
+}
+
+
+/////////////////////////////////////////////////////////////////////
+//
+// Name:     UpperCaseBuff
+//
+// Synopsis: Upper cases cch characters of lpSrc into lpDst (which may be
+//           the same buffer), the way CompareOrdinalNoCase does before
+//           comparing.  Names upper cased once compare in that order
+//           character by character, with no further folding.
+//
+/////////////////////////////////////////////////////////////////////
+
+VOID
+UpperCaseBuff(LPCWSTR lpSrc, LPWSTR lpDst, SIZE_T cch)
+{
+   MapCaseBuff(lpSrc, lpDst, cch, CHAR_a, LCMAP_UPPERCASE);
+}
+
+
+/////////////////////////////////////////////////////////////////////
+//
+// Name:     CompareOrdinalNoCase
+//
+// Synopsis: Case insensitive comparison of two null terminated names
+//
+// Return:   < 0, 0 or > 0 like lstrcmpi
+//
+// Notes:    The order is that of CompareStringOrdinal(bIgnoreCase = TRUE):
+//           both names upper cased, then compared by code point.  That is
+//           also the order NTFS keeps directories in, so listings read
+//           from NTFS come back already sorted.  Unlike lstrcmpi it does
+//           not depend on the user's locale.
+//
+/////////////////////////////////////////////////////////////////////
+
+INT
+CompareOrdinalNoCase(LPCWSTR lpsz1, LPCWSTR lpsz2)
+{
+   WCHAR ch1, ch2;
+
+   for (;;) {
+
+#ifdef CASE_SSE2
+      if (CHUNK_IN_PAGE(lpsz1) && CHUNK_IN_PAGE(lpsz2)) {
+
+         __m128i v1 = _mm_loadu_si128((const __m128i*)lpsz1);
+         __m128i v2 = _mm_loadu_si128((const __m128i*)lpsz2);
+         UINT uStop;
+
+         //
+         // Stop at the first lane that differs, ends lpsz1 or needs the
+         // slow path.  Lanes holding non-ASCII fold to garbage but are
+         // never looked at: they stop the scan first.
+         //
+         __m128i u1 = _mm_sub_epi16(v1, LetterBits(v1, CHAR_a));
+         __m128i u2 = _mm_sub_epi16(v2, LetterBits(v2, CHAR_a));
+
+         uStop = ~(UINT)_mm_movemask_epi8(_mm_cmpeq_epi16(u1, u2)) & 0xFFFF;
+         uStop |= (UINT)_mm_movemask_epi8(_mm_cmpeq_epi16(v1, _mm_setzero_si128()));
+         uStop |= NonAsciiMask(_mm_or_si128(v1, v2));
+
+         if (!uStop) {
+            lpsz1 += CASE_CHUNK;
+            lpsz2 += CASE_CHUNK;
+            continue;
+         }
+
+         lpsz1 += FirstBit(uStop) / sizeof(WCHAR);
+         lpsz2 += FirstBit(uStop) / sizeof(WCHAR);
+      }
+#endif
+
+      ch1 = *lpsz1;
+      ch2 = *lpsz2;
+
+      if (ch1 >= 0x80 || ch2 >= 0x80) {
+
+         //
+         // Ordinal comparison is per character, so the rest of the names
+         // can be compared on their own
+         //
+         return CompareStringOrdinal(lpsz1, -1, lpsz2, -1, TRUE) - CSTR_EQUAL;
+      }
+
+      if (ch1 >= CHAR_a && ch1 <= CHAR_z)
+         ch1 -= 0x20;
+      if (ch2 >= CHAR_a && ch2 <= CHAR_z)
+         ch2 -= 0x20;
+
+      if (ch1 != ch2)
+         return ch1 < ch2 ? -1 : 1;
+
+      if (!ch1)
+         return 0;
+
+      lpsz1++;
+      lpsz2++;
+   }
+}
@@ -0,0 +1,29 @@
+/********************************************************************
+
+   wfcase.h
+
+   Copyright (c) Microsoft Corporation. All rights reserved.
+   Licensed under the MIT License.
+
+********************************************************************/
+
+#pragma once
+
+#include <windows.h>
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//
+// Case folding and comparison of file names.  Runs of ASCII are done
+// eight characters at a time; the rest of a name past the first
+// non-ASCII character goes through the invariant (ordinal) tables.
+//
+
+VOID LowerCaseBuff(LPCWSTR lpSrc, LPWSTR lpDst, SIZE_T cch);
+VOID UpperCaseBuff(LPCWSTR lpSrc, LPWSTR lpDst, SIZE_T cch);
+INT CompareOrdinalNoCase(LPCWSTR lpsz1, LPCWSTR lpsz2);
+
+#ifdef __cplusplus
+}
+#endif
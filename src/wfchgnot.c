@@ -34,6 +34,7 @@ VOID
 vWaitMessage()
 {
    DWORD dwEvent;
+   WCHAR szDir[MAXPATHLEN];
 
    dwEvent = MsgWaitForMultipleObjects(nHandles,
                                        ahEvents,
@@ -58,6 +59,12 @@ vWaitMessage()
          if ((dwEvent >= MAX_WINDOWS) || ahEvents[dwEvent] == NULL)
             return;
 
+         //
+         // What the readers found out about the files there may be stale
+         //
+         SendMessage(ahwndWindows[dwEvent], FS_GETDIRECTORY, COUNTOF(szDir), (LPARAM)szDir);
+         ProbeCacheInvalidate(szDir);
+
          //
          // Modify GWL_FSCFLAG directly.
          //
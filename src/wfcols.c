@@ -0,0 +1,1105 @@
+/********************************************************************
+
+   wfcols.c
+
+   Column (struct of arrays) view of a directory listing
+
+   Copyright (c) Microsoft Corporation. All rights reserved.
+   Licensed under the MIT License.
+
+********************************************************************/
+
+#include "winfile.h"
+
+#define SORT_RUN            16           // insertion sorted before merging
+#define SORT_PARALLEL_MIN   32768        // fewer entries are sorted on one thread
+#define SORT_MAX_THREADS    8            // power of 2
+
+typedef INT (*PFNCOMPAREINDEX)(PVOID pContext, DWORD i, DWORD j);
+
+//
+// One thread's share of SortIndicesParallel: sort the cLeft entries of
+// aiSrc (aiDst is scratch), or merge the cLeft and cRight entries there
+// into aiDst
+//
+typedef struct _SORTCHUNK {
+   BOOL bMerge;
+   LPDWORD aiSrc;
+   LPDWORD aiDst;
+   DWORD cLeft;
+   DWORD cRight;
+   PFNCOMPAREINDEX pfnCompare;
+   PVOID pContext;
+   HANDLE hThread;
+} SORTCHUNK, *PSORTCHUNK;
+
+typedef struct _COLSSORT {
+   PXDTACOLS pCols;
+   DWORD dwSort;
+} COLSSORT, *PCOLSSORT;
+
+typedef struct _EXTTABLE {
+   LPWSTR* apszExt;           // distinct extensions
+   LPDWORD adwHash;
+   LPDWORD adwRank;
+   DWORD cExt;
+   DWORD cExtMax;
+   LPDWORD aiSlot;            // 1 + index into apszExt; 0 is free
+   DWORD cSlots;              // power of 2
+} EXTTABLE, *PEXTTABLE;
+
+
+//
+// Merges the sorted runs aiSrc[iLo..iMid) and aiSrc[iMid..iHi) into aiDst
+//
+VOID
+MergeIndices(
+   LPDWORD aiSrc,
+   LPDWORD aiDst,
+   DWORD iLo,
+   DWORD iMid,
+   DWORD iHi,
+   PFNCOMPAREINDEX pfnCompare,
+   PVOID pContext)
+{
+   DWORD i, j, k;
+
+   if (iMid == iHi || iLo == iMid || pfnCompare(pContext, aiSrc[iMid-1], aiSrc[iMid]) <= 0) {
+      CopyMemory(&aiDst[iLo], &aiSrc[iLo], (iHi - iLo) * sizeof(DWORD));
+      return;
+   }
+
+   //
+   // Ties take the left one, which keeps the sort stable
+   //
+   for (i = iLo, j = iMid, k = iLo; i < iMid && j < iHi; k++) {
+
+      if (pfnCompare(pContext, aiSrc[i], aiSrc[j]) <= 0)
+         aiDst[k] = aiSrc[i++];
+      else
+         aiDst[k] = aiSrc[j++];
+   }
+
+   while (i < iMid)
+      aiDst[k++] = aiSrc[i++];
+
+   while (j < iHi)
+      aiDst[k++] = aiSrc[j++];
+}
+
+
+/////////////////////////////////////////////////////////////////////
+//
+// Name:     SortIndices
+//
+// Synopsis: Stable merge sort of an array of entry numbers
+//
+// aiOrder   numbers to sort
+// aiTemp    scratch of the same size
+//
+// Return:   VOID
+//
+// Notes:    Runs which are already in order (as NTFS hands out names)
+//           are merged with one compare each.
+//
+/////////////////////////////////////////////////////////////////////
+
+VOID
+SortIndices(
+   LPDWORD aiOrder,
+   LPDWORD aiTemp,
+   DWORD cItems,
+   PFNCOMPAREINDEX pfnCompare,
+   PVOID pContext)
+{
+   DWORD i, j;
+   DWORD iLo, iHi;
+   DWORD dwWidth;
+   DWORD dwItem;
+   LPDWORD aiSrc = aiOrder;
+   LPDWORD aiDst = aiTemp;
+   LPDWORD aiSwap;
+
+   for (iLo = 0; iLo < cItems; iLo += SORT_RUN) {
+
+      iHi = min(iLo + SORT_RUN, cItems);
+
+      for (i = iLo + 1; i < iHi; i++) {
+
+         dwItem = aiOrder[i];
+
+         for (j = i; j > iLo && pfnCompare(pContext, aiOrder[j-1], dwItem) > 0; j--)
+            aiOrder[j] = aiOrder[j-1];
+
+         aiOrder[j] = dwItem;
+      }
+   }
+
+   for (dwWidth = SORT_RUN; dwWidth < cItems; dwWidth *= 2) {
+
+      for (iLo = 0; iLo < cItems; iLo += 2 * dwWidth) {
+
+         MergeIndices(aiSrc,
+                      aiDst,
+                      iLo,
+                      min(iLo + dwWidth, cItems),
+                      min(iLo + 2 * dwWidth, cItems),
+                      pfnCompare,
+                      pContext);
+      }
+
+      aiSwap = aiSrc;
+      aiSrc = aiDst;
+      aiDst = aiSwap;
+   }
+
+   if (aiSrc != aiOrder)
+      CopyMemory(aiOrder, aiSrc, cItems * sizeof(DWORD));
+}
+
+
+DWORD WINAPI
+SortChunkThread(LPVOID lpParam)
+{
+   PSORTCHUNK pChunk = (PSORTCHUNK)lpParam;
+
+   if (pChunk->bMerge) {
+
+      MergeIndices(pChunk->aiSrc,
+                   pChunk->aiDst,
+                   0,
+                   pChunk->cLeft,
+                   pChunk->cLeft + pChunk->cRight,
+                   pChunk->pfnCompare,
+                   pChunk->pContext);
+   } else {
+
+      SortIndices(pChunk->aiSrc,
+                  pChunk->aiDst,
+                  pChunk->cLeft,
+                  pChunk->pfnCompare,
+                  pChunk->pContext);
+   }
+
+   return 0;
+}
+
+
+//
+// Runs the chunks, all but the first on threads of their own (or here
+// if one can't be had), and waits for them
+//
+VOID
+RunSortChunks(PSORTCHUNK aChunk, DWORD cChunks)
+{
+   DWORD dwIgnore;
+   DWORD i;
+
+   for (i = 1; i < cChunks; i++) {
+
+      aChunk[i].hThread = CreateThread(NULL,
+                                       0L,
+                                       SortChunkThread,
+                                       &aChunk[i],
+                                       0L,
+                                       &dwIgnore);
+
+      if (!aChunk[i].hThread)
+         SortChunkThread(&aChunk[i]);
+   }
+
+   SortChunkThread(&aChunk[0]);
+
+   for (i = 1; i < cChunks; i++) {
+
+      if (aChunk[i].hThread) {
+         WaitForSingleObject(aChunk[i].hThread, INFINITE);
+         CloseHandle(aChunk[i].hThread);
+      }
+   }
+}
+
+
+//
+// Threads to sort on: a power of 2, no more than there are processors
+//
+DWORD
+SortThreads(VOID)
+{
+   static DWORD cThreads;
+   SYSTEM_INFO si;
+
+   if (!cThreads) {
+
+      GetSystemInfo(&si);
+
+      for (cThreads = 1;
+         cThreads < SORT_MAX_THREADS && 2 * cThreads <= si.dwNumberOfProcessors;
+         cThreads *= 2)
+         ;
+   }
+
+   return cThreads;
+}
+
+
+/////////////////////////////////////////////////////////////////////
+//
+// Name:     SortIndicesParallel
+//
+// Synopsis: SortIndices on several threads
+//
+// Return:   VOID
+//
+// Notes:    Each thread sorts an equal slice; the slices are then
+//           merged in pairs, the pairs of a round on threads of their
+//           own.  pfnCompare is called from all of them at once.
+//           Small sorts (and single processors) stay on this thread.
+//
+/////////////////////////////////////////////////////////////////////
+
+VOID
+SortIndicesParallel(
+   LPDWORD aiOrder,
+   LPDWORD aiTemp,
+   DWORD cItems,
+   PFNCOMPAREINDEX pfnCompare,
+   PVOID pContext)
+{
+   SORTCHUNK aChunk[SORT_MAX_THREADS];
+   DWORD aiBound[SORT_MAX_THREADS + 1];
+   DWORD cThreads = SortThreads();
+   DWORD cChunks;
+   DWORD dwWidth;
+   DWORD i;
+   LPDWORD aiSrc = aiOrder;
+   LPDWORD aiDst = aiTemp;
+   LPDWORD aiSwap;
+
+   if (cThreads < 2 || cItems < SORT_PARALLEL_MIN) {
+      SortIndices(aiOrder, aiTemp, cItems, pfnCompare, pContext);
+      return;
+   }
+
+   for (i = 0; i <= cThreads; i++)
+      aiBound[i] = (DWORD)((ULONGLONG)cItems * i / cThreads);
+
+   for (i = 0; i < cThreads; i++) {
+
+      aChunk[i].aiSrc = aiOrder + aiBound[i];
+      aChunk[i].aiDst = aiTemp + aiBound[i];
+      aChunk[i].cLeft = aiBound[i+1] - aiBound[i];
+      aChunk[i].bMerge = FALSE;
+      aChunk[i].cRight = 0;
+      aChunk[i].pfnCompare = pfnCompare;
+      aChunk[i].pContext = pContext;
+   }
+
+   RunSortChunks(aChunk, cThreads);
+
+   for (dwWidth = 1; dwWidth < cThreads; dwWidth *= 2) {
+
+      for (i = 0, cChunks = 0; i < cThreads; i += 2 * dwWidth, cChunks++) {
+
+         aChunk[cChunks].bMerge = TRUE;
+         aChunk[cChunks].aiSrc = aiSrc + aiBound[i];
+         aChunk[cChunks].aiDst = aiDst + aiBound[i];
+         aChunk[cChunks].cLeft = aiBound[i + dwWidth] - aiBound[i];
+         aChunk[cChunks].cRight = aiBound[i + 2 * dwWidth] - aiBound[i + dwWidth];
+         aChunk[cChunks].pfnCompare = pfnCompare;
+         aChunk[cChunks].pContext = pContext;
+      }
+
+      RunSortChunks(aChunk, cChunks);
+
+      aiSwap = aiSrc;
+      aiSrc = aiDst;
+      aiDst = aiSwap;
+   }
+
+   if (aiSrc != aiOrder)
+      CopyMemory(aiOrder, aiSrc, cItems * sizeof(DWORD));
+}
+
+
+//
+// Hash that agrees with CompareOrdinalNoCase for ASCII; other
+// characters are hashed as they are (see ExtRank for the fix up).
+//
+DWORD
+ExtHash(LPCWSTR pszExt)
+{
+   DWORD dwHash = 2166136261;
+   WCHAR ch;
+
+   for (; (ch = *pszExt) != CHAR_NULL; pszExt++) {
+
+      if (ch >= CHAR_A && ch <= CHAR_Z)
+         ch += CHAR_a - CHAR_A;
+
+      dwHash = (dwHash ^ ch) * 16777619;
+   }
+
+   return dwHash;
+}
+
+
+BOOL
+ExtGrowSlots(PEXTTABLE pTable)
+{
+   LPDWORD aiSlot;
+   DWORD cSlots = pTable->cSlots * 2;
+   DWORD i, iSlot;
+
+   aiSlot = (LPDWORD)LocalAlloc(LPTR, cSlots * sizeof(DWORD));
+
+   if (!aiSlot)
+      return FALSE;
+
+   for (i = 0; i < pTable->cExt; i++) {
+
+      for (iSlot = pTable->adwHash[i] & (cSlots - 1); aiSlot[iSlot]; iSlot = (iSlot + 1) & (cSlots - 1))
+         ;
+
+      aiSlot[iSlot] = i + 1;
+   }
+
+   if (pTable->aiSlot)
+      LocalFree(pTable->aiSlot);
+
+   pTable->aiSlot = aiSlot;
+   pTable->cSlots = cSlots;
+
+   return TRUE;
+}
+
+
+//
+// Returns the index of pszExt in the table, adding it if it's new;
+// -1 if out of memory.
+//
+DWORD
+ExtLookup(PEXTTABLE pTable, LPWSTR pszExt)
+{
+   DWORD dwHash = ExtHash(pszExt);
+   DWORD iSlot;
+   DWORD i;
+   PVOID pNew;
+
+   for (iSlot = dwHash & (pTable->cSlots - 1);
+        (i = pTable->aiSlot[iSlot]) != 0;
+        iSlot = (iSlot + 1) & (pTable->cSlots - 1)) {
+
+      if (pTable->adwHash[i-1] == dwHash && !CompareOrdinalNoCase(pTable->apszExt[i-1], pszExt))
+         return i-1;
+   }
+
+   if (pTable->cExt == pTable->cExtMax) {
+
+      pTable->cExtMax *= 2;
+
+      pNew = LocalReAlloc(pTable->apszExt, pTable->cExtMax * sizeof(LPWSTR), LMEM_MOVEABLE);
+      if (!pNew)
+         return (DWORD)-1;
+      pTable->apszExt = (LPWSTR*)pNew;
+
+      pNew = LocalReAlloc(pTable->adwHash, pTable->cExtMax * sizeof(DWORD), LMEM_MOVEABLE);
+      if (!pNew)
+         return (DWORD)-1;
+      pTable->adwHash = (LPDWORD)pNew;
+   }
+
+   i = pTable->cExt++;
+
+   pTable->apszExt[i] = pszExt;
+   pTable->adwHash[i] = dwHash;
+   pTable->aiSlot[iSlot] = i + 1;
+
+   if (pTable->cExt * 2 > pTable->cSlots && !ExtGrowSlots(pTable))
+      return (DWORD)-1;
+
+   return i;
+}
+
+
+INT
+CompareExt(PVOID pContext, DWORD i, DWORD j)
+{
+   PEXTTABLE pTable = (PEXTTABLE)pContext;
+
+   return CompareOrdinalNoCase(pTable->apszExt[i], pTable->apszExt[j]);
+}
+
+
+/////////////////////////////////////////////////////////////////////
+//
+// Name:     ExtRank
+//
+// Synopsis: Replaces adwExt (indices into pTable) with the ranks
+//
+// Return:   FALSE if out of memory
+//
+// Notes:    Directories have a few distinct extensions however many
+//           entries they have, so sorting those is cheap.  Distinct
+//           table entries that still compare equal (non-ASCII case
+//           differences) get the same rank.
+//
+/////////////////////////////////////////////////////////////////////
+
+BOOL
+ExtRank(PXDTACOLS pCols, PEXTTABLE pTable)
+{
+   LPDWORD aiOrder;
+   DWORD i;
+
+   aiOrder = (LPDWORD)LocalAlloc(LMEM_FIXED, 2 * pTable->cExt * sizeof(DWORD));
+   pTable->adwRank = (LPDWORD)LocalAlloc(LMEM_FIXED, pTable->cExt * sizeof(DWORD));
+
+   if (!aiOrder || !pTable->adwRank) {
+
+      if (aiOrder)
+         LocalFree(aiOrder);
+
+      return FALSE;
+   }
+
+   for (i = 0; i < pTable->cExt; i++)
+      aiOrder[i] = i;
+
+   SortIndices(aiOrder, aiOrder + pTable->cExt, pTable->cExt, CompareExt, pTable);
+
+   pTable->adwRank[aiOrder[0]] = 0;
+
+   for (i = 1; i < pTable->cExt; i++) {
+
+      pTable->adwRank[aiOrder[i]] = pTable->adwRank[aiOrder[i-1]] +
+         (CompareExt(pTable, aiOrder[i-1], aiOrder[i]) ? 1 : 0);
+   }
+
+   for (i = 0; i < pCols->dwEntries; i++)
+      pCols->adwExt[i] = pTable->adwRank[pCols->adwExt[i]];
+
+   LocalFree(aiOrder);
+
+   return TRUE;
+}
+
+
+/////////////////////////////////////////////////////////////////////
+//
+// Name:     ColsBuild
+//
+// Synopsis: Builds the columns of a complete listing
+//
+// Return:   The columns, or NULL (no entries or out of memory)
+//
+// Assumes:  lpStart is complete and not handed out yet
+//
+// Notes:    Reader thread.  Callers fall back on the XDTA chain when
+//           there are no columns.
+//
+/////////////////////////////////////////////////////////////////////
+
+PXDTACOLS
+ColsBuild(LPXDTALINK lpStart)
+{
+   PXDTACOLS pCols;
+   EXTTABLE table;
+   LPXDTALINK lpLink;
+   LPXDTA lpxdta;
+   DWORD dwEntries;
+   DWORD i;
+   SIZE_T cchNames;
+   DWORD ichName;
+   LPWSTR pszName;
+   LPWSTR pszKey;
+   ULONGLONG qPrefix;
+   DWORD ich;
+   LPWSTR pszExt;
+   DWORD iExt;
+   PBYTE pb;
+
+   if (!lpStart || !(dwEntries = MemLinkToHead(lpStart)->dwEntries))
+      return NULL;
+
+   //
+   // Names are stored with their null, which cchFileNameOffset counts
+   //
+   cchNames = 0;
+   lpLink = lpStart;
+   lpxdta = MemFirst(lpStart);
+
+   for (i = 0; i < dwEntries; i++) {
+
+      cchNames += lpxdta->cchFileNameOffset;
+
+      if (i + 1 < dwEntries)
+         lpxdta = MemNext(&lpLink, lpxdta);
+   }
+
+   if (cchNames > MAXDWORD)
+      return NULL;
+
+   pCols = (PXDTACOLS)LocalAlloc(LPTR, sizeof(XDTACOLS));
+   if (!pCols)
+      return NULL;
+
+   pCols->dwEntries = dwEntries;
+
+   //
+   // One block for the fixed size columns, widest first
+   //
+   pb = (PBYTE)LocalAlloc(LMEM_FIXED,
+      dwEntries * (3 * sizeof(ULONGLONG) + sizeof(LPXDTA) + 4 * sizeof(DWORD)));
+
+   pCols->szNames = (LPWSTR)LocalAlloc(LMEM_FIXED, ByteCountOf(cchNames));
+   pCols->szKeys = (LPWSTR)LocalAlloc(LMEM_FIXED, ByteCountOf(cchNames));
+
+   if (!pb || !pCols->szNames || !pCols->szKeys) {
+
+      if (pb)
+         LocalFree(pb);
+
+      ColsFree(pCols);
+      return NULL;
+   }
+
+   pCols->aqSize = (ULONGLONG*)pb;
+   pCols->aqTime = pCols->aqSize + dwEntries;
+   pCols->aqKeyPrefix = pCols->aqTime + dwEntries;
+   pCols->alpxdta = (LPXDTA*)(pCols->aqKeyPrefix + dwEntries);
+   pCols->adwAttrs = (LPDWORD)(pCols->alpxdta + dwEntries);
+   pCols->adwExt = pCols->adwAttrs + dwEntries;
+   pCols->adwName = pCols->adwExt + dwEntries;
+   pCols->acchStem = pCols->adwName + dwEntries;
+
+   table.cExt = 0;
+   table.cExtMax = 64;
+   table.cSlots = 64;
+   table.adwRank = NULL;
+   table.apszExt = (LPWSTR*)LocalAlloc(LMEM_FIXED, table.cExtMax * sizeof(LPWSTR));
+   table.adwHash = (LPDWORD)LocalAlloc(LMEM_FIXED, table.cExtMax * sizeof(DWORD));
+   table.aiSlot = (LPDWORD)LocalAlloc(LPTR, table.cSlots * sizeof(DWORD));
+
+   if (!table.apszExt || !table.adwHash || !table.aiSlot)
+      goto Fail;
+
+   ichName = 0;
+   lpLink = lpStart;
+   lpxdta = MemFirst(lpStart);
+
+   for (i = 0; i < dwEntries; i++) {
+
+      pszName = &pCols->szNames[ichName];
+
+      CopyMemory(pszName, MemGetFileName(lpxdta), ByteCountOf(lpxdta->cchFileNameOffset));
+
+      pszKey = &pCols->szKeys[ichName];
+      UpperCaseBuff(pszName, pszKey, lpxdta->cchFileNameOffset);
+
+      //
+      // Keys shorter than four characters are padded with their null,
+      // which sorts before any character as it does in the key
+      //
+      qPrefix = 0;
+      for (ich = 0; ich < 4; ich++) {
+         qPrefix = (qPrefix << 16) | pszKey[ich];
+         if (!pszKey[ich])
+            break;
+      }
+      pCols->aqKeyPrefix[i] = qPrefix << (16 * (ich < 4 ? 3 - ich : 0));
+
+      pCols->alpxdta[i] = lpxdta;
+      pCols->aqSize[i] = lpxdta->qFileSize.QuadPart;
+      pCols->aqTime[i] = ((ULONGLONG)lpxdta->ftLastWriteTime.dwHighDateTime << 32) |
+                         lpxdta->ftLastWriteTime.dwLowDateTime;
+      pCols->adwAttrs[i] = lpxdta->dwAttrs;
+      pCols->adwName[i] = ichName;
+
+      //
+      // As in CompareDTA: the stem is the name up to the extension's
+      // dot, or all of it if there is no extension
+      //
+      pszExt = GetExtension(pszName);
+      pCols->acchStem[i] = (DWORD)((*pszExt ? pszExt - 1 : pszExt) - pszName);
+
+      iExt = ExtLookup(&table, pszExt);
+      if (iExt == (DWORD)-1)
+         goto Fail;
+
+      pCols->adwExt[i] = iExt;
+
+      ichName += lpxdta->cchFileNameOffset;
+
+      if (i + 1 < dwEntries)
+         lpxdta = MemNext(&lpLink, lpxdta);
+   }
+
+   if (!ExtRank(pCols, &table))
+      goto Fail;
+
+   LocalFree(table.apszExt);
+   LocalFree(table.adwHash);
+   LocalFree(table.adwRank);
+   LocalFree(table.aiSlot);
+
+   return pCols;
+
+Fail:
+
+   if (table.apszExt)
+      LocalFree(table.apszExt);
+   if (table.adwHash)
+      LocalFree(table.adwHash);
+   if (table.adwRank)
+      LocalFree(table.adwRank);
+   if (table.aiSlot)
+      LocalFree(table.aiSlot);
+
+   ColsFree(pCols);
+   return NULL;
+}
+
+
+VOID
+ColsFree(PXDTACOLS pCols)
+{
+   INT i;
+
+   if (!pCols)
+      return;
+
+   for (i = 0; i < COLS_SORTS; i++) {
+      if (pCols->aaiOrder[i])
+         LocalFree(pCols->aaiOrder[i]);
+   }
+
+   //
+   // aqSize starts the block of fixed size columns
+   //
+   if (pCols->aqSize)
+      LocalFree(pCols->aqSize);
+
+   if (pCols->szNames)
+      LocalFree(pCols->szNames);
+
+   if (pCols->szKeys)
+      LocalFree(pCols->szKeys);
+
+   LocalFree(pCols);
+}
+
+
+//
+// Compares the keys (upper cased names) of entries i and j
+//
+INT
+CompareColsKeys(PXDTACOLS pCols, DWORD i, DWORD j)
+{
+   LPCWSTR pKey1;
+   LPCWSTR pKey2;
+
+   if (pCols->aqKeyPrefix[i] != pCols->aqKeyPrefix[j])
+      return pCols->aqKeyPrefix[i] < pCols->aqKeyPrefix[j] ? -1 : 1;
+
+   //
+   // A null in the prefix means both keys ended there
+   //
+   if (!(pCols->aqKeyPrefix[i] & 0xFFFF))
+      return 0;
+
+   pKey1 = ColsGetKey(pCols, i) + 4;
+   pKey2 = ColsGetKey(pCols, j) + 4;
+
+   for (; *pKey1 == *pKey2; pKey1++, pKey2++) {
+      if (!*pKey1)
+         return 0;
+   }
+
+   return *pKey1 < *pKey2 ? -1 : 1;
+}
+
+
+//
+// Compares the stems (the keys up to the extension's dot) of entries
+// i and j
+//
+INT
+CompareColsStems(PXDTACOLS pCols, DWORD i, DWORD j)
+{
+   LPCWSTR pKey1 = ColsGetKey(pCols, i);
+   LPCWSTR pKey2 = ColsGetKey(pCols, j);
+   DWORD cch1 = pCols->acchStem[i];
+   DWORD cch2 = pCols->acchStem[j];
+   DWORD ich = 0;
+
+   if (cch1 >= 4 && cch2 >= 4) {
+
+      if (pCols->aqKeyPrefix[i] != pCols->aqKeyPrefix[j])
+         return pCols->aqKeyPrefix[i] < pCols->aqKeyPrefix[j] ? -1 : 1;
+
+      ich = 4;
+   }
+
+   for (; ich < cch1 && ich < cch2; ich++) {
+      if (pKey1[ich] != pKey2[ich])
+         return pKey1[ich] < pKey2[ich] ? -1 : 1;
+   }
+
+   return cch1 < cch2 ? -1 : cch1 > cch2 ? 1 : 0;
+}
+
+
+/////////////////////////////////////////////////////////////////////
+//
+// Name:     ColsCompare
+//
+// Synopsis: Compares entries i and j for sort dwSort
+//
+// Return:   < 0, 0 or > 0
+//
+// Notes:    Same order as CompareDTA, which it must be kept in step
+//           with.  Names compare by their keys, which is the order of
+//           CompareOrdinalNoCase on the names.
+//
+/////////////////////////////////////////////////////////////////////
+
+INT
+ColsCompare(
+   PXDTACOLS pCols,
+   DWORD i,
+   DWORD j,
+   DWORD dwSort)
+{
+   DWORD dwAttrs1 = pCols->adwAttrs[i];
+   DWORD dwAttrs2 = pCols->adwAttrs[j];
+   INT ret;
+
+   if (dwAttrs1 & ATTR_PARENT)
+      return -1;
+
+   if (dwAttrs2 & ATTR_PARENT)
+      return 1;
+
+   if ((dwAttrs1 & ATTR_DIR) != (dwAttrs2 & ATTR_DIR))
+      return (dwAttrs1 & ATTR_DIR) ? -1 : 1;
+
+   switch (dwSort) {
+   case IDD_TYPE:
+
+      if (pCols->adwExt[i] != pCols->adwExt[j])
+         return pCols->adwExt[i] < pCols->adwExt[j] ? -1 : 1;
+
+      return CompareColsStems(pCols, i, j);
+
+   case IDD_SIZE:
+
+      if (pCols->aqSize[i] != pCols->aqSize[j])
+         return pCols->aqSize[i] > pCols->aqSize[j] ? -1 : 1;
+
+      break;
+
+   case IDD_DATE:
+   case IDD_FDATE:
+
+      if (pCols->aqTime[i] != pCols->aqTime[j]) {
+
+         ret = pCols->aqTime[i] > pCols->aqTime[j] ? -1 : 1;
+
+         return dwSort == IDD_FDATE ? -ret : ret;
+      }
+
+      break;
+   }
+
+   return CompareColsKeys(pCols, i, j);
+}
+
+
+INT
+CompareCols(PVOID pContext, DWORD i, DWORD j)
+{
+   PCOLSSORT pSort = (PCOLSSORT)pContext;
+
+   return ColsCompare(pSort->pCols, i, j, pSort->dwSort);
+}
+
+
+//
+// Parent, then directories, then files
+//
+#define ColsGroup(pCols, i) \
+   (((pCols)->adwAttrs[i] & ATTR_PARENT) ? 0 : ((pCols)->adwAttrs[i] & ATTR_DIR) ? 1 : 2)
+
+#define RADIX_PASSES  (sizeof(ULONGLONG) + 1)   // the key's bytes, then the group
+
+
+/////////////////////////////////////////////////////////////////////
+//
+// Name:     RadixSortCols
+//
+// Synopsis: Sorts for size or date without comparing entries
+//
+// aiOrder   gets the entry numbers in sorted order
+// aiTemp    scratch of the same size
+//
+// Return:   FALSE if out of memory
+//
+// Notes:    An LSD radix sort of 64 bit keys (complemented where the
+//           sort is descending) a byte at a time, then of the group
+//           ColsCompare puts first.  Bytes which are the same for all
+//           keys (the high bytes of sizes, mostly) are skipped.  Being
+//           stable, entries with equal keys come out in read order;
+//           those runs are then put in name order by comparing.
+//
+/////////////////////////////////////////////////////////////////////
+
+BOOL
+RadixSortCols(
+   PXDTACOLS pCols,
+   DWORD dwSort,
+   LPDWORD aiOrder,
+   LPDWORD aiTemp)
+{
+   DWORD acCount[RADIX_PASSES][256];
+   COLSSORT sort;
+   ULONGLONG* aqKey;
+   ULONGLONG* aqKeySrc;
+   ULONGLONG* aqKeyDst;
+   ULONGLONG* aqKeySwap;
+   ULONGLONG* aqCol;
+   ULONGLONG qFlip;
+   LPDWORD aiSrc = aiOrder;
+   LPDWORD aiDst = aiTemp;
+   LPDWORD aiSwap;
+   DWORD dwEntries = pCols->dwEntries;
+   DWORD dwTotal;
+   DWORD dwCount;
+   DWORD dwDigit;
+   DWORD iPass;
+   DWORD i, j;
+
+   aqKey = (ULONGLONG*)LocalAlloc(LMEM_FIXED, 2 * dwEntries * sizeof(ULONGLONG));
+   if (!aqKey)
+      return FALSE;
+
+   aqCol = dwSort == IDD_SIZE ? pCols->aqSize : pCols->aqTime;
+   qFlip = dwSort == IDD_FDATE ? 0 : ~(ULONGLONG)0;
+
+   ZeroMemory(acCount, sizeof(acCount));
+
+   for (i = 0; i < dwEntries; i++) {
+
+      aiOrder[i] = i;
+      aqKey[i] = aqCol[i] ^ qFlip;
+
+      for (iPass = 0; iPass < sizeof(ULONGLONG); iPass++)
+         acCount[iPass][(BYTE)(aqKey[i] >> (8 * iPass))]++;
+
+      acCount[sizeof(ULONGLONG)][ColsGroup(pCols, i)]++;
+   }
+
+   aqKeySrc = aqKey;
+   aqKeyDst = aqKey + dwEntries;
+
+   for (iPass = 0; iPass < RADIX_PASSES; iPass++) {
+
+      //
+      // Turn the counts into where each digit starts
+      //
+      for (dwDigit = 0, dwTotal = 0; dwDigit < 256; dwDigit++) {
+
+         dwCount = acCount[iPass][dwDigit];
+
+         if (dwCount == dwEntries)
+            break;
+
+         acCount[iPass][dwDigit] = dwTotal;
+         dwTotal += dwCount;
+      }
+
+      if (dwDigit < 256)
+         continue;
+
+      for (i = 0; i < dwEntries; i++) {
+
+         if (iPass < sizeof(ULONGLONG))
+            dwDigit = (BYTE)(aqKeySrc[i] >> (8 * iPass));
+         else
+            dwDigit = ColsGroup(pCols, aiSrc[i]);
+
+         j = acCount[iPass][dwDigit]++;
+
+         aiDst[j] = aiSrc[i];
+         aqKeyDst[j] = aqKeySrc[i];
+      }
+
+      aiSwap = aiSrc;
+      aiSrc = aiDst;
+      aiDst = aiSwap;
+
+      aqKeySwap = aqKeySrc;
+      aqKeySrc = aqKeyDst;
+      aqKeyDst = aqKeySwap;
+   }
+
+   if (aiSrc != aiOrder) {
+      CopyMemory(aiOrder, aiSrc, dwEntries * sizeof(DWORD));
+      CopyMemory(aqKey, aqKeySrc, dwEntries * sizeof(ULONGLONG));
+   }
+
+   //
+   // Names break ties
+   //
+   sort.pCols = pCols;
+   sort.dwSort = dwSort;
+
+   for (i = 0; i < dwEntries; i = j) {
+
+      for (j = i + 1;
+         j < dwEntries && aqKey[j] == aqKey[i] &&
+         ColsGroup(pCols, aiOrder[j]) == ColsGroup(pCols, aiOrder[i]);
+         j++)
+         ;
+
+      if (j - i > 1)
+         SortIndices(aiOrder + i, aiTemp, j - i, CompareCols, &sort);
+   }
+
+   LocalFree(aqKey);
+
+   return TRUE;
+}
+
+
+/////////////////////////////////////////////////////////////////////
+//
+// Name:     ColsSort
+//
+// Synopsis: Sorts the entries for dwSort
+//
+// aiOrder   gets the entry numbers in sorted order (dwEntries of them)
+//
+// Return:   FALSE if out of memory
+//
+// Notes:    A listing already in order (NTFS, by name) costs one
+//           pass.  Entries that compare equal stay in read order.
+//
+//           Size and date sorts are radix sorts; the others (or if
+//           there isn't memory for the keys) merge sorts on as many
+//           threads as there are processors.
+//
+/////////////////////////////////////////////////////////////////////
+
+BOOL
+ColsSort(
+   PXDTACOLS pCols,
+   DWORD dwSort,
+   LPDWORD aiOrder)
+{
+   COLSSORT sort;
+   LPDWORD aiTemp;
+   DWORD i;
+
+   sort.pCols = pCols;
+   sort.dwSort = dwSort;
+
+   for (i = 0; i < pCols->dwEntries; i++)
+      aiOrder[i] = i;
+
+   for (i = 1; i < pCols->dwEntries; i++) {
+      if (ColsCompare(pCols, i-1, i, dwSort) > 0)
+         break;
+   }
+
+   if (i >= pCols->dwEntries)
+      return TRUE;
+
+   aiTemp = (LPDWORD)LocalAlloc(LMEM_FIXED, pCols->dwEntries * sizeof(DWORD));
+   if (!aiTemp)
+      return FALSE;
+
+   switch (dwSort) {
+   case IDD_SIZE:
+   case IDD_DATE:
+   case IDD_FDATE:
+
+      if (RadixSortCols(pCols, dwSort, aiOrder, aiTemp))
+         break;
+
+      // Fall through
+
+   default:
+
+      SortIndicesParallel(aiOrder, aiTemp, pCols->dwEntries, CompareCols, &sort);
+      break;
+   }
+
+   LocalFree(aiTemp);
+
+   return TRUE;
+}
+
+
+/////////////////////////////////////////////////////////////////////
+//
+// Name:     ColsGetOrder
+//
+// Synopsis: Returns the entry numbers in dwSort order, sorting only
+//           the first time
+//
+// Return:   dwEntries entry numbers (owned by pCols); NULL if out
+//           of memory
+//
+// Notes:    Main thread ONLY!
+//
+/////////////////////////////////////////////////////////////////////
+
+LPDWORD
+ColsGetOrder(
+   PXDTACOLS pCols,
+   DWORD dwSort)
+{
+   LPDWORD* paiOrder;
+
+   if (dwSort < IDD_NAME || dwSort >= IDD_NAME + COLS_SORTS)
+      dwSort = IDD_NAME;
+
+   paiOrder = &pCols->aaiOrder[dwSort - IDD_NAME];
+
+   if (!*paiOrder) {
+
+      *paiOrder = (LPDWORD)LocalAlloc(LMEM_FIXED, pCols->dwEntries * sizeof(DWORD));
+
+      if (*paiOrder && !ColsSort(pCols, dwSort, *paiOrder)) {
+         LocalFree(*paiOrder);
+         *paiOrder = NULL;
+      }
+   }
+
+   return *paiOrder;
+}
+
+
+//
+// Bytes held by pCols, including the orders built so far
+//
+SIZE_T
+ColsSize(PXDTACOLS pCols)
+{
+   SIZE_T cbSize;
+   INT i;
+
+   if (!pCols)
+      return 0;
+
+   cbSize = LocalSize(pCols) + LocalSize(pCols->aqSize) +
+            LocalSize(pCols->szNames) + LocalSize(pCols->szKeys);
+
+   for (i = 0; i < COLS_SORTS; i++) {
+      if (pCols->aaiOrder[i])
+         cbSize += LocalSize(pCols->aaiOrder[i]);
+   }
+
+   return cbSize;
+}
@@ -0,0 +1,78 @@
+/********************************************************************
+
+   wfcols.h
+
+   Column (struct of arrays) view of a directory listing
+
+   Copyright (c) Microsoft Corporation. All rights reserved.
+   Licensed under the MIT License.
+
+********************************************************************/
+
+#pragma once
+
+#include <windows.h>
+#include "wfdocb.h"
+#include "wfmem.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//
+// Entry i of every column is the i-th entry of the XDTA chain, in read
+// order.  Built once by the reader after the chain is complete, then
+// read-only like the chain itself (freed with it by MemDelete).
+//
+// Sorting and summing look only at the columns they need, which are
+// contiguous, instead of walking the variable length XDTA records.
+//
+// Names are also kept upper cased (szKeys, at the same offsets as
+// szNames), so comparing them is comparing characters: no case folding
+// or locale per comparison.  The first four characters of each key are
+// packed into an integer which compares the same way and settles most
+// comparisons on its own.
+//
+// The order for each sort is kept once asked for (ColsGetOrder), so
+// going back to an earlier sort doesn't sort again.  Those are built
+// and read by the main thread only.
+//
+#define COLS_SORTS   5        // IDD_NAME .. IDD_FDATE
+
+typedef struct _XDTACOLS {
+
+   DWORD dwEntries;
+
+   LPXDTA* alpxdta;           // the entry in the chain
+   ULONGLONG* aqSize;
+   ULONGLONG* aqTime;         // ftLastWriteTime
+   ULONGLONG* aqKeyPrefix;    // first four characters of the key, the
+                              // first in the high word
+   DWORD* adwAttrs;
+   DWORD* adwExt;             // rank of the extension: compares like the
+                              // extensions, ignoring case
+   DWORD* adwName;            // offset of the name in szNames (and of
+                              // its key in szKeys)
+   DWORD* acchStem;           // chars in the name before the extension's dot
+
+   LPWSTR szNames;            // all names, each null terminated
+   LPWSTR szKeys;             // the names upper cased
+
+   LPDWORD aaiOrder[COLS_SORTS];   // entry numbers in sorted order; NULL
+                                   // until asked for
+
+} XDTACOLS;
+
+PXDTACOLS ColsBuild(LPXDTALINK lpStart);
+VOID ColsFree(PXDTACOLS pCols);
+INT ColsCompare(PXDTACOLS pCols, DWORD i, DWORD j, DWORD dwSort);
+BOOL ColsSort(PXDTACOLS pCols, DWORD dwSort, LPDWORD aiOrder);
+LPDWORD ColsGetOrder(PXDTACOLS pCols, DWORD dwSort);
+SIZE_T ColsSize(PXDTACOLS pCols);
+
+#define ColsGetName(pCols, i) (&(pCols)->szNames[(pCols)->adwName[i]])
+#define ColsGetKey(pCols, i)  (&(pCols)->szKeys[(pCols)->adwName[i]])
+
+#ifdef __cplusplus
+}
+#endif
@@ -298,12 +298,18 @@ ChangeFileSystem(
    lstrcpy(szFrom, lpszFile);
    QualifyPath(szFrom);            // already partly qualified
 
+   // Cached listings of what changed are stale now
+   DirCacheInvalidate(szFrom);
+   ProbeCacheInvalidate(szFrom);
+
    switch (dwFunction)
    {
 	  case ( FSC_RENAME ) :
 	  {
 		 lstrcpy(szTo, lpszTo);
 		 QualifyPath(szTo);    // already partly qualified
+		 DirCacheInvalidate(szTo);
+		 ProbeCacheInvalidate(szTo);
 
 		 NotifySearchFSC(szFrom, dwFunction);
 
@@ -351,6 +357,7 @@ ChangeFileSystem(
 #ifdef NETCHECK
 			InvalidateAllNetTypes();
 #endif
+			UpdateDirectoryTrie(dwFunction, szFrom, szTo);
 		 }
 		 break;
 	  }
@@ -369,6 +376,8 @@ ChangeFileSystem(
 	  case ( FSC_MKDIR ) :
 	  case ( FSC_MKDIRQUIET ) :
 	  {
+		 UpdateDirectoryTrie(dwFunction, szFrom, NULL);
+
 		 /* Update the tree. */
 		 for (hwnd = GetWindow(hwndMDIClient, GW_CHILD);
 			  hwnd;
@@ -1467,9 +1476,7 @@ AppCommandProc( DWORD id)
 		 //
 		 lpStart = (LPXDTALINK)GetWindowLongPtr(hwndDir, GWL_HDTA);
 
-		 if (lpStart) {
-
-			lpxdta = MemLinkToHead(lpStart)->alpxdtaSorted[0];
+		 if (lpStart && DirGetItem(hwndLB, 0, &lpxdta) != LB_ERR && lpxdta) {
 
 			if (lpxdta->dwAttrs & ATTR_PARENT)
 			   SendMessageW(hwndLB, LB_SETSEL, 0, 0L);
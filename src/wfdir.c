@@ -70,6 +70,15 @@ DrawItem(
    HWND hwndListParms = (HWND)GetWindowLongPtr(hwnd, GWL_LISTPARMS);
    BOOL bLower;
 
+   //
+   // Directory listboxes hold no data (see DirViewGetItem)
+   //
+   if (lpLBItem->itemID != -1 &&
+      (GetWindowLongPtr(lpLBItem->hwndItem, GWL_STYLE) & LBS_NODATA)) {
+
+      lpxdta = DirViewGetItem(hwnd, lpLBItem->itemID);
+   }
+
    //
    // Print out any errors
    //
@@ -125,6 +134,12 @@ DrawItem(
       rgbBackground = SetBkColor(hDC, GetSysColor(COLOR_WINDOW));
    }
 
+   //
+   // Entries of a read still in progress (see DirReadProgress)
+   //
+   if (!lpStart)
+      lpStart = (LPXDTALINK)GetWindowLongPtr(hwnd, GWL_HDTASTREAM);
+
    if (lpLBItem->itemID == -1 || !lpStart || !lpxdta) {
 
       if (bHasFocus)
@@ -224,8 +239,8 @@ DrawItem(
                          szBuf,
                          (WORD *)GetWindowLongPtr(hwnd, GWL_TABARRAY),
                          x,
-                         dwViewOpts & VIEW_DOSNAMES ?
-                            MemLinkToHead(lpStart)->dwAlternateFileNameExtent :
+                         (dwViewOpts & VIEW_DOSNAMES) && hwnd != hwndSearch ?
+                            (DWORD)GetWindowLongPtr(hwnd, GWL_ALTNAMEEXTENT) :
                             0);
 
       // SetBkMode(hDC, OPAQUE);
@@ -478,6 +493,14 @@ DirWndProc(
       return (LRESULT)lpStart;
    }
 
+   case FS_DIRREADPROGRESS:
+
+      //
+      // wParam => batch sequence number, 0 if the read is abandoned
+      // lParam => PDIRREADPROGRESS
+      //
+      return DirReadProgress(hwnd, (UINT)wParam, (PDIRREADPROGRESS)lParam);
+
    case FS_GETDIRECTORY:
 
       GetMDIWindowText(hwndParent, (LPWSTR)lParam, (INT)wParam);
@@ -536,7 +559,7 @@ DirWndProc(
       {
          HWND hwndNext;
 
-         SendMessage(hwndLB, LB_GETTEXT, 0, (LPARAM) &lpxdta);
+         DirGetItem(hwndLB, 0, &lpxdta);
          if (!lpxdta && GetFocus() == hwndLB)
          {
             hwndNext = (HWND)lParam;
@@ -615,8 +638,7 @@ DirWndProc(
 
       for (; j < cItems; j++) {
 
-         if (SendMessage(hwndLB, LB_GETTEXT, (i + j) % cItems, (LPARAM)&lpxdta)
-            == LB_ERR) {
+         if (DirGetItem(hwndLB, (i + j) % cItems, &lpxdta) == LB_ERR) {
 
             return -2L;
          }
@@ -639,15 +661,6 @@ DirWndProc(
 
       return((i + j) % cItems);
    }
-   case WM_COMPAREITEM:
-
-#define lpci ((LPCOMPAREITEMSTRUCT)lParam)
-
-      return (LONG)CompareDTA((LPXDTA)lpci->itemData1,
-                              (LPXDTA)lpci->itemData2,
-                              GetWindowLongPtr(hwndParent, GWL_SORT));
-#undef lpci
-
    case WM_NCDESTROY:
 
       DirReadDestroyWindow(hwnd);
@@ -1645,10 +1658,7 @@ SelectFirst:
       iSel = 0;
       while (iSel < iLBCount) {
 
-         if (SendMessage(hwndLB,
-                         LB_GETTEXT,
-                         iSel,
-                         (LPARAM)&lpxdta) == LB_ERR || !lpxdta) {
+         if (DirGetItem(hwndLB, iSel, &lpxdta) == LB_ERR || !lpxdta) {
             break;
          }
 
@@ -2026,11 +2036,10 @@ GetMaxExtent(HWND hwndLB, LPXDTALINK lpLink, BOOL bNTFS)
    HDC hdc;
    DWORD dwItems;
    INT maxWidth = 0;
-   SIZE size;
    HFONT hOld;
-   WCHAR szPath[MAXPATHLEN];
    LPWSTR pszName;
    LPXDTA lpxdta;
+   WIDTHTABLE table;
 
    if (!lpLink)
       goto NoDTA;
@@ -2038,6 +2047,8 @@ GetMaxExtent(HWND hwndLB, LPXDTALINK lpLink, BOOL bNTFS)
    hdc = GetDC(hwndLB);
    hOld = SelectObject(hdc, hFont);
 
+   WidthTableInit(&table, hdc);
+
    for (dwItems = MemLinkToHead(lpLink)->dwEntries, lpxdta = MemFirst(lpLink);
         dwItems;
         dwItems--, lpxdta = MemNext(&lpLink, lpxdta))
@@ -2048,44 +2059,34 @@ GetMaxExtent(HWND hwndLB, LPXDTALINK lpLink, BOOL bNTFS)
 
          if (pszName[0])
          {
-            lstrcpy(szPath, pszName);
-
             //
             // ALWAYS AnsiUpper/Lower based on TA_LOWERCASE
             // since this is a dos style name for ntfs.
             //
-            if (wTextAttribs & TA_LOWERCASE ||
-                wTextAttribs & TA_LOWERCASEALL)
-            {
-               CharLower(szPath);
-            }
-            else
-            {
-               CharUpper(szPath);
-            }
-
-            GetTextExtentPoint32(hdc, szPath, lstrlen(szPath), &size);
-
-            maxWidth = max(size.cx, maxWidth);
+            maxWidth = WidthMax(&table,
+                                hdc,
+                                pszName,
+                                (wTextAttribs & TA_LOWERCASE ||
+                                 wTextAttribs & TA_LOWERCASEALL) ?
+                                   WIDTH_LOWER :
+                                   WIDTH_UPPER,
+                                maxWidth);
          }
       }
       else
       {
-         lstrcpy(szPath, MemGetFileName(lpxdta));
-
          //
          // set the case of the file names here!
          //
-         if ( ( (lpxdta->dwAttrs & ATTR_LOWERCASE) &&
-                (wTextAttribs & TA_LOWERCASE) ) ||
-              (wTextAttribs & TA_LOWERCASEALL) )
-         {
-            CharLower(szPath);
-         }
-
-         GetTextExtentPoint32(hdc, szPath, lstrlen(szPath), &size);
-
-         maxWidth = max(size.cx, maxWidth);
+         maxWidth = WidthMax(&table,
+                             hdc,
+                             MemGetFileName(lpxdta),
+                             ( ( (lpxdta->dwAttrs & ATTR_LOWERCASE) &&
+                                 (wTextAttribs & TA_LOWERCASE) ) ||
+                               (wTextAttribs & TA_LOWERCASEALL) ) ?
+                                WIDTH_LOWER :
+                                WIDTH_ASIS,
+                             maxWidth);
       }
    }
 
@@ -2254,7 +2255,7 @@ FixTabsAndThings(
 //
 // Assumes:
 //
-//    alpxdtaSorted initialized and filled
+//    GWL_HDTASORTED initialized and filled
 //
 //    dyFileName  GLOBAL; set based on new font height
 //    GWL_VIEW    view definition
@@ -2283,7 +2284,7 @@ SetLBFont(
    LPXDTALINK lpStart)
 {
    INT dxMaxExtent;
-   LPXDTAHEAD lpHead;
+   DWORD dwAlternateFileNameExtent;
 
 
    SendMessage(hwndLB, WM_SETFONT, (WPARAM)hNewFont, MAKELPARAM(TRUE, 0));
@@ -2300,8 +2301,6 @@ SetLBFont(
                0,
                (LONG)dyFileName);
 
-   lpHead = MemLinkToHead(lpStart);
-
    dxMaxExtent = GetMaxExtent(hwndLB, lpStart, FALSE);
 
    //
@@ -2316,14 +2315,16 @@ SetLBFont(
 
    } else {
 
-      lpHead->dwAlternateFileNameExtent = GetMaxExtent(hwndLB,
-                                                       lpStart,
-                                                       TRUE);
+      dwAlternateFileNameExtent = GetMaxExtent(hwndLB,
+                                               lpStart,
+                                               TRUE);
+
+      SetWindowLongPtr(hwnd, GWL_ALTNAMEEXTENT, dwAlternateFileNameExtent);
 
       FixTabsAndThings(hwndLB,
                        (WORD *)GetWindowLongPtr(hwnd, GWL_TABARRAY),
                        dxMaxExtent,
-                       lpHead->dwAlternateFileNameExtent,
+                       dwAlternateFileNameExtent,
                        dwViewFlags);
    }
 }
@@ -2402,15 +2403,18 @@ RightTabbedTextOut(
 //
 // Return:   VOID
 //
-// Assumes:  hDTA->head.alpxdtaSorted is NULL _or_
-//           holds valid previously malloc'd array of pointers
+// Assumes:  lpStart is GWL_HDTA of hwndDir
+//           The listbox is empty
 //
-// Effects:  mallocs hDTA->head.alpxdtaSorted if it was NULL
-//           In-place sorts alpxdtaSorted also
+// Effects:  Sets GWL_HDTAORDER, or mallocs GWL_HDTASORTED (FreeDTA
+//           frees it); see DirViewGetItem
 //
 // Notes:    Can be called by either worker or UI thread, therefore
 //           must be reentrant.
 //
+//           Costs one message however many entries there are; only
+//           the rows drawn are ever looked at.
+//
 /////////////////////////////////////////////////////////////////////
 
 VOID
@@ -2419,8 +2423,11 @@ FillDirList(
    LPXDTALINK lpStart)
 {
     DWORD count;
-   UINT   i;
    LPXDTAHEAD lpHead;
+   LPXDTA* alpxdtaSorted;
+   PXDTACOLS pCols;
+   LPDWORD aiOrder;
+   DWORD dwSort;
    INT iError;
    HWND hwndLB = GetDlgItem(hwndDir, IDCW_LISTBOX);
 
@@ -2429,6 +2436,8 @@ FillDirList(
    //
    ExtSelItemsInvalidate();
 
+   DirViewFree(hwndDir);
+
    iError = (INT)GetWindowLongPtr(hwndDir, GWL_IERROR);
 
    lpHead = MemLinkToHead(lpStart);
@@ -2450,26 +2459,124 @@ Error:
       // token for no items
       //
       goto Error;
+   }
+
+   dwSort = GetWindowLongPtr((HWND)GetWindowLongPtr(hwndDir,
+                                                   GWL_LISTPARMS),
+                               GWL_SORT);
+
+   //
+   // Show the sort kept with the columns if the reader built them
+   // (it's shared with other windows on the listing); otherwise sort
+   // the entries into an array of our own
+   //
+   pCols = lpHead->pCols;
+
+   if (pCols && pCols->dwEntries == count &&
+      (aiOrder = ColsGetOrder(pCols, dwSort))) {
+
+      SetWindowLongPtr(hwndDir, GWL_HDTAORDER, (LONG_PTR)aiOrder);
 
    } else {
 
-      if (!lpHead->alpxdtaSorted) {
-         lpHead->alpxdtaSorted = (LPXDTA *)LocalAlloc(LMEM_FIXED,
-            sizeof(LPXDTA) * count);
-      }
+      alpxdtaSorted = (LPXDTA *)LocalAlloc(LMEM_FIXED,
+         sizeof(LPXDTA) * count);
 
-      if (lpHead->alpxdtaSorted) {
+      if (!alpxdtaSorted)
+         return;
 
-         SortDirList(hwndDir, lpStart, count, lpHead->alpxdtaSorted);
+      SortDirList(hwndDir, lpStart, count, alpxdtaSorted);
 
-         for (i = 0; i < count; i++) {
-            SendMessage(hwndLB,
-                        LB_INSERTSTRING,
-                        (WPARAM)-1,
-                        (LPARAM)lpHead->alpxdtaSorted[i]);
-         }
-      }
+      SetWindowLongPtr(hwndDir, GWL_HDTASORTED, (LONG_PTR)alpxdtaSorted);
    }
+
+   //
+   // The listbox only needs to know how many there are
+   //
+   SendMessage(hwndLB, LB_SETCOUNT, count, 0L);
+}
+
+
+/////////////////////////////////////////////////////////////////////
+//
+// Name:     DirViewGetItem
+//
+// Synopsis: Returns the entry shown at iItem of hwndDir's listbox
+//
+// Return:   The entry; NULL for the "no files" or "reading" token
+//
+// Assumes:  iItem is in the listbox
+//
+// Notes:    Directory listboxes hold no data (LBS_NODATA), just a
+//           count; the entries are looked up when drawn or asked for.
+//           They are GWL_HDTA's columns in the order GWL_HDTAORDER,
+//           or GWL_HDTASORTED when there are no columns or the read
+//           is still going (see DirReadProgress).
+//
+/////////////////////////////////////////////////////////////////////
+
+LPXDTA
+DirViewGetItem(
+   HWND hwndDir,
+   INT iItem)
+{
+   LPXDTALINK lpStart = (LPXDTALINK)GetWindowLongPtr(hwndDir, GWL_HDTA);
+   LPDWORD aiOrder = (LPDWORD)GetWindowLongPtr(hwndDir, GWL_HDTAORDER);
+   LPXDTA* alpxdta;
+
+   if (lpStart && aiOrder)
+      return MemLinkToHead(lpStart)->pCols->alpxdta[aiOrder[iItem]];
+
+   alpxdta = (LPXDTA*)GetWindowLongPtr(hwndDir, GWL_HDTASORTED);
+
+   return alpxdta ? alpxdta[iItem] : NULL;
+}
+
+
+/////////////////////////////////////////////////////////////////////
+//
+// Name:     DirGetItem
+//
+// Synopsis: LB_GETTEXT for directory and search listboxes
+//
+// Return:   LB_ERR (and *plpxdta NULL) if iItem is not in the listbox
+//
+/////////////////////////////////////////////////////////////////////
+
+LRESULT
+DirGetItem(
+   HWND hwndLB,
+   INT iItem,
+   LPXDTA* plpxdta)
+{
+   *plpxdta = NULL;
+
+   if (iItem < 0 || iItem >= (INT)SendMessage(hwndLB, LB_GETCOUNT, 0, 0L))
+      return LB_ERR;
+
+   if (!(GetWindowLongPtr(hwndLB, GWL_STYLE) & LBS_NODATA))
+      return SendMessage(hwndLB, LB_GETTEXT, iItem, (LPARAM)plpxdta);
+
+   *plpxdta = DirViewGetItem(GetParent(hwndLB), iItem);
+
+   return sizeof(LPXDTA);
+}
+
+
+//
+// Forgets the entries the listbox shows; it must be emptied or refilled
+// before it's drawn again
+//
+VOID
+DirViewFree(HWND hwndDir)
+{
+   LPXDTA* alpxdta = (LPXDTA*)GetWindowLongPtr(hwndDir, GWL_HDTASORTED);
+
+   SetWindowLongPtr(hwndDir, GWL_HDTASORTED, 0L);
+   SetWindowLongPtr(hwndDir, GWL_HDTAORDER, 0L);
+
+   if (alpxdta)
+      LocalFree(alpxdta);
 }
 
 
@@ -2530,31 +2637,25 @@ CompareDTA(
          ptr1 = GetExtension(MemGetFileName(lpItem1));
          ptr2 = GetExtension(MemGetFileName(lpItem2));
 
-         ret = lstrcmpi(ptr1, ptr2);
+         ret = CompareOrdinalNoCase(ptr1, ptr2);
 
          if (ret == 0) {
 
-            if (*ptr1) {
-               *--ptr1 = CHAR_NULL;
-            } else {
-               ptr1 = NULL;
-            }
-
-            if (*ptr2) {
-               *--ptr2 = CHAR_NULL;
-            } else {
-               ptr2 = NULL;
-            }
-
-            ret = lstrcmpi(MemGetFileName(lpItem1), MemGetFileName(lpItem2));
+            //
+            // Same extension; compare what is before the dot (the
+            // names may be shared, so they can't be cut in place)
+            //
+            if (*ptr1)
+               ptr1--;
 
-            if (ptr1) {
-               *ptr1 = CHAR_DOT;
-            }
+            if (*ptr2)
+               ptr2--;
 
-            if (ptr2) {
-               *ptr2 = CHAR_DOT;
-            }
+            ret = CompareStringOrdinal(MemGetFileName(lpItem1),
+                                       (INT)(ptr1 - MemGetFileName(lpItem1)),
+                                       MemGetFileName(lpItem2),
+                                       (INT)(ptr2 - MemGetFileName(lpItem2)),
+                                       TRUE) - CSTR_EQUAL;
          }
 
          break;
@@ -2614,7 +2715,7 @@ CompareDTA(
    case IDD_NAME:
 
 CompareNames:
-      ret = lstrcmpi(MemGetFileName(lpItem1), MemGetFileName(lpItem2));
+      ret = CompareOrdinalNoCase(MemGetFileName(lpItem1), MemGetFileName(lpItem2));
       break;
    }
 
@@ -2682,7 +2783,6 @@ DirGetSelection(
    INT iMac;
    LPXDTA lpxdta;
    LPXDTALINK lpStart;
-   LPXDTA* alpxdta;
    WCHAR szFile[MAXPATHLEN];
    WCHAR szPath[MAXPATHLEN];
    WCHAR szTemp[MAXPATHLEN];
@@ -2759,8 +2859,6 @@ Fail:
    if (lpSelItems == NULL)
       goto Fail;
 
-   alpxdta = MemLinkToHead(lpStart)->alpxdtaSorted;
-
    iMac = (INT)SendMessage(hwndLB,
                            LB_GETSELITEMS,
                            (WPARAM)iMac,
@@ -2787,7 +2885,7 @@ Fail:
 
       } else {
 
-         lpxdta = alpxdta[lpSelItems[i]];
+         lpxdta = DirViewGetItem(hwndView, lpSelItems[i]);
       }
 
       if (!lpxdta)
@@ -2943,8 +3041,7 @@ GDSDone:
 //
 // Return:  INT    index, (-1) = not found
 //
-// Assumes: hDTA->head.alpxdtaSorted is valid and matches listbox
-//          structure
+// Assumes: the listbox's view (see DirViewGetItem) is valid
 //
 //          hDTA->head.dwEntries must be < INTMAX since there is
 //          a conversion from dword to int.  blech.
@@ -2970,7 +3067,7 @@ DirFindIndex(HWND hwndLB, LPXDTALINK lpStart, LPWSTR lpszFile)
 
    for (i = 0; i < (INT) dwSel; i++) {
 
-      if (SendMessage(hwndLB, LB_GETTEXT, i, (LPARAM)&lpxdta) == LB_ERR)
+      if (DirGetItem(hwndLB, i, &lpxdta) == LB_ERR)
          return -1;
 
       if (lpxdta && !lstrcmpi(lpszFile, MemGetFileName(lpxdta)))
@@ -3013,14 +3110,14 @@ DirGetAnchorFocus(
       return;
 
    if (iCount == 1) {
-      SendMessage(hwndLB, LB_GETTEXT, (WPARAM)iSel, (LPARAM)&lpxdta);
+      DirGetItem(hwndLB, iSel, &lpxdta);
 
       if (!lpxdta) {
          return;
       }
    }
    if (iSel >= 0 && iSel < iCount) {
-      SendMessage(hwndLB, LB_GETTEXT, (WPARAM)iSel, (LPARAM)&lpxdta);
+      DirGetItem(hwndLB, iSel, &lpxdta);
 
       lstrcpy(pSelInfo->szAnchor, MemGetFileName(lpxdta));
    }
@@ -3028,14 +3125,14 @@ DirGetAnchorFocus(
    iSel = (INT)SendMessage(hwndLB, LB_GETCARETINDEX, 0, 0L);
 
    if (iSel >= 0 && iSel < iCount) {
-      SendMessage(hwndLB, LB_GETTEXT, (WPARAM)iSel, (LPARAM)&lpxdta);
+      DirGetItem(hwndLB, iSel, &lpxdta);
       lstrcpy(pSelInfo->szCaret, MemGetFileName(lpxdta));
    }
 
    iSel = SendMessage(hwndLB, LB_GETTOPINDEX, 0, 0L);
 
    if (iSel >= 0 && iSel < iCount) {
-      SendMessage(hwndLB, LB_GETTEXT, (WPARAM)iSel, (LPARAM)&lpxdta);
+      DirGetItem(hwndLB, iSel, &lpxdta);
       lstrcpy(pSelInfo->szTopIndex, MemGetFileName(lpxdta));
    }
 }
@@ -3239,7 +3336,7 @@ GetDirSelData(
 
    for (i=0; i < iMac; i++) {
 
-      SendMessage(hwndLB, LB_GETTEXT, lpSelItems[i], (LPARAM)(LPTSTR)&lpxdta);
+      lpxdta = DirViewGetItem(hwnd, lpSelItems[i]);
 
       if (!lpxdta)
          break;
@@ -12,6 +12,7 @@
 #include "winfile.h"
 #include "lfn.h"
 #include "wfcopy.h"
+#include "dbg.h"
 
 typedef enum {
    EDIRABORT_NULL        = 0,
@@ -33,12 +34,104 @@ EXTLOCATION aExtLocation[] = {
 };
 
 
+//
+// Directories are read by a small pool of threads so that one slow
+// (e.g., network) directory doesn't hold up the other windows.  Each
+// reader owns one DIRREADREQ describing what it is reading; these are
+// only changed with CriticalSectionDirRead held.
+//
+#define DIRREAD_WORKERS       4
+#define DIRREAD_MAX_REMOTE    (DIRREAD_WORKERS - 1)   // keep a reader for local drives
+#define DIRREAD_MAX_FOLLOWERS 16
+
+//
+// A read taking longer than DIRREAD_STREAM_DELAY shows what it has so far,
+// then hands over more every DIRREAD_STREAM_INTERVAL (milliseconds)
+//
+#define DIRREAD_STREAM_DELAY     250
+#define DIRREAD_STREAM_INTERVAL  500
+
+//
+// Decoding reparse points and asking whether directories are shared
+// (see ProbeFile) is what makes reading some directories slow.  Once a
+// read is slow, the probes not answered by the probe cache are put off
+// until the window has the listing; the reader then does them and has
+// the icons redrawn.
+//
+#define PROBE_REPARSE   0x0001
+#define PROBE_NETDIR    0x0002
+
+typedef struct _PROBESTAMP {
+   LARGE_INTEGER liFileId;
+   FILETIME ftChangeTime;
+   FILETIME ftLastWriteTime;
+} PROBESTAMP, *PPROBESTAMP;
+
+typedef struct _DIRPROBE {
+   LPXDTA lpxdta;
+   DWORD dwProbe;             // PROBE_* still to do
+   PROBESTAMP stamp;
+} DIRPROBE, *PDIRPROBE;
+
+//
+// What the probes found; posted to the main thread, which fills it into
+// the listing (see DirReadProbed)
+//
+typedef struct _PROBERESULT {
+   LPXDTA lpxdta;
+   DWORD dwAttrs;             // ATTR_JUNCTION or ATTR_SYMBOLIC to add; 0 if neither
+   BOOL bNetDir;
+} PROBERESULT, *PPROBERESULT;
+
+typedef struct _DIRPROBED {
+   LPXDTALINK lpStart;        // our reference to the listing; DirReadProbed releases it
+   INT cResults;
+   PROBERESULT aResult[1];
+} DIRPROBED, *PDIRPROBED;
+
+typedef struct _DIRREADREQ {
+   HWND hwnd;                 // MDI child being read; NULL if the reader is idle
+   HWND hwndDir;
+   WCHAR szPath[MAXPATHLEN];
+   DWORD dwAttribs;
+   BOOL bRemote;
+   LONG lAbortSeen;           // lDirReadAbort when the abort state was last checked
+
+   //
+   // Other windows waiting for the same path with the same attribs;
+   // they get copies of the result instead of reading it again
+   //
+   INT cFollowers;
+   HWND ahwndDirFollower[DIRREAD_MAX_FOLLOWERS];
+
+   LPVOID pBatchBuffer;       // LFNBATCH_BUFFER_SIZE bytes reused for every read
+
+   //
+   // Probes put off until after the read; lpProbeStart is our
+   // reference to the listing they are for
+   //
+   LPXDTALINK lpProbeStart;
+   INT cProbes;
+   INT cProbesMax;
+   PDIRPROBE aProbe;
+} DIRREADREQ, *PDIRREADREQ;
+
 HANDLE hEventDirRead;
-HANDLE hThreadDirRead;
+HANDLE ahThreadDirRead[DIRREAD_WORKERS];
+INT cDirReadWorkers;
 BOOL bDirReadRun;
 
-BOOL bDirReadAbort;
-BOOL bDirReadRebuildDocString;
+DIRREADREQ aDirReadReq[DIRREAD_WORKERS];
+INT cDirReadRemote;                    // readers busy with remote drives
+
+volatile LONG lDirReadAbort;           // bumped on every abort; readers recheck their window when it changes
+volatile LONG bDirReadRebuildDocString;
+
+//
+// Reads hold this shared; rebuilding the document list (which the
+// reads point into) holds it exclusive
+//
+SRWLOCK SRWLockDirReadDocs = SRWLOCK_INIT;
 
 CRITICAL_SECTION CriticalSectionDirRead;
 
@@ -46,17 +139,26 @@ CRITICAL_SECTION CriticalSectionDirRead;
 // Prototypes
 //
 VOID DirReadServer(LPVOID lpvParm);
-LPXDTALINK CreateDTABlockWorker(HWND hwnd, HWND hwndDir);
-LPXDTALINK StealDTABlock(HWND hwndCur, LPWSTR pPath, DWORD dwAttribs);
-BOOL IsNetDir(LPWSTR pPath, LPWSTR pName);
+BOOL ClaimDirRead(PDIRREADREQ pReq);
+VOID ReleaseDirRead(PDIRREADREQ pReq);
+VOID RequeueDirRead(HWND hwndDir);
+BOOL SendDirReadProgress(HWND hwndDir, PDIRREADPROGRESS pProgress, UINT uSeq);
+LPXDTALINK CreateDTABlockWorker(PDIRREADREQ pReq);
+BOOL IsNetDir(LPWSTR pPath, LPWSTR pName, PBOOL pbFailed);
 VOID DirReadAbort(HWND hwnd, LPXDTALINK lpStart, EDIRABORT eDirAbort);
 DWORD DecodeReparsePoint(LPCWSTR szMyFile, LPCWSTR szChild, LPWSTR szDest, DWORD cwcDest);
+VOID ProbeCacheFlushWorker(DRIVE drive);
+DWORD ProbeFile(LPWSTR pPath, LPWSTR pName, PPROBESTAMP pStamp, DWORD dwProbe, BOOL bDefer, LPDWORD pdwTag, PBOOL pbNetDir);
+BOOL ReserveDirProbe(PDIRREADREQ pReq);
+VOID ResolveDirProbes(PDIRREADREQ pReq);
+VOID PostDirProbed(PDIRPROBED pProbed);
 LONG WFRegGetValueW(HKEY hkey, LPCWSTR lpSubKey, LPCWSTR lpValue, LPDWORD pdwType, PVOID pvData, LPDWORD pcbData);
 
 BOOL
 InitDirRead(VOID)
 {
    DWORD dwIgnore;
+   INT i;
 
    bDirReadRun = TRUE;
    InitializeCriticalSection(&CriticalSectionDirRead);
@@ -74,14 +176,23 @@ Error:
    }
 
 
-   hThreadDirRead = CreateThread(NULL,
-                                 0L,
-                                 (LPTHREAD_START_ROUTINE)DirReadServer,
-                                 NULL,
-                                 0L,
-                                 &dwIgnore);
+   for (cDirReadWorkers = 0, i = 0; i < DIRREAD_WORKERS; i++) {
+
+      ahThreadDirRead[cDirReadWorkers] = CreateThread(NULL,
+                                                      0L,
+                                                      (LPTHREAD_START_ROUTINE)DirReadServer,
+                                                      &aDirReadReq[cDirReadWorkers],
+                                                      0L,
+                                                      &dwIgnore);
+
+      if (ahThreadDirRead[cDirReadWorkers])
+         cDirReadWorkers++;
+   }
 
-   if (!hThreadDirRead) {
+   //
+   // Fewer readers are fine, but we need at least one
+   //
+   if (!cDirReadWorkers) {
 
       CloseHandle(hEventDirRead);
       goto Error;
@@ -94,17 +205,39 @@ Error:
 VOID
 DestroyDirRead(VOID)
 {
+#if DBG
+   WCHAR szMessage[80];
+#endif
+   INT i;
+
    if (bDirReadRun) {
 
       bDirReadRun = FALSE;
 
+      //
+      // Each reader passes the event on as it exits
+      //
       SetEvent(hEventDirRead);
-      WaitForSingleObject(hThreadDirRead, INFINITE);
+      WaitForMultipleObjects(cDirReadWorkers, ahThreadDirRead, TRUE, INFINITE);
 
       CloseHandle(hEventDirRead);
-      CloseHandle(hThreadDirRead);
+      for (i = 0; i < cDirReadWorkers; i++)
+         CloseHandle(ahThreadDirRead[i]);
+
       DeleteCriticalSection(&CriticalSectionDirRead);
    }
+
+#if DBG
+   //
+   // How well the listing cache did this session
+   //
+   wsprintf(szMessage, TEXT("Listing cache: %u hits, %u misses"),
+            dwDirCacheHits, dwDirCacheMisses);
+   TRACE(BF_START, szMessage);
+#endif
+
+   DirCacheFlush();
+   ProbeCacheFlush(-1);
 }
 
 
@@ -131,7 +264,8 @@ DestroyDirRead(VOID)
 // Notes:    The first DTA chunk has a head entry which holds
 //           the number of item/size.  See header.
 //
-//           lpStart->head.alpxdtaSorted is set to NULL
+//           lpStart is read-only and may be shared; the sort is kept
+//           by the window (GWL_HDTASORTED)
 //
 //           dwTotal{Count,Size} handles "real" files only (no "..").
 //           They are used for caching.  dwEntries holds the actual number
@@ -153,7 +287,7 @@ CreateDTABlock(
 
    SetWindowLongPtr(hwnd, GWL_IERROR, ERROR_SUCCESS);
 
-   if (!bDontSteal && (lpStart = StealDTABlock(hwnd, pPath, dwAttribs))) {
+   if (!bDontSteal && (lpStart = DirCacheLookup(pPath, dwAttribs))) {
 
       if (PeekMessage(&msg,
                       NULL,
@@ -200,7 +334,8 @@ DirReadAbort(
 
    SetWindowLongPtr(hwnd, GWL_HDTA, (LPARAM)lpStart);
    SetWindowLongPtr(hwnd, GWL_HDTAABORT, eDirAbort);
-   bDirReadAbort = TRUE;
+   SetWindowLongPtr(hwnd, GWL_HDTASTREAM, 0L);
+   InterlockedIncrement(&lDirReadAbort);
 
    SetEvent(hEventDirRead);
 
@@ -211,207 +346,1198 @@ DirReadAbort(
 
 /////////////////////////////////////////////////////////////////////
 //
-// Name:     StealDTABlock
+// Listing cache
+//
+// Completed listings are kept by (window text, attribs) so that going
+// back to a directory, or opening another window on it, doesn't read
+// the disk again.  Each entry holds a change notification on its
+// directory: one that has fired (or failed) means the entry is stale.
+// ChangeFileSystem drops the entries for directories winfile changes
+// itself, and rebuilding the document list drops everything (entries
+// point into it).
 //
-// Synopsis: Steals a DTA block based on title bar directory
+// Removable and CD-ROM drives aren't cached, since the notification
+// handles would keep the media from being ejected.
 //
-// hwnd      hwnd of target steal
-// hwndDir   Dir to receive
-// dwAttribs Attribs we are going to have
+// Main Thread ONLY!
 //
-// Return:   Copied block or NULL
+/////////////////////////////////////////////////////////////////////
+
+#define DIRCACHE_MAX_ENTRIES  32
+#define DIRCACHE_MAX_BYTES    (16 * 1024 * 1024)
+
+typedef struct _DIRCACHEENTRY {
+   struct _DIRCACHEENTRY* pNext;   // next less recently used
+   LPXDTALINK lpStart;             // our reference
+   SIZE_T cbSize;
+   HANDLE hChange;
+   DWORD dwAttribs;
+   WCHAR szPath[1];                // directory and filespec
+} DIRCACHEENTRY, *PDIRCACHEENTRY;
+
+PDIRCACHEENTRY pDirCacheMRU;
+INT cDirCacheEntries;
+SIZE_T cbDirCache;
+
 //
+// Lookups that were (not) satisfied; see DirCacheGetStats
 //
-// Assumes:  If the title bar is set, the directory has been fully read.
+DWORD dwDirCacheHits;
+DWORD dwDirCacheMisses;
+
+
 //
+// Unlinks and frees *ppEntry
 //
-// Effects:
+VOID
+DirCacheRemove(PDIRCACHEENTRY* ppEntry)
+{
+   PDIRCACHEENTRY pEntry = *ppEntry;
+
+   *ppEntry = pEntry->pNext;
+
+   cDirCacheEntries--;
+   cbDirCache -= pEntry->cbSize;
+
+   FindCloseChangeNotification(pEntry->hChange);
+   MemDelete(pEntry->lpStart);
+   LocalFree(pEntry);
+}
+
+
+/////////////////////////////////////////////////////////////////////
 //
+// Name:     DirCacheLookup
 //
-// Notes:    Called from Main thread.
+// Synopsis: Gets a cached listing
+//
+// pPath     directory and filespec, as in the MDI title
+// dwAttribs attribs the listing was read with
+//
+// Return:   Reference to the listing, or NULL
+//
+// Notes:    Stale entries met on the way are dropped, so a directory
+//           deleted outside winfile isn't kept open by our handle.
 //
 /////////////////////////////////////////////////////////////////////
 
 LPXDTALINK
-StealDTABlock(
-   HWND hwndCur,
+DirCacheLookup(
    LPWSTR pPath,
    DWORD dwAttribs)
 {
-   HWND hwndDir;
-   HWND hwnd;
-   WCHAR szPath[MAXPATHLEN];
+   PDIRCACHEENTRY* ppEntry;
+   PDIRCACHEENTRY pEntry;
+   LPXDTALINK lpStart = NULL;
 
-   LPXDTALINK lpStart, lpStartCopy;
-   INT iError;
-
-   for (hwnd = GetWindow(hwndMDIClient, GW_CHILD);
-      hwnd;
-      hwnd = GetWindow(hwnd, GW_HWNDNEXT)) {
+   for (ppEntry = &pDirCacheMRU; pEntry = *ppEntry; ) {
 
-      if ((hwndDir = HasDirWindow(hwnd)) && (hwndDir != hwndCur)) {
+      if (WaitForSingleObject(pEntry->hChange, 0) != WAIT_TIMEOUT) {
+         DirCacheRemove(ppEntry);
+         continue;
+      }
 
-         GetMDIWindowText(hwnd, szPath, COUNTOF(szPath));
+      if (!lpStart &&
+         dwAttribs == pEntry->dwAttribs &&
+         !lstrcmpi(pPath, pEntry->szPath)) {
 
-         if ((dwAttribs == (DWORD)GetWindowLongPtr(hwnd, GWL_ATTRIBS)) &&
-            !lstrcmpi(pPath, szPath) &&
-            (lpStart = (LPXDTALINK)GetWindowLongPtr(hwndDir, GWL_HDTA))) {
+         lpStart = MemAddRef(pEntry->lpStart);
 
-            iError = (INT)GetWindowLongPtr(hwndDir, GWL_IERROR);
-            if (!iError || IDS_NOFILES == iError) {
+         //
+         // Most recently used goes first
+         //
+         *ppEntry = pEntry->pNext;
+         pEntry->pNext = pDirCacheMRU;
+         pDirCacheMRU = pEntry;
 
-               lpStartCopy = MemClone(lpStart);
+         if (ppEntry == &pDirCacheMRU)
+            ppEntry = &pEntry->pNext;
 
-               return lpStartCopy;
-            }
-         }
+         continue;
       }
+
+      ppEntry = &pEntry->pNext;
    }
 
-   return NULL;
+   if (lpStart)
+      dwDirCacheHits++;
+   else
+      dwDirCacheMisses++;
+
+   return lpStart;
 }
 
 
 /////////////////////////////////////////////////////////////////////
 //
-// Name:     FreeDTA
+// Name:     DirCacheInsert
 //
-// Synopsis: Clears the DTA
+// Synopsis: Keeps a reference to a completed listing
 //
-// hwnd      Window to free (either hwndDir or hwndSearch)
+// pPath     directory and filespec, as in the MDI title
+// dwAttribs attribs the listing was read with
+// lpStart   the listing; caller keeps its own reference
 //
 // Return:   VOID
 //
-// Assumes:
+// Notes:    The notification is set up after the read, the same as the
+//           window's own (see ModifyWatchList in DirReadDone).
 //
-// Effects:
+/////////////////////////////////////////////////////////////////////
+
+VOID
+DirCacheInsert(
+   LPWSTR pPath,
+   DWORD dwAttribs,
+   LPXDTALINK lpStart)
+{
+   PDIRCACHEENTRY* ppEntry;
+   PDIRCACHEENTRY pEntry;
+   WCHAR szDir[MAXPATHLEN];
+   DRIVE drive;
+
+   if (!lpStart || CHAR_COLON != pPath[1])
+      return;
+
+   drive = DRIVEID(pPath);
+
+   if (IsRemovableDrive(drive) || IsCDRomDrive(drive))
+      return;
+
+   //
+   // Replace what we had
+   //
+   for (ppEntry = &pDirCacheMRU; pEntry = *ppEntry; ppEntry = &pEntry->pNext) {
+
+      if (dwAttribs == pEntry->dwAttribs && !lstrcmpi(pPath, pEntry->szPath)) {
+         DirCacheRemove(ppEntry);
+         break;
+      }
+   }
+
+   pEntry = (PDIRCACHEENTRY)LocalAlloc(LMEM_FIXED,
+      sizeof(DIRCACHEENTRY) + ByteCountOf(lstrlen(pPath)));
+
+   if (!pEntry)
+      return;
+
+   lstrcpy(szDir, pPath);
+   StripFilespec(szDir);
+
+   pEntry->hChange = FindFirstChangeNotification(szDir, FALSE, FILE_NOTIFY_CHANGE_FLAGS);
+
+   if (pEntry->hChange == INVALID_HANDLE_VALUE) {
+      LocalFree(pEntry);
+      return;
+   }
+
+   pEntry->lpStart = MemAddRef(lpStart);
+   pEntry->cbSize = LocalSize(pEntry) + MemSize(pEntry->lpStart);
+   pEntry->dwAttribs = dwAttribs;
+   lstrcpy(pEntry->szPath, pPath);
+
+   pEntry->pNext = pDirCacheMRU;
+   pDirCacheMRU = pEntry;
+
+   cDirCacheEntries++;
+   cbDirCache += pEntry->cbSize;
+
+   //
+   // Drop the least recently used ones until we are within budget
+   // (possibly the new one, if it alone is too big)
+   //
+   while (cDirCacheEntries > DIRCACHE_MAX_ENTRIES || cbDirCache > DIRCACHE_MAX_BYTES) {
+
+      for (ppEntry = &pDirCacheMRU; (*ppEntry)->pNext; ppEntry = &(*ppEntry)->pNext)
+         ;
+
+      DirCacheRemove(ppEntry);
+   }
+}
+
+
+/////////////////////////////////////////////////////////////////////
 //
+// Name:     DirCacheInvalidate
 //
-// Notes:    !! Must not be called from worker thread !!
-//           Directory windows assumed to be synchronized by
-//           SendMessage to Main UI Thread.  (Search windows ok)
+// Synopsis: Drops the listings a change to pPath makes stale
+//
+// pPath     fully qualified file or directory that was changed
+//
+// Return:   VOID
+//
+// Notes:    That is the listing of the directory holding pPath and,
+//           if pPath is a directory, those of pPath and below.
 //
 /////////////////////////////////////////////////////////////////////
 
-
 VOID
-FreeDTA(HWND hwnd)
+DirCacheInvalidate(LPWSTR pPath)
 {
-    LPXDTALINK lpxdtaLink;
+   PDIRCACHEENTRY* ppEntry;
+   PDIRCACHEENTRY pEntry;
+   WCHAR szParent[MAXPATHLEN];
+   WCHAR szDir[MAXPATHLEN];
+   INT cchPath;
 
-   lpxdtaLink = (LPXDTALINK)GetWindowLongPtr(hwnd, GWL_HDTA);
+   lstrcpy(szParent, pPath);
+   StripFilespec(szParent);
 
-   SetWindowLongPtr(hwnd, GWL_HDTA, 0L);
+   cchPath = lstrlen(pPath);
 
-   //
-   // Only delete it if it's not in use.
-   //
-   if (lpxdtaLink) {
+   for (ppEntry = &pDirCacheMRU; pEntry = *ppEntry; ) {
 
-       if (MemLinkToHead(lpxdtaLink)->fdwStatus & LPXDTA_STATUS_READING) {
+      lstrcpy(szDir, pEntry->szPath);
+      StripFilespec(szDir);
 
-           MemLinkToHead(lpxdtaLink)->fdwStatus |= LPXDTA_STATUS_CLOSE;
+      if (!lstrcmpi(szDir, szParent) ||
+         (lstrlen(szDir) >= cchPath &&
+          CSTR_EQUAL == CompareStringOrdinal(szDir, cchPath, pPath, cchPath, TRUE) &&
+          (CHAR_NULL == szDir[cchPath] || CHAR_BACKSLASH == szDir[cchPath]))) {
 
-       } else {
+         DirCacheRemove(ppEntry);
+         continue;
+      }
 
-           MemDelete(lpxdtaLink);
-       }
+      ppEntry = &pEntry->pNext;
    }
 }
 
 
 VOID
-DirReadDestroyWindow(HWND hwndDir)
+DirCacheFlush(VOID)
 {
-   DirReadAbort(hwndDir, NULL, EDIRABORT_WINDOWCLOSE);
+   while (pDirCacheMRU)
+      DirCacheRemove(&pDirCacheMRU);
 }
 
 
+/////////////////////////////////////////////////////////////////////
+//
+// Name:     DirCacheGetStats
+//
+// Synopsis: Reports how many listing cache lookups were satisfied
+//
+// pdwHits    receives the lookups answered from the cache
+// pdwMisses  receives the lookups that had to read the directory
+//
+// Return:   VOID
+//
+// Notes:    Counts are for the session so far.  Main thread only,
+//           like DirCacheLookup.
+//
+/////////////////////////////////////////////////////////////////////
+
+VOID
+DirCacheGetStats(LPDWORD pdwHits, LPDWORD pdwMisses)
+{
+   *pdwHits = dwDirCacheHits;
+   *pdwMisses = dwDirCacheMisses;
+}
+
 
 /////////////////////////////////////////////////////////////////////
 //
-// Name:     DirReadDone
+// Probe cache
 //
-// Synopsis: Called by main thread (sync'd by SM)
+// What DecodeReparsePoint and IsNetDir found out about an entry, kept
+// per volume by full path so that reading a directory again doesn't
+// open every junction or ask the network about every subdirectory.
+// An entry is only used while the file id, change time and last write
+// time the read returns for the file are the ones it was probed with;
+// besides that, changes winfile makes (ChangeFileSystem) or is told
+// about (change notifications) drop the entries below the directory,
+// and sharing or refreshing drops everything on the drive.
 //
-// Return:   LRESULT
+// Used by the readers and the main thread; SRWLockProbeCache guards it.
 //
-// Assumes:
+/////////////////////////////////////////////////////////////////////
+
+#define PROBECACHE_BUCKETS      256
+#define PROBECACHE_MAX_ENTRIES  8192         // per volume
+#define PROBECACHE_BUCKET_MAX   (PROBECACHE_MAX_ENTRIES / PROBECACHE_BUCKETS)
+
+typedef struct _PROBEENTRY {
+   struct _PROBEENTRY* pNext;
+   PROBESTAMP stamp;
+   DWORD dwKnown;             // PROBE_*: which of the below are valid
+   DWORD dwTag;               // reparse tag; IO_REPARSE_TAG_RESERVED_ZERO if none
+   BOOL bNetDir;
+   DWORD dwHash;
+   WCHAR szPath[1];
+} PROBEENTRY, *PPROBEENTRY;
+
+typedef struct _PROBECACHE {
+   INT cEntries;
+   PPROBEENTRY apBucket[PROBECACHE_BUCKETS];
+} PROBECACHE, *PPROBECACHE;
+
+PPROBECACHE apProbeCache[MAX_DRIVES];
+SRWLOCK SRWLockProbeCache = SRWLOCK_INIT;
+
+
+DWORD
+ProbeCacheHash(LPCWSTR pPath)
+{
+   DWORD dwHash = 2166136261;
+   WCHAR ch;
+
+   for (; ch = *pPath; pPath++) {
+
+      if (ch >= CHAR_A && ch <= CHAR_Z)
+         ch += CHAR_a - CHAR_A;
+
+      dwHash = (dwHash ^ ch) * 16777619;
+   }
+
+   return dwHash;
+}
+
+
+BOOL
+ProbeStampEqual(PPROBESTAMP pStamp1, PPROBESTAMP pStamp2)
+{
+   return pStamp1->liFileId.QuadPart == pStamp2->liFileId.QuadPart &&
+          !CompareFileTime(&pStamp1->ftChangeTime, &pStamp2->ftChangeTime) &&
+          !CompareFileTime(&pStamp1->ftLastWriteTime, &pStamp2->ftLastWriteTime);
+}
+
+
+/////////////////////////////////////////////////////////////////////
 //
-// Effects:
+// Name:     ProbeCacheLookup
 //
+// Synopsis: Finds what is known about a file
 //
-// Notes:    Main Thread ONLY!
+// pPath     fully qualified file
+// pStamp    the file as just read
+// pdwTag    gets the reparse tag if PROBE_REPARSE is returned
+// pbNetDir  gets the share state if PROBE_NETDIR is returned
+//
+// Return:   PROBE_* of what is known; 0 if nothing
 //
 /////////////////////////////////////////////////////////////////////
 
-LPXDTALINK
-DirReadDone(
-   HWND hwndDir,
-   LPXDTALINK lpStart,
-   INT iError)
+DWORD
+ProbeCacheLookup(
+   LPCWSTR pPath,
+   PPROBESTAMP pStamp,
+   LPDWORD pdwTag,
+   PBOOL pbNetDir)
 {
-   HWND hwndLB = GetDlgItem(hwndDir, IDCW_LISTBOX);
-   HWND hwndParent = GetParent(hwndDir);
-   WCHAR szPath[MAXPATHLEN];
-   HWND hwndNext;
+   PPROBEENTRY pEntry;
+   DRIVE drive = DRIVEID(pPath);
+   DWORD dwHash = ProbeCacheHash(pPath);
+   DWORD dwKnown = 0;
+
+   if (drive >= MAX_DRIVES)
+      return 0;
+
+   AcquireSRWLockShared(&SRWLockProbeCache);
 
+   if (apProbeCache[drive]) {
+
+      for (pEntry = apProbeCache[drive]->apBucket[dwHash % PROBECACHE_BUCKETS];
+         pEntry;
+         pEntry = pEntry->pNext) {
+
+         if (pEntry->dwHash == dwHash && !lstrcmpi(pEntry->szPath, pPath)) {
+
+            if (ProbeStampEqual(&pEntry->stamp, pStamp)) {
+
+               dwKnown = pEntry->dwKnown;
+
+               if (dwKnown & PROBE_REPARSE)
+                  *pdwTag = pEntry->dwTag;
+
+               if (dwKnown & PROBE_NETDIR)
+                  *pbNetDir = pEntry->bNetDir;
+            }
+            break;
+         }
+      }
+   }
+
+   ReleaseSRWLockShared(&SRWLockProbeCache);
+
+   return dwKnown;
+}
+
+
+/////////////////////////////////////////////////////////////////////
+//
+// Name:     ProbeCacheStore
+//
+// Synopsis: Remembers what was found out about a file
+//
+// pPath     fully qualified file
+// pStamp    the file as read before probing it
+// dwKnown   PROBE_* of dwTag and bNetDir that are valid
+//
+// Return:   VOID
+//
+// Notes:    Adds to what is known if the file is unchanged; otherwise
+//           replaces it.  New files go to the front of their bucket;
+//           a full bucket drops its oldest (the one at the end).
+//
+/////////////////////////////////////////////////////////////////////
+
+VOID
+ProbeCacheStore(
+   LPCWSTR pPath,
+   PPROBESTAMP pStamp,
+   DWORD dwKnown,
+   DWORD dwTag,
+   BOOL bNetDir)
+{
+   PPROBECACHE pCache;
+   PPROBEENTRY* ppEntry;
+   PPROBEENTRY* ppLast = NULL;
+   PPROBEENTRY pEntry;
+   DRIVE drive = DRIVEID(pPath);
+   DWORD dwHash = ProbeCacheHash(pPath);
+   INT cInBucket = 0;
+
+   if (drive >= MAX_DRIVES || !dwKnown)
+      return;
+
+   AcquireSRWLockExclusive(&SRWLockProbeCache);
+
+   if (!(pCache = apProbeCache[drive])) {
+
+      pCache = (PPROBECACHE)LocalAlloc(LPTR, sizeof(PROBECACHE));
+
+      if (!pCache)
+         goto Done;
+
+      apProbeCache[drive] = pCache;
+   }
+
+   for (ppEntry = &pCache->apBucket[dwHash % PROBECACHE_BUCKETS];
+      pEntry = *ppEntry;
+      ppEntry = &pEntry->pNext) {
+
+      if (pEntry->dwHash == dwHash && !lstrcmpi(pEntry->szPath, pPath))
+         break;
+
+      ppLast = ppEntry;
+      cInBucket++;
+   }
+
+   if (pEntry) {
+
+      if (!ProbeStampEqual(&pEntry->stamp, pStamp)) {
+         pEntry->stamp = *pStamp;
+         pEntry->dwKnown = 0;
+      }
+
+   } else {
+
+      if (cInBucket >= PROBECACHE_BUCKET_MAX) {
+
+         pEntry = *ppLast;
+         *ppLast = NULL;
+         pCache->cEntries--;
+         LocalFree(pEntry);
+      }
+
+      pEntry = (PPROBEENTRY)LocalAlloc(LMEM_FIXED,
+         sizeof(PROBEENTRY) + ByteCountOf(lstrlen(pPath)));
+
+      if (!pEntry)
+         goto Done;
+
+      pEntry->stamp = *pStamp;
+      pEntry->dwKnown = 0;
+      pEntry->dwHash = dwHash;
+      lstrcpy(pEntry->szPath, pPath);
+
+      pEntry->pNext = pCache->apBucket[dwHash % PROBECACHE_BUCKETS];
+      pCache->apBucket[dwHash % PROBECACHE_BUCKETS] = pEntry;
+      pCache->cEntries++;
+   }
+
+   if (dwKnown & PROBE_REPARSE)
+      pEntry->dwTag = dwTag;
+
+   if (dwKnown & PROBE_NETDIR)
+      pEntry->bNetDir = bNetDir;
+
+   pEntry->dwKnown |= dwKnown;
+
+Done:
+
+   ReleaseSRWLockExclusive(&SRWLockProbeCache);
+}
+
+
+/////////////////////////////////////////////////////////////////////
+//
+// Name:     ProbeCacheInvalidate
+//
+// Synopsis: Drops what is known about pPath and everything below it
+//
+// pPath     fully qualified file or directory; a trailing backslash
+//           is allowed
+//
+// Return:   VOID
+//
+/////////////////////////////////////////////////////////////////////
+
+VOID
+ProbeCacheInvalidate(LPWSTR pPath)
+{
+   PPROBECACHE pCache;
+   PPROBEENTRY* ppEntry;
+   PPROBEENTRY pEntry;
+   DRIVE drive = DRIVEID(pPath);
+   INT cchPath;
+   INT i;
+
+   if (drive >= MAX_DRIVES)
+      return;
+
+   cchPath = lstrlen(pPath);
+
+   if (cchPath && CHAR_BACKSLASH == pPath[cchPath-1])
+      cchPath--;
+
+   AcquireSRWLockExclusive(&SRWLockProbeCache);
+
+   if (pCache = apProbeCache[drive]) {
+
+      for (i = 0; i < PROBECACHE_BUCKETS; i++) {
+
+         for (ppEntry = &pCache->apBucket[i]; pEntry = *ppEntry; ) {
+
+            if (lstrlen(pEntry->szPath) >= cchPath &&
+               CSTR_EQUAL == CompareStringOrdinal(pEntry->szPath, cchPath, pPath, cchPath, TRUE) &&
+               (CHAR_NULL == pEntry->szPath[cchPath] || CHAR_BACKSLASH == pEntry->szPath[cchPath])) {
+
+               *ppEntry = pEntry->pNext;
+               pCache->cEntries--;
+               LocalFree(pEntry);
+               continue;
+            }
+
+            ppEntry = &pEntry->pNext;
+         }
+      }
+   }
+
+   ReleaseSRWLockExclusive(&SRWLockProbeCache);
+}
+
+
+//
+// Frees a volume's cache; SRWLockProbeCache held exclusive
+//
+VOID
+ProbeCacheFlushWorker(DRIVE drive)
+{
+   PPROBECACHE pCache = apProbeCache[drive];
+   PPROBEENTRY pEntry;
+   INT i;
+
+   if (!pCache)
+      return;
+
+   for (i = 0; i < PROBECACHE_BUCKETS; i++) {
+
+      while (pEntry = pCache->apBucket[i]) {
+         pCache->apBucket[i] = pEntry->pNext;
+         LocalFree(pEntry);
+      }
+   }
+
+   LocalFree(pCache);
+   apProbeCache[drive] = NULL;
+}
+
+
+//
+// Drops everything known about drive; -1 for all drives
+//
+VOID
+ProbeCacheFlush(DRIVE drive)
+{
+   AcquireSRWLockExclusive(&SRWLockProbeCache);
+
+   if (-1 == drive) {
+      for (drive = 0; drive < MAX_DRIVES; drive++)
+         ProbeCacheFlushWorker(drive);
+
+   } else if (drive >= 0 && drive < MAX_DRIVES) {
+      ProbeCacheFlushWorker(drive);
+   }
+
+   ReleaseSRWLockExclusive(&SRWLockProbeCache);
+}
+
+
+/////////////////////////////////////////////////////////////////////
+//
+// Name:     ProbeFile
+//
+// Synopsis: Decodes a reparse point and/or checks for a shared
+//           directory, using the cache when it can
+//
+// pPath     directory and filespec being read
+// pName     file in it
+// pStamp    the file as read
+// dwProbe   PROBE_* wanted
+// bDefer    TRUE = only look in the cache
+// pdwTag    gets the reparse tag (PROBE_REPARSE)
+// pbNetDir  gets whether it is shared (PROBE_NETDIR)
+//
+// Return:   PROBE_* not answered (only if bDefer)
+//
+// Notes:    Called from reader threads.
+//
+/////////////////////////////////////////////////////////////////////
+
+DWORD
+ProbeFile(
+   LPWSTR pPath,
+   LPWSTR pName,
+   PPROBESTAMP pStamp,
+   DWORD dwProbe,
+   BOOL bDefer,
+   LPDWORD pdwTag,
+   PBOOL pbNetDir)
+{
+   WCHAR szFile[2*MAXPATHLEN];
+   WCHAR szLinkDest[MAXPATHLEN];
+   DWORD dwKnown;
+   DWORD dwStore = 0;
+   BOOL bShareChkFail;
+
+   lstrcpy(szFile, pPath);
+   StripFilespec(szFile);
+   AppendToPath(szFile, pName);
+
+   dwKnown = ProbeCacheLookup(szFile, pStamp, pdwTag, pbNetDir);
+
+   if (bDefer)
+      return dwProbe & ~dwKnown;
+
+   if ((dwProbe & PROBE_REPARSE) && !(dwKnown & PROBE_REPARSE)) {
+
+      *pdwTag = DecodeReparsePoint(pPath, pName, szLinkDest, COUNTOF(szLinkDest));
+      dwStore |= PROBE_REPARSE;
+   }
+
+   if ((dwProbe & PROBE_NETDIR) && !(dwKnown & PROBE_NETDIR)) {
+
+      *pbNetDir = IsNetDir(pPath, pName, &bShareChkFail);
+
+      //
+      // Not worth keeping when the check failed (it won't be tried
+      // on this drive again anyway) or couldn't be made yet
+      //
+      if (!bShareChkFail)
+         dwStore |= PROBE_NETDIR;
+   }
+
+   if (dwStore)
+      ProbeCacheStore(szFile, pStamp, dwStore, *pdwTag, *pbNetDir);
+
+   return 0;
+}
+
+
+//
+// Makes sure pReq can put off one more probe
+//
+BOOL
+ReserveDirProbe(PDIRREADREQ pReq)
+{
+   PDIRPROBE aProbe;
+   INT cProbesMax;
+
+   if (pReq->cProbes < pReq->cProbesMax)
+      return TRUE;
+
+   cProbesMax = pReq->cProbesMax ? 2 * pReq->cProbesMax : 64;
+
+   if (pReq->aProbe)
+      aProbe = (PDIRPROBE)LocalReAlloc(pReq->aProbe, cProbesMax * sizeof(DIRPROBE), LMEM_MOVEABLE);
+   else
+      aProbe = (PDIRPROBE)LocalAlloc(LMEM_FIXED, cProbesMax * sizeof(DIRPROBE));
+
+   if (!aProbe)
+      return FALSE;
+
+   pReq->aProbe = aProbe;
+   pReq->cProbesMax = cProbesMax;
+
+   return TRUE;
+}
+
+
+/////////////////////////////////////////////////////////////////////
+//
+// Name:     ResolveDirProbes
+//
+// Synopsis: Does the probes put off while reading pReq->szPath
+//
+// pReq      the reader; lpProbeStart is released
+//
+// Return:   VOID
+//
+// Notes:    Called from reader threads, after the window has the
+//           listing.  The listing is shared by then, so nothing is
+//           changed here: the results are posted to the main thread in
+//           batches as we go, and it fills them in (see DirReadProbed).
+//
+/////////////////////////////////////////////////////////////////////
+
+VOID
+ResolveDirProbes(PDIRREADREQ pReq)
+{
+   LPXDTALINK lpStart = pReq->lpProbeStart;
+   LPXDTAHEAD lpHead = MemLinkToHead(lpStart);
+   PDIRPROBE pProbe;
+   PDIRPROBED pProbed = NULL;
+   PPROBERESULT pResult;
+   DWORD dwTick = GetTickCount();
+   DWORD dwTag;
+   BOOL bNetDir;
+   INT i;
+
+   for (i = 0; i < pReq->cProbes; i++) {
+
+      //
+      // Nobody but us (and the batches posted) wants it any more?
+      //
+      if (!bDirReadRun || 1 == lpHead->cRef)
+         break;
+
+      //
+      // Room for the rest of the probes
+      //
+      if (!pProbed) {
+
+         pProbed = (PDIRPROBED)LocalAlloc(LMEM_FIXED,
+            sizeof(DIRPROBED) + (pReq->cProbes - i - 1) * sizeof(PROBERESULT));
+
+         if (!pProbed)
+            break;
+
+         pProbed->lpStart = lpStart;
+         pProbed->cResults = 0;
+      }
+
+      pProbe = &pReq->aProbe[i];
+
+      dwTag = IO_REPARSE_TAG_RESERVED_ZERO;
+      bNetDir = FALSE;
+
+      ProbeFile(pReq->szPath,
+                MemGetFileName(pProbe->lpxdta),
+                &pProbe->stamp,
+                pProbe->dwProbe,
+                FALSE,
+                &dwTag,
+                &bNetDir);
+
+      pResult = &pProbed->aResult[pProbed->cResults++];
+      pResult->lpxdta = pProbe->lpxdta;
+      pResult->bNetDir = bNetDir;
+
+      if (dwTag == IO_REPARSE_TAG_MOUNT_POINT)
+         pResult->dwAttrs = ATTR_JUNCTION;
+      else if (dwTag == IO_REPARSE_TAG_SYMLINK)
+         pResult->dwAttrs = ATTR_SYMBOLIC;
+      else
+         pResult->dwAttrs = 0;
+
+      if (GetTickCount() - dwTick >= DIRREAD_STREAM_INTERVAL) {
+
+         PostDirProbed(pProbed);
+         pProbed = NULL;
+         dwTick = GetTickCount();
+      }
+   }
+
+   if (pProbed)
+      PostDirProbed(pProbed);
+
+   pReq->lpProbeStart = NULL;
+   pReq->cProbes = 0;
+
+   MemDelete(lpStart);
+}
+
+
+//
+// Hands a batch of probe results to the main thread, with a reference
+// to their listing
+//
+VOID
+PostDirProbed(PDIRPROBED pProbed)
+{
+   pProbed->lpStart = MemAddRef(pProbed->lpStart);
+
+   if (!PostMessage(hwndFrame, FS_DIRREADPROBED, 0, (LPARAM)pProbed)) {
+
+      MemDelete(pProbed->lpStart);
+      LocalFree(pProbed);
+   }
+}
+
+
+/////////////////////////////////////////////////////////////////////
+//
+// Name:     FreeDTA
+//
+// Synopsis: Clears the DTA and this window's sort of it
+//
+// hwnd      Window to free (hwndDir)
+//
+// Return:   VOID
+//
+// Assumes:
+//
+// Effects:
+//
+//
+// Notes:    !! Must not be called from worker thread !!
+//           Directory windows assumed to be synchronized by
+//           SendMessage to Main UI Thread.
+//
+//           Only our reference is dropped; the cache, other windows
+//           or ReadDirLevel may still hold the DTA.
+//
+/////////////////////////////////////////////////////////////////////
+
+
+VOID
+FreeDTA(HWND hwnd)
+{
+   LPXDTALINK lpxdtaLink;
+
+   lpxdtaLink = (LPXDTALINK)GetWindowLongPtr(hwnd, GWL_HDTA);
+
+   DirViewFree(hwnd);
+   SetWindowLongPtr(hwnd, GWL_HDTA, 0L);
+
+   MemDelete(lpxdtaLink);
+}
+
+
+VOID
+DirReadDestroyWindow(HWND hwndDir)
+{
+   DirReadAbort(hwndDir, NULL, EDIRABORT_WINDOWCLOSE);
+}
+
+
+
+/////////////////////////////////////////////////////////////////////
+//
+// Name:     DirReadDone
+//
+// Synopsis: Called by main thread (sync'd by SM)
+//
+// Return:   LRESULT
+//
+// Assumes:
+//
+// Effects:
+//
+//
+// Notes:    Main Thread ONLY!
+//
+/////////////////////////////////////////////////////////////////////
+
+LPXDTALINK
+DirReadDone(
+   HWND hwndDir,
+   LPXDTALINK lpStart,
+   INT iError)
+{
+   HWND hwndLB = GetDlgItem(hwndDir, IDCW_LISTBOX);
+   HWND hwndParent = GetParent(hwndDir);
+   WCHAR szPath[MAXPATHLEN];
+   HWND hwndNext;
+
+
+   EDIRABORT eDirAbort;
+
+   eDirAbort = (EDIRABORT)GetWindowLongPtr(hwndDir, GWL_HDTAABORT);
+
+   //
+   // Last chance check for abort
+   //
+   if ((eDirAbort & (EDIRABORT_READREQUEST|EDIRABORT_WINDOWCLOSE)) ||
+      GetWindowLongPtr(hwndDir, GWL_HDTA)) {
+
+      //
+      // We don't want it
+      //
+      return NULL;
+   }
+
+   GetMDIWindowText(hwndParent, szPath, COUNTOF(szPath));
+
+   if (!iError && lpStart) {
+      DirCacheInsert(szPath,
+                     (DWORD)GetWindowLongPtr(hwndParent, GWL_ATTRIBS),
+                     lpStart);
+   }
+
+   StripFilespec(szPath);
+
+   ModifyWatchList(hwndParent,
+                   szPath,
+                   FILE_NOTIFY_CHANGE_FLAGS);
+
+   SetWindowLongPtr(hwndDir, GWL_IERROR, iError);
+   SetWindowLongPtr(hwndDir, GWL_HDTA, (LPARAM)lpStart);
+   SetWindowLongPtr(hwndDir, GWL_HDTASTREAM, 0L);
+
+   //
+   // Remove the "reading" token, or the unsorted entries shown
+   // while reading (see DirReadProgress)
+   //
+   SendMessage(hwndLB, LB_RESETCONTENT, 0, 0);
+
+   FillDirList(hwndDir, lpStart);
+
+   SetWindowLongPtr(hwndDir, GWLP_USERDATA, 0);
+
+   hwndNext = (HWND)GetWindowLongPtr(hwndDir, GWL_NEXTHWND);
+   if (hwndNext)
+   {
+       SendMessage(hwndDir, FS_TESTEMPTY, 0L, (LPARAM)hwndNext);
+   }
+   SetWindowLongPtr(hwndDir, GWL_NEXTHWND, 0L);
+
+   //
+   // Refresh display, but don't hit disk
+   //
+   SPC_SET_INVALID(qFreeSpace);
+
+   return lpStart;
+}
+
+
+/////////////////////////////////////////////////////////////////////
+//
+// Name:     DirReadProgress
+//
+// Synopsis: Shows the entries of a read still in progress
+//
+// uSeq      batch number, starting at 1; 0 if the reader is abandoning
+//           the read and is about to free pProgress->lpStart
+//
+// Return:   TRUE if the reader should keep sending batches
+//
+// Notes:    Main Thread ONLY!  The reader waits in SendMessage, so
+//           the chain can be walked; the first dwEntries entries
+//           don't change after we return.
+//
+//           Entries are shown in the order read, from GWL_HDTASORTED
+//           (see DirViewGetItem); DirReadDone replaces them with the
+//           sorted list.  The listbox is trusted to hold the earlier
+//           batches only if it holds exactly dwShown entries starting
+//           with ours: a listbox rebuilt meanwhile (sort or view
+//           change) is back to the "reading" token and is refilled
+//           from the start.
+//
+/////////////////////////////////////////////////////////////////////
+
+BOOL
+DirReadProgress(
+   HWND hwndDir,
+   UINT uSeq,
+   PDIRREADPROGRESS pProgress)
+{
+   HWND hwndLB = GetDlgItem(hwndDir, IDCW_LISTBOX);
+   LPXDTALINK lpLink;
+   LPXDTA lpxdta;
+   LPXDTA lpxdtaFirst;
+   LPXDTA* alpxdta;
+   SIZE_T cbNeeded;
+   INT iCount;
+   DWORD dwItems;
+   DWORD i;
+   BOOL bShown;
+
+   iCount = (INT)SendMessage(hwndLB, LB_GETCOUNT, 0, 0L);
+
+   DirGetItem(hwndLB, 0, &lpxdtaFirst);
+
+   bShown = pProgress->dwShown &&
+            (DWORD)iCount == pProgress->dwShown &&
+            lpxdtaFirst == MemFirst(pProgress->lpStart);
+
+   if (!uSeq) {
+
+      //
+      // Don't leave the listbox pointing into memory about to be freed
+      //
+      if (bShown) {
+
+         ExtSelItemsInvalidate();
+
+         SendMessage(hwndLB, LB_RESETCONTENT, 0, 0L);
+         DirViewFree(hwndDir);
+         SendMessage(hwndLB, LB_INSERTSTRING, 0, 0L);
+      }
+
+      if ((LPXDTALINK)GetWindowLongPtr(hwndDir, GWL_HDTASTREAM) == pProgress->lpStart)
+         SetWindowLongPtr(hwndDir, GWL_HDTASTREAM, 0L);
+
+      return FALSE;
+   }
+
+   //
+   // Same check as DirReadDone
+   //
+   if (((EDIRABORT)GetWindowLongPtr(hwndDir, GWL_HDTAABORT) &
+         (EDIRABORT_READREQUEST|EDIRABORT_WINDOWCLOSE)) ||
+      GetWindowLongPtr(hwndDir, GWL_HDTA)) {
+
+      return FALSE;
+   }
+
+   if (bShown) {
+
+      lpLink = pProgress->lpLinkNext;
+      lpxdta = pProgress->lpxdtaNext;
+      dwItems = pProgress->dwEntries - pProgress->dwShown;
+
+   } else if (iCount == 1 && !lpxdtaFirst) {
+
+      //
+      // Just the "reading" token
+      //
+      SendMessage(hwndLB, LB_DELETESTRING, 0, 0L);
+      DirViewFree(hwndDir);
+
+      SetWindowLongPtr(hwndDir, GWL_HDTASTREAM, (LPARAM)pProgress->lpStart);
+
+      SetLBFont(hwndDir,
+                hwndLB,
+                hFont,
+                GetWindowLongPtr(GetParent(hwndDir), GWL_VIEW),
+                pProgress->lpStart);
+
+      lpLink = pProgress->lpStart;
+      lpxdta = MemFirst(lpLink);
+      dwItems = pProgress->dwEntries;
+
+   } else {
+
+      return FALSE;
+   }
+
+   //
+   // Grow the array (doubling, so a read costs one pass over it) and
+   // tell the listbox the new count
+   //
+   alpxdta = (LPXDTA*)GetWindowLongPtr(hwndDir, GWL_HDTASORTED);
+   cbNeeded = pProgress->dwEntries * sizeof(LPXDTA);
+
+   if (!alpxdta || LocalSize(alpxdta) < cbNeeded) {
+
+      if (alpxdta)
+         cbNeeded = max(cbNeeded, 2 * LocalSize(alpxdta));
+
+      alpxdta = alpxdta ?
+         (LPXDTA*)LocalReAlloc(alpxdta, cbNeeded, LMEM_MOVEABLE) :
+         (LPXDTA*)LocalAlloc(LMEM_FIXED, cbNeeded);
+
+      //
+      // Out of memory: keep what's shown until DirReadDone
+      //
+      if (!alpxdta)
+         return FALSE;
+
+      SetWindowLongPtr(hwndDir, GWL_HDTASORTED, (LONG_PTR)alpxdta);
+   }
 
-   EDIRABORT eDirAbort;
+   ExtSelItemsInvalidate();
 
-   eDirAbort = (EDIRABORT)GetWindowLongPtr(hwndDir, GWL_HDTAABORT);
+   for (i = pProgress->dwEntries - dwItems; dwItems; dwItems--, i++) {
 
-   //
-   // Last chance check for abort
-   //
-   if ((eDirAbort & (EDIRABORT_READREQUEST|EDIRABORT_WINDOWCLOSE)) ||
-      GetWindowLongPtr(hwndDir, GWL_HDTA)) {
+      alpxdta[i] = lpxdta;
 
       //
-      // We don't want it
+      // The entry after the last complete one may not exist yet
       //
-      return NULL;
+      if (dwItems > 1)
+         lpxdta = MemNext(&lpLink, lpxdta);
    }
 
-   GetMDIWindowText(hwndParent, szPath, COUNTOF(szPath));
-   StripFilespec(szPath);
+   SendMessage(hwndLB, WM_SETREDRAW, FALSE, 0L);
+   SendMessage(hwndLB, LB_SETCOUNT, pProgress->dwEntries, 0L);
+   SendMessage(hwndLB, WM_SETREDRAW, TRUE, 0L);
+   InvalidateRect(hwndLB, NULL, FALSE);
 
-   ModifyWatchList(hwndParent,
-                   szPath,
-                   FILE_NOTIFY_CHANGE_FLAGS);
+   return TRUE;
+}
 
-   SetWindowLongPtr(hwndDir, GWL_IERROR, iError);
-   SetWindowLongPtr(hwndDir, GWL_HDTA, (LPARAM)lpStart);
 
-   //
-   // Remove the "reading" token
-   //
-   SendMessage(hwndLB, LB_DELETESTRING, 0, 0);
+/////////////////////////////////////////////////////////////////////
+//
+// Name:     DirReadProbed
+//
+// Synopsis: Fills in the icons and attributes a reader probed for, and
+//           redraws the windows showing the listing
+//
+// lpProbed  the batch posted (see ResolveDirProbes); freed here
+//
+// Return:   VOID
+//
+// Notes:    Main Thread ONLY!  The listings are shared, and this is
+//           the thread that draws them, so this is the one place they
+//           are changed after the read.
+//
+/////////////////////////////////////////////////////////////////////
 
-   FillDirList(hwndDir, lpStart);
+VOID
+DirReadProbed(LPVOID lpProbed)
+{
+   PDIRPROBED pProbed = (PDIRPROBED)lpProbed;
+   LPXDTALINK lpStart = pProbed->lpStart;
+   PPROBERESULT pResult;
+   HWND hwnd;
+   HWND hwndDir;
+   INT i;
 
-   SetWindowLongPtr(hwndDir, GWLP_USERDATA, 0);
+   for (i = 0; i < pProbed->cResults; i++) {
 
-   hwndNext = (HWND)GetWindowLongPtr(hwndDir, GWL_NEXTHWND);
-   if (hwndNext)
-   {
-       SendMessage(hwndDir, FS_TESTEMPTY, 0L, (LPARAM)hwndNext);
+      pResult = &pProbed->aResult[i];
+
+      pResult->lpxdta->dwAttrs |= pResult->dwAttrs;
+
+      if (pResult->bNetDir)
+         pResult->lpxdta->byBitmap = BM_IND_CLOSEDFS;
    }
-   SetWindowLongPtr(hwndDir, GWL_NEXTHWND, 0L);
 
-   //
-   // Refresh display, but don't hit disk
-   //
-   SPC_SET_INVALID(qFreeSpace);
+   for (hwnd = GetWindow(hwndMDIClient, GW_CHILD);
+      hwnd;
+      hwnd = GetWindow(hwnd, GW_HWNDNEXT)) {
 
-   return lpStart;
+      if ((hwndDir = HasDirWindow(hwnd)) &&
+         lpStart == (LPXDTALINK)GetWindowLongPtr(hwndDir, GWL_HDTA)) {
+
+         InvalidateRect(GetDlgItem(hwndDir, IDCW_LISTBOX), NULL, FALSE);
+      }
+   }
+
+   MemDelete(lpStart);
+   LocalFree(pProbed);
 }
 
 
 VOID
 BuildDocumentString()
 {
-   bDirReadRebuildDocString = TRUE;
+   InterlockedExchange(&bDirReadRebuildDocString, TRUE);
    SetEvent(hEventDirRead);
 }
 
@@ -447,6 +1573,11 @@ BuildDocumentStringWorker()
 
    DWORD dwStatus;
 
+   //
+   // Cached listings point into the old buckets
+   //
+   DirCacheFlush();
+
    //
    // Reinitialize the ppDocBucket struct
    //
@@ -581,74 +1712,275 @@ VOID
 DirReadServer(
    LPVOID lpvParm)
 {
-   HWND hwnd;
-   HWND hwndDir;
-   BOOL bRead;
+   PDIRREADREQ pReq = (PDIRREADREQ)lpvParm;
+
+   //
+   // If this fails WFFindFirstBatch allocates a buffer per read instead
+   //
+   pReq->pBatchBuffer = LocalAlloc(LMEM_FIXED, LFNBATCH_BUFFER_SIZE);
 
    while (bDirReadRun) {
 
       WaitForSingleObject(hEventDirRead, INFINITE);
 
-Restart:
-      //
-      // Delete all extra pibs
-      //
-      if (!bDirReadRun)
-         break;
+      while (bDirReadRun) {
 
-      if (bDirReadRebuildDocString) {
-         bDirReadRebuildDocString = FALSE;
-         SendMessage(hwndFrame, FS_REBUILDDOCSTRING, 0, 0L);
+         if (bDirReadRebuildDocString) {
+
+            //
+            // Wait for the other readers to abandon their reads (they
+            // check bDirReadRebuildDocString as they go); only one of
+            // us does the rebuild
+            //
+            AcquireSRWLockExclusive(&SRWLockDirReadDocs);
+
+            if (InterlockedExchange(&bDirReadRebuildDocString, FALSE))
+               SendMessage(hwndFrame, FS_REBUILDDOCSTRING, 0, 0L);
+
+            ReleaseSRWLockExclusive(&SRWLockDirReadDocs);
+         }
+
+         if (!ClaimDirRead(pReq))
+            break;
+
+         //
+         // There may be more windows waiting; let another reader look
+         //
+         SetEvent(hEventDirRead);
+
+         AcquireSRWLockShared(&SRWLockDirReadDocs);
+         CreateDTABlockWorker(pReq);
+         ReleaseSRWLockShared(&SRWLockDirReadDocs);
+
+         ReleaseDirRead(pReq);
+
+         //
+         // The window has the listing; now finish it
+         //
+         if (pReq->lpProbeStart)
+            ResolveDirProbes(pReq);
       }
+   }
+
+   if (pReq->pBatchBuffer) {
+      LocalFree(pReq->pBatchBuffer);
+      pReq->pBatchBuffer = NULL;
+   }
+
+   if (pReq->aProbe) {
+      LocalFree(pReq->aProbe);
+      pReq->aProbe = NULL;
+   }
+
+   //
+   // Wake the next reader so it sees bDirReadRun too
+   //
+   SetEvent(hEventDirRead);
+}
+
+
+/////////////////////////////////////////////////////////////////////
+//
+// Name:     ClaimDirRead
+//
+// Synopsis: Picks the next window to read for a reader
+//
+// pReq      the reader's request; filled in if there is work
+//
+// Return:   TRUE if pReq now describes a read
+//
+// Notes:    The first window in z order with a read request wins;
+//           windows after it wanting the same path and attribs are
+//           taken along as followers.  Remote windows are skipped while
+//           DIRREAD_MAX_REMOTE readers are busy with remote drives, and
+//           windows another reader has are left alone.  Windows which
+//           need no read get their "change display" flag cleared.
+//
+/////////////////////////////////////////////////////////////////////
+
+BOOL
+ClaimDirRead(PDIRREADREQ pReq)
+{
+   HWND hwnd;
+   HWND hwndDir;
+   WCHAR szPath[MAXPATHLEN];
+   DWORD dwAttribs;
+   BOOL bRemote;
+   INT i, j;
+
+   EnterCriticalSection(&CriticalSectionDirRead);
+
+   pReq->hwnd = NULL;
+   pReq->cFollowers = 0;
+
+   for (hwnd = GetWindow(hwndMDIClient, GW_CHILD);
+      hwnd;
+      hwnd = GetWindow(hwnd, GW_HWNDNEXT)) {
+
+      if (!(hwndDir = HasDirWindow(hwnd)))
+         continue;
 
       //
-      // bDirReadAbort means that we need to abort the current read
-      // and rescan from the beginning.  Since we are here right now, we can
-      // clear bDirReadAbort since we are about to rescan anyway.
+      // Being read by another reader?
       //
-      bDirReadAbort = FALSE;
+      for (i = 0; i < cDirReadWorkers; i++) {
+
+         if (aDirReadReq[i].hwndDir == hwndDir)
+            break;
+
+         for (j = 0; j < aDirReadReq[i].cFollowers; j++) {
+            if (aDirReadReq[i].ahwndDirFollower[j] == hwndDir)
+               break;
+         }
+
+         if (j < aDirReadReq[i].cFollowers)
+            break;
+      }
+
+      if (i < cDirReadWorkers) {
+
+         //
+         // Even if it has a new request: that reader may be about to
+         // deliver the old result, which DirReadDone would take if we
+         // had cleared the request.  It's picked up after ReleaseDirRead.
+         //
+         continue;
+      }
+
+      if (GetWindowLongPtr(hwndDir, GWL_HDTA) ||
+         EDIRABORT_READREQUEST != (EDIRABORT)GetWindowLongPtr(hwndDir, GWL_HDTAABORT)) {
+
+         SetWindowLongPtr(hwndDir, GWLP_USERDATA, 0);
+         continue;
+      }
+
+      GetMDIWindowText(hwnd, szPath, COUNTOF(szPath));
+      dwAttribs = (DWORD)GetWindowLongPtr(hwnd, GWL_ATTRIBS);
+
+      if (!pReq->hwnd) {
+
+         bRemote = IsRemoteDrive(DRIVEID(szPath));
+
+         if (bRemote && cDirReadRemote >= DIRREAD_MAX_REMOTE)
+            continue;
+
+         pReq->hwnd = hwnd;
+         pReq->hwndDir = hwndDir;
+         pReq->dwAttribs = dwAttribs;
+         pReq->bRemote = bRemote;
+         pReq->lAbortSeen = lDirReadAbort;
+         lstrcpy(pReq->szPath, szPath);
+
+         if (bRemote)
+            cDirReadRemote++;
+
+      } else if (dwAttribs == pReq->dwAttribs &&
+         pReq->cFollowers < DIRREAD_MAX_FOLLOWERS &&
+         !lstrcmpi(szPath, pReq->szPath)) {
+
+         pReq->ahwndDirFollower[pReq->cFollowers++] = hwndDir;
+
+      } else {
+
+         continue;
+      }
 
       //
-      // Go through z order and update reads.
+      // Claimed: a new request for this window now shows up as an abort
       //
-      for (hwnd = GetWindow(hwndMDIClient, GW_CHILD);
-         hwnd;
-         hwnd = GetWindow(hwnd, GW_HWNDNEXT)) {
+      SetWindowLongPtr(hwndDir, GWL_HDTAABORT, EDIRABORT_NULL);
+   }
 
-         if (hwndDir = HasDirWindow(hwnd)) {
+   LeaveCriticalSection(&CriticalSectionDirRead);
 
-            //
-            // Critical section since GWL_HDTA+HDTAABORT reads must
-            // be atomic.
-            //
-            EnterCriticalSection(&CriticalSectionDirRead);
+   return pReq->hwnd != NULL;
+}
+
+
+VOID
+ReleaseDirRead(PDIRREADREQ pReq)
+{
+   INT i;
 
-            bRead = !GetWindowLongPtr(hwndDir, GWL_HDTA) &&
-                       EDIRABORT_READREQUEST ==
-                          (EDIRABORT)GetWindowLongPtr(hwndDir, GWL_HDTAABORT);
+   //
+   // Followers not served (e.g., the read was abandoned) read on their own
+   //
+   for (i = 0; i < pReq->cFollowers; i++)
+      RequeueDirRead(pReq->ahwndDirFollower[i]);
 
-            LeaveCriticalSection(&CriticalSectionDirRead);
+   EnterCriticalSection(&CriticalSectionDirRead);
 
-            if (bRead) {
-               CreateDTABlockWorker(hwnd, hwndDir);
-               goto Restart;
-            }
-            SetWindowLongPtr(hwndDir, GWLP_USERDATA, 0);
-         }
-      }
+   if (pReq->bRemote)
+      cDirReadRemote--;
+
+   pReq->hwnd = NULL;
+   pReq->hwndDir = NULL;
+   pReq->cFollowers = 0;
+
+   LeaveCriticalSection(&CriticalSectionDirRead);
+
+   //
+   // A remote slot may have opened up
+   //
+   SetEvent(hEventDirRead);
+}
+
+
+//
+// Puts a claimed window back in line if nobody has asked for anything else since
+//
+VOID
+RequeueDirRead(HWND hwndDir)
+{
+   EnterCriticalSection(&CriticalSectionDirRead);
+
+   if (IsWindow(hwndDir) &&
+      !GetWindowLongPtr(hwndDir, GWL_HDTA) &&
+      EDIRABORT_NULL == (EDIRABORT)GetWindowLongPtr(hwndDir, GWL_HDTAABORT)) {
+
+      SetWindowLongPtr(hwndDir, GWL_HDTAABORT, EDIRABORT_READREQUEST);
+   }
+
+   LeaveCriticalSection(&CriticalSectionDirRead);
+
+   SetEvent(hEventDirRead);
+}
+
+
+//
+// Hands the entries read since the last batch to hwndDir; uSeq 0 takes
+// back everything handed over.  Returns FALSE once hwndDir doesn't want more.
+//
+BOOL
+SendDirReadProgress(
+   HWND hwndDir,
+   PDIRREADPROGRESS pProgress,
+   UINT uSeq)
+{
+   BOOL bMore;
+
+   bMore = (BOOL)SendMessage(hwndDir, FS_DIRREADPROGRESS, (WPARAM)uSeq, (LPARAM)pProgress);
+
+   if (bMore) {
+      pProgress->dwShown = pProgress->dwEntries;
+      pProgress->lpxdtaNext = NULL;
    }
+
+   return bMore;
 }
 
 
 LPXDTALINK
 CreateDTABlockWorker(
-   HWND hwnd,
-   HWND hwndDir)
+   PDIRREADREQ pReq)
 {
+   HWND hwnd = pReq->hwnd;
+   HWND hwndDir = pReq->hwndDir;
     LPWSTR pName;
    PDOCBUCKET pDoc, pProgram;
 
-   LFNDTA lfndta;
+   LFNBATCH batch = { 0 };
+   LPLFNENTRY lpEntry;
 
    LPXDTALINK lpLinkLast;
    LPXDTAHEAD lpHead;
@@ -669,8 +2001,22 @@ CreateDTABlockWorker(
 
    DWORD dwAttribs;
    LPXDTALINK lpStart;
+   LPXDTALINK lpShared;
+
+   DIRREADPROGRESS progress;
+   UINT uSeq = 0;
+   BOOL bStream = TRUE;
+   DWORD dwStreamTick = GetTickCount();
+
+   PROBESTAMP stamp;
+   DWORD dwProbe;
+   DWORD dwTag;
+   BOOL bNetDir;
 
    INT iError = 0;
+   INT i;
+
+   pReq->cProbes = 0;
 
    lpStart = MemNew();
 
@@ -678,18 +2024,18 @@ CreateDTABlockWorker(
       goto CDBMemoryErr;
    }
 
+   progress.lpStart = lpStart;
+   progress.dwEntries = 0;
+   progress.dwShown = 0;
+   progress.lpLinkNext = NULL;
+   progress.lpxdtaNext = NULL;
+
    //
-   // Checking abort and reading current dir must be atomic,
-   // since a directory change causes an abort.
+   // The path and attribs were read atomically with claiming the window
+   // (see ClaimDirRead), since a directory change causes an abort.
    //
-   EnterCriticalSection(&CriticalSectionDirRead);
-
-   GetMDIWindowText(hwnd, szPath, COUNTOF(szPath));
-   SetWindowLongPtr(hwndDir, GWL_HDTAABORT, EDIRABORT_NULL);
-
-   LeaveCriticalSection(&CriticalSectionDirRead);
-
-   dwAttribs = GetWindowLongPtr(hwnd, GWL_ATTRIBS);
+   lstrcpy(szPath, pReq->szPath);
+   dwAttribs = pReq->dwAttribs;
 
    //
    // get the drive index assuming path is
@@ -701,12 +2047,12 @@ CreateDTABlockWorker(
    lpHead = MemLinkToHead(lpStart);
    lpLinkLast = lpStart;
 
-   if (!WFFindFirst(&lfndta, szPath, dwAttribs & ATTR_ALL)) {
+   if (!WFFindFirstBatch(&batch, szPath, dwAttribs & ATTR_ALL, pReq->pBatchBuffer, LFNBATCH_BUFFER_SIZE)) {
 
       //
       // Try again!  But first, see if the directory was invalid!
       //
-      if (ERROR_PATH_NOT_FOUND == lfndta.err) {
+      if (ERROR_PATH_NOT_FOUND == batch.err) {
 
          iError = IDS_BADPATHMSG;
          goto InvalidDirectory;
@@ -722,9 +2068,9 @@ CreateDTABlockWorker(
       // break out of this loop if we were returned something
       // other than PATHNOTFOUND
       //
-      if (!WFFindFirst(&lfndta, szPath, dwAttribs & ATTR_ALL)) {
+      if (!WFFindFirstBatch(&batch, szPath, dwAttribs & ATTR_ALL, pReq->pBatchBuffer, LFNBATCH_BUFFER_SIZE)) {
 
-         switch (lfndta.err) {
+         switch (batch.err) {
          case ERROR_PATH_NOT_FOUND:
 
 InvalidDirectory:
@@ -776,7 +2122,7 @@ Fail:
             iError = IDS_NOACCESSDIR;
             {
                 DWORD tag = DecodeReparsePoint(szPath, NULL, szLinkDest, COUNTOF(szLinkDest));
-                if (tag != IO_REPARSE_TAG_RESERVED_ZERO && WFFindFirst(&lfndta, szLinkDest, ATTR_ALL))
+                if (tag != IO_REPARSE_TAG_RESERVED_ZERO && WFFindFirstBatch(&batch, szLinkDest, ATTR_ALL, pReq->pBatchBuffer, LFNBATCH_BUFFER_SIZE))
 		        {
 		        	// TODO: make add routine to share with below
 
@@ -788,15 +2134,15 @@ Fail:
 					lpHead->dwEntries++;
 
 					lpxdta->dwAttrs = ATTR_DIR | ATTR_REPARSE_POINT;
-					lpxdta->ftLastWriteTime = lfndta.fd.ftLastWriteTime;
+					lpxdta->ftLastWriteTime = batch.lpEntry->ftLastWriteTime;
 
 					//
 					// files > 2^63 will come out negative, so tough.
 					// (WIN32_FIND_DATA.nFileSizeHigh is not signed, but
 					// LARGE_INTEGER is)
 					//
-					lpxdta->qFileSize.LowPart = lfndta.fd.nFileSizeLow;
-					lpxdta->qFileSize.HighPart = lfndta.fd.nFileSizeHigh;
+					lpxdta->qFileSize.LowPart = batch.lpEntry->nFileSizeLow;
+					lpxdta->qFileSize.HighPart = batch.lpEntry->nFileSizeHigh;
 
 					lpxdta->byBitmap = BM_IND_CLOSE;
 					lpxdta->pDocB = NULL;
@@ -826,6 +2172,8 @@ Fail:
 					(lpHead->qTotalSize).QuadPart = (lpxdta->qFileSize).QuadPart +
 					                              (lpHead->qTotalSize).QuadPart;					
 
+					WFFindCloseBatch(&batch);
+
 			        iError = 0;
 			        goto Done;
 		        }
@@ -844,7 +2192,7 @@ Fail:
                           szTitle,
                           COUNTOF(szTitle));
 
-               FormatError(TRUE, szText, COUNTOF(szText), lfndta.err);
+               FormatError(TRUE, szText, COUNTOF(szText), batch.err);
 
                MessageBox(hwndDir,
                           szText,
@@ -877,6 +2225,9 @@ Fail:
       if (!lpxdta)
          goto CDBMemoryErr;
 
+      progress.lpLinkNext = lpLinkLast;
+      progress.lpxdtaNext = lpxdta;
+
       //
       // Fill the new DTA with a fudged ".." entry.
       //
@@ -893,29 +2244,42 @@ Fail:
       //
    }
 
-   if (lfndta.err)
+   if (batch.err)
       goto CDBDiskGone;
 
    while (TRUE) {
 
-      pName = lfndta.fd.cFileName;
-
       //
-      // be safe, zero unused DOS dta bits
+      // The entry lives in the batch buffer and is ours to modify; its
+      // attributes are already masked with ATTR_USED
       //
-      lfndta.fd.dwFileAttributes &= ATTR_USED;
+      lpEntry = batch.lpEntry;
+      pName = lpEntry->cFileName;
+
+      stamp.liFileId = lpEntry->liFileId;
+      stamp.ftChangeTime = lpEntry->ftChangeTime;
+      stamp.ftLastWriteTime = lpEntry->ftLastWriteTime;
+
+      dwProbe = 0;
+      dwTag = IO_REPARSE_TAG_RESERVED_ZERO;
+      bNetDir = FALSE;
 
       //
       // if reparse point, figure out whether it is a junction point
-	  if (lfndta.fd.dwFileAttributes & ATTR_REPARSE_POINT)
+      // (once the read is slow, later unless junctions are filtered out)
+	  if (lpEntry->dwFileAttributes & ATTR_REPARSE_POINT)
       {
-          DWORD tag = DecodeReparsePoint(szPath, pName, szLinkDest, COUNTOF(szLinkDest));
+          dwProbe = ProbeFile(szPath, pName, &stamp, PROBE_REPARSE,
+                              uSeq &&
+                              (!(lpEntry->dwFileAttributes & ATTR_DIR) || (dwAttribs & ATTR_JUNCTION)) &&
+                              ReserveDirProbe(pReq),
+                              &dwTag, &bNetDir);
 
-          if (tag == IO_REPARSE_TAG_MOUNT_POINT)
-              lfndta.fd.dwFileAttributes |= ATTR_JUNCTION;
+          if (dwTag == IO_REPARSE_TAG_MOUNT_POINT)
+              lpEntry->dwFileAttributes |= ATTR_JUNCTION;
 
-          else if (tag == IO_REPARSE_TAG_SYMLINK)
-              lfndta.fd.dwFileAttributes |= ATTR_SYMBOLIC;
+          else if (dwTag == IO_REPARSE_TAG_SYMLINK)
+              lpEntry->dwFileAttributes |= ATTR_SYMBOLIC;
 
           else
           {
@@ -928,7 +2292,7 @@ Fail:
       //
 	  pDoc = NULL;
 	  pProgram = NULL;
-      if (!(lfndta.fd.dwFileAttributes & ATTR_DIR)) {
+      if (!(lpEntry->dwFileAttributes & ATTR_DIR)) {
 
          pProgram = IsProgramFile(pName);
          pDoc     = IsDocument(pName);
@@ -943,7 +2307,7 @@ Fail:
          if (!(dwAttribs & ATTR_OTHER) && !(pProgram || pDoc))
             goto CDBCont;
       }
-	  else if (lfndta.fd.dwFileAttributes & ATTR_JUNCTION) {
+	  else if (lpEntry->dwFileAttributes & ATTR_JUNCTION) {
 		  if (!(dwAttribs & ATTR_JUNCTION))
 			  goto CDBCont;
 	  }
@@ -951,7 +2315,7 @@ Fail:
       //
       // figure out the bitmap type here
       //
-      if (lfndta.fd.dwFileAttributes & ATTR_DIR) {
+      if (lpEntry->dwFileAttributes & ATTR_DIR) {
 
          //
          // ignore "."  and ".." directories
@@ -962,11 +2326,15 @@ Fail:
 
         // NOTE: Reparse points are directories
 
-         if (IsNetDir(szPath,pName))
+         dwProbe |= ProbeFile(szPath, pName, &stamp, PROBE_NETDIR,
+                              uSeq && ReserveDirProbe(pReq),
+                              &dwTag, &bNetDir);
+
+         if (bNetDir)
             iBitmap = BM_IND_CLOSEDFS;
          else
             iBitmap = BM_IND_CLOSE;
-      } else if (lfndta.fd.dwFileAttributes & (ATTR_HIDDEN | ATTR_SYSTEM)) {
+      } else if (lpEntry->dwFileAttributes & (ATTR_HIDDEN | ATTR_SYSTEM)) {
          iBitmap = BM_IND_RO;
       } else if (pProgram) {
          iBitmap = BM_IND_APP;
@@ -977,24 +2345,29 @@ Fail:
       }
 
       lpxdta = MemAdd(&lpLinkLast,
-                      lstrlen(pName),
-                      lstrlen(lfndta.fd.cAlternateFileName));
+                      lpEntry->cchFileName,
+                      lpEntry->cchAlternateFileName);
 
       if (!lpxdta)
          goto CDBMemoryErr;
 
       lpHead->dwEntries++;
 
-      lpxdta->dwAttrs = lfndta.fd.dwFileAttributes;
-      lpxdta->ftLastWriteTime = lfndta.fd.ftLastWriteTime;
+      if (!progress.lpxdtaNext) {
+         progress.lpLinkNext = lpLinkLast;
+         progress.lpxdtaNext = lpxdta;
+      }
+
+      lpxdta->dwAttrs = lpEntry->dwFileAttributes;
+      lpxdta->ftLastWriteTime = lpEntry->ftLastWriteTime;
 
       //
       // files > 2^63 will come out negative, so tough.
-      // (WIN32_FIND_DATA.nFileSizeHigh is not signed, but
+      // (LFNENTRY.nFileSizeHigh is not signed, but
       // LARGE_INTEGER is)
       //
-      lpxdta->qFileSize.LowPart = lfndta.fd.nFileSizeLow;
-      lpxdta->qFileSize.HighPart = lfndta.fd.nFileSizeHigh;
+      lpxdta->qFileSize.LowPart = lpEntry->nFileSizeLow;
+      lpxdta->qFileSize.HighPart = lpEntry->nFileSizeHigh;
 
       lpxdta->byBitmap = iBitmap;
       lpxdta->pDocB = pDoc;			// even if program, use extension list for icon to display
@@ -1006,8 +2379,19 @@ Fail:
       if (!bCasePreserved)
          lpxdta->dwAttrs |= ATTR_LOWERCASE;
 
-      lstrcpy(MemGetFileName(lpxdta), pName);
-      lstrcpy(MemGetAlternateFileName(lpxdta), lfndta.fd.cAlternateFileName);
+      CopyMemory(MemGetFileName(lpxdta), pName, ByteCountOf(lpEntry->cchFileName + 1));
+      CopyMemory(MemGetAlternateFileName(lpxdta), lpEntry->cAlternateFileName,
+                 ByteCountOf(lpEntry->cchAlternateFileName + 1));
+
+      //
+      // Put off (ReserveDirProbe made room)
+      //
+      if (dwProbe) {
+         pReq->aProbe[pReq->cProbes].lpxdta = lpxdta;
+         pReq->aProbe[pReq->cProbes].dwProbe = dwProbe;
+         pReq->aProbe[pReq->cProbes].stamp = stamp;
+         pReq->cProbes++;
+      }
 
       lpHead->dwTotalCount++;
       (lpHead->qTotalSize).QuadPart = (lpxdta->qFileSize).QuadPart +
@@ -1016,18 +2400,31 @@ Fail:
 CDBCont:
 
       if (bDirReadRebuildDocString) {
+
+         //
+         // Read it again once the document list is rebuilt
+         //
+         RequeueDirRead(hwndDir);
 Abort:
-         WFFindClose(&lfndta);
+         WFFindCloseBatch(&batch);
+
+         if (uSeq)
+            SendDirReadProgress(hwndDir, &progress, 0);
+
          MemDelete(lpStart);
 
          return NULL;
       }
 
 
-      if (bDirReadAbort) {
+      //
+      // Only look at our window when some window was aborted
+      //
+      if (pReq->lAbortSeen != lDirReadAbort) {
 
          EnterCriticalSection(&CriticalSectionDirRead);
 
+         pReq->lAbortSeen = lDirReadAbort;
          bAbort = ((GetWindowLongPtr(hwndDir,
                                   GWL_HDTAABORT) & (EDIRABORT_WINDOWCLOSE|
                                                     EDIRABORT_READREQUEST)) ||
@@ -1039,12 +2436,24 @@ Abort:
             goto Abort;
       }
 
-      if (!WFFindNext(&lfndta)) {
+      //
+      // Slow read: let the window show what we have so far
+      //
+      if (bStream && lpHead->dwEntries > progress.dwShown &&
+         GetTickCount() - dwStreamTick >= (DWORD)(uSeq ? DIRREAD_STREAM_INTERVAL : DIRREAD_STREAM_DELAY)) {
+
+         progress.dwEntries = lpHead->dwEntries;
+         bStream = SendDirReadProgress(hwndDir, &progress, ++uSeq);
+
+         dwStreamTick = GetTickCount();
+      }
+
+      if (!WFFindNextEntry(&batch)) {
          break;
       }
    }
 
-   WFFindClose(&lfndta);
+   WFFindCloseBatch(&batch);
 
 CDBDiskGone:
 
@@ -1058,7 +2467,7 @@ CDBDiskGone:
 
 CDBMemoryErr:
 
-   WFFindClose(&lfndta);
+   WFFindCloseBatch(&batch);
 
    MyMessageBox(hwndFrame,
                 IDS_OOMTITLE,
@@ -1075,10 +2484,26 @@ CDBMemoryErr:
 Done:
 
    if (iError) {
+
+      if (uSeq)
+         SendDirReadProgress(hwndDir, &progress, 0);
+
       MemDelete(lpStart);
       lpStart = NULL;
    }
 
+   //
+   // Columns for sorting, while we are still the only one with lpStart
+   //
+   if (lpStart)
+      MemLinkToHead(lpStart)->pCols = ColsBuild(lpStart);
+
+   //
+   // Keep it for the probes put off (see ResolveDirProbes)
+   //
+   if (lpStart && pReq->cProbes)
+      pReq->lpProbeStart = MemAddRef(lpStart);
+
    SetLBFont(hwndDir,
              GetDlgItem(hwndDir, IDCW_LISTBOX),
              hFont,
@@ -1088,11 +2513,45 @@ Done:
    R_Space(drive);
    U_Space(drive);
 
+   //
+   // Share lpStart with the followers before it goes to hwndDir (which
+   // may drop its reference at any time after).  Each one that takes
+   // it keeps the reference we give it.
+   //
+   for (i = 0; i < pReq->cFollowers; ) {
+
+      lpShared = MemAddRef(lpStart);
+
+      SetLBFont(pReq->ahwndDirFollower[i],
+                GetDlgItem(pReq->ahwndDirFollower[i], IDCW_LISTBOX),
+                hFont,
+                GetWindowLongPtr(GetParent(pReq->ahwndDirFollower[i]), GWL_VIEW),
+                lpShared);
+
+      if (SendMessage(pReq->ahwndDirFollower[i],
+                      FS_DIRREADDONE,
+                      (WPARAM)iError,
+                      (LPARAM)lpShared) != (LRESULT)lpShared) {
+
+         MemDelete(lpShared);
+      }
+
+      //
+      // Served; drop it from the list (other readers look at it)
+      //
+      EnterCriticalSection(&CriticalSectionDirRead);
+      pReq->ahwndDirFollower[i] = pReq->ahwndDirFollower[--pReq->cFollowers];
+      LeaveCriticalSection(&CriticalSectionDirRead);
+   }
+
    if (SendMessage(hwndDir,
                    FS_DIRREADDONE,
                    (WPARAM)iError,
                    (LPARAM)lpStart) != (LRESULT)lpStart) {
 
+      if (uSeq)
+         SendDirReadProgress(hwndDir, &progress, 0);
+
       MemDelete(lpStart);
       lpStart = NULL;
    }
@@ -1122,20 +2581,23 @@ Done:
 // Effects:
 //
 //
-// Notes:    !! BUGBUG !! Check if this is reentrant !!
+// Notes:    Called by the readers at the same time; GetNetDirType
+//           keeps the drive's share check flags.  Results are kept in
+//           the probe cache (see ProbeFile).
 //
 /////////////////////////////////////////////////////////////////////
 
 BOOL
-IsNetDir(LPWSTR pPath, LPWSTR pName)
+IsNetDir(LPWSTR pPath, LPWSTR pName, PBOOL pbFailed)
 {
-   DWORD dwType;
    WCHAR szFullPath[2*MAXPATHLEN];
 
    DRIVE drive = DRIVEID(pPath);
 
-   if (!WAITNET_TYPELOADED)
+   if (!WAITNET_TYPELOADED) {
+      *pbFailed = TRUE;
       return FALSE;
+   }
 
    lstrcpy(szFullPath, pPath);
    StripFilespec(szFullPath);
@@ -1150,20 +2612,7 @@ IsNetDir(LPWSTR pPath, LPWSTR pName)
    // for this drive, since the fail is assumed always due to
    // insufficient privilege.
    //
-   if (aDriveInfo[drive].bShareChkFail ||
-       !(WNetGetDirectoryType(szFullPath, &dwType,
-                              !aDriveInfo[drive].bShareChkTried) == WN_SUCCESS))
-   {
-      dwType = 0;
-
-      //
-      // Remind ourselves that we failed, so don't try again on this drive.
-      //
-      aDriveInfo[drive].bShareChkFail = TRUE;
-   }
-
-   aDriveInfo[drive].bShareChkTried = TRUE;
-   return dwType;
+   return GetNetDirType(drive, szFullPath, pbFailed) != 0;
 }
 
 typedef struct _REPARSE_DATA_BUFFER {
@@ -123,7 +123,7 @@ DSSetSelection(
 
    for (i = 0; i < iMac; i++) {
 
-      if (SendMessage(hwndLB, LB_GETTEXT, i, (LPARAM)&lpxdta) == LB_ERR)
+      if (DirGetItem(hwndLB, i, &lpxdta) == LB_ERR)
          return;
 
       if (!lpxdta || lpxdta->dwAttrs & ATTR_PARENT)
@@ -335,7 +335,7 @@ DSDragLoop(HWND hwndLB, WPARAM wParam, LPDROPSTRUCT lpds)
          //
          // are we over a directory entry?
          //
-         SendMessage(hwndLB, LB_GETTEXT, (WPARAM)(lpds->dwControlData), (LPARAM)&lpxdta);
+         DirGetItem(hwndLB, (INT)lpds->dwControlData, &lpxdta);
 
          if (!(lpxdta && lpxdta->dwAttrs & ATTR_DIR)) {
 
@@ -372,7 +372,7 @@ DSDragLoop(HWND hwndLB, WPARAM wParam, LPDROPSTRUCT lpds)
          //
          // Are we over an Executable?
          //
-         SendMessage(lpds->hwndSink, LB_GETTEXT, (WORD)(lpds->dwControlData), (LPARAM)(LPTSTR)&lpxdta);
+         DirGetItem(lpds->hwndSink, (WORD)(lpds->dwControlData), &lpxdta);
 
          if (lpxdta && IsProgramFile(MemGetFileName(lpxdta))) {
             goto DragLoopCont;
@@ -488,10 +488,7 @@ ClearStatus:
    //
    // We only put rectangles around directories and program items.
    //
-   if (SendMessage(hwndLB,
-                   LB_GETTEXT,
-                   iItem,
-                   (LPARAM)(LPTSTR)&lpxdta) == LB_ERR || !lpxdta) {
+   if (DirGetItem(hwndLB, iItem, &lpxdta) == LB_ERR || !lpxdta) {
       return FALSE;
    }
 
@@ -886,10 +883,7 @@ DSTrackPoint(
       // There is only one thing selected.
       //  Figure out which cursor to use.
 
-      if (SendMessage(hwndLB,
-                      LB_GETTEXT,
-                      wParam,
-                      (LPARAM)&lpxdta) == LB_ERR || !lpxdta) {
+      if (DirGetItem(hwndLB, (INT)wParam, &lpxdta) == LB_ERR || !lpxdta) {
          return 1;
       }
 
@@ -1073,10 +1067,7 @@ DSDropObject(
    if (!lpStart)
       goto NormalMoveCopy;
 
-   if (SendMessage(hwndLB,
-                   LB_GETTEXT,
-                   dwSelSink,
-                   (LPARAM)&lpxdta) == LB_ERR || !lpxdta) {
+   if (DirGetItem(hwndLB, (INT)dwSelSink, &lpxdta) == LB_ERR || !lpxdta) {
       goto NormalMoveCopy;
    }
 
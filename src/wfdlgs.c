@@ -564,6 +564,10 @@ NewFont()
       return;
    }
 
+   // widths measured in the old font are no use now
+
+   WidthCacheFlush();
+
    // recalc all the metrics for the new font
 
    hdc = GetDC(NULL);
@@ -1291,7 +1291,7 @@ InitPropertiesDialog(
          //
          // get info from either dir or search window
          //
-         SendMessage(hwndLB, LB_GETTEXT, i, (LPARAM)&lpxdta);
+         DirGetItem(hwndLB, i, &lpxdta);
          dwAttrib = lpxdta->dwAttrs;
 
          //
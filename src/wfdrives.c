@@ -755,9 +755,9 @@ DrivesWndProc(HWND hWnd, UINT wMsg, WPARAM wParam, LPARAM lParam)
                       hwndLB = GetDlgItem (hwndDir, IDCW_LISTBOX);
                       if (hwndLB && !bChangeDisplay)
                       {
-                         PVOID pv;
-                         SendMessage (hwndLB, LB_GETTEXT, 0, (LPARAM) &pv);
-                         bDir = pv != NULL;
+                         LPXDTA lpxdta;
+                         DirGetItem(hwndLB, 0, &lpxdta);
+                         bDir = lpxdta != NULL;
                       }
                    }
 
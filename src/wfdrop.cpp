@@ -394,8 +394,7 @@ namespace {
 
 				if (this->m_iItemSelected != -1)
 				{
-					SendMessageW(hwndLB, LB_GETTEXT, this->m_iItemSelected,
-						(LPARAM)(LPTSTR)&lpxdta);
+					DirGetItem(hwndLB, this->m_iItemSelected, &lpxdta);
 
 					AddBackslash(szDest);
 					lstrcat(szDest, MemGetFileName(lpxdta));
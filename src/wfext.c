@@ -97,10 +97,7 @@ GetExtSelection(
 
       for (i=0, uSel=0; i < uExtSelItems; i++) {
 
-         SendMessage(hwndLB,
-                     LB_GETTEXT,
-                     lpExtSelItems[i],
-                     (LPARAM)&lplpxdtaExtSelItems[i]);
+         DirGetItem(hwndLB, lpExtSelItems[i], &lplpxdtaExtSelItems[i]);
       }
 
       //
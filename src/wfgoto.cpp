@@ -10,45 +10,181 @@
 ********************************************************************/
 
 #include <sstream>
+#include "Arena.h"
+#include "BagOTrie.h"
 #include "BagOValues.h"
 #include <iterator>
 #include <atomic>
+#include <thread>
+#include <memory>
+#include <unordered_map>
+#include <unordered_set>
 #include <deque>
+#include <queue>
+#include <mutex>
+#include <chrono>
+#include <condition_variable>
 #include <string_view>
 #include <PathCch.h>
 #include "winfile.h"
 #include "treectl.h"
 #include "lfn.h"
+#include "dbg.h"
 
 namespace {
-	class dnode : public DNODE {
-	public:
-		dnode(PDNODE pParentNode, WCHAR *szName, DWORD dwAttribs)
-		{
-			this->pParent = pParentNode;
-			this->nLevels = pParentNode ? (pParentNode->nLevels + (BYTE)1) : (BYTE)0;
-			this->wFlags = (BYTE)NULL;
-			this->dwNetType = (DWORD)-1;
-			this->dwAttribs = dwAttribs;
-			this->dwExtent = (DWORD)-1;
-		}
+	// pre-order position of a node and the end of its subtree, so that ordering and ancestor tests
+	// are integer comparisons; see LabelTree
+	struct node_interval {
+		DWORD iFirst;
+		DWORD iEnd;				// one past the last node in the subtree
+	};
+	typedef std::unordered_map<PDNODE, node_interval> node_intervals;
+
+	struct labelled_node {
+		node_interval interval;
+		PDNODE pNode;
+	};
+
+	typedef std::vector<std::shared_ptr<const BagOTrie<PDNODE>>> trie_runs;
+	typedef std::unordered_set<PDNODE> node_set;
+	typedef std::vector<std::wstring> goto_history;		// directories visited, newest first (see GetGotoHistory)
+
+	// What queries see of a bag.  A view never changes once published: a change to the directories,
+	// a run published by a scan in progress and a compaction each publish a new one, so a query
+	// reads one consistent state without taking a lock.  Views share the parts which didn't change.
+	struct bag_view {
+		std::shared_ptr<const BagOTrie<PDNODE>> pTrie;				// the trie the last compaction built; null for the bag's BagOCDrive
+		BagOValues<PDNODE>::TSnapshot overlay;						// keys of the directories added since the trie was built
+		std::shared_ptr<const std::vector<PDNODE>> overlayNodes;	// ... those directories, in the order added
+		std::shared_ptr<const node_set> removedNodes;				// directories removed since (their subtrees are hidden too)
+		std::shared_ptr<const trie_runs> segments;					// runs of the scan in progress, for a partial bag; else null
+		std::shared_ptr<const node_intervals> intervals;			// labels of the trie's nodes; null until labelled
 	};
-	std::atomic_uint32_t g_driveScanEpoc;				// incremented when a refresh is requested; old bags are discarded; scans are aborted if epoc changes		
-	struct values_bag {
-		std::deque<PDNODE> allNodes; // holds the values from the scan per g_driveScanEpoc
-		BagOValues<PDNODE> BagOCDrive; // holds the nodes we created to make freeing them simpler (e.g., because some are reused)
 
+	struct values_bag {
+		std::deque<PDNODE> allNodes; // holds the values from the scan per scan epoc of the shard
+		Arena nodeArena;			// memory of the nodes in allNodes; freed all at once with the bag
+		BagOTrie<PDNODE> BagOCDrive; // keys of the scan (or snapshot); not changed once the bag is published
+		LPVOID pSnapshotView = nullptr; // mapped GOTO-<root>.IDX the trie of BagOCDrive points into, if loaded from a snapshot
+
+		// Changes reported through ChangeFileSystem since the scan: directories added go into a small
+		// sorted overlay, removed directories are hidden (with their subtrees) until compaction folds
+		// both into a new trie.  Removed nodes stay allocated since queries may still hold them.
+		SpinLock overlayLock;				// serializes the writers below (and allNodes and nodeArena once published); queries don't take it
+		BagOValues<PDNODE> overlay;			// builds the overlay of the views
+		bool fCompacting = false;
+
+		// When there is no complete bag yet, a partial one is published while the scan runs: workers
+		// append sorted runs of the keys found so far and queries merge them.
+		bool fPartial = false;
+		std::shared_ptr<values_bag> pNodeOwner;		// the bag being scanned; it owns the nodes in the runs
+
+		const std::atomic_uint32_t* pScanEpoc = nullptr;	// of the shard this bag belongs to; rescans of subtrees stop when it changes
+
+		values_bag();
 		~values_bag()
 		{
-			// free all PDNODE in BagOValues
-			for (PDNODE p : allNodes)
-			{
-				LocalFree(p);
-			}
+			if (pSnapshotView)
+				UnmapViewOfFile(pSnapshotView);
+		}
+
+		// the state to run one query on; the nodes it returns belong to this bag
+		std::shared_ptr<const bag_view> GetView() const
+		{
+			return std::atomic_load(&pView);
 		}
+
+		std::vector<PDNODE> Retrieve(const bag_view& view, const std::wstring_view query, bool fPrefix, unsigned maxResults) const;
+		std::vector<PDNODE> RetrieveSubsequence(const bag_view& view, const std::wstring_view query, unsigned maxResults) const;
+		PDNODE FindDirectoryNode(const bag_view& view, LPCTSTR szPath) const;
+		VOID AddDirectoryNode(LPCTSTR szPath, std::shared_ptr<values_bag> pSelf);
+		VOID RemoveDirectoryNode(LPCTSTR szPath);
+		VOID AddSegment(std::shared_ptr<const BagOTrie<PDNODE>> pRun);
+		VOID Label();
+		BOOL NeedsCompaction();
+		VOID Compact();
+
+	private:
+		std::shared_ptr<const bag_view> pView;	// use std::atomic_load/atomic_store; replaced under overlayLock
+
+		const BagOTrie<PDNODE>& Trie(const bag_view& view) const;
+		BOOL IsRemoved(const bag_view& view, PDNODE pNode) const;
+		VOID AddOverlayNodes(const std::vector<PDNODE>& nodes);
+		VOID Publish(std::shared_ptr<bag_view> pNext);
+	};
+
+	// a directory created (or renamed to) or removed (or renamed from), as ChangeFileSystem reports it
+	struct goto_change {
+		bool fAdd;
+		std::wstring path;
+	};
+
+	// One index per configured root (GotoRoots in winfile.ini), each scanned on its own thread so
+	// that slow or removable roots don't hold up the others; queries fan out over all of them.
+	struct goto_shard {
+		std::wstring root;						// c:\ or \\server\share\ (always with the trailing backslash)
+		size_t cMaxNodes;						// memory budget, in directories
+		std::atomic_uint32_t scanEpoc{ 0 };		// incremented when a refresh is requested; old bags are discarded; scans are aborted if epoc changes
+		std::shared_ptr<values_bag> pBag;		// use std::atomic_load/atomic_store; holders of a reference keep an old bag alive
+
+		// A scan may read a directory's parent before the directory changes, so the changes made
+		// while scans run are kept and replayed on the bag a scan publishes.
+		std::mutex changesLock;					// held while a change is applied and while a scan publishes its bag
+		unsigned cScans = 0;					// scans running; changes are kept while there are any
+		std::vector<goto_change> changes;		// in the order made
+	};
+
+	std::atomic_uint32_t g_cScansRunning;		// shards being scanned; the status bar says so while this isn't 0
+
+	constexpr unsigned MAX_SCAN_WORKERS = 8;			// the scan is mostly I/O bound; more threads just contend
+	constexpr size_t GOTO_OVERLAY_COMPACT = 4096;		// overlay adds + removes before they are folded into the trie
+	constexpr size_t GOTO_SEGMENT_SIZE = 4096;			// directories a worker finds before publishing them to a partial bag
+	constexpr size_t GOTO_LOCAL_MAX_NODES = 4000000;	// directories indexed per root on a fixed drive
+	constexpr size_t GOTO_REMOTE_MAX_NODES = 250000;	// ... on network, removable and other drives
+
+	// Ranked Go To: candidates per word are gathered generously and scored; only the best
+	// GOTO_RANK_SHOWN are kept (in a bounded heap), so the cost doesn't depend on how many directories match.
+	constexpr unsigned GOTO_RANK_CANDIDATES = 20000;
+	constexpr unsigned GOTO_RANK_SHOWN = 10;
+	constexpr size_t GOTO_LATENCY_SAMPLES = 4096;		// per dialog; only the latest are kept
+	constexpr int SCORE_EXACT = 100;				// name is the word
+	constexpr int SCORE_PREFIX = 80;				// name starts with the word
+	constexpr int SCORE_WORD = 60;					// a word within the name starts with the word
+	constexpr int SCORE_SUBSTRING = 40;				// word is somewhere in the name
+	constexpr int SCORE_SUBSEQUENCE = 20;			// chars of the word appear in order in the name
+	constexpr int SCORE_DEPTH_MAX = 20;				// shallower directories are more likely targets
+	constexpr int SCORE_RECENT_MAX = 40;			// most recently visited directory; older ones get less
+
+	// Layout of the Go To snapshot file (GOTO-<root>.IDX).  Sections follow the header, each 4 byte aligned.
+	// All references are indices or offsets from the start of the file, so the file can be mapped
+	// at any address and the trie sections are used in place.
+	constexpr DWORD GOTO_SNAPSHOT_SIGNATURE = 0x49544F47;	// "GOTI"
+	constexpr DWORD GOTO_SNAPSHOT_VERSION = 2;				// bump when the layout below, BagOTrie::TrieNode or the key folding (LowerCaseBuff) changes
+	constexpr DWORD GOTO_SNAPSHOT_NO_PARENT = (DWORD)-1;
+
+	struct snapshot_header {
+		DWORD dwSignature;
+		DWORD dwVersion;
+		DWORD cbFile;
+		DWORD cNodes;					// snapshot_node entries
+		DWORD cchNames;					// chars in the name blob
+		DWORD cTrieNodes;				// BagOTrie::TrieNode entries
+		DWORD cchLabels;				// chars in the trie label arena
+		DWORD cPostings;				// node indices in key order
+		DWORD dwNodesOffset;
+		DWORD dwNamesOffset;
+		DWORD dwTrieNodesOffset;
+		DWORD dwLabelsOffset;
+		DWORD dwPostingsOffset;
 	};
 
-	std::atomic<values_bag*> g_valuesBag;
+	struct snapshot_node {
+		DWORD iParent;					// GOTO_SNAPSHOT_NO_PARENT for the root
+		DWORD nLevels;
+		DWORD dwAttribs;
+		DWORD ichName;					// name in the name blob; not null terminated
+		DWORD cchName;
+	};
 
 	
 }
@@ -77,7 +213,7 @@ static int ParentOrdering(const PDNODE& a, const PDNODE& b)
 				return wCmp;
 		}
 
-		wCmp = lstrcmpi(a->szName, b->szName);
+		wCmp = CompareOrdinalNoCase(a->szName, b->szName);
 		if (wCmp < 0)
 			wCmp = -2;
 		else if (wCmp > 0)
@@ -117,26 +253,100 @@ static int ParentOrdering(const PDNODE& a, const PDNODE& b)
 	}
 }
 
+// interval version of ParentOrdering; same results for labelled nodes
+static int IntervalOrdering(const labelled_node& a, const labelled_node& b)
+{
+	if (a.interval.iFirst == b.interval.iFirst)
+		return 0;
+
+	if (a.interval.iFirst < b.interval.iFirst)
+		return (b.interval.iFirst < a.interval.iEnd) ? -1 : -2;
+
+	return (a.interval.iFirst < b.interval.iEnd) ? 1 : 2;
+}
+
+// labels nodes (a whole tree: parents before or with their children) in pre-order with siblings in
+// name order, i.e., in the order ParentOrdering sorts them
+static std::shared_ptr<const node_intervals> LabelTree(std::vector<PDNODE> nodes)
+{
+	auto pIntervals = std::make_shared<node_intervals>();
+	pIntervals->reserve(nodes.size());
+
+	// group children by parent (roots first since their parent is null)
+	std::sort(nodes.begin(), nodes.end(), [](PDNODE a, PDNODE b) {
+		if (a->pParent != b->pParent)
+			return std::less<PDNODE>()(a->pParent, b->pParent);
+
+		return CompareOrdinalNoCase(a->szName, b->szName) < 0;
+	});
+
+	std::unordered_map<PDNODE, std::pair<size_t, size_t>> children;
+	for (size_t i = 0; i < nodes.size(); )
+	{
+		size_t iEnd = i + 1;
+		while (iEnd < nodes.size() && nodes[iEnd]->pParent == nodes[i]->pParent)
+			iEnd++;
+
+		children[nodes[i]->pParent] = std::make_pair(i, iEnd);
+		i = iEnd;
+	}
+
+	// depth first; the second of each pair is true when the node's subtree is done
+	std::vector<std::pair<PDNODE, bool>> stack;
+	auto PushChildren = [&stack, &children, &nodes](PDNODE pParent) {
+		auto itr = children.find(pParent);
+		if (itr == children.end())
+			return;
+
+		for (size_t i = itr->second.second; i-- > itr->second.first; )
+			stack.emplace_back(nodes[i], false);
+	};
+
+	DWORD iNext = 0;
+	PushChildren(nullptr);
+	while (!stack.empty())
+	{
+		auto item = stack.back();
+		stack.pop_back();
+
+		if (item.second)
+		{
+			(*pIntervals)[item.first].iEnd = iNext;
+			continue;
+		}
+
+		(*pIntervals)[item.first] = node_interval{ iNext++, 0 };
+		stack.emplace_back(item.first, true);
+		PushChildren(item.first);
+	}
+
+	return pIntervals;
+}
+
 static std::vector<PDNODE> FilterBySubtree(std::vector<PDNODE> const& parents, std::vector<PDNODE>  const& children)
 {
 	std::vector<PDNODE> results;
+	std::unordered_set<PDNODE> parentSet(std::cbegin(parents), std::cend(parents));
 
 	// for each child, if parent in parents, return
 	std::copy_if(std::cbegin(children),
 				 std::cend(children),
 				 std::back_inserter(results),
-				 [&parents](auto const& child)
+				 [&parentSet](auto const& child)
 	{
 		PDNODE parent = child->pParent;
-		return (std::find(std::cbegin(parents), std::cend(parents), parent) != std::cend(parents));
+		return parentSet.count(parent) != 0;
 	});
 
 	return results;
 }
 
-static std::vector<PDNODE> TreeIntersection(std::vector<std::vector<PDNODE>>& trees)
+// merges the sorted trees keeping the deepest node of each path found in all of them; ordering is
+// ParentOrdering or IntervalOrdering
+template <class TNode, class TOrdering>
+static std::vector<TNode> MergeTrees(std::vector<std::vector<TNode>>& trees, TOrdering ordering)
 {
-	std::vector<PDNODE> result;
+	std::vector<TNode> result;
 
 	if (trees.empty())
 		return result;
@@ -150,8 +360,8 @@ static std::vector<PDNODE> TreeIntersection(std::vector<std::vector<PDNODE>>& tr
 	{
 		std::sort(tree.begin(), tree.end(),
 			// returns true if a strictly less than b
-			[](const auto & a, const auto & b) {
-			return ParentOrdering(a, b) < 0;
+			[&ordering](const auto & a, const auto & b) {
+			return ordering(a, b) < 0;
 		});
 		if (tree.size() > maxOutput)
 			maxOutput = tree.size();
@@ -163,13 +373,13 @@ static std::vector<PDNODE> TreeIntersection(std::vector<std::vector<PDNODE>>& tr
 		return trees.at(0);
 
 	// use up to two outputs and switch back and forth; lastOutput is last number output 
-	std::vector<PDNODE> outputA(maxOutput);
-	std::vector<PDNODE> outputB(maxOutput);
-	std::vector<PDNODE> *combined = nullptr;
+	std::vector<TNode> outputA(maxOutput);
+	std::vector<TNode> outputB(maxOutput);
+	std::vector<TNode> *combined = nullptr;
 	size_t lastOutput = 0;
 
 	// first is left side of merge; changes each time through the loop
-	std::vector<PDNODE>* first = nullptr;
+	std::vector<TNode>* first = nullptr;
 
 	// for all other result sets, merge
 	for (int i = 1; i < count; i++)
@@ -209,10 +419,10 @@ static std::vector<PDNODE> TreeIntersection(std::vector<std::vector<PDNODE>>& tr
 		// while results in both sets
 		while (first1 < last1 && first2 < last2)
 		{
-			PDNODE& p1 = first->at(first1);
-			PDNODE& p2 = second->at(first2);
+			TNode& p1 = first->at(first1);
+			TNode& p2 = second->at(first2);
 
-			int wCmp = ParentOrdering(p1, p2);
+			int wCmp = ordering(p1, p2);
 			switch (wCmp)
 			{
 			case -2:
@@ -257,10 +467,47 @@ static std::vector<PDNODE> TreeIntersection(std::vector<std::vector<PDNODE>>& tr
 	return (*combined);
 }
 
-static PDNODE CreateNode(PDNODE pParentNode, const std::wstring_view szName, DWORD dwAttribs)
+// pIntervals, if given, labels the nodes of the bag the trees came from
+static std::vector<PDNODE> TreeIntersection(std::vector<std::vector<PDNODE>>& trees, const node_intervals* pIntervals)
+{
+	if (pIntervals != nullptr)
+	{
+		std::vector<std::vector<labelled_node>> labelled(trees.size());
+		bool fLabelled = true;
+		for (size_t i = 0; i < trees.size() && fLabelled; i++)
+		{
+			labelled[i].reserve(trees[i].size());
+			for (PDNODE p : trees[i])
+			{
+				auto itr = pIntervals->find(p);
+				if (itr == pIntervals->end())
+				{
+					// added since labelling (e.g., in the overlay); use the slow ordering
+					fLabelled = false;
+					break;
+				}
+
+				labelled[i].push_back(labelled_node{ itr->second, p });
+			}
+		}
+
+		if (fLabelled)
+		{
+			std::vector<PDNODE> result;
+			for (auto& item : MergeTrees(labelled, IntervalOrdering))
+				result.push_back(item.pNode);
+
+			return result;
+		}
+	}
+
+	return MergeTrees(trees, ParentOrdering);
+}
+
+static PDNODE CreateNode(Arena& arena, PDNODE pParentNode, const std::wstring_view szName, DWORD dwAttribs)
 {
 
-	auto pNode = static_cast<PDNODE>(LocalAlloc(LPTR, sizeof(DNODE) + ByteCountOf(szName.size())));
+	auto pNode = static_cast<PDNODE>(arena.Allocate(sizeof(DNODE) + ByteCountOf(szName.size()), alignof(DNODE)));
 	if (!pNode)
 	{
 		return nullptr;
@@ -273,7 +520,9 @@ static PDNODE CreateNode(PDNODE pParentNode, const std::wstring_view szName, DWO
 	pNode->dwAttribs = dwAttribs;
 	pNode->dwExtent = (DWORD)-1;
 
-	StringCchCopyW(pNode->szName, szName.size(), szName.data());
+	// szName need not be null terminated; DNODE already has room for the terminator
+	CopyMemory(pNode->szName, szName.data(), ByteCountOf(szName.size()));
+	pNode->szName[szName.size()] = CHAR_NULL;
 
 	if (pParentNode)
 		pParentNode->wFlags |= TF_HASCHILDREN;      // mark the parent
@@ -298,212 +547,1786 @@ auto SplitIntoWords(LPCTSTR szText)
 	return words;
 }
 
-static BOOL BuildDirectoryBagOValues(values_bag& result_bag, LPCTSTR szRoot, PDNODE pNodeParent, DWORD scanEpoc)
-{
-	LFNDTA lfndta;
-	WCHAR szPath[MAXPATHLEN];
-	LPWSTR szEndPath;
-	lstrcpy(szPath, szRoot);
-	if (lstrlen(szPath) + 1 >= std::size(szPath))
+namespace {
+	// Scans a drive with a pool of worker threads.  Each worker owns a shard: a queue of directories
+	// still to be read plus the nodes and keys found so far.  A worker reads from the back of its
+	// own queue and, when that is empty, steals from the front of another worker's queue; with
+	// nothing to steal it sleeps until someone queues more.  The shards are merged into the result
+	// bag once all workers are done.
+	class directory_scanner
 	{
-		// path too long
-		return TRUE;
-	}
-
-	PathCchAddBackslash(szPath, std::size(szPath));
-	szEndPath = szPath + lstrlen(szPath);
+		struct scan_item {
+			PDNODE pNode;
+			std::wstring path;			// full path of pNode including trailing backslash
+		};
+
+		struct scan_shard {
+			SpinLock lock;					// protects pending
+			std::deque<scan_item> pending;
+			values_bag bag;
+			BagOTrie<PDNODE> segment;		// keys not yet published, when scanning for a partial bag
+			size_t cSegment = 0;			// directories in segment
+		};
+
+		std::vector<std::unique_ptr<scan_shard>> m_shards;
+		std::atomic_size_t m_outstanding;	// directories queued or being read
+		std::atomic_size_t m_queued;		// directories queued and not taken yet
+		std::atomic_bool m_aborted;
+		std::mutex m_idleLock;				// idle workers sleep on m_wake until there is work, the scan is done or aborted
+		std::condition_variable m_wake;
+		std::atomic_uint m_cIdle;			// workers sleeping (or about to) on m_wake
+		const std::atomic_uint32_t& m_scanEpocCurrent;	// of the shard; the scan is aborted when it no longer matches m_scanEpoc
+		DWORD m_scanEpoc;
+		values_bag* m_pPartial;				// gets the keys in runs as they are found; null to just build the result
+		std::atomic_size_t m_cNodes;		// directories found so far
+		size_t m_cMaxNodes;					// no more are added after this many; the result is incomplete but usable
 
-	if (pNodeParent == nullptr)
-	{
-		// create first one; assume directory; "name" is full path starting with <drive>:
-		// normally name is just directory name by itself
-		pNodeParent = CreateNode(nullptr, szPath, FILE_ATTRIBUTE_DIRECTORY);
-		if (pNodeParent == nullptr)
+	public:
+		directory_scanner(unsigned cWorkers, const std::atomic_uint32_t& scanEpocCurrent, DWORD scanEpoc, size_t cMaxNodes, values_bag* pPartial = nullptr) :
+			m_outstanding(0), m_queued(0), m_aborted(false), m_cIdle(0), m_scanEpocCurrent(scanEpocCurrent), m_scanEpoc(scanEpoc), m_pPartial(pPartial),
+			m_cNodes(0), m_cMaxNodes(cMaxNodes)
 		{
-			// out of memory
-			return TRUE;
+			for (unsigned i = 0; i < cWorkers; i++)
+				m_shards.emplace_back(std::make_unique<scan_shard>());
 		}
 
-		result_bag.allNodes.push_back(pNodeParent);
-		result_bag.BagOCDrive.Add(szPath, pNodeParent);
-	}
+		// returns FALSE if the scan was aborted because a newer one started
+		BOOL Scan(values_bag& result_bag, LPCTSTR szRoot)
+		{
+			WCHAR szPath[MAXPATHLEN];
+			if (FAILED(StringCchCopy(szPath, std::size(szPath), szRoot)) ||
+				FAILED(PathCchAddBackslash(szPath, std::size(szPath))))
+			{
+				// path too long
+				return TRUE;
+			}
 
-	if (lstrlen(szPath) + lstrlen(szStarDotStar) >= std::size(szPath))
-	{
-		// path too long
-		return TRUE;
-	}
+			// create first one; assume directory; "name" is full path starting with <drive>:
+			// normally name is just directory name by itself
+			PDNODE pNodeRoot = CreateNode(result_bag.nodeArena, nullptr, szPath, FILE_ATTRIBUTE_DIRECTORY);
+			if (pNodeRoot == nullptr)
+			{
+				// out of memory
+				return TRUE;
+			}
 
-	// add *.* to end of path
-	lstrcat(szPath, szStarDotStar);
+			result_bag.allNodes.push_back(pNodeRoot);
+			if (m_pPartial != nullptr)
+			{
+				// in a run like the directories below it, so that changes under the root find it
+				auto pRun = std::make_shared<BagOTrie<PDNODE>>();
+				pRun->Add(szPath, pNodeRoot);
+				pRun->Sort();
+				m_pPartial->AddSegment(pRun);
+			}
+			else
+			{
+				result_bag.BagOCDrive.Add(szPath, pNodeRoot);
+			}
 
-	BOOL bFound = WFFindFirst(&lfndta, szPath, ATTR_DIR);
+			return ScanSubtree(result_bag, pNodeRoot, szPath);
+		}
 
-	while (bFound)
-	{
-		if (g_driveScanEpoc != scanEpoc)
+		// adds the directories below pNode (which is szPath and already in a bag) to result_bag
+		BOOL ScanSubtree(values_bag& result_bag, PDNODE pNode, LPCTSTR szPath)
 		{
-			// new scan started; abort this one
-			WFFindClose(&lfndta);
-			return FALSE;
-		}
+			std::wstring path = szPath;
+			if (path.empty() || path.back() != CHAR_BACKSLASH)
+				path.push_back(CHAR_BACKSLASH);
 
-		// for all directories at this level, insert into BagOValues
+			PushWork(*m_shards[0], scan_item{ pNode, std::move(path) });
 
-		if ((lfndta.fd.dwFileAttributes & ATTR_DIR) == 0 || ISDOTDIR(lfndta.fd.cFileName))
-		{
-			bFound = WFFindNext(&lfndta);
-			continue;
+			// this thread is worker 0
+			std::vector<std::thread> threads;
+			try
+			{
+				for (unsigned i = 1; i < m_shards.size(); i++)
+				{
+					threads.emplace_back(&directory_scanner::Worker, this, i);
+					SetThreadPriority(threads.back().native_handle(), THREAD_PRIORITY_BELOW_NORMAL);
+				}
+			}
+			catch (const std::system_error&)
+			{
+				// fewer threads than hoped for; the ones running steal the remaining work
+			}
+
+			Worker(0);
+
+			for (auto& thread : threads)
+				thread.join();
+
+			// the nodes go to result_bag even when aborted; a partial bag may still refer to them
+			for (auto& shard : m_shards)
+			{
+				result_bag.allNodes.insert(result_bag.allNodes.end(), shard->bag.allNodes.cbegin(), shard->bag.allNodes.cend());
+				shard->bag.allNodes.clear();
+				result_bag.nodeArena.Adopt(shard->bag.nodeArena);
+				result_bag.BagOCDrive.Append(shard->bag.BagOCDrive);
+			}
+
+			if (m_aborted)
+				return FALSE;
+
+			if (m_pPartial != nullptr)
+			{
+				// all keys were published in runs
+				auto pSegments = m_pPartial->GetView()->segments;
+				if (pSegments != nullptr)
+				{
+					for (auto& pRun : *pSegments)
+					{
+						pRun->ForEachPair([&result_bag](const std::wstring& key, PDNODE pNode) {
+							result_bag.BagOCDrive.Add(key, pNode);
+						});
+					}
+				}
+			}
+
+			return TRUE;
 		}
 
-		if ((lfndta.fd.dwFileAttributes & ATTR_REPARSE_POINT) != 0)
+	private:
+		void PushWork(scan_shard& shard, scan_item&& item)
 		{
-			// skip following reparse points in case they lead in an infinite loop
-			bFound = WFFindNext(&lfndta);
-			continue;
+			m_outstanding++;
+			{
+				std::lock_guard<SpinLock> guard(shard.lock);
+				shard.pending.push_back(std::move(item));
+			}
+			m_queued++;
+			WakeIdle(false);
 		}
 
-		PDNODE pNodeChild = CreateNode(pNodeParent, lfndta.fd.cFileName, lfndta.fd.dwFileAttributes);
-		if (pNodeChild == nullptr)
+		// wakes one idle worker for new work, or all of them when the scan is done or aborted
+		void WakeIdle(bool fAll)
 		{
-			// out of memory
-			break;
-		}
-		result_bag.allNodes.push_back(pNodeChild);
+			// a worker going idle counts itself before it checks for work, so if it isn't counted
+			// yet it will see the change; if it is, taking the lock means it is either still
+			// checking (and will see it) or already waiting (and gets the notification)
+			if (m_cIdle == 0)
+				return;
+
+			{
+				std::lock_guard<std::mutex> guard(m_idleLock);
+			}
 
-		// if spaces, each word individually (and not whole thing)
-		auto words = SplitIntoWords(lfndta.fd.cFileName);
+			if (fAll)
+				m_wake.notify_all();
+			else
+				m_wake.notify_one();
+		}
 
-		for (auto word : words)
+		// sleeps until there is something to take (or steal), the scan is done or it was aborted
+		void WaitForWork()
 		{
-			// TODO: how to mark which word is primary to avoid double free?
-			result_bag.BagOCDrive.Add(word, pNodeChild);
+			std::unique_lock<std::mutex> guard(m_idleLock);
+			m_cIdle++;
+			m_wake.wait(guard, [this]() { return m_queued != 0 || m_outstanding == 0 || m_aborted; });
+			m_cIdle--;
 		}
 
-		//
-		// Construct the path to this new subdirectory.
-		//
-		*szEndPath = CHAR_NULL;
-		if (lstrlen(szPath) + 1 + lstrlen(lfndta.fd.cFileName) >= COUNTOF(szPath))
+		bool TakeWork(unsigned iWorker, scan_item& item)
 		{
-			// path too long
-			return TRUE;
+			// own queue first, newest item (depth first keeps the queue short)
+			{
+				scan_shard& shard = *m_shards[iWorker];
+				std::lock_guard<SpinLock> guard(shard.lock);
+				if (!shard.pending.empty())
+				{
+					item = std::move(shard.pending.back());
+					shard.pending.pop_back();
+					m_queued--;
+					return true;
+				}
+			}
+
+			// steal the oldest item (likely the largest subtree) from someone else
+			for (size_t i = 1; i < m_shards.size(); i++)
+			{
+				scan_shard& victim = *m_shards[(iWorker + i) % m_shards.size()];
+				std::lock_guard<SpinLock> guard(victim.lock);
+				if (!victim.pending.empty())
+				{
+					item = std::move(victim.pending.front());
+					victim.pending.pop_front();
+					m_queued--;
+					return true;
+				}
+			}
+
+			return false;
 		}
 
-		if (FAILED(PathCchAppend(szPath, std::size(szPath), lfndta.fd.cFileName))) {// cFileName is ANSI now
-			return TRUE;
+		void Worker(unsigned iWorker)
+		{
+			scan_item item;
+
+			while (!m_aborted)
+			{
+				if (TakeWork(iWorker, item))
+				{
+					if (!ReadDirectory(*m_shards[iWorker], item))
+					{
+						m_aborted = true;
+						WakeIdle(true);
+					}
+
+					// children were counted when queued, so this cannot reach 0 early
+					if (--m_outstanding == 0)
+						WakeIdle(true);
+				}
+				else if (m_outstanding == 0)
+				{
+					break;
+				}
+				else
+				{
+					// others are still reading and may queue more; don't spin while they do
+					WaitForWork();
+				}
+			}
+
+			if (m_pPartial != nullptr && !m_aborted)
+				PublishSegment(*m_shards[iWorker]);
 		}
-		// add directories in subdir
-		if (!BuildDirectoryBagOValues(result_bag, szPath, pNodeChild, scanEpoc))
+
+		// sorts the keys the shard found since its last run and adds them to the partial bag
+		void PublishSegment(scan_shard& shard)
 		{
-			WFFindClose(&lfndta);
-			return FALSE;
+			if (shard.cSegment == 0)
+				return;
+
+			auto pRun = std::make_shared<BagOTrie<PDNODE>>();
+			pRun->Swap(shard.segment);
+			pRun->Sort();
+			m_pPartial->AddSegment(pRun);
+			shard.cSegment = 0;
 		}
 
-		bFound = WFFindNext(&lfndta);
-	}
+		// adds the subdirectories of item to the shard's bag and queues them; FALSE if the scan was aborted
+		BOOL ReadDirectory(scan_shard& shard, const scan_item& item)
+		{
+			LFNDTA lfndta;
+			WCHAR szPath[MAXPATHLEN];
 
-	WFFindClose(&lfndta);
+			if (item.path.size() + lstrlen(szStarDotStar) >= std::size(szPath))
+			{
+				// path too long
+				return TRUE;
+			}
 
-	return TRUE;
-}
+			// add *.* to end of path
+			lstrcpy(szPath, item.path.c_str());
+			lstrcat(szPath, szStarDotStar);
 
-static auto GetDirectoryOptionsFromText(LPCTSTR szText, BOOL *pbLimited)
-{
-	if (g_valuesBag == nullptr)
-		return std::vector<PDNODE>{};
+			BOOL bFound = WFFindFirst(&lfndta, szPath, ATTR_DIR);
 
-	auto words = SplitIntoWords(szText);
+			while (bFound)
+			{
+				if (m_scanEpocCurrent != m_scanEpoc || m_aborted)
+				{
+					// new scan started; abort this one
+					WFFindClose(&lfndta);
+					return FALSE;
+				}
 
-	std::vector<std::vector<PDNODE>> options_per_word;
+				// for all directories at this level, insert into BagOValues
 
-	for (auto word : words)
-	{
-		std::vector<PDNODE> options;
-		size_t pos = word.find_first_of(L'\\');
-		if (pos == word.size() - 1)
-		{
-			// '\' at end; remove
-			word = word.substr(0, pos);
-			pos = std::wstring::npos;
-		}
-		bool fPrefix = true;
-		if (word[0] == L'\'')
-		{
-			fPrefix = false;
-			word = word.substr(1);
-		}
-		auto& bagOCDrive = g_valuesBag.load()->BagOCDrive;
-		if (pos == std::wstring::npos)
-		{
-			options = bagOCDrive.Retrieve(word, fPrefix, 1000);
+				if ((lfndta.fd.dwFileAttributes & ATTR_DIR) == 0 || ISDOTDIR(lfndta.fd.cFileName))
+				{
+					bFound = WFFindNext(&lfndta);
+					continue;
+				}
 
-			if (options.size() == 1000)
-				*pbLimited = TRUE;
-		}
-		else
-		{
-			// "foo\bar" -> find candidates foo* which have subdir bar*
-			auto first = word.substr(0, pos);
-			auto second = word.substr(pos + 1);
+				if ((lfndta.fd.dwFileAttributes & ATTR_REPARSE_POINT) != 0)
+				{
+					// skip following reparse points in case they lead in an infinite loop
+					bFound = WFFindNext(&lfndta);
+					continue;
+				}
 
-			std::vector<PDNODE> options1 = bagOCDrive.Retrieve(first, fPrefix, 1000);
-			std::vector<PDNODE> options2 = bagOCDrive.Retrieve(second, fPrefix, 1000);
+				if (item.path.size() + lstrlen(lfndta.fd.cFileName) + 1 >= MAXPATHLEN)
+				{
+					// path too long
+					bFound = WFFindNext(&lfndta);
+					continue;
+				}
 
-			if (options1.size() == 1000 ||
-				options2.size() == 1000)
-				*pbLimited = TRUE;
+				if (m_cNodes++ >= m_cMaxNodes)
+				{
+					// over budget; keep what we have
+					break;
+				}
 
-			options = std::move(FilterBySubtree(options1, options2));
-		}
+				PDNODE pNodeChild = CreateNode(shard.bag.nodeArena, item.pNode, lfndta.fd.cFileName, lfndta.fd.dwFileAttributes);
+				if (pNodeChild == nullptr)
+				{
+					// out of memory
+					break;
+				}
+				shard.bag.allNodes.push_back(pNodeChild);
 
-		options_per_word.emplace_back(std::move(options));
-	}
+				// if spaces, each word individually (and not whole thing)
+				auto words = SplitIntoWords(lfndta.fd.cFileName);
 
-	std::vector<PDNODE> final_options = TreeIntersection(options_per_word);
+				BagOTrie<PDNODE>& keys = (m_pPartial != nullptr) ? shard.segment : shard.bag.BagOCDrive;
+				for (auto word : words)
+				{
+					// TODO: how to mark which word is primary to avoid double free?
+					keys.Add(word, pNodeChild);
+				}
+				shard.cSegment++;
 
-	return final_options;
+				// add directories in subdir; whichever worker gets to it first
+				std::wstring childPath = item.path;
+				childPath.append(lfndta.fd.cFileName);
+				childPath.push_back(CHAR_BACKSLASH);
+				PushWork(shard, scan_item{ pNodeChild, std::move(childPath) });
+
+				bFound = WFFindNext(&lfndta);
+			}
+
+			WFFindClose(&lfndta);
+
+			if (m_pPartial != nullptr && shard.cSegment >= GOTO_SEGMENT_SIZE)
+				PublishSegment(shard);
+
+			return TRUE;
+		}
+	};
 }
 
-static void UpdateGotoList(HWND hDlg)
+static unsigned GetScanWorkerCount()
 {
-	BOOL bLimited = FALSE;
-	TCHAR szText[MAXPATHLEN];
+	unsigned cWorkers = std::thread::hardware_concurrency();
+	if (cWorkers == 0)
+		cWorkers = 1;
+	else if (cWorkers > MAX_SCAN_WORKERS)
+		cWorkers = MAX_SCAN_WORKERS;
+
+	return cWorkers;
+}
 
-	auto dw = GetDlgItemTextW(hDlg, IDD_GOTODIR, szText, std::size(szText));
+// pPartial, if given, is published to queries and gets what the scan finds as it goes
+static BOOL BuildDirectoryBagOValues(values_bag& result_bag, goto_shard& shard, DWORD scanEpoc, values_bag* pPartial)
+{
+	directory_scanner scanner(GetScanWorkerCount(), shard.scanEpoc, scanEpoc, shard.cMaxNodes, pPartial);
 
-	const auto options = GetDirectoryOptionsFromText(szText, &bLimited);
+	return scanner.Scan(result_bag, shard.root.c_str());
+}
 
-	HWND hwndLB = GetDlgItem(hDlg, IDD_GOTOLIST);
-	SendMessageW(hwndLB, LB_RESETCONTENT, 0, 0);
+values_bag::values_bag()
+{
+	auto pEmpty = std::make_shared<bag_view>();
+	pEmpty->overlay = overlay.Snapshot();
+	pEmpty->overlayNodes = std::make_shared<const std::vector<PDNODE>>();
+	pEmpty->removedNodes = std::make_shared<const node_set>();
+	pView = std::move(pEmpty);
+}
 
-	if (options.empty())
-		return;
+const BagOTrie<PDNODE>& values_bag::Trie(const bag_view& view) const
+{
+	return view.pTrie != nullptr ? *view.pTrie : BagOCDrive;
+}
 
-	for (auto i = 0u; i < 10u && i < options.size(); i++)
+// caller holds overlayLock
+VOID values_bag::Publish(std::shared_ptr<bag_view> pNext)
+{
+	std::atomic_store(&pView, std::shared_ptr<const bag_view>(std::move(pNext)));
+}
+
+// queries the trie and the overlay; results under removed directories are dropped
+std::vector<PDNODE> values_bag::Retrieve(const bag_view& view, const std::wstring_view query, bool fPrefix, unsigned maxResults) const
+{
+	std::vector<PDNODE> results = Trie(view).Retrieve(query, fPrefix, maxResults);
+
+	if (view.segments != nullptr)
 	{
-		GetTreePath(options.at(i), szText);
+		for (auto& pRun : *view.segments)
+		{
+			if (results.size() >= maxResults)
+				break;
 
-		SendMessageW(hwndLB, LB_ADDSTRING, 0, (LPARAM)szText);
+			auto more = pRun->Retrieve(query, fPrefix, maxResults - static_cast<unsigned>(results.size()));
+			results.insert(results.end(), more.cbegin(), more.cend());
+		}
 	}
 
-	if (bLimited)
+	if (view.overlayNodes->empty() && view.removedNodes->empty())
+		return results;
+
+	if (!view.removedNodes->empty())
 	{
-		SendMessageW(hwndLB, LB_ADDSTRING, 0, (LPARAM)TEXT("... limited ..."));
+		results.erase(std::remove_if(results.begin(), results.end(), [this, &view](PDNODE p) { return IsRemoved(view, p); }), results.end());
 	}
-	else if (options.size() >= 10)
+
+	for (PDNODE p : BagOValues<PDNODE>::Retrieve(view.overlay, query, fPrefix, maxResults))
 	{
-		SendMessageW(hwndLB, LB_ADDSTRING, 0, (LPARAM)TEXT("... more ..."));
+		if (results.size() >= maxResults)
+			break;
+
+		if (!IsRemoved(view, p))
+			results.push_back(p);
 	}
 
-	SendMessageW(hwndLB, LB_SETCURSEL, 0, 0);
+	return results;
 }
 
-/*--------------------------------------------------------------------------*/
-/*                                                                          */
-/*  GotoDirDlgProc() -                                                      */
-/*                                                                          */
-/*--------------------------------------------------------------------------*/
+// true if szName has a word which starts with the first char of the query and contains the rest in order
+static BOOL IsWordSubsequence(const std::wstring_view loweredQuery, LPCWSTR szName)
+{
+	// folded as the keys are, so the overlay matches what the trie would
+	std::wstring name(szName);
+	LowerCaseBuff(name.data(), &name[0], name.size());
+
+	for (auto& word : SplitIntoWords(name.c_str()))
+	{
+		if (word[0] != loweredQuery[0])
+			continue;
+
+		size_t matched = 1;
+		for (size_t i = 1; i < word.size() && matched < loweredQuery.size(); i++)
+		{
+			if (word[i] == loweredQuery[matched])
+				matched++;
+		}
+
+		if (matched == loweredQuery.size())
+			return TRUE;
+	}
+
+	return FALSE;
+}
+
+// fuzzy version of Retrieve; see BagOTrie::RetrieveSubsequence
+std::vector<PDNODE> values_bag::RetrieveSubsequence(const bag_view& view, const std::wstring_view query, unsigned maxResults) const
+{
+	std::vector<PDNODE> results = Trie(view).RetrieveSubsequence(query, maxResults);
+
+	if (view.segments != nullptr)
+	{
+		for (auto& pRun : *view.segments)
+		{
+			if (results.size() >= maxResults)
+				break;
+
+			auto more = pRun->RetrieveSubsequence(query, maxResults - static_cast<unsigned>(results.size()));
+			results.insert(results.end(), more.cbegin(), more.cend());
+		}
+	}
+
+	if (view.overlayNodes->empty() && view.removedNodes->empty())
+		return results;
+
+	if (!view.removedNodes->empty())
+	{
+		results.erase(std::remove_if(results.begin(), results.end(), [this, &view](PDNODE p) { return IsRemoved(view, p); }), results.end());
+	}
+
+	// the overlay is small; scan it rather than keep a second trie
+	std::wstring lowered(query);
+	LowerCaseBuff(lowered.data(), &lowered[0], lowered.size());
+	for (PDNODE p : *view.overlayNodes)
+	{
+		if (results.size() >= maxResults)
+			break;
+
+		if (!lowered.empty() && IsWordSubsequence(lowered, p->szName) && !IsRemoved(view, p))
+			results.push_back(p);
+	}
+
+	return results;
+}
+
+BOOL values_bag::IsRemoved(const bag_view& view, PDNODE pNode) const
+{
+	for (; pNode != nullptr; pNode = pNode->pParent)
+	{
+		if (view.removedNodes->count(pNode) != 0)
+			return TRUE;
+	}
+
+	return FALSE;
+}
+
+// finds the node for a fully qualified path (the trailing backslash is optional); the candidates
+// found by the last component's first word are checked by comparing their parents with the path
+PDNODE values_bag::FindDirectoryNode(const bag_view& view, LPCTSTR szPath) const
+{
+	WCHAR szComponents[MAXPATHLEN];
+	LPCWSTR pszRootEnd;
+
+	if (FAILED(StringCchCopy(szComponents, COUNTOF(szComponents), szPath)) ||
+		FAILED(PathCchAddBackslash(szComponents, COUNTOF(szComponents))) ||
+		FAILED(PathCchSkipRoot(szComponents, &pszRootEnd)))
+		return nullptr;
+
+	// the root node's name (and key) is the whole root, c:\ or \\server\share\, so it is looked
+	// up as one; the components below it are split off in place
+	std::wstring root(szComponents, pszRootEnd - szComponents);
+	LPWSTR pszRest = szComponents + root.size();
+	std::vector<LPCWSTR> components;
+	for (LPWSTR pch = pszRest; *pch != CHAR_NULL; pch++)
+	{
+		if (*pch == CHAR_BACKSLASH)
+		{
+			if (pch == pszRest)
+				return nullptr;
+
+			*pch = CHAR_NULL;
+			components.push_back(pszRest);
+			pszRest = pch + 1;
+		}
+	}
+
+	std::wstring key = root;
+	if (!components.empty())
+	{
+		auto words = SplitIntoWords(components.back());
+		if (words.empty())
+			return nullptr;
+
+		key = words[0];
+	}
+
+	auto candidates = Trie(view).Retrieve(key, false);
+	if (view.segments != nullptr)
+	{
+		// a partial bag's directories are all in the runs of the scan
+		for (auto& pRun : *view.segments)
+		{
+			auto runCandidates = pRun->Retrieve(key, false);
+			candidates.insert(candidates.end(), runCandidates.cbegin(), runCandidates.cend());
+		}
+	}
+	auto overlayCandidates = BagOValues<PDNODE>::Retrieve(view.overlay, key, false);
+	candidates.insert(candidates.end(), overlayCandidates.cbegin(), overlayCandidates.cend());
+
+	auto IsAtPath = [&root, &components](PDNODE pNode) {
+		if (pNode->nLevels != components.size())
+			return false;
+
+		for (size_t i = components.size(); i-- > 0; pNode = pNode->pParent)
+		{
+			if (lstrcmpi(pNode->szName, components[i]) != 0)
+				return false;
+		}
+
+		return lstrcmpi(pNode->szName, root.c_str()) == 0;
+	};
+
+	for (PDNODE p : candidates)
+	{
+		if (IsAtPath(p) && !IsRemoved(view, p))
+			return p;
+	}
+
+	return nullptr;
+}
+
+// publishes another sorted run of a scan in progress
+VOID values_bag::AddSegment(std::shared_ptr<const BagOTrie<PDNODE>> pRun)
+{
+	std::lock_guard<SpinLock> guard(overlayLock);
+
+	auto pCurrent = GetView();
+	auto pSegments = std::make_shared<trie_runs>();
+	if (pCurrent->segments != nullptr)
+		*pSegments = *pCurrent->segments;
+	pSegments->push_back(std::move(pRun));
+
+	auto pNext = std::make_shared<bag_view>(*pCurrent);
+	pNext->segments = std::move(pSegments);
+	Publish(std::move(pNext));
+}
+
+// labels the nodes for ordering results (see LabelTree); done once the bag is complete
+VOID values_bag::Label()
+{
+	std::lock_guard<SpinLock> guard(overlayLock);
+
+	auto pNext = std::make_shared<bag_view>(*GetView());
+	pNext->intervals = LabelTree(std::vector<PDNODE>(allNodes.cbegin(), allNodes.cend()));
+	Publish(std::move(pNext));
+}
+
+// adds nodes to the overlay and publishes it; caller holds overlayLock
+VOID values_bag::AddOverlayNodes(const std::vector<PDNODE>& nodes)
+{
+	auto pCurrent = GetView();
+	auto pNodes = std::make_shared<std::vector<PDNODE>>(*pCurrent->overlayNodes);
+
+	for (PDNODE pNode : nodes)
+	{
+		for (auto word : SplitIntoWords(pNode->szName))
+		{
+			overlay.Add(word, pNode);
+		}
+		pNodes->push_back(pNode);
+	}
+	overlay.Sort();
+
+	auto pNext = std::make_shared<bag_view>(*pCurrent);
+	pNext->overlay = overlay.Snapshot();
+	pNext->overlayNodes = std::move(pNodes);
+	Publish(std::move(pNext));
+}
+
+// adds the directory szPath, and anything already below it (e.g. after a rename), to the overlay
+VOID values_bag::AddDirectoryNode(LPCTSTR szPath, std::shared_ptr<values_bag> pSelf)
+{
+	WCHAR szNodePath[MAXPATHLEN];
+	WCHAR szParent[MAXPATHLEN];
+	PDNODE pNode;
+
+	if (FAILED(StringCchCopy(szNodePath, COUNTOF(szNodePath), szPath)))
+		return;
+
+	StripBackslash(szNodePath);
+	LPCWSTR pszName = StrRChr(szNodePath, NULL, CHAR_BACKSLASH);
+	if (pszName == nullptr || pszName[1] == CHAR_NULL)
+		return;
+
+	// parent path with its backslash, which keeps a root (c:\ or \\server\share\) whole
+	pszName++;
+	lstrcpy(szParent, szNodePath);
+	szParent[pszName - szNodePath] = CHAR_NULL;
+
+	{
+		std::lock_guard<SpinLock> guard(overlayLock);
+
+		auto pCurrent = GetView();
+		PDNODE pParent = FindDirectoryNode(*pCurrent, szParent);
+		if (pParent == nullptr)
+		{
+			// not in this index (e.g. another drive) or the parent was never seen
+			return;
+		}
+
+		if (FindDirectoryNode(*pCurrent, szNodePath) != nullptr)
+		{
+			// already known
+			return;
+		}
+
+		pNode = CreateNode(nodeArena, pParent, pszName, FILE_ATTRIBUTE_DIRECTORY);
+		if (pNode == nullptr)
+			return;
+
+		allNodes.push_back(pNode);
+		AddOverlayNodes(std::vector<PDNODE>{ pNode });
+	}
+
+	if (pScanEpoc != nullptr && !PathIsDirectoryEmpty(szPath))
+	{
+		// a renamed or moved directory brings its subtree along; scan it in the background
+		std::wstring path(szPath);
+		DWORD scanEpoc = *pScanEpoc;
+		try
+		{
+			std::thread thread([pSelf, pNode, path, scanEpoc]() {
+				values_bag subtree;
+				directory_scanner scanner(1, *pSelf->pScanEpoc, scanEpoc, SIZE_MAX);
+				if (!scanner.ScanSubtree(subtree, pNode, path.c_str()))
+					return;
+
+				std::vector<PDNODE> nodes(subtree.allNodes.cbegin(), subtree.allNodes.cend());
+				subtree.allNodes.clear();
+
+				std::lock_guard<SpinLock> guard(pSelf->overlayLock);
+				pSelf->allNodes.insert(pSelf->allNodes.end(), nodes.cbegin(), nodes.cend());
+				pSelf->nodeArena.Adopt(subtree.nodeArena);
+				pSelf->AddOverlayNodes(nodes);
+			});
+			SetThreadPriority(thread.native_handle(), THREAD_PRIORITY_BELOW_NORMAL);
+			thread.detach();
+		}
+		catch (const std::system_error&)
+		{
+			// the subtree shows up after the next full scan
+		}
+	}
+}
+
+VOID values_bag::RemoveDirectoryNode(LPCTSTR szPath)
+{
+	WCHAR szNodePath[MAXPATHLEN];
+
+	if (FAILED(StringCchCopy(szNodePath, COUNTOF(szNodePath), szPath)))
+		return;
+
+	StripBackslash(szNodePath);
+
+	std::lock_guard<SpinLock> guard(overlayLock);
+
+	auto pCurrent = GetView();
+	PDNODE pNode = FindDirectoryNode(*pCurrent, szNodePath);
+	if (pNode == nullptr)
+		return;
+
+	auto pRemoved = std::make_shared<node_set>(*pCurrent->removedNodes);
+	pRemoved->insert(pNode);
+
+	auto pNext = std::make_shared<bag_view>(*pCurrent);
+	pNext->removedNodes = std::move(pRemoved);
+	Publish(std::move(pNext));
+}
+
+// claims the compaction if the overlay has grown large enough
+BOOL values_bag::NeedsCompaction()
+{
+	std::lock_guard<SpinLock> guard(overlayLock);
+
+	auto pCurrent = GetView();
+	if (fCompacting || pCurrent->overlayNodes->size() + pCurrent->removedNodes->size() < GOTO_OVERLAY_COMPACT)
+		return FALSE;
+
+	fCompacting = true;
+	return TRUE;
+}
+
+// folds the overlay into a new trie; the expensive part runs without holding overlayLock
+VOID values_bag::Compact()
+{
+	std::shared_ptr<const bag_view> pBefore;
+	std::vector<PDNODE> nodesLive;
+	{
+		std::lock_guard<SpinLock> guard(overlayLock);
+		pBefore = GetView();
+		nodesLive.assign(allNodes.cbegin(), allNodes.cend());
+	}
+
+	const node_set& nodesRemoved = *pBefore->removedNodes;
+	auto IsRemovedNode = [&nodesRemoved](PDNODE pNode) {
+		for (; pNode != nullptr; pNode = pNode->pParent)
+		{
+			if (nodesRemoved.count(pNode) != 0)
+				return true;
+		}
+		return false;
+	};
+
+	auto pTrie = std::make_shared<BagOTrie<PDNODE>>();
+	Trie(*pBefore).ForEachPair([&pTrie, &IsRemovedNode](const std::wstring& key, PDNODE pNode) {
+		if (!IsRemovedNode(pNode))
+			pTrie->Add(key, pNode);
+	});
+
+	for (PDNODE pNode : *pBefore->overlayNodes)
+	{
+		if (IsRemovedNode(pNode))
+			continue;
+
+		for (auto word : SplitIntoWords(pNode->szName))
+		{
+			pTrie->Add(word, pNode);
+		}
+	}
+
+	pTrie->Sort();
+
+	nodesLive.erase(std::remove_if(nodesLive.begin(), nodesLive.end(), IsRemovedNode), nodesLive.end());
+	auto labels = LabelTree(std::move(nodesLive));
+
+	std::lock_guard<SpinLock> guard(overlayLock);
+
+	// anything reported while compacting stays in the overlay; the overlay only grows in between
+	auto pCurrent = GetView();
+	auto pNodesLater = std::make_shared<std::vector<PDNODE>>(pCurrent->overlayNodes->cbegin() + pBefore->overlayNodes->size(), pCurrent->overlayNodes->cend());
+	overlay.Clear();
+	for (PDNODE pNode : *pNodesLater)
+	{
+		for (auto word : SplitIntoWords(pNode->szName))
+		{
+			overlay.Add(word, pNode);
+		}
+	}
+	overlay.Sort();
+
+	auto pRemoved = std::make_shared<node_set>(*pCurrent->removedNodes);
+	for (PDNODE pNode : nodesRemoved)
+		pRemoved->erase(pNode);
+
+	auto pNext = std::make_shared<bag_view>(*pCurrent);
+	pNext->pTrie = std::move(pTrie);
+	pNext->intervals = std::move(labels);
+	pNext->overlay = overlay.Snapshot();
+	pNext->overlayNodes = std::move(pNodesLater);
+	pNext->removedNodes = std::move(pRemoved);
+	Publish(std::move(pNext));
+
+	fCompacting = false;
+}
+
+static DWORD AlignSnapshotOffset(size_t cb)
+{
+	return static_cast<DWORD>((cb + 3) & ~static_cast<size_t>(3));
+}
+
+// Writes bag (which must be sorted) in the GOTO-<root>.IDX format; FALSE if it does not fit the format
+static BOOL SerializeSnapshot(const values_bag& bag, std::vector<BYTE>& buffer)
+{
+	typedef BagOTrie<PDNODE>::TrieNode TrieNode;
+	const auto& trie = bag.BagOCDrive;
+
+	std::unordered_map<PDNODE, DWORD> nodeIndex;
+	nodeIndex.reserve(bag.allNodes.size());
+	size_t cchNames = 0;
+	for (PDNODE p : bag.allNodes)
+	{
+		nodeIndex.emplace(p, static_cast<DWORD>(nodeIndex.size()));
+		cchNames += lstrlen(p->szName);
+	}
+
+	snapshot_header header = {};
+	size_t cb = sizeof(header);
+
+	header.dwNodesOffset = AlignSnapshotOffset(cb);
+	cb = header.dwNodesOffset + bag.allNodes.size() * sizeof(snapshot_node);
+	header.dwNamesOffset = AlignSnapshotOffset(cb);
+	cb = header.dwNamesOffset + cchNames * sizeof(WCHAR);
+	header.dwTrieNodesOffset = AlignSnapshotOffset(cb);
+	cb = header.dwTrieNodesOffset + trie.NodeCount() * sizeof(TrieNode);
+	header.dwLabelsOffset = AlignSnapshotOffset(cb);
+	cb = header.dwLabelsOffset + trie.LabelCount() * sizeof(WCHAR);
+	header.dwPostingsOffset = AlignSnapshotOffset(cb);
+	cb = header.dwPostingsOffset + trie.Postings().size() * sizeof(DWORD);
+
+	if (cb > MAXDWORD || trie.size() != trie.Postings().size())
+	{
+		// too big for the format or not sorted
+		return FALSE;
+	}
+
+	header.dwSignature = GOTO_SNAPSHOT_SIGNATURE;
+	header.dwVersion = GOTO_SNAPSHOT_VERSION;
+	header.cbFile = static_cast<DWORD>(cb);
+	header.cNodes = static_cast<DWORD>(bag.allNodes.size());
+	header.cchNames = static_cast<DWORD>(cchNames);
+	header.cTrieNodes = static_cast<DWORD>(trie.NodeCount());
+	header.cchLabels = static_cast<DWORD>(trie.LabelCount());
+	header.cPostings = static_cast<DWORD>(trie.Postings().size());
+
+	buffer.assign(cb, 0);
+	CopyMemory(buffer.data(), &header, sizeof(header));
+
+	auto pNodes = reinterpret_cast<snapshot_node*>(buffer.data() + header.dwNodesOffset);
+	auto pNames = reinterpret_cast<WCHAR*>(buffer.data() + header.dwNamesOffset);
+	DWORD ichName = 0;
+	for (PDNODE p : bag.allNodes)
+	{
+		snapshot_node& node = *pNodes++;
+		DWORD cchName = lstrlen(p->szName);
+
+		node.iParent = p->pParent ? nodeIndex.at(p->pParent) : GOTO_SNAPSHOT_NO_PARENT;
+		node.nLevels = p->nLevels;
+		node.dwAttribs = p->dwAttribs;
+		node.ichName = ichName;
+		node.cchName = cchName;
+
+		CopyMemory(pNames + ichName, p->szName, ByteCountOf(cchName));
+		ichName += cchName;
+	}
+
+	if (trie.NodeCount() != 0)
+	{
+		CopyMemory(buffer.data() + header.dwTrieNodesOffset, trie.Nodes(), trie.NodeCount() * sizeof(TrieNode));
+		CopyMemory(buffer.data() + header.dwLabelsOffset, trie.Labels(), ByteCountOf(trie.LabelCount()));
+	}
+
+	auto pPostings = reinterpret_cast<DWORD*>(buffer.data() + header.dwPostingsOffset);
+	for (PDNODE p : trie.Postings())
+	{
+		*pPostings++ = nodeIndex.at(p);
+	}
+
+	return TRUE;
+}
+
+// Rebuilds the nodes of a GOTO-<root>.IDX image into bag and attaches the trie in place; pb must outlive bag.
+// Returns FALSE for a damaged or mismatched file.
+static BOOL DeserializeSnapshot(values_bag& bag, const BYTE* pb, size_t cb)
+{
+	typedef BagOTrie<PDNODE>::TrieNode TrieNode;
+
+	if (cb < sizeof(snapshot_header))
+		return FALSE;
+
+	auto pHeader = reinterpret_cast<const snapshot_header*>(pb);
+	if (pHeader->dwSignature != GOTO_SNAPSHOT_SIGNATURE ||
+		pHeader->dwVersion != GOTO_SNAPSHOT_VERSION ||
+		pHeader->cbFile != cb)
+		return FALSE;
+
+	auto SectionFits = [cb](DWORD dwOffset, size_t count, size_t cbItem) {
+		return dwOffset % 4 == 0 && dwOffset >= sizeof(snapshot_header) && dwOffset <= cb && count <= (cb - dwOffset) / cbItem;
+	};
+
+	if (!SectionFits(pHeader->dwNodesOffset, pHeader->cNodes, sizeof(snapshot_node)) ||
+		!SectionFits(pHeader->dwNamesOffset, pHeader->cchNames, sizeof(WCHAR)) ||
+		!SectionFits(pHeader->dwTrieNodesOffset, pHeader->cTrieNodes, sizeof(TrieNode)) ||
+		!SectionFits(pHeader->dwLabelsOffset, pHeader->cchLabels, sizeof(WCHAR)) ||
+		!SectionFits(pHeader->dwPostingsOffset, pHeader->cPostings, sizeof(DWORD)))
+		return FALSE;
+
+	auto pNodes = reinterpret_cast<const snapshot_node*>(pb + pHeader->dwNodesOffset);
+	auto pNames = reinterpret_cast<const WCHAR*>(pb + pHeader->dwNamesOffset);
+
+	// first create all the nodes, then link them; parents need not precede their children
+	std::vector<PDNODE> nodes(pHeader->cNodes);
+	for (DWORD i = 0; i < pHeader->cNodes; i++)
+	{
+		const snapshot_node& node = pNodes[i];
+		if (node.ichName > pHeader->cchNames || node.cchName > pHeader->cchNames - node.ichName ||
+			node.cchName == 0 || node.cchName >= MAXPATHLEN)
+			return FALSE;
+
+		nodes[i] = CreateNode(bag.nodeArena, nullptr, std::wstring_view(pNames + node.ichName, node.cchName), node.dwAttribs);
+		if (nodes[i] == nullptr)
+		{
+			// out of memory
+			return FALSE;
+		}
+		bag.allNodes.push_back(nodes[i]);
+	}
+
+	for (DWORD i = 0; i < pHeader->cNodes; i++)
+	{
+		const snapshot_node& node = pNodes[i];
+		if (node.iParent == GOTO_SNAPSHOT_NO_PARENT)
+		{
+			if (node.nLevels != 0)
+				return FALSE;
+			continue;
+		}
+
+		// levels must strictly increase toward the leaves, which also rules out cycles
+		if (node.iParent >= pHeader->cNodes || pNodes[node.iParent].nLevels + 1 != node.nLevels || node.nLevels > MAXBYTE)
+			return FALSE;
+
+		nodes[i]->pParent = nodes[node.iParent];
+		nodes[i]->nLevels = static_cast<BYTE>(node.nLevels);
+		nodes[node.iParent]->wFlags |= TF_HASCHILDREN;
+	}
+
+	auto pPostings = reinterpret_cast<const DWORD*>(pb + pHeader->dwPostingsOffset);
+	std::vector<PDNODE> postings(pHeader->cPostings);
+	for (DWORD i = 0; i < pHeader->cPostings; i++)
+	{
+		if (pPostings[i] >= pHeader->cNodes)
+			return FALSE;
+		postings[i] = nodes[pPostings[i]];
+	}
+
+	return bag.BagOCDrive.Attach(
+		reinterpret_cast<const TrieNode*>(pb + pHeader->dwTrieNodesOffset), pHeader->cTrieNodes,
+		reinterpret_cast<const wchar_t*>(pb + pHeader->dwLabelsOffset), pHeader->cchLabels,
+		std::move(postings));
+}
+
+// %LOCALAPPDATA%\Microsoft\Winfile\<szFile>; the index is specific to this machine so it does not roam
+static BOOL GetGotoLocalPath(LPCWSTR szFile, LPWSTR szPath, size_t cchPath)
+{
+	WCHAR szBuffer[MAXPATHLEN];
+
+	DWORD dwRetval = GetEnvironmentVariable(TEXT("LOCALAPPDATA"), szBuffer, COUNTOF(szBuffer));
+	if (dwRetval == 0 || dwRetval >= COUNTOF(szBuffer))
+		return FALSE;
+
+	if (FAILED(StringCchPrintf(szPath, cchPath, TEXT("%s%s"), szBuffer, szRoamINIPath)))
+		return FALSE;
+
+	if (!CreateDirectory(szPath, NULL) && GetLastError() != ERROR_ALREADY_EXISTS)
+		return FALSE;
+
+	return SUCCEEDED(PathCchAppend(szPath, cchPath, szFile));
+}
+
+// one file per root: c:\ -> GOTO-c.IDX, \\server\share\ -> GOTO-server_share.IDX
+static BOOL GetGotoSnapshotPath(const std::wstring& root, LPWSTR szPath, size_t cchPath)
+{
+	WCHAR szFile[MAXFILENAMELEN];
+	std::wstring name;
+
+	for (WCHAR ch : root)
+	{
+		if (IsCharAlphaNumeric(ch))
+			name.push_back(ch);
+		else if (!name.empty() && name.back() != L'_')
+			name.push_back(L'_');
+	}
+	while (!name.empty() && name.back() == L'_')
+		name.pop_back();
+
+	if (FAILED(StringCchPrintf(szFile, COUNTOF(szFile), szGotoSnapshotFile, name.c_str())))
+		return FALSE;
+
+	return GetGotoLocalPath(szFile, szPath, cchPath);
+}
+
+// the single GOTO.IDX of before there was one index per root; nothing reads it any more
+static VOID DeleteLegacyGotoSnapshot()
+{
+	WCHAR szPath[MAXPATHLEN];
+
+	if (GetGotoLocalPath(szGotoLegacySnapshotFile, szPath, COUNTOF(szPath)))
+		DeleteFile(szPath);
+}
+
+// Maps the snapshot of the last complete scan, if there is a usable one
+static std::unique_ptr<values_bag> LoadGotoSnapshot(const std::wstring& root)
+{
+	WCHAR szPath[MAXPATHLEN];
+	if (!GetGotoSnapshotPath(root, szPath, COUNTOF(szPath)))
+		return nullptr;
+
+	// FILE_SHARE_DELETE so a newer snapshot can be renamed over this one
+	HANDLE hFile = CreateFile(szPath, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (hFile == INVALID_HANDLE_VALUE)
+		return nullptr;
+
+	LARGE_INTEGER qSize;
+	HANDLE hMapping = NULL;
+	if (GetFileSizeEx(hFile, &qSize) && qSize.QuadPart >= (LONGLONG)sizeof(snapshot_header) && qSize.QuadPart <= MAXDWORD)
+	{
+		hMapping = CreateFileMapping(hFile, NULL, PAGE_READONLY, 0, 0, NULL);
+	}
+
+	// the view keeps the file and the mapping alive
+	CloseHandle(hFile);
+	if (hMapping == NULL)
+		return nullptr;
+
+	LPVOID pView = MapViewOfFile(hMapping, FILE_MAP_READ, 0, 0, 0);
+	CloseHandle(hMapping);
+	if (pView == NULL)
+		return nullptr;
+
+	auto pBag = std::make_unique<values_bag>();
+	pBag->pSnapshotView = pView;
+
+	if (!DeserializeSnapshot(*pBag, static_cast<const BYTE*>(pView), static_cast<size_t>(qSize.QuadPart)))
+		return nullptr;
+
+	pBag->Label();
+
+	return pBag;
+}
+
+// Writes a serialized snapshot next to the old one and renames it into place so readers never see a partial file
+static VOID SaveGotoSnapshot(const std::wstring& root, const std::vector<BYTE>& buffer)
+{
+	WCHAR szPath[MAXPATHLEN];
+	WCHAR szTempPath[MAXPATHLEN];
+
+	if (buffer.empty() ||
+		!GetGotoSnapshotPath(root, szPath, COUNTOF(szPath)) ||
+		FAILED(StringCchPrintf(szTempPath, COUNTOF(szTempPath), TEXT("%s.tmp"), szPath)))
+		return;
+
+	HANDLE hFile = CreateFile(szTempPath, GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (hFile == INVALID_HANDLE_VALUE)
+		return;
+
+	DWORD cbWritten = 0;
+	BOOL bWritten = WriteFile(hFile, buffer.data(), static_cast<DWORD>(buffer.size()), &cbWritten, NULL) && cbWritten == buffer.size();
+	CloseHandle(hFile);
+
+	if (!bWritten || !MoveFileEx(szTempPath, szPath, MOVEFILE_REPLACE_EXISTING))
+		DeleteFile(szTempPath);
+}
+
+// the shards for the roots in GotoRoots (default c:\); set up on first use and fixed afterwards
+static const std::vector<std::unique_ptr<goto_shard>>& GetGotoShards()
+{
+	static std::vector<std::unique_ptr<goto_shard>> shards;
+	static std::once_flag once;
+
+	std::call_once(once, []() {
+		TCHAR szRoots[MAXPATHLEN * 4];
+		GetPrivateProfileString(szSettings, szGotoRoots, TEXT("c:\\"), szRoots, COUNTOF(szRoots), szTheINIFile);
+
+		// roots are separated by ';'
+		std::wstringstream ss;
+		ss.str(szRoots);
+		std::wstring root;
+		while (std::getline(ss, root, L';'))
+		{
+			root.erase(0, root.find_first_not_of(L' '));
+			root.erase(root.find_last_not_of(L' ') + 1);
+			if (root.empty())
+				continue;
+
+			if (root.back() != CHAR_BACKSLASH)
+				root.push_back(CHAR_BACKSLASH);
+
+			if (std::any_of(shards.cbegin(), shards.cend(), [&root](auto& pShard) { return lstrcmpi(pShard->root.c_str(), root.c_str()) == 0; }))
+				continue;
+
+			auto pShard = std::make_unique<goto_shard>();
+			pShard->root = root;
+
+			UINT uType = GetDriveType(root.c_str());
+			pShard->cMaxNodes = (uType == DRIVE_FIXED || uType == DRIVE_RAMDISK) ? GOTO_LOCAL_MAX_NODES : GOTO_REMOTE_MAX_NODES;
+
+			shards.push_back(std::move(pShard));
+		}
+	});
+
+	return shards;
+}
+
+// the shard whose root holds szPath (the longest root if they nest); nullptr if none does
+static goto_shard* FindShardForPath(LPCTSTR szPath)
+{
+	std::wstring path(szPath);
+	if (path.empty() || path.back() != CHAR_BACKSLASH)
+		path.push_back(CHAR_BACKSLASH);
+
+	goto_shard* pFound = nullptr;
+	for (auto& pShard : GetGotoShards())
+	{
+		const std::wstring& root = pShard->root;
+		if (path.size() >= root.size() &&
+			lstrcmpi(path.substr(0, root.size()).c_str(), root.c_str()) == 0 &&
+			(pFound == nullptr || root.size() > pFound->root.size()))
+			pFound = pShard.get();
+	}
+
+	return pFound;
+}
+
+// lets a query notice that a newer one has made its results useless
+struct query_cancel {
+	const std::atomic<DWORD>* pGeneration;		// null if the query can't be cancelled
+	DWORD generation;
+
+	bool IsCancelled() const
+	{
+		return pGeneration != nullptr && *pGeneration != generation;
+	}
+};
+
+// the nodes returned belong to pBag; hold it while using them
+static auto GetDirectoryOptionsFromText(const std::shared_ptr<values_bag>& pBag, LPCTSTR szText, BOOL *pbLimited, const query_cancel& cancel)
+{
+	if (pBag == nullptr)
+		return std::vector<PDNODE>{};
+
+	auto pView = pBag->GetView();
+	auto words = SplitIntoWords(szText);
+
+	std::vector<std::vector<PDNODE>> options_per_word;
+
+	for (auto word : words)
+	{
+		if (cancel.IsCancelled())
+			return std::vector<PDNODE>{};
+
+		std::vector<PDNODE> options;
+		size_t pos = word.find_first_of(L'\\');
+		if (pos == word.size() - 1)
+		{
+			// '\' at end; remove
+			word = word.substr(0, pos);
+			pos = std::wstring::npos;
+		}
+		bool fPrefix = true;
+		if (word[0] == L'\'')
+		{
+			fPrefix = false;
+			word = word.substr(1);
+		}
+		if (pos == std::wstring::npos)
+		{
+			options = pBag->Retrieve(*pView, word, fPrefix, 1000);
+
+			if (options.size() == 1000)
+				*pbLimited = TRUE;
+		}
+		else
+		{
+			// "foo\bar" -> find candidates foo* which have subdir bar*
+			auto first = word.substr(0, pos);
+			auto second = word.substr(pos + 1);
+
+			std::vector<PDNODE> options1 = pBag->Retrieve(*pView, first, fPrefix, 1000);
+			std::vector<PDNODE> options2 = pBag->Retrieve(*pView, second, fPrefix, 1000);
+
+			if (options1.size() == 1000 ||
+				options2.size() == 1000)
+				*pbLimited = TRUE;
+
+			options = std::move(FilterBySubtree(options1, options2));
+		}
+
+		options_per_word.emplace_back(std::move(options));
+	}
+
+	std::vector<PDNODE> final_options = TreeIntersection(options_per_word, pView->intervals.get());
+
+	return final_options;
+}
+
+static BOOL IsWordBoundary(const std::wstring& name, size_t ich)
+{
+	if (ich == 0)
+		return TRUE;
+
+	switch (name[ich - 1])
+	{
+	case L' ':
+	case L'.':
+	case L'_':
+	case L'-':
+		return TRUE;
+	}
+
+	return FALSE;
+}
+
+// how well loweredWord matches the directory name szName; 0 if it doesn't
+static int ScoreNameMatch(LPCWSTR szName, const std::wstring_view loweredWord)
+{
+	std::wstring name(szName);
+	LowerCaseBuff(name.data(), &name[0], name.size());
+
+	if (loweredWord.empty())
+		return 0;
+
+	if (name == loweredWord)
+		return SCORE_EXACT;
+
+	size_t ich = name.find(loweredWord);
+	if (ich == 0)
+		return SCORE_PREFIX;
+
+	int score = 0;
+	for (; ich != std::wstring::npos; ich = name.find(loweredWord, ich + 1))
+	{
+		if (IsWordBoundary(name, ich))
+			return SCORE_WORD;
+
+		score = SCORE_SUBSTRING;
+	}
+
+	if (score != 0)
+		return score;
+
+	// subsequence: favor chars at word boundaries and penalize gaps, but stay below a substring match
+	size_t matched = 0;
+	size_t ichLast = 0;
+	for (ich = 0; ich < name.size() && matched < loweredWord.size(); ich++)
+	{
+		if (name[ich] != loweredWord[matched])
+			continue;
+
+		if (IsWordBoundary(name, ich))
+			score += 2;
+		if (matched != 0)
+			score -= (int)std::min<size_t>(ich - ichLast - 1, 4);
+
+		ichLast = ich;
+		matched++;
+	}
+
+	if (matched != loweredWord.size())
+		return 0;
+
+	return std::max(1, std::min(SCORE_SUBSEQUENCE + score, SCORE_SUBSTRING - 1));
+}
+
+// matches on the directory itself count fully, matches on a parent count half
+static int ScoreDirectory(PDNODE pNode, const std::vector<std::wstring>& parts, const std::unordered_map<PDNODE, int>& recent)
+{
+	int score = 0;
+
+	for (auto& part : parts)
+	{
+		int scorePart = ScoreNameMatch(pNode->szName, part);
+		for (PDNODE p = pNode->pParent; scorePart == 0 && p != nullptr; p = p->pParent)
+		{
+			scorePart = ScoreNameMatch(p->szName, part) / 2;
+		}
+
+		score += scorePart;
+	}
+
+	score += std::max(0, SCORE_DEPTH_MAX - 2 * (int)pNode->nLevels);
+
+	auto itr = recent.find(pNode);
+	if (itr != recent.end())
+		score += itr->second;
+
+	return score;
+}
+
+// the directories of the SaveHistoryDir history, newest first; the history belongs to the UI thread,
+// so this is called there and the copy goes along with the query
+static goto_history GetGotoHistory()
+{
+	goto_history history;
+	WCHAR szDir[MAXPATHLEN];
+
+	for (UINT iAge = 0; GetHistoryDir(iAge, szDir); iAge++)
+	{
+		// history holds window titles, e.g., c:\foo\*.*
+		if (IsWild(szDir))
+			StripFilespec(szDir);
+
+		history.emplace_back(szDir);
+	}
+
+	return history;
+}
+
+namespace {
+	// The history resolved against one view of a bag.  That takes a lookup per entry, so it is kept
+	// until the bag publishes another view or the history changes instead of redone per keystroke.
+	struct recent_directories {
+		std::weak_ptr<const bag_view> pView;		// compared by owner; doesn't keep the view alive
+		goto_history history;
+		std::unordered_map<PDNODE, int> recent;
+	};
+	typedef std::vector<recent_directories> recent_cache;	// one per thread running queries; an entry per bag
+}
+
+// directories in the history, with a bonus which decreases with age; valid until the next call with cache
+static const std::unordered_map<PDNODE, int>& GetRecentDirectories(const values_bag& bag, const std::shared_ptr<const bag_view>& pView, const goto_history& history, recent_cache& cache)
+{
+	// views no query holds and no bag publishes any more
+	cache.erase(std::remove_if(cache.begin(), cache.end(), [](const recent_directories& entry) {
+		return entry.pView.expired();
+	}), cache.end());
+
+	auto itr = std::find_if(cache.begin(), cache.end(), [&pView](const recent_directories& entry) {
+		return !entry.pView.owner_before(pView) && !pView.owner_before(entry.pView);
+	});
+	if (itr != cache.end() && itr->history == history)
+		return itr->recent;
+
+	if (itr == cache.end())
+		itr = cache.emplace(cache.end());
+
+	itr->pView = pView;
+	itr->history = history;
+	itr->recent.clear();
+
+	for (size_t iAge = 0; iAge < history.size(); iAge++)
+	{
+		PDNODE pNode = bag.FindDirectoryNode(*pView, history[iAge].c_str());
+		if (pNode != nullptr && itr->recent.count(pNode) == 0)
+			itr->recent[pNode] = std::max(0, SCORE_RECENT_MAX - 2 * (int)iAge);
+	}
+
+	return itr->recent;
+}
+
+struct scored_node {
+	int score;
+	PDNODE pNode;
+};
+
+// like GetDirectoryOptionsFromText, but words also match fuzzily and only the best cMax are returned, best first
+// and with their scores
+static auto GetRankedDirectoryOptions(const std::shared_ptr<values_bag>& pBag, LPCTSTR szText, const goto_history& history, recent_cache& recentCache, BOOL *pbLimited, size_t cMax, size_t *pcTotal, const query_cancel& cancel)
+{
+	*pcTotal = 0;
+
+	if (pBag == nullptr)
+		return std::vector<scored_node>{};
+
+	auto pView = pBag->GetView();
+	std::vector<std::vector<PDNODE>> options_per_word;
+	std::vector<std::wstring> parts;		// lowered text scored against each candidate (and its parents)
+
+	for (auto word : SplitIntoWords(szText))
+	{
+		if (cancel.IsCancelled())
+			return std::vector<scored_node>{};
+
+		std::vector<PDNODE> options;
+		size_t pos = word.find_first_of(L'\\');
+		if (pos == word.size() - 1)
+		{
+			// '\' at end; remove
+			word = word.substr(0, pos);
+			pos = std::wstring::npos;
+		}
+		bool fPrefix = true;
+		if (word[0] == L'\'')
+		{
+			fPrefix = false;
+			word = word.substr(1);
+		}
+		if (word.empty())
+			continue;
+
+		LowerCaseBuff(word.data(), &word[0], word.size());
+
+		if (pos == std::wstring::npos)
+		{
+			options = fPrefix ? pBag->RetrieveSubsequence(*pView, word, GOTO_RANK_CANDIDATES) : pBag->Retrieve(*pView, word, false, GOTO_RANK_CANDIDATES);
+
+			if (options.size() == GOTO_RANK_CANDIDATES)
+				*pbLimited = TRUE;
+
+			parts.push_back(word);
+		}
+		else
+		{
+			// "foo\bar" -> find candidates foo* which have subdir bar*
+			auto first = word.substr(0, pos);
+			auto second = word.substr(pos + 1);
+
+			std::vector<PDNODE> options1 = pBag->Retrieve(*pView, first, fPrefix, GOTO_RANK_CANDIDATES);
+			std::vector<PDNODE> options2 = pBag->Retrieve(*pView, second, fPrefix, GOTO_RANK_CANDIDATES);
+
+			if (options1.size() == GOTO_RANK_CANDIDATES ||
+				options2.size() == GOTO_RANK_CANDIDATES)
+				*pbLimited = TRUE;
+
+			options = FilterBySubtree(options1, options2);
+
+			parts.push_back(first);
+			parts.push_back(second);
+		}
+
+		options_per_word.emplace_back(std::move(options));
+	}
+
+	if (cancel.IsCancelled())
+		return std::vector<scored_node>{};
+
+	std::vector<PDNODE> candidates = TreeIntersection(options_per_word, pView->intervals.get());
+	*pcTotal = candidates.size();
+
+	auto& recent = GetRecentDirectories(*pBag, pView, history, recentCache);
+
+	// heap of the best cMax so far, worst on top; ties go to the earlier candidate (i.e., in path order)
+	typedef std::pair<int, size_t> scored;
+	auto better = [](const scored& a, const scored& b)
+	{
+		return a.first > b.first || (a.first == b.first && a.second < b.second);
+	};
+	std::priority_queue<scored, std::vector<scored>, decltype(better)> best(better);
+
+	for (size_t i = 0; i < candidates.size(); i++)
+	{
+		if (i % 1024 == 0 && cancel.IsCancelled())
+			return std::vector<scored_node>{};
+
+		scored item(ScoreDirectory(candidates[i], parts, recent), i);
+		if (best.size() < cMax)
+		{
+			best.push(item);
+		}
+		else if (better(item, best.top()))
+		{
+			best.pop();
+			best.push(item);
+		}
+	}
+
+	std::vector<scored_node> results(best.size());
+	for (size_t i = results.size(); i-- > 0; best.pop())
+	{
+		results[i] = scored_node{ best.top().first, candidates[best.top().second] };
+	}
+
+	return results;
+}
+
+// what the Go To list shows for one query
+struct goto_results {
+	std::vector<std::wstring> paths;
+	BOOL bLimited = FALSE;
+	size_t cTotal = 0;
+};
+
+// runs the query for szText; returns FALSE if it was cancelled
+static BOOL RunGotoQuery(LPCTSTR szText, const goto_history& history, recent_cache& recentCache, const query_cancel& cancel, goto_results& results)
+{
+	TCHAR szPath[MAXPATHLEN];
+
+	// the bags own the nodes returned; keep them until the nodes are turned into paths
+	std::vector<std::shared_ptr<values_bag>> bags;
+	std::vector<scored_node> options;
+
+	results = goto_results();
+
+	// each shard answers from memory; one still being scanned (or not at all yet) adds what it has
+	for (auto& pShard : GetGotoShards())
+	{
+		auto pBag = std::atomic_load(&pShard->pBag);
+		if (pBag == nullptr)
+			continue;
+
+		BOOL bLimited = FALSE;
+		size_t cTotal;
+		if (bGotoRanked)
+		{
+			auto best = GetRankedDirectoryOptions(pBag, szText, history, recentCache, &bLimited, GOTO_RANK_SHOWN, &cTotal, cancel);
+			options.insert(options.end(), best.cbegin(), best.cend());
+		}
+		else
+		{
+			auto found = GetDirectoryOptionsFromText(pBag, szText, &bLimited, cancel);
+			cTotal = found.size();
+			for (size_t i = 0; i < found.size() && i < GOTO_RANK_SHOWN; i++)
+				options.push_back(scored_node{ 0, found[i] });
+		}
+
+		if (cancel.IsCancelled())
+			return FALSE;
+
+		results.bLimited |= bLimited;
+		results.cTotal += cTotal;
+		bags.push_back(std::move(pBag));
+	}
+
+	// unranked results keep the order of the roots, then paths
+	std::stable_sort(options.begin(), options.end(), [](const scored_node& a, const scored_node& b) {
+		return a.score > b.score;
+	});
+
+	for (auto i = 0u; i < 10u && i < options.size(); i++)
+	{
+		GetTreePath(options.at(i).pNode, szPath);
+		results.paths.emplace_back(szPath);
+	}
+
+	return TRUE;
+}
+
+// Runs the Go To dialog's queries on a background thread so typing doesn't wait for them.  Each
+// keystroke submits the text with a new generation; a query in progress gives up as soon as it
+// sees a newer generation.  Results are posted to the dialog as FS_GOTORESULTS(generation).
+class goto_query_worker
+{
+	typedef std::chrono::steady_clock clock;
+
+	std::mutex m_lock;					// protects the members below except m_generation
+	std::condition_variable m_wake;
+	std::thread m_thread;
+	HWND m_hDlg = NULL;
+	bool m_fStop = false;
+	std::wstring m_text;				// text of the latest submission
+	goto_history m_history;				// ... and the history as of then
+	DWORD m_generationTaken = 0;		// latest generation the thread picked up
+	clock::time_point m_submitted;		// ... and when it was submitted
+	goto_results m_results;				// latest completed query
+	DWORD m_generationResults = 0;
+	clock::time_point m_submittedResults;
+	std::vector<double> m_latencies;	// ms from keystroke to list updated, per query shown
+
+	std::atomic<DWORD> m_generation{ 0 };	// of the latest submission
+
+public:
+	// returns FALSE if no thread could be started; run queries synchronously then
+	BOOL Start(HWND hDlg)
+	{
+		std::lock_guard<std::mutex> guard(m_lock);
+		m_hDlg = hDlg;
+		m_fStop = false;
+		m_text.clear();
+		m_generationTaken = m_generationResults = m_generation;
+		m_latencies.clear();
+
+		try
+		{
+			m_thread = std::thread(&goto_query_worker::Worker, this);
+		}
+		catch (const std::system_error&)
+		{
+			return FALSE;
+		}
+
+		return TRUE;
+	}
+
+	BOOL IsRunning() const
+	{
+		return m_thread.joinable();
+	}
+
+	// called on the UI thread
+	void Submit(LPCTSTR szText)
+	{
+		goto_history history = GetGotoHistory();
+
+		{
+			std::lock_guard<std::mutex> guard(m_lock);
+			m_text = szText;
+			m_history = std::move(history);
+			m_generation++;
+		}
+		m_wake.notify_one();
+	}
+
+	// TRUE if the list doesn't show the results of the latest submission yet
+	BOOL IsPending()
+	{
+		std::lock_guard<std::mutex> guard(m_lock);
+		return m_generationResults != m_generation;
+	}
+
+	// gets the results posted for generation; FALSE if they were superseded since
+	BOOL TakeResults(DWORD generation, goto_results& results)
+	{
+		std::lock_guard<std::mutex> guard(m_lock);
+		if (generation != m_generationResults || generation != m_generation)
+			return FALSE;
+
+		results = std::move(m_results);
+		RecordLatency(std::chrono::duration<double, std::milli>(clock::now() - m_submittedResults).count());
+		return TRUE;
+	}
+
+	// cancels any query and waits for the thread; reports the latencies of this dialog in debug output
+	void Stop()
+	{
+		{
+			std::lock_guard<std::mutex> guard(m_lock);
+			m_fStop = true;
+			m_generation++;
+		}
+		m_wake.notify_one();
+
+		if (m_thread.joinable())
+			m_thread.join();
+
+		std::lock_guard<std::mutex> guard(m_lock);
+		m_hDlg = NULL;
+		ReportLatencies();
+	}
+
+private:
+	void Worker()
+	{
+		std::wstring text;
+		goto_history history;
+		recent_cache recentCache;
+		query_cancel cancel{ &m_generation, 0 };
+		clock::time_point submitted;
+
+		for (;;)
+		{
+			{
+				std::unique_lock<std::mutex> guard(m_lock);
+				m_wake.wait(guard, [this]() { return m_fStop || m_generation != m_generationTaken; });
+				if (m_fStop)
+					return;
+
+				text = m_text;
+				history = m_history;
+				m_generationTaken = cancel.generation = m_generation;
+				m_submitted = submitted = clock::now();
+			}
+
+			goto_results results;
+			if (!RunGotoQuery(text.c_str(), history, recentCache, cancel, results))
+				continue;
+
+			HWND hDlg;
+			{
+				std::lock_guard<std::mutex> guard(m_lock);
+				if (cancel.IsCancelled())
+					continue;
+
+				m_results = std::move(results);
+				m_generationResults = cancel.generation;
+				m_submittedResults = submitted;
+				hDlg = m_hDlg;
+			}
+
+			PostMessage(hDlg, FS_GOTORESULTS, cancel.generation, 0);
+		}
+	}
+
+	// caller holds m_lock
+	void RecordLatency(double ms)
+	{
+		if (m_latencies.size() >= GOTO_LATENCY_SAMPLES)
+			m_latencies.erase(m_latencies.begin(), m_latencies.begin() + GOTO_LATENCY_SAMPLES / 2);
+
+		m_latencies.push_back(ms);
+	}
+
+	// caller holds m_lock; debug builds trace the percentiles when the dialog closes
+	void ReportLatencies()
+	{
+#if DBG
+		TCHAR szMessage[128];
+
+		if (m_latencies.empty())
+			return;
+
+		std::vector<double> sorted(m_latencies);
+		std::sort(sorted.begin(), sorted.end());
+		auto Percentile = [&sorted](size_t percent) {
+			return (UINT)(sorted[(sorted.size() - 1) * percent / 100] * 1000);
+		};
+
+		wsprintf(szMessage, TEXT("Go To: %u queries; latency (us) p50 %u, p90 %u, p99 %u, max %u"),
+			(UINT)sorted.size(), Percentile(50), Percentile(90), Percentile(99), Percentile(100));
+		TRACE(BF_START, szMessage);
+#endif
+	}
+};
+
+static goto_query_worker g_gotoQueries;
+
+static void FillGotoList(HWND hDlg, const goto_results& results)
+{
+	HWND hwndLB = GetDlgItem(hDlg, IDD_GOTOLIST);
+	SendMessageW(hwndLB, LB_RESETCONTENT, 0, 0);
+
+	if (results.paths.empty())
+		return;
+
+	for (auto& path : results.paths)
+	{
+		SendMessageW(hwndLB, LB_ADDSTRING, 0, (LPARAM)path.c_str());
+	}
+
+	if (results.bLimited)
+	{
+		SendMessageW(hwndLB, LB_ADDSTRING, 0, (LPARAM)TEXT("... limited ..."));
+	}
+	else if (results.cTotal >= 10)
+	{
+		SendMessageW(hwndLB, LB_ADDSTRING, 0, (LPARAM)TEXT("... more ..."));
+	}
+
+	SendMessageW(hwndLB, LB_SETCURSEL, 0, 0);
+}
+
+// queries for the text in the edit box; the list is updated when the results arrive
+static void UpdateGotoList(HWND hDlg, BOOL bSync)
+{
+	static recent_cache recentCache;		// for the queries run here, on the UI thread
+	TCHAR szText[MAXPATHLEN];
+
+	GetDlgItemTextW(hDlg, IDD_GOTODIR, szText, std::size(szText));
+
+	if (!bSync && g_gotoQueries.IsRunning())
+	{
+		g_gotoQueries.Submit(szText);
+		return;
+	}
+
+	goto_results results;
+	RunGotoQuery(szText, GetGotoHistory(), recentCache, query_cancel{ nullptr, 0 }, results);
+	FillGotoList(hDlg, results);
+}
+
+/*--------------------------------------------------------------------------*/
+/*                                                                          */
+/*  GotoDirDlgProc() -                                                      */
+/*                                                                          */
+/*--------------------------------------------------------------------------*/
 
 WNDPROC wpOrigEditProc;
 
@@ -522,7 +2345,7 @@ static LRESULT APIENTRY GotoEditSubclassProc(
 
 			if (lpmsg->message == WM_KEYDOWN && (lpmsg->wParam == VK_DOWN || lpmsg->wParam == VK_UP || lpmsg->wParam == VK_HOME || lpmsg->wParam == VK_END)) {
 				HWND hwndDlg = GetParent(hwnd);
-				DWORD iSel = SendDlgItemMessage(hwndDlg, IDD_GOTOLIST, LB_GETCURSEL, 0, 0);
+				LRESULT iSel = SendDlgItemMessage(hwndDlg, IDD_GOTOLIST, LB_GETCURSEL, 0, 0);
 				if (iSel == LB_ERR)
 					iSel = 0;
 				else if (lpmsg->wParam == VK_DOWN)
@@ -569,6 +2392,8 @@ GotoDirDlgProc(HWND hDlg, UINT wMsg, WPARAM wParam, LPARAM lParam)
 	HWND hwndEdit;
 	DWORD command_id;
 
+	UNREFERENCED_PARAMETER(lParam);
+
 	switch (wMsg)
 	{
 	case WM_INITDIALOG:
@@ -579,7 +2404,20 @@ GotoDirDlgProc(HWND hDlg, UINT wMsg, WPARAM wParam, LPARAM lParam)
 		wpOrigEditProc = (WNDPROC)SetWindowLongPtr(hwndEdit, GWLP_WNDPROC, (LONG_PTR)GotoEditSubclassProc);
 
 		SendDlgItemMessage(hDlg, IDD_GOTOLIST, LB_ADDSTRING, 0, (LPARAM)TEXT("<type name fragments into edit box>"));
+
+		// if this fails, queries run as the text changes
+		g_gotoQueries.Start(hDlg);
+		break;
+
+	case FS_GOTORESULTS:
+	{
+		goto_results results;
+
+		// older results (a newer query has been submitted since) are dropped
+		if (g_gotoQueries.TakeResults((DWORD)wParam, results))
+			FillGotoList(hDlg, results);
 		break;
+	}
 
 	case WM_COMMAND:
 		command_id = GET_WM_COMMAND_ID(wParam, lParam);
@@ -590,7 +2428,7 @@ GotoDirDlgProc(HWND hDlg, UINT wMsg, WPARAM wParam, LPARAM lParam)
 			{
 			case EN_UPDATE:
 				// repopulate listbox with candidate directories; select first one
-				UpdateGotoList(hDlg);
+				UpdateGotoList(hDlg, FALSE);
 				break;
 			}
 			break;
@@ -608,6 +2446,10 @@ GotoDirDlgProc(HWND hDlg, UINT wMsg, WPARAM wParam, LPARAM lParam)
 
 			EndDialog(hDlg, TRUE);
 
+			// choose from the list for the text as typed, not from an older one
+			if (g_gotoQueries.IsPending())
+				UpdateGotoList(hDlg, TRUE);
+
 			auto iSel = SendDlgItemMessageW(hDlg, IDD_GOTOLIST, LB_GETCURSEL, 0, 0);
 			if (iSel == LB_ERR)
 			{
@@ -641,6 +2483,8 @@ GotoDirDlgProc(HWND hDlg, UINT wMsg, WPARAM wParam, LPARAM lParam)
 
 		// Remove the subclass from the edit control. 
 		SetWindowLongPtr(hwndEdit, GWLP_WNDPROC, (LONG_PTR)wpOrigEditProc);
+
+		g_gotoQueries.Stop();
 		break;
 
 	default:
@@ -656,45 +2500,202 @@ GotoDirDlgProc(HWND hDlg, UINT wMsg, WPARAM wParam, LPARAM lParam)
 	return TRUE;
 }
 
+static VOID ApplyDirectoryChange(const std::shared_ptr<values_bag>& pBag, const goto_change& change)
+{
+	if (change.fAdd)
+		pBag->AddDirectoryNode(change.path.c_str(), pBag);
+	else
+		pBag->RemoveDirectoryNode(change.path.c_str());
+}
+
 static DWORD
-BuildDirectoryTreeBagOValues()
+BuildDirectoryTreeBagOValues(goto_shard* pShard)
 {
-	DWORD scanEpocNew = ++g_driveScanEpoc;
+	DWORD scanEpocNew = ++pShard->scanEpoc;
+
+	{
+		std::lock_guard<std::mutex> guard(pShard->changesLock);
+		pShard->cScans++;
+	}
+
+	if (std::atomic_load(&pShard->pBag) == nullptr)
+	{
+		// answer queries from the last session's index while the scan below refreshes it
+		std::shared_ptr<values_bag> pBagSnapshot = LoadGotoSnapshot(pShard->root);
+		std::shared_ptr<values_bag> pExpected;
+		if (pBagSnapshot)
+		{
+			pBagSnapshot->pScanEpoc = &pShard->scanEpoc;
+			std::atomic_compare_exchange_strong(&pShard->pBag, &pExpected, pBagSnapshot);
+		}
+	}
 
-	std::unique_ptr<values_bag> pBagNew = std::make_unique<values_bag>();
+	std::shared_ptr<values_bag> pBagNew = std::make_shared<values_bag>();
+	pBagNew->pScanEpoc = &pShard->scanEpoc;
+
+	// with nothing to answer queries yet, publish what the scan finds as it goes
+	std::shared_ptr<values_bag> pBagPartial;
+	std::shared_ptr<values_bag> pBagCurrent = std::atomic_load(&pShard->pBag);
+	if (pBagCurrent == nullptr || pBagCurrent->fPartial)
+	{
+		pBagPartial = std::make_shared<values_bag>();
+		pBagPartial->fPartial = true;
+		pBagPartial->pNodeOwner = pBagNew;
+		if (!std::atomic_compare_exchange_strong(&pShard->pBag, &pBagCurrent, pBagPartial))
+			pBagPartial.reset();
+	}
 
-	SendMessageW(hwndStatus, SB_SETTEXT, 2, (LPARAM)TEXT("BUILDING GOTO CACHE"));
+	if (g_cScansRunning++ == 0)
+		SendMessageW(hwndStatus, SB_SETTEXT, 2, (LPARAM)TEXT("BUILDING GOTO CACHE"));
 
-	if (BuildDirectoryBagOValues(*pBagNew, TEXT("c:\\"), nullptr, scanEpocNew))
+	if (BuildDirectoryBagOValues(*pBagNew, *pShard, scanEpocNew, pBagPartial.get()))
 	{
 		pBagNew->BagOCDrive.Sort();
+		pBagNew->Label();
+
+		// serialize while the bag is still private to this thread
+		std::vector<BYTE> snapshot;
+		try
+		{
+			if (!SerializeSnapshot(*pBagNew, snapshot))
+				snapshot.clear();
+		}
+		catch (const std::bad_alloc&)
+		{
+			snapshot.clear();
+		}
+
+		{
+			// changes made from here on find the new bag
+			std::lock_guard<std::mutex> guard(pShard->changesLock);
+			for (auto& change : pShard->changes)
+				ApplyDirectoryChange(pBagNew, change);
+
+			pBagNew = std::atomic_exchange(&pShard->pBag, pBagNew);
+			if (--pShard->cScans == 0)
+				pShard->changes.clear();
+		}
 
-		pBagNew.reset(g_valuesBag.exchange(pBagNew.release()));
+		// the old bag may be mapped from the snapshot file; release it before replacing the file
+		// (if a query still holds it, the rename fails and the old snapshot stays)
+		pBagNew.reset();
+		SaveGotoSnapshot(pShard->root, snapshot);
+	}
+	else
+	{
+		std::lock_guard<std::mutex> guard(pShard->changesLock);
+		if (--pShard->cScans == 0)
+			pShard->changes.clear();
 	}
 
-	UpdateMoveStatus(ReadMoveStatus());
+	if (--g_cScansRunning == 0)
+		UpdateMoveStatus(ReadMoveStatus());
 
 	return ERROR_SUCCESS;
 }
 
-// We're building a Trie structure (not just a directory tree)
+// We're building a Trie structure (not just a directory tree); one per root, each on its own thread
 DWORD
 StartBuildingDirectoryTrie()
 {
+	static std::once_flag once;
+	DWORD dwError = 0;
+
+	std::call_once(once, DeleteLegacyGotoSnapshot);
 
 	//
 	// Move/Copy things.
 	//
-	try
+	for (auto& pShard : GetGotoShards())
+	{
+		try
+		{
+			std::thread thread(BuildDirectoryTreeBagOValues, pShard.get());
+			SetThreadPriority(thread.native_handle(), THREAD_PRIORITY_BELOW_NORMAL);
+
+			thread.detach();
+		}
+		catch (const std::system_error & ex) {
+			if (dwError == 0)
+				dwError = ex.code().value();
+		}
+	}
+
+	return dwError;
+}
+
+// folds the changes into the trie in the background once there are enough of them
+static VOID CompactDirectoryTrie(std::shared_ptr<values_bag> pBag)
+{
+	if (pBag->NeedsCompaction())
 	{
-		std::thread thread(BuildDirectoryTreeBagOValues);
-		SetThreadPriority(thread.native_handle(), THREAD_PRIORITY_BELOW_NORMAL);
-		
-		thread.detach();
+		try
+		{
+			std::thread thread([pBag]() { pBag->Compact(); });
+			SetThreadPriority(thread.native_handle(), THREAD_PRIORITY_BELOW_NORMAL);
+			thread.detach();
+		}
+		catch (const std::system_error&)
+		{
+			// try again on the next change
+			std::lock_guard<SpinLock> guard(pBag->overlayLock);
+			pBag->fCompacting = false;
+		}
 	}
-	catch (const std::system_error & ex) {
-		return ex.code().value();
+}
+
+// applies the change to the index of the root holding its path, and keeps it if that root is being scanned
+static VOID ChangeDirectoryTrie(goto_change change)
+{
+	goto_shard* pShard = FindShardForPath(change.path.c_str());
+	if (pShard == nullptr)
+		return;
+
+	std::shared_ptr<values_bag> pBag;
+	{
+		std::lock_guard<std::mutex> guard(pShard->changesLock);
+		pBag = std::atomic_load(&pShard->pBag);
+		if (pBag != nullptr)
+			ApplyDirectoryChange(pBag, change);
+
+		if (pShard->cScans != 0)
+			pShard->changes.push_back(std::move(change));
 	}
 
-	return 0;
-}
\ No newline at end of file
+	if (pBag != nullptr)
+		CompactDirectoryTrie(pBag);
+}
+
+static VOID AddToDirectoryTrie(LPCTSTR szPath)
+{
+	ChangeDirectoryTrie(goto_change{ true, szPath });
+}
+
+static VOID RemoveFromDirectoryTrie(LPCTSTR szPath)
+{
+	ChangeDirectoryTrie(goto_change{ false, szPath });
+}
+
+// Applies a directory change reported to ChangeFileSystem to the Go To index
+VOID
+UpdateDirectoryTrie(DWORD dwFunction, LPTSTR szFrom, LPTSTR szTo)
+{
+	switch (dwFunction)
+	{
+	case FSC_MKDIR:
+	case FSC_MKDIRQUIET:
+		AddToDirectoryTrie(szFrom);
+		break;
+
+	case FSC_RMDIR:
+	case FSC_RMDIRQUIET:
+		RemoveFromDirectoryTrie(szFrom);
+		break;
+
+	case FSC_RENAME:
+		// the two may be in different shards
+		RemoveFromDirectoryTrie(szFrom);
+		AddToDirectoryTrie(szTo);
+		break;
+	}
+}
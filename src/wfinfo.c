@@ -51,6 +51,7 @@ INT  UpdateDriveListWorker(VOID);
 
 
 CRITICAL_SECTION CriticalSectionUpdate;
+CRITICAL_SECTION CriticalSectionShareChk;    // aDriveInfo[].bShareChkTried/bShareChkFail
 
 //
 // Translation table from ALTNAME -> WNFMT_*
@@ -73,12 +74,14 @@ VOID
 M_Info(VOID)
 {
    InitializeCriticalSection(&CriticalSectionUpdate);
+   InitializeCriticalSection(&CriticalSectionShareChk);
 }
 
 VOID
 D_Info(VOID)
 {
    DeleteCriticalSection(&CriticalSectionUpdate);
+   DeleteCriticalSection(&CriticalSectionShareChk);
 }
 
 U_HEAD(Type)
@@ -2092,3 +2095,56 @@ WaitLoadEvent(BOOL bNet)
 }
 
 
+/////////////////////////////////////////////////////////////////////
+//
+// Name:     GetNetDirType
+//
+// Synopsis: Asks the network whether a directory is shared, unless
+//           that failed on the drive before
+//
+// drive     drive of pPath
+// pPath     fully qualified directory
+// pbFailed  gets TRUE if the drive can't answer; may be NULL
+//
+// Return:   WNDT_* type; 0 if not shared or not known
+//
+// Notes:    The fail is assumed to be for lack of privilege, so the
+//           drive isn't asked again.  Called by the main thread and
+//           the directory readers at the same time; the drive's share
+//           check flags share a word, so they are only read and set
+//           with CriticalSectionShareChk held (but not across the call
+//           to the network).
+//
+/////////////////////////////////////////////////////////////////////
+
+DWORD
+GetNetDirType(DRIVE drive, LPTSTR pPath, PBOOL pbFailed)
+{
+   DWORD dwType = 0;
+   BOOL bTried;
+   BOOL bFail;
+
+   EnterCriticalSection(&CriticalSectionShareChk);
+   bTried = aDriveInfo[drive].bShareChkTried;
+   bFail = aDriveInfo[drive].bShareChkFail;
+   LeaveCriticalSection(&CriticalSectionShareChk);
+
+   if (!bFail && WNetGetDirectoryType(pPath, &dwType, !bTried) != WN_SUCCESS) {
+      dwType = 0;
+      bFail = TRUE;
+   }
+
+   EnterCriticalSection(&CriticalSectionShareChk);
+
+   if (bFail)
+      aDriveInfo[drive].bShareChkFail = TRUE;
+
+   aDriveInfo[drive].bShareChkTried = TRUE;
+
+   LeaveCriticalSection(&CriticalSectionShareChk);
+
+   if (pbFailed)
+      *pbFailed = bFail;
+
+   return dwType;
+}
@@ -74,14 +74,28 @@ typedef struct _INFO_STATUS {
    aDriveInfo[drive].s##type.dwRetVal = retval;\
    }
 
+//
+// Space is also refreshed by the directory readers (see ReadDirLevel),
+// so its flags are only set with CriticalSectionInfoSpace held.
+//
 #define R_Type(drive)     R_REFRESH(Type, drive)
-#define R_Space(drive)    R_REFRESH(Space, drive)
+#define R_Space(drive) \
+   do { \
+   EnterCriticalSection(&CriticalSectionInfoSpace); \
+   R_REFRESH(Space, drive); \
+   LeaveCriticalSection(&CriticalSectionInfoSpace); \
+   } while (0)
 #define R_NetCon(drive)   R_REFRESH(NetCon, drive)
 #define R_VolInfo(drive)  R_REFRESH(VolInfo, drive)
 
 
 #define I_Type(drive)     I_INVALIDATE(Type, drive)
-#define I_Space(drive)    I_INVALIDATE(Space, drive)
+#define I_Space(drive) \
+   do { \
+   EnterCriticalSection(&CriticalSectionInfoSpace); \
+   I_INVALIDATE(Space, drive); \
+   LeaveCriticalSection(&CriticalSectionInfoSpace); \
+   } while (0)
 #define I_NetCon(drive)   I_INVALIDATE(NetCon, drive)
 #define I_VolInfo(drive)  I_INVALIDATE(VolInfo, drive)
 
@@ -163,6 +177,7 @@ BOOL NetLoad(VOID);
 VOID UpdateInit(PVOID ThreadParameter);
 DWORD  WFGetConnection(DRIVE,LPTSTR*,BOOL,DWORD);
 DWORD GetVolShare(DRIVE drive, LPTSTR* ppszVolShare, DWORD dwType);
+DWORD GetNetDirType(DRIVE drive, LPTSTR pPath, PBOOL pbFailed);
 VOID UpdateDriveListComplete(VOID);
 VOID UpdateDriveList(VOID);
 VOID ResetDriveInfo(VOID);
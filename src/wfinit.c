@@ -217,6 +217,7 @@ GetSettings()
    /* Get the flags out of the INI file. */
    bMinOnRun            = GetPrivateProfileInt(szSettings, szMinOnRun,            bMinOnRun,            szTheINIFile);
    bIndexOnLaunch       = GetPrivateProfileInt(szSettings, szIndexOnLaunch,       bIndexOnLaunch,       szTheINIFile);
+   bGotoRanked          = GetPrivateProfileInt(szSettings, szGotoRanked,          bGotoRanked,          szTheINIFile);
    wTextAttribs         = (WORD)GetPrivateProfileInt(szSettings, szLowerCase,     wTextAttribs,         szTheINIFile);
    bStatusBar           = GetPrivateProfileInt(szSettings, szStatusBar,           bStatusBar,           szTheINIFile);
    bDisableVisualStyles = GetPrivateProfileInt(szSettings, szDisableVisualStyles, bDisableVisualStyles, szTheINIFile);
@@ -1176,7 +1177,7 @@ JAPANEND
    wndClass.style          = 0;  //CS_VREDRAW | CS_HREDRAW;
    wndClass.lpfnWndProc    = DirWndProc;
 // wndClass.cbClsExtra     = 0;
-   wndClass.cbWndExtra     = GWL_OLEDROP + sizeof(LONG_PTR);
+   wndClass.cbWndExtra     = GWL_HDTAORDER + sizeof(LONG_PTR);
 // wndClass.hInstance      = hInstance;
    wndClass.hIcon          = NULL;
 // wndClass.hCursor        = hcurArrow;
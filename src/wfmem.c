@@ -8,7 +8,10 @@
 ********************************************************************/
 
 #define BLOCK_SIZE_GRANULARITY 1024     // must be larger than XDTA
+#define BLOCK_SIZE_VIRTUAL (64*1024)    // links this big are whole pages
+#define BLOCK_SIZE_MAX (1024*1024)      // links stop doubling here
 #define ALIGNBLOCK(x) (((x)+7)&~7)      // quad word align for Alpha
+#define ALIGNPAGE(x) (((x)+4095)&~4095)
 
 #ifdef HEAPCHECK
 #include "heap.h"
@@ -17,6 +20,41 @@
 #include <windows.h>
 #include "wfdocb.h"
 #include "wfmem.h"
+#include "wfcols.h"
+
+//
+// Small links come from the local heap.  Big ones are taken straight
+// from VirtualAlloc, so they don't fragment the heap and go back to
+// the system as soon as the listing is freed.
+//
+LPXDTALINK
+MemAllocLink(DWORD dwSize)
+{
+   LPXDTALINK lpLink;
+
+   if (dwSize >= BLOCK_SIZE_VIRTUAL)
+      lpLink = (LPXDTALINK)VirtualAlloc(NULL, dwSize, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE);
+   else
+      lpLink = (LPXDTALINK)LocalAlloc(LMEM_FIXED, dwSize);
+
+   if (lpLink) {
+      lpLink->next = NULL;
+      lpLink->dwSize = dwSize;
+   }
+
+   return lpLink;
+}
+
+
+VOID
+MemFreeLink(LPXDTALINK lpLink)
+{
+   if (lpLink->dwSize >= BLOCK_SIZE_VIRTUAL)
+      VirtualFree(lpLink, 0, MEM_RELEASE);
+   else
+      LocalFree(lpLink);
+}
+
 
 LPXDTALINK
 MemNew()
@@ -24,7 +62,7 @@ MemNew()
    LPXDTALINK lpStart;
    LPXDTAHEAD lpHead;
 
-   lpStart = (LPXDTALINK) LocalAlloc(LMEM_FIXED, BLOCK_SIZE_GRANULARITY);
+   lpStart = MemAllocLink(BLOCK_SIZE_GRANULARITY);
 
    if (!lpStart)
       return NULL;
@@ -32,10 +70,6 @@ MemNew()
    //
    // Initialize the link structure
    //
-   lpStart->next = NULL;
-#ifdef MEMDOUBLE
-   lpStart->dwSize = BLOCK_SIZE_GRANULARITY;
-#endif
    lpStart->dwNextFree = LINKHEADSIZE;
 
    //
@@ -50,11 +84,10 @@ MemNew()
    lpHead->dwTotalCount = 0;
    lpHead->qTotalSize.HighPart = 0;
    lpHead->qTotalSize.LowPart = 0;
-   lpHead->alpxdtaSorted = NULL;
-   lpHead->fdwStatus = 0;
+   lpHead->cRef = 1;
+   lpHead->pCols = NULL;
 
    //
-   // lpHead->dwAlternateFileNameExtent = 0;
    // lpHead->iError = 0;
    //
 #ifdef TESTING
@@ -67,13 +100,21 @@ MemNew()
 }
 
 
+/////////////////////////////////////////////////////////////////////
+//
+// Name:     MemDelete
+//
+// Synopsis: Drops a reference; frees the block with the last one
+//
+// Notes:    Any thread.
+//
+/////////////////////////////////////////////////////////////////////
+
 VOID
 MemDelete(
    LPXDTALINK lpStart)
 {
    LPXDTALINK lpLink;
-   LPXDTAHEAD lpHead;
-   LPXDTA* plpxdta;
 
 #ifdef TESTING
 // TESTING
@@ -84,16 +125,15 @@ MemDelete(
    if (!lpStart)
       return;
 
-   lpHead = MemLinkToHead(lpStart);
-   plpxdta = lpHead->alpxdtaSorted;
+   if (InterlockedDecrement(&MemLinkToHead(lpStart)->cRef))
+      return;
 
-   if (plpxdta)
-      LocalFree(plpxdta);
+   ColsFree(MemLinkToHead(lpStart)->pCols);
 
    while (lpStart) {
 
       lpLink = lpStart->next;
-      LocalFree(lpStart);
+      MemFreeLink(lpStart);
 
       lpStart = lpLink;
    }
@@ -131,6 +171,12 @@ MemDelete(
 //    lpLast*->dwNextFree maintained
 //    lpLast*->next linked list maintained
 //
+// Notes:
+//
+//    Link sizes double up to BLOCK_SIZE_MAX: a small directory stays
+//    in one 1K link, a million entries take about 130 links, and at
+//    most one link's worth of space is unused.
+//
 /////////////////////////////////////////////////////////////////////
 
 LPXDTA
@@ -142,15 +188,12 @@ MemAdd(
    LPXDTA lpxdta;
    UINT cbSpace;
    LPXDTALINK lpLast = *plpLast;
-#ifdef MEMDOUBLE
    DWORD dwNewSize;
-#endif
 
    cbSpace = ALIGNBLOCK((cchFileName+
                          cchAlternateFileName+2)*sizeof(WCHAR)+
                          sizeof(XDTA));
 
-#ifdef MEMDOUBLE
    if (cbSpace + lpLast->dwNextFree > lpLast->dwSize) {
 
       //
@@ -158,32 +201,16 @@ MemAdd(
       //
       dwNewSize = lpLast->dwSize*2;
 
-      if (dwNewSize < lpLast->dwSize)
-         dwNewSize = lpLast->dwSize;
-
-      lpLast->next = LocalAlloc(LMEM_FIXED, dwNewSize);
-
-      if (!lpLast->next)
-         return NULL;
-
-      lpLast = *plpLast = lpLast->next;
+      if (dwNewSize > BLOCK_SIZE_MAX)
+         dwNewSize = BLOCK_SIZE_MAX;
 
-      lpLast->dwSize = dwNewSize;
-#else
-   if (cbSpace + lpLast->dwNextFree > BLOCK_SIZE_GRANULARITY) {
-
-      //
-      // Must allocate a new block
-      //
-      lpLast->next = LocalAlloc(LMEM_FIXED, BLOCK_SIZE_GRANULARITY);
+      lpLast->next = MemAllocLink(dwNewSize);
 
       if (!lpLast->next)
          return NULL;
 
       lpLast = *plpLast = lpLast->next;
-#endif
 
-      lpLast->next = NULL;
       lpLast->dwNextFree = ALIGNBLOCK(sizeof(XDTALINK));
    }
 
@@ -207,82 +234,60 @@ MemAdd(
 
 /////////////////////////////////////////////////////////////////////
 //
-// Name:     MemClone
+// Name:     MemAddRef
 //
-// Synopsis: returns a copy of the specified block
+// Synopsis: Takes another reference on a block
 //
+// Return:   lpStart (may be NULL)
 //
-// Return:   Full Copy or NULL
+// Assumes:  Caller already holds a reference, or is the main thread
+//           and got lpStart from a window
 //
-// Assumes:  lpStart stable and safe
-//
-// Effects:
-//
-// Notes:
+// Notes:    Any thread.  Release with MemDelete.
 //
 /////////////////////////////////////////////////////////////////////
 
 LPXDTALINK
-MemClone(LPXDTALINK lpStart)
+MemAddRef(LPXDTALINK lpStart)
 {
-   LPXDTALINK lpStartCopy;
-   LPXDTALINK lpPrev;
-   LPXDTALINK lpLink;
-   LPXDTALINK lpNext;
-   DWORD dwSize;
+   if (lpStart)
+      InterlockedIncrement(&MemLinkToHead(lpStart)->cRef);
 
-#ifdef TESTING
-// TESTING
-   {TCHAR szT[100]; wsprintf(szT,
-   L"MemClone %x ", lpStart); OutputDebugString(szT);}
-#endif
-
-   for (lpPrev = NULL, lpStartCopy = NULL; lpStart; lpStart = lpNext)
-   {
-      lpNext = lpStart->next;
+   return lpStart;
+}
 
-      dwSize = LocalSize((HLOCAL)lpStart);
 
-      lpLink = LocalAlloc(LMEM_FIXED, dwSize);
-      if (!lpLink)
-      {
-         MemDelete(lpStartCopy);
-         return NULL;
-      }
+/////////////////////////////////////////////////////////////////////
+//
+// Name:     MemSize
+//
+// Synopsis: returns the bytes held by a block
+//
+// Notes:    The pages of a VirtualAlloc'd link past what was used are
+//           never touched, so they are not counted.  The columns and
+//           the sorts built so far are.
+//
+/////////////////////////////////////////////////////////////////////
 
-      CopyMemory((PBYTE)lpLink, (PBYTE)lpStart, dwSize);
+SIZE_T
+MemSize(LPXDTALINK lpStart)
+{
+   SIZE_T cbSize;
 
-      if (!lpStartCopy)
-      {
-         lpStartCopy = lpLink;
+   if (!lpStart)
+      return 0;
 
-         //
-         // MUST set lpxdtaDst->head.alpxdtaSorted to NULL,
-         // otherwise it will attempt to use the original one's space
-         //
-         MemLinkToHead(lpStartCopy)->alpxdtaSorted = NULL;
-      }
+   cbSize = ColsSize(MemLinkToHead(lpStart)->pCols);
 
-      //
-      // Setup link (must null out last one since we can free it at
-      // any time if memory alloc fails).
-      //
-      lpLink->next = NULL;
+   for (; lpStart; lpStart = lpStart->next) {
 
-      if (lpPrev)
-      {
-         lpPrev->next = lpLink;
-      }
-      lpPrev = lpLink;
+      if (lpStart->dwSize >= BLOCK_SIZE_VIRTUAL)
+         cbSize += ALIGNPAGE(lpStart->dwNextFree);
+      else
+         cbSize += lpStart->dwSize;
    }
 
-#ifdef TESTING
-// TESTING
-   {TCHAR szT[100]; wsprintf(szT,
-   L"rets %x\n", lpStartCopy); OutputDebugString(szT);}
-#endif
-
-   return lpStartCopy;
+   return cbSize;
 }
 
 LPXDTA
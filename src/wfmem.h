@@ -13,34 +13,44 @@
 typedef struct _XDTAHEAD* LPXDTAHEAD;
 typedef struct _XDTA* LPXDTA;
 typedef struct _XDTALINK* LPXDTALINK;
+typedef struct _XDTACOLS* PXDTACOLS;
 
+//
+// Each link is twice the size of the one before it, up to
+// BLOCK_SIZE_MAX (see MemAdd), so even a huge directory is a few
+// hundred links.
+//
 typedef struct _XDTALINK {
    LPXDTALINK next;
-#ifdef MEMDOUBLE
    DWORD dwSize;
-#endif
    DWORD dwNextFree;
-#ifdef MEMDOUBLE
    DWORD dwPad;            /* quad word align for Alpha */
-#endif
 } XDTALINK;
 
-#define LPXDTA_STATUS_READING 0x1   // Reading by ReadDirLevel
-#define LPXDTA_STATUS_CLOSE   0x2   // ReadDirLevel must free
-
-
+//
+// A block is shared by reference (MemAddRef/MemDelete) between the
+// windows, the listing cache and ReadDirLevel once its reader hands it
+// out.  From then on only the main thread changes it, and only to fill
+// in what the reader probed for after the read: junction and symbolic
+// link attributes and the shared folder icon (see DirReadProbed).
+// Nothing sorted or copied into the columns depends on those.
+//
+// The sort orders are kept with the columns (pCols; see ColsGetOrder),
+// so every window showing the block shares them; column extents are
+// kept by the window.
+//
 typedef struct _XDTAHEAD {
 
    DWORD dwEntries;
    DWORD dwTotalCount;
    LARGE_INTEGER qTotalSize;
-   LPXDTA* alpxdtaSorted;
 
-   DWORD dwAlternateFileNameExtent;
-   DWORD fdwStatus;
+   LONG cRef;              /* interlocked */
 
    DWORD dwPad;            /* quad word align for Alpha */
 
+   PXDTACOLS pCols;        /* NULL if not built; see wfcols.h */
+
 } XDTAHEAD;
 
 typedef struct _XDTA {
@@ -64,7 +74,8 @@ typedef struct _XDTA {
 LPXDTALINK MemNew();
 VOID   MemDelete(LPXDTALINK lpStart);
 
-LPXDTALINK MemClone(LPXDTALINK lpStart);
+LPXDTALINK MemAddRef(LPXDTALINK lpStart);
+SIZE_T MemSize(LPXDTALINK lpStart);
 LPXDTA MemAdd(LPXDTALINK* plpLast, UINT cchFileName, UINT cchAlternateFileName);
 LPXDTA MemNext(LPXDTALINK* plpLink, LPXDTA lpxdta);
 
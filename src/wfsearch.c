@@ -140,11 +140,10 @@ SearchList(
    BOOL bRoot)
 {
    INT iRetVal;
-   SIZE size;
    BOOL bFound;
    LPWSTR pszNewPath;
    LPWSTR pszNextFile;
-   LFNDTA lfndta;
+   LFNBATCH batch;
    LPXDTA lpxdta;
 
    HDC hdc;
@@ -152,7 +151,7 @@ SearchList(
    DWORD dwTimeNow;
 
    BOOL bLowercase;
-   WCHAR szTemp[MAXPATHLEN];
+   WIDTHTABLE table;
 
    BOOL bLFN;
    DWORD dwAttrs;
@@ -190,11 +189,6 @@ MemoryError:
          return iFileCount;
       }
 
-      //
-      // Never shows altname
-      //
-      MemLinkToHead(*plpStart)->dwAlternateFileNameExtent = 0;
-
       SetWindowLongPtr(GetParent(hwndLB), GWL_HDTA, (LPARAM)*plpStart);
       SearchInfo.lpStart = *plpStart;
    }
@@ -214,24 +208,26 @@ MemoryError:
    pszNextFile = pszNewPath + lstrlen(pszNewPath);
    lstrcpy(pszNextFile, szFileSpec);
 
-   bFound = WFFindFirst(&lfndta, pszNewPath, ATTR_ALL);
+   bFound = WFFindFirstBatch(&batch, pszNewPath, ATTR_ALL, NULL, 0);
 
    hdc = GetDC(hwndLB);
    hOld = SelectObject(hdc, hFont);
 
+   WidthTableInit(&table, hdc);
+
    //
    // Ignore file not found errors AND access denied errors
    // AND PATH_NOT_FOUND when not in the root
    //
 
-   if (!bFound && ERROR_FILE_NOT_FOUND != lfndta.err &&
+   if (!bFound && ERROR_FILE_NOT_FOUND != batch.err &&
       (bRoot ||
-         ERROR_ACCESS_DENIED != lfndta.err &&
-         ERROR_PATH_NOT_FOUND != lfndta.err &&
-         ERROR_INVALID_NAME != lfndta.err)) {
+         ERROR_ACCESS_DENIED != batch.err &&
+         ERROR_PATH_NOT_FOUND != batch.err &&
+         ERROR_INVALID_NAME != batch.err)) {
 
       SearchInfo.eStatus = SEARCH_ERROR;
-      SearchInfo.dwError = lfndta.err;
+      SearchInfo.dwError = batch.err;
       bRecurse = FALSE;
 
       goto SearchCleanup;
@@ -249,10 +245,10 @@ MemoryError:
       }
 
 	  // default ftSince is 0 and so normally this will be true
-	  bFound = CompareFileTime(&SearchInfo.ftSince, &lfndta.fd.ftLastWriteTime) < 0;
+	  bFound = CompareFileTime(&SearchInfo.ftSince, &batch.lpEntry->ftLastWriteTime) < 0;
 
 	  // if we otherwise match, but shouldn't include directories in the output, skip
-	  if (bFound && !bIncludeSubdirs && (lfndta.fd.dwFileAttributes & ATTR_DIR) != 0)
+	  if (bFound && !bIncludeSubdirs && (batch.lpEntry->dwFileAttributes & ATTR_DIR) != 0)
 	  {
 		  bFound = FALSE;
 	  }
@@ -260,27 +256,22 @@ MemoryError:
       //
       // Make sure this matches date (if specified) and is not a "." or ".." directory 
       //
-      if (bFound && !ISDOTDIR(lfndta.fd.cFileName)) {
+      if (bFound && !ISDOTDIR(batch.lpEntry->cFileName)) {
 
-         lstrcpy(pszNextFile, lfndta.fd.cFileName);
+         lstrcpy(pszNextFile, batch.lpEntry->cFileName);
 
          // Warning: was OemToChar(pszNewPath, szMessage);
          // but taken out since no translation necessary.
          // Here on out _was_ using szMessage
          // (Multithreaded=> szMessage usage BAD)
 
-         bLFN = IsLFN(lfndta.fd.cFileName);
-
-         if (bLowercase) {
-            lstrcpy(szTemp, pszNewPath);
-            CharLower(szTemp);
-
-            GetTextExtentPoint32(hdc, szTemp, lstrlen(szTemp), &size);
-         } else {
-            GetTextExtentPoint32(hdc, pszNewPath, lstrlen(pszNewPath), &size);
-         }
+         bLFN = IsLFN(batch.lpEntry->cFileName);
 
-         maxExt = max(size.cx,maxExt);
+         maxExt = WidthMax(&table,
+                           hdc,
+                           pszNewPath,
+                           bLowercase ? WIDTH_LOWER : WIDTH_ASIS,
+                           maxExt);
 
          lpxdta = MemAdd(plpStart, lstrlen(pszNewPath), 0);
 
@@ -293,10 +284,10 @@ MemoryError:
             break;
          }
 
-         dwAttrs = lpxdta->dwAttrs = lfndta.fd.dwFileAttributes;
-         lpxdta->ftLastWriteTime = lfndta.fd.ftLastWriteTime;
-         lpxdta->qFileSize.LowPart = lfndta.fd.nFileSizeLow;
-         lpxdta->qFileSize.HighPart = lfndta.fd.nFileSizeHigh;
+         dwAttrs = lpxdta->dwAttrs = batch.lpEntry->dwFileAttributes;
+         lpxdta->ftLastWriteTime = batch.lpEntry->ftLastWriteTime;
+         lpxdta->qFileSize.LowPart = batch.lpEntry->nFileSizeLow;
+         lpxdta->qFileSize.HighPart = batch.lpEntry->nFileSizeHigh;
 
          lstrcpy(MemGetFileName(lpxdta), pszNewPath);
          MemGetAlternateFileName(lpxdta)[0] = CHAR_NULL;
@@ -311,9 +302,9 @@ MemoryError:
             iBitmap = BM_IND_CLOSE;
          else if (dwAttrs & (ATTR_HIDDEN | ATTR_SYSTEM))
             iBitmap = BM_IND_RO;
-         else if (IsProgramFile(lfndta.fd.cFileName))
+         else if (IsProgramFile(batch.lpEntry->cFileName))
             iBitmap = BM_IND_APP;
-         else if (IsDocument(lfndta.fd.cFileName))
+         else if (IsDocument(batch.lpEntry->cFileName))
             iBitmap = BM_IND_DOC;
          else
             iBitmap = BM_IND_FIL;
@@ -331,12 +322,12 @@ MemoryError:
       //
       // Search for more files in the current directory
       //
-      bFound = WFFindNext(&lfndta);
+      bFound = WFFindNextEntry(&batch);
    }
 
 SearchCleanup:
 
-   WFFindClose(&lfndta);
+   WFFindCloseBatch(&batch);
 
    if (hOld)
       SelectObject(hdc, hOld);
@@ -350,7 +341,7 @@ SearchCleanup:
    //
    lstrcpy(pszNextFile, szStarDotStar);
 
-   bFound = WFFindFirst(&lfndta, pszNewPath, ATTR_DIR | ATTR_HS);
+   bFound = WFFindFirstBatch(&batch, pszNewPath, ATTR_DIR | ATTR_HS, NULL, 0);
 
    while (bFound) {
 
@@ -366,13 +357,13 @@ SearchCleanup:
       //
       // Make sure this is not a "." or ".." directory.
       //
-      if (!ISDOTDIR(lfndta.fd.cFileName) &&
-         (lfndta.fd.dwFileAttributes & ATTR_DIR)) {
+      if (!ISDOTDIR(batch.lpEntry->cFileName) &&
+         (batch.lpEntry->dwFileAttributes & ATTR_DIR)) {
 
          //
          // Yes, search and add files in this directory
          //
-         lstrcpy(pszNextFile, lfndta.fd.cFileName);
+         lstrcpy(pszNextFile, batch.lpEntry->cFileName);
 
          //
          // Add all files in this subdirectory.
@@ -393,10 +384,10 @@ SearchCleanup:
          }
 
       }
-      bFound = WFFindNext(&lfndta);
+      bFound = WFFindNextEntry(&batch);
    }
 
-   WFFindClose(&lfndta);
+   WFFindCloseBatch(&batch);
 
 SearchEnd:
 
@@ -225,9 +225,9 @@ ResizeSplit(HWND hwnd, INT dxSplit)
          if (hwndDir) {
             hwndLB = GetDlgItem (hwndDir,IDCW_LISTBOX);
             if (hwndLB) {
-               PVOID pv;
-               SendMessage (hwndLB,LB_GETTEXT,0,(LPARAM)(LPTSTR) &pv);
-               if (!pv)
+               LPXDTA lpxdta;
+               DirGetItem(hwndLB, 0, &lpxdta);
+               if (!lpxdta)
                   SetFocus(hwndDriveBar);
             }
          }
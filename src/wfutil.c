@@ -59,6 +59,24 @@ GetPrevHistoryDir(BOOL forward, HWND *phwnd, LPWSTR szDir)
 	return TRUE;
 }
 
+// directory visited iAge steps before the current one (0 is the current one); doesn't move the history
+BOOL
+GetHistoryDir(UINT iAge, LPWSTR szDir)
+{
+	DWORD historyT;
+
+	// the entry after the current one is always empty
+	if (iAge >= MAXHISTORY - 1)
+		return FALSE;
+
+	historyT = (historyCur + MAXHISTORY - iAge) % MAXHISTORY;
+	if (rghistoryDir[historyT].hwnd == NULL)
+		return FALSE;
+
+	lstrcpy(szDir, rghistoryDir[historyT].szDir);
+	return TRUE;
+}
+
 LPWSTR
 pszNextComponent(
    LPWSTR p)
@@ -340,8 +358,10 @@ RefreshWindow(
    //
    // If bFlushCache, remind ourselves to try it
    //
-   if (bFlushCache)
+   if (bFlushCache) {
       aDriveInfo[drive].bShareChkTried = FALSE;
+      ProbeCacheFlush(drive);
+   }
 
    // NOTE: similar to CreateDirWindow
 
@@ -0,0 +1,354 @@
+/********************************************************************
+
+   wfwidth.c
+
+   Widths of names in the file list font
+
+   Copyright (c) Microsoft Corporation. All rights reserved.
+   Licensed under the MIT License.
+
+********************************************************************/
+
+#include "winfile.h"
+
+#define WIDTH_FONTS   4              // fonts whose tables are kept
+#define WIDTH_SLOTS   1024           // measured names kept; power of 2
+
+typedef struct _WIDTHFONT {
+   HFONT hFont;
+   LOGFONT lf;                       // handles are reused once deleted
+   WIDTHTABLE table;                 // table.dwFont is 0 if the slot is free
+} WIDTHFONT, *PWIDTHFONT;
+
+typedef struct _WIDTHSLOT {
+   DWORD dwFont;
+   DWORD dwHash;
+   UINT uCase;
+   INT cx;
+   LPWSTR lpsz;                      // as passed (before its case is mapped);
+                                     // NULL if the slot is free
+} WIDTHSLOT, *PWIDTHSLOT;
+
+//
+// Shared by the UI and the search worker
+//
+WIDTHFONT aWidthFont[WIDTH_FONTS];
+UINT iWidthFontNext;                 // slot the next new font replaces
+DWORD dwWidthFontSerial;             // serial number of the last font
+WIDTHSLOT aWidthSlot[WIDTH_SLOTS];
+SRWLOCK SRWLockWidth = SRWLOCK_INIT;
+
+
+/////////////////////////////////////////////////////////////////////
+//
+// Name:     WidthTableBuild
+//
+// Synopsis: Fill in the advances of the font selected in hdc
+//
+// Return:   TRUE on success
+//
+// Notes:    The case of the whole table is mapped at once by the same
+//           calls which map the names, so the advance in each case is
+//           that of the character actually drawn.
+//
+/////////////////////////////////////////////////////////////////////
+
+BOOL
+WidthTableBuild(PWIDTHTABLE pTable, HDC hdc)
+{
+   TEXTMETRIC tm;
+   INT acx[WIDTH_CHARS];
+   WCHAR aach[WIDTH_CASES][WIDTH_CHARS];
+   UINT uCase, i;
+   INT cx;
+
+   if (!GetTextMetrics(hdc, &tm) ||
+      !GetCharWidth32(hdc, 0, WIDTH_CHARS - 1, acx)) {
+
+      return FALSE;
+   }
+
+   for (uCase = 0; uCase < WIDTH_CASES; uCase++) {
+      for (i = 0; i < WIDTH_CHARS; i++) {
+         aach[uCase][i] = (WCHAR)i;
+      }
+   }
+
+   //
+   // Skip the null (never in a name): it would end the strings
+   //
+   CharLowerBuff(&aach[WIDTH_LOWER][1], WIDTH_CHARS - 1);
+   CharUpperBuff(&aach[WIDTH_UPPER][1], WIDTH_CHARS - 1);
+
+   for (uCase = 0; uCase < WIDTH_CASES; uCase++) {
+      for (i = 0; i < WIDTH_CHARS; i++) {
+
+         if (aach[uCase][i] < WIDTH_CHARS) {
+            cx = acx[aach[uCase][i]];
+         } else if (!GetCharWidth32(hdc, aach[uCase][i], aach[uCase][i], &cx)) {
+            cx = tm.tmMaxCharWidth;
+         }
+
+         pTable->aacx[uCase][i] = (WORD)cx;
+      }
+   }
+
+   pTable->cxOverhang = tm.tmOverhang;
+
+   return TRUE;
+}
+
+
+/////////////////////////////////////////////////////////////////////
+//
+// Name:     WidthTableInit
+//
+// Synopsis: Get the table for the font selected in hdc
+//
+// Return:   TRUE if the table was built (or was already kept).
+//           Otherwise pTable->dwFont is 0 and WidthMax measures
+//           every name.
+//
+// Notes:    The table is copied out, so it stays good however long the
+//           caller keeps it.
+//
+//           !! Called by UI and worker thread !!
+//
+/////////////////////////////////////////////////////////////////////
+
+BOOL
+WidthTableInit(PWIDTHTABLE pTable, HDC hdc)
+{
+   HFONT hFontDC;
+   LOGFONT lf;
+   PWIDTHFONT pFont;
+   UINT i;
+
+   pTable->dwFont = 0;
+
+   hFontDC = (HFONT)GetCurrentObject(hdc, OBJ_FONT);
+
+   if (!hFontDC || !GetObject(hFontDC, sizeof(lf), &lf))
+      return FALSE;
+
+   AcquireSRWLockExclusive(&SRWLockWidth);
+
+   for (i = 0; i < WIDTH_FONTS; i++) {
+
+      pFont = &aWidthFont[i];
+
+      if (pFont->table.dwFont && pFont->hFont == hFontDC &&
+         !memcmp(&pFont->lf, &lf, sizeof(lf))) {
+
+         break;
+      }
+   }
+
+   if (i == WIDTH_FONTS) {
+
+      pFont = &aWidthFont[iWidthFontNext];
+
+      if (!WidthTableBuild(&pFont->table, hdc)) {
+
+         pFont->table.dwFont = 0;
+         ReleaseSRWLockExclusive(&SRWLockWidth);
+
+         return FALSE;
+      }
+
+      pFont->hFont = hFontDC;
+      pFont->lf = lf;
+      pFont->table.dwFont = ++dwWidthFontSerial;
+
+      iWidthFontNext = (iWidthFontNext + 1) % WIDTH_FONTS;
+   }
+
+   *pTable = pFont->table;
+
+   ReleaseSRWLockExclusive(&SRWLockWidth);
+
+   return TRUE;
+}
+
+
+/////////////////////////////////////////////////////////////////////
+//
+// Name:     WidthHash
+//
+// Synopsis: FNV-1a of the name, its case and its font
+//
+/////////////////////////////////////////////////////////////////////
+
+DWORD
+WidthHash(DWORD dwFont, UINT uCase, LPCWSTR lpsz, INT cch)
+{
+   DWORD dwHash = 2166136261 ^ (dwFont * WIDTH_CASES + uCase);
+   INT i;
+
+   for (i = 0; i < cch; i++) {
+      dwHash = (dwHash ^ lpsz[i]) * 16777619;
+   }
+
+   return dwHash;
+}
+
+
+/////////////////////////////////////////////////////////////////////
+//
+// Name:     WidthMax
+//
+// Synopsis: Width of lpsz if wider than cxMax
+//
+// pTable    from WidthTableInit for the font selected in hdc
+// lpsz      name, drawn in case uCase (WIDTH_*)
+// cxMax     widest name so far
+//
+// Return:   max(width of lpsz, cxMax)
+//
+// Notes:    A name of characters in the table is as wide as the sum
+//           of their advances (GDI doesn't kern extents), so only the
+//           names wider than cxMax, and names the table can't estimate,
+//           are looked up or measured.  Measured names are kept by font
+//           and name.
+//
+//           !! Called by UI and worker thread !!
+//
+/////////////////////////////////////////////////////////////////////
+
+INT
+WidthMax(PWIDTHTABLE pTable, HDC hdc, LPCWSTR lpsz, UINT uCase, INT cxMax)
+{
+   WCHAR szName[MAXPATHLEN];
+   LPCWSTR lpszMeasure;
+   PWIDTHSLOT pSlot = NULL;
+   DWORD dwHash = 0;
+   SIZE size;
+   INT cch;
+   INT cx;
+   WCHAR ch;
+   BOOL bFound;
+   LPWSTR lpszKeep;
+
+   if (!pTable->dwFont) {
+
+      cch = lstrlen(lpsz);
+
+   } else {
+
+      cx = pTable->cxOverhang;
+
+      for (cch = 0; (ch = lpsz[cch]) != CHAR_NULL; cch++) {
+
+         if (ch >= WIDTH_CHARS)
+            break;
+
+         cx += pTable->aacx[uCase][ch];
+      }
+
+      if (ch == CHAR_NULL) {
+
+         if (cx <= cxMax)
+            return cxMax;
+
+      } else {
+
+         cch += lstrlen(&lpsz[cch]);
+      }
+
+      dwHash = WidthHash(pTable->dwFont, uCase, lpsz, cch);
+      pSlot = &aWidthSlot[dwHash & (WIDTH_SLOTS - 1)];
+
+      AcquireSRWLockShared(&SRWLockWidth);
+
+      bFound = pSlot->lpsz && pSlot->dwFont == pTable->dwFont &&
+         pSlot->dwHash == dwHash && pSlot->uCase == uCase &&
+         CSTR_EQUAL == CompareStringOrdinal(pSlot->lpsz, -1, lpsz, cch, FALSE);
+
+      if (bFound)
+         cx = pSlot->cx;
+
+      ReleaseSRWLockShared(&SRWLockWidth);
+
+      if (bFound)
+         return max(cx, cxMax);
+   }
+
+   //
+   // Names which don't fit are measured as they are (as before)
+   //
+   lpszMeasure = lpsz;
+
+   if (uCase != WIDTH_ASIS && cch < MAXPATHLEN) {
+
+      CopyMemory(szName, lpsz, (cch + 1) * sizeof(WCHAR));
+
+      if (uCase == WIDTH_LOWER)
+         CharLower(szName);
+      else
+         CharUpper(szName);
+
+      lpszMeasure = szName;
+   }
+
+   if (!GetTextExtentPoint32(hdc, lpszMeasure, cch, &size))
+      return cxMax;
+
+   if (pTable->dwFont) {
+
+      lpszKeep = (LPWSTR)LocalAlloc(LMEM_FIXED, (cch + 1) * sizeof(WCHAR));
+
+      if (lpszKeep) {
+
+         CopyMemory(lpszKeep, lpsz, (cch + 1) * sizeof(WCHAR));
+
+         AcquireSRWLockExclusive(&SRWLockWidth);
+
+         if (pSlot->lpsz)
+            LocalFree(pSlot->lpsz);
+
+         pSlot->dwFont = pTable->dwFont;
+         pSlot->dwHash = dwHash;
+         pSlot->uCase = uCase;
+         pSlot->cx = size.cx;
+         pSlot->lpsz = lpszKeep;
+
+         ReleaseSRWLockExclusive(&SRWLockWidth);
+      }
+   }
+
+   return max(size.cx, cxMax);
+}
+
+
+/////////////////////////////////////////////////////////////////////
+//
+// Name:     WidthCacheFlush
+//
+// Synopsis: Forget all tables and measured names
+//
+// Notes:    Called when the font changes; the old font's entries would
+//           never be found again.
+//
+/////////////////////////////////////////////////////////////////////
+
+VOID
+WidthCacheFlush(VOID)
+{
+   UINT i;
+
+   AcquireSRWLockExclusive(&SRWLockWidth);
+
+   for (i = 0; i < WIDTH_SLOTS; i++) {
+
+      if (aWidthSlot[i].lpsz) {
+         LocalFree(aWidthSlot[i].lpsz);
+         aWidthSlot[i].lpsz = NULL;
+      }
+   }
+
+   for (i = 0; i < WIDTH_FONTS; i++) {
+      aWidthFont[i].table.dwFont = 0;
+   }
+
+   ReleaseSRWLockExclusive(&SRWLockWidth);
+}
@@ -0,0 +1,52 @@
+/********************************************************************
+
+   wfwidth.h
+
+   Widths of names in the file list font
+
+   Copyright (c) Microsoft Corporation. All rights reserved.
+   Licensed under the MIT License.
+
+********************************************************************/
+
+#pragma once
+
+#include <windows.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//
+// Finding the widest of many names.  A name's width is first estimated
+// from the advances of its characters, kept per font; only a name whose
+// estimate is wider than the widest so far is measured by GDI.  Those
+// measurements are cached by font and name, so measuring the same
+// listing again (changing views, refreshing) mostly finds them there.
+//
+// A name with a character past the table (which may be drawn from a
+// linked font) has no estimate; it is looked up or measured.
+//
+
+#define WIDTH_ASIS    0       // how the name will be drawn
+#define WIDTH_LOWER   1       //    CharLower'd
+#define WIDTH_UPPER   2       //    CharUpper'd
+#define WIDTH_CASES   3
+
+#define WIDTH_CHARS   256     // characters with an advance in the table
+
+typedef struct _WIDTHTABLE {
+   DWORD dwFont;              // serial number of the font; 0 if the table
+                              // couldn't be built (everything is measured)
+   INT cxOverhang;            // added once per name (synthesized styles)
+   WORD aacx[WIDTH_CASES][WIDTH_CHARS];   // advance of each character
+                                          // after its case is mapped
+} WIDTHTABLE, *PWIDTHTABLE;
+
+BOOL WidthTableInit(PWIDTHTABLE pTable, HDC hdc);
+INT WidthMax(PWIDTHTABLE pTable, HDC hdc, LPCWSTR lpsz, UINT uCase, INT cxMax);
+VOID WidthCacheFlush(VOID);
+
+#ifdef __cplusplus
+}
+#endif
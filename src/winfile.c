@@ -535,6 +535,14 @@ FrameWndProc(HWND hwnd, UINT wMsg, WPARAM wParam, LPARAM lParam)
       BuildDocumentStringWorker();
       break;
 
+   case FS_DIRREADPROBED:
+
+      //
+      // lParam => probe results (see ResolveDirProbes)
+      //
+      DirReadProbed((LPVOID)lParam);
+      break;
+
    case FS_UPDATEDRIVETYPECOMPLETE:
       //
       // wParam = new cDrives
@@ -1271,10 +1279,7 @@ EnablePropertiesMenu(
       //
       // Get the DTA index.
       //
-      if (SendMessage(hwndLB,
-                      LB_GETTEXT,
-                      0,
-                      (LPARAM)&lpxdta) == LB_ERR || !lpxdta) {
+      if (DirGetItem(hwndLB, 0, &lpxdta) == LB_ERR || !lpxdta) {
          goto ReturnFalse;
       }
 
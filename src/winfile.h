@@ -32,12 +32,15 @@
 #include <strsafe.h>
 #include "suggest.h"
 #include "numfmt.h"
+#include "wfcase.h"
 
 #include "wfexti.h"
 #include "wfhelp.h"
 
 #include "wfdocb.h"
 #include "wfmem.h"
+#include "wfcols.h"
+#include "wfwidth.h"
 #include "res.h"
 
 #ifdef HEAPCHECK
@@ -186,6 +189,7 @@ INT atoiW(LPWSTR sz);
 #define CHAR_A TEXT('A')
 #define CHAR_a TEXT('a')
 #define CHAR_Z TEXT('Z')
+#define CHAR_z TEXT('z')
 
 // Default char for untranslatable unicode
 // MUST NOT BE an acceptable char for file systems!!
@@ -434,12 +438,16 @@ BOOL TypeAheadString(WCHAR ch, LPWSTR szT);
 
 VOID SaveHistoryDir(HWND hwnd, LPWSTR szDir);
 BOOL GetPrevHistoryDir(BOOL forward, HWND *phwnd, LPWSTR szDir);
+BOOL GetHistoryDir(UINT iAge, LPWSTR szDir);
 
 // WFDIR.C
 
 VOID   UpdateStatus(HWND hWnd);
 LPWSTR DirGetSelection(HWND hwndDir, HWND hwndView, HWND hwndLB, INT iSelType, BOOL *pfDir, PINT piLastSel);
 VOID   FillDirList(HWND hwndDir, LPXDTALINK lpStart);
+LPXDTA DirViewGetItem(HWND hwndDir, INT iItem);
+LRESULT DirGetItem(HWND hwndLB, INT iItem, LPXDTA* plpxdta);
+VOID   DirViewFree(HWND hwndDir);
 VOID   CreateLBLine( DWORD dwLineFormat, LPXDTA lpxdta, LPTSTR szBuffer);
 INT    GetMaxExtent(HWND hwndLB, LPXDTALINK lpXDTA, BOOL bNTFS);
 VOID   UpdateSelection(HWND hwndLB);
@@ -454,14 +462,34 @@ VOID SetLBFont(HWND hwnd, HWND hwndLB, HANDLE hNewFont, DWORD dwViewFlags, LPXDT
 
 // WFDIRRD.C
 
+//
+// A read in progress, handed to the directory window with FS_DIRREADPROGRESS
+//
+typedef struct _DIRREADPROGRESS {
+   LPXDTALINK lpStart;
+   DWORD dwEntries;           // complete entries in lpStart
+   DWORD dwShown;             // entries handed over by earlier batches
+   LPXDTALINK lpLinkNext;     // link holding lpxdtaNext
+   LPXDTA lpxdtaNext;         // first entry after dwShown
+} DIRREADPROGRESS, *PDIRREADPROGRESS;
+
 BOOL  InitDirRead(VOID);
 VOID  DestroyDirRead(VOID);
 LPXDTALINK CreateDTABlock(HWND hwnd, LPWSTR pPath, DWORD dwAttribs, BOOL bDontSteal);
 VOID  FreeDTA(HWND hwnd);
 VOID  DirReadDestroyWindow(HWND hwndDir);
 LPXDTALINK DirReadDone(HWND hwndDir, LPXDTALINK lpStart, INT iError);
+BOOL  DirReadProgress(HWND hwndDir, UINT uSeq, PDIRREADPROGRESS pProgress);
 VOID  BuildDocumentString(VOID);
 VOID  BuildDocumentStringWorker(VOID);
+LPXDTALINK DirCacheLookup(LPWSTR pPath, DWORD dwAttribs);
+VOID  DirCacheInsert(LPWSTR pPath, DWORD dwAttribs, LPXDTALINK lpStart);
+VOID  DirCacheInvalidate(LPWSTR pPath);
+VOID  DirCacheFlush(VOID);
+VOID  DirCacheGetStats(LPDWORD pdwHits, LPDWORD pdwMisses);
+VOID  ProbeCacheInvalidate(LPWSTR pPath);
+VOID  ProbeCacheFlush(DRIVE drive);
+VOID  DirReadProbed(LPVOID lpProbed);
 
 // WFDIRSRC.C
 
@@ -515,6 +543,7 @@ UINT  FillDocType(PPDOCBUCKET ppDoc, LPCWSTR pszSection, LPCWSTR pszDefault);
 BOOL  CheckDirExists(LPWSTR szDir);
 
 DWORD StartBuildingDirectoryTrie();
+VOID  UpdateDirectoryTrie(DWORD dwFunction, LPTSTR szFrom, LPTSTR szTo);
 
 
 // WFCOPY.C
@@ -661,8 +690,8 @@ BOOL  RectTreeItem(HWND hwndLB,  INT iItem, BOOL bFocusOn);
 #define DO_LISTOFFILES      1L
 
 #define WS_MDISTYLE (WS_CHILD | WS_CLIPSIBLINGS | WS_CLIPCHILDREN | WS_SYSMENU | WS_CAPTION | WS_THICKFRAME | WS_MAXIMIZEBOX)
-#define WS_DIRSTYLE (WS_CHILD | LBS_SORT | LBS_NOTIFY | LBS_OWNERDRAWFIXED | LBS_EXTENDEDSEL | LBS_NOINTEGRALHEIGHT | LBS_WANTKEYBOARDINPUT)
-#define WS_SEARCHSTYLE  (WS_DIRSTYLE | LBS_HASSTRINGS | WS_VSCROLL)
+#define WS_DIRSTYLE (WS_CHILD | LBS_NODATA | LBS_NOTIFY | LBS_OWNERDRAWFIXED | LBS_EXTENDEDSEL | LBS_NOINTEGRALHEIGHT | LBS_WANTKEYBOARDINPUT)
+#define WS_SEARCHSTYLE  (WS_CHILD | LBS_SORT | LBS_NOTIFY | LBS_OWNERDRAWFIXED | LBS_EXTENDEDSEL | LBS_NOINTEGRALHEIGHT | LBS_WANTKEYBOARDINPUT | LBS_HASSTRINGS | WS_VSCROLL)
 
 
 //
@@ -681,9 +710,10 @@ BOOL  RectTreeItem(HWND hwndLB,  INT iItem, BOOL bFocusOn);
 // 5    VIEW         VIEW           INITIALDIRSEL
 // 6    SORT         SORT           NEXTHWND
 // 7    OLEDROP      n/a            OLEDROP
-// 8    ATTRIBS      ATTRIBS        
-// 9    FCSFLAG      FSCFLAG
-// 10   LASTFOCUS    LASTFOCUS
+// 8    ATTRIBS      ATTRIBS        HDTASTREAM
+// 9    FCSFLAG      FSCFLAG        HDTASORTED
+// 10   LASTFOCUS    LASTFOCUS      ALTNAMEEXTENT
+// 11                               HDTAORDER
 //
 
 
@@ -711,10 +741,15 @@ BOOL  RectTreeItem(HWND hwndLB,  INT iItem, BOOL bFocusOn);
 #define GWL_OLEDROP      (7*sizeof(LONG_PTR))
 
 #define GWL_ATTRIBS      (8*sizeof(LONG_PTR))
+#define GWL_HDTASTREAM   (8*sizeof(LONG_PTR))     // lpStart of a read still in progress
 
 #define GWL_FSCFLAG      (9*sizeof(LONG_PTR))
+#define GWL_HDTASORTED   (9*sizeof(LONG_PTR))     // LPXDTA array in listbox order, when there's no GWL_HDTAORDER
 
 #define GWL_LASTFOCUS    (10*sizeof(LONG_PTR))
+#define GWL_ALTNAMEEXTENT (10*sizeof(LONG_PTR))   // widest alternate name in GWL_HDTA
+
+#define GWL_HDTAORDER    (11*sizeof(LONG_PTR))    // GWL_HDTA's column order the listbox shows
 
 // szDrivesClass...
 
@@ -790,6 +825,9 @@ BOOL  RectTreeItem(HWND hwndLB,  INT iItem, BOOL bFocusOn);
 
 #define FS_ENABLEFSC               (WM_USER+0x121)
 #define FS_DISABLEFSC              (WM_USER+0x122)
+#define FS_GOTORESULTS             (WM_USER+0x123)
+#define FS_DIRREADPROGRESS         (WM_USER+0x124)
+#define FS_DIRREADPROBED           (WM_USER+0x125)
 
 #define ATTR_READWRITE      0x0000
 #define ATTR_READONLY       FILE_ATTRIBUTE_READONLY     // == 0x0001
@@ -1135,6 +1173,7 @@ JAPANEND
 
 Extern BOOL bMinOnRun        EQ( FALSE );
 Extern BOOL bIndexOnLaunch   EQ( TRUE );
+Extern BOOL bGotoRanked      EQ( TRUE );
 Extern BOOL bStatusBar       EQ( TRUE );
 
 Extern BOOL bDriveBar            EQ( TRUE );
@@ -1174,6 +1213,8 @@ Extern TCHAR        szUILanguage[]          EQ( TEXT("UILanguage") );
 
 Extern TCHAR        szMinOnRun[]            EQ( TEXT("MinOnRun") );
 Extern TCHAR        szIndexOnLaunch[]       EQ( TEXT("IndexOnLaunch") );
+Extern TCHAR        szGotoRanked[]          EQ( TEXT("GotoRanked") );
+Extern TCHAR        szGotoRoots[]           EQ( TEXT("GotoRoots") );
 Extern TCHAR        szStatusBar[]           EQ( TEXT("StatusBar") );
 Extern TCHAR        szSaveSettings[]        EQ( TEXT("Save Settings") );
 
@@ -1209,6 +1250,8 @@ Extern TCHAR        szUndelete[]            EQ( TEXT("UNDELETE.DLL") );
 Extern TCHAR        szDefPrograms[]         EQ( TEXT("EXE COM BAT PIF") );
 Extern TCHAR        szRoamINIPath[]         EQ( TEXT("\\Microsoft\\Winfile"));
 Extern TCHAR        szBaseINIFile[]         EQ( TEXT("WINFILE.INI") );
+Extern TCHAR        szGotoSnapshotFile[]    EQ( TEXT("GOTO-%s.IDX") );
+Extern TCHAR        szGotoLegacySnapshotFile[] EQ( TEXT("GOTO.IDX") );
 Extern TCHAR        szPrevious[]            EQ( TEXT("Previous") );
 Extern TCHAR        szSettings[]            EQ( TEXT("Settings") );
 Extern TCHAR        szInternational[]       EQ( TEXT("Intl") );